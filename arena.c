@@ -0,0 +1,316 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "arena.h"
+#include "container.h"
+#include "trace.h"
+
+// Alignment of the float buffers, one cache line
+#define ARENA_ALIGNMENT 64
+
+/*
+ * Function: arenaAlloc
+ * -------------------------------------------------------------------------------
+ * Allocates a cache line aligned float buffer.
+ * -------------------------------------------------------------------------------
+ */
+static float *arenaAlloc(size_t num_elements){
+	size_t bytes = (sizeof(float) * num_elements + ARENA_ALIGNMENT - 1) / ARENA_ALIGNMENT * ARENA_ALIGNMENT;
+	float *buf = aligned_alloc(ARENA_ALIGNMENT, bytes);
+	if (buf == NULL){
+		printf("ERROR: could not allocate %zu bytes\n", bytes);
+		exit(-1);
+	}
+	return buf;
+}
+
+/*
+ * Function: arenaSetup
+ * -------------------------------------------------------------------------------
+ * Sets up an arena around an input buffer, NULL to allocate one.
+ * -------------------------------------------------------------------------------
+ */
+static struct buffer_arena *arenaSetup(size_t const *dims, int num_dims, float *input, const struct pressio_library *lib){
+	struct buffer_arena *arena = calloc(1, sizeof(struct buffer_arena));
+	int i;
+
+	if (num_dims < 1 || num_dims > METRICS_MAX_DIMS){
+		printf("ERROR: Unsupported number of dimensions: %d\n", num_dims);
+		exit(-1);
+	}
+	arena->lib = lib;
+	arena->num_dims = num_dims;
+	arena->num_elements = 1;
+	for (i = 0; i < num_dims; i++){
+		arena->dims[i] = dims[i];
+		arena->num_elements *= dims[i];
+	}
+
+	arena->borrowed_input = input != NULL;
+	arena->input = input != NULL ? input : arenaAlloc(arena->num_elements);
+	arena->output = mmap(NULL, sizeof(float) * arena->num_elements, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (arena->output == MAP_FAILED){
+		perror("ERROR: ");
+		exit(-1);
+	}
+
+	arena->input_view = arena->lib->data_new_nonowning(pressio_float_dtype, arena->input, num_dims, arena->dims);
+	arena->compressed = arena->lib->data_new_empty(pressio_byte_dtype, 0, NULL);
+	arena->output_view = arena->lib->data_new_nonowning(pressio_float_dtype, arena->output, num_dims, arena->dims);
+	return arena;
+}
+
+/*
+ * Function: arenaCreate
+ * -------------------------------------------------------------------------------
+ * Allocates the input and output buffers of a field and their libpressio
+ * views. The compressed stream and the baseline are filled in later.
+ *
+ * dims: the data dimensions, dims[0] fastest varying
+ * num_dims: number of entries in dims
+ *
+ * returns: the arena, exits on failure
+ * -------------------------------------------------------------------------------
+ */
+struct buffer_arena *arenaCreate(size_t const *dims, int num_dims){
+	return arenaSetup(dims, num_dims, NULL, &PRESSIO_LINKED);
+}
+
+/*
+ * Function: arenaWrap
+ * -------------------------------------------------------------------------------
+ * Like arenaCreate, but the field is read in place from a buffer the caller
+ * owns (a NumPy array handed in from Python, for example). It must outlive
+ * the arena and is never written.
+ * -------------------------------------------------------------------------------
+ */
+struct buffer_arena *arenaWrap(size_t const *dims, int num_dims, float *input){
+	return arenaSetup(dims, num_dims, input, &PRESSIO_LINKED);
+}
+
+/*
+ * Function: arenaShare
+ * -------------------------------------------------------------------------------
+ * Makes an arena for another libpressio build (see library.h) that reads the
+ * input of an existing arena in place. The compressed stream, baseline and
+ * output are its own. The input must outlive the new arena.
+ * -------------------------------------------------------------------------------
+ */
+struct buffer_arena *arenaShare(struct buffer_arena *arena, const struct pressio_library *lib){
+	return arenaSetup(arena->dims, arena->num_dims, arena->input, lib);
+}
+
+/*
+ * Function: arenaLoad
+ * -------------------------------------------------------------------------------
+ * Reads a headerless binary float file, or an HDF5/NetCDF selection (see
+ * container.h), straight into the input buffer.
+ * -------------------------------------------------------------------------------
+ */
+void arenaLoad(struct buffer_arena *arena, const char *data_path){
+	int64_t span = traceBegin(TRACE_LOAD);
+	if (containerIsSpec(data_path)){
+		containerRead(data_path, arena->input, arena->num_elements);
+	} else {
+		FILE *fp = fopen(data_path, "rb");
+		if (fp == NULL){
+			perror("ERROR: ");
+			exit(-1);
+		}
+		if (fread(arena->input, sizeof(float), arena->num_elements, fp) != arena->num_elements){
+			printf("WARNING: %s is smaller than the given dimensions\n", data_path);
+		}
+		fclose(fp);
+	}
+	traceEnd(TRACE_LOAD, span, 0, 0, -1);
+}
+
+/*
+ * Function: arenaFieldDims
+ * -------------------------------------------------------------------------------
+ * Finds the dims of a field that were not given: from the metadata of an
+ * HDF5/NetCDF selection, or from the data_path.dims sidecar gen_field
+ * writes ("dims" and "type" lines, '#' starts a comment).
+ *
+ * dims: filled fastest first, as -d takes them
+ *
+ * returns: the number of dims, 0 when the field does not record them
+ * -------------------------------------------------------------------------------
+ */
+int arenaFieldDims(const char *data_path, size_t *dims){
+	if (containerIsSpec(data_path)){
+		return containerDims(data_path, dims);
+	}
+	char path[4096], line[1024];
+	int num_dims = 0;
+	snprintf(path, sizeof(path), "%s.dims", data_path);
+	FILE *fp = fopen(path, "r");
+	if (fp == NULL){
+		return 0;
+	}
+	while (fgets(line, sizeof(line), fp) != NULL){
+		char *comment = strchr(line, '#');
+		if (comment != NULL){
+			*comment = '\0';
+		}
+		char *tok = strtok(line, " \t\r\n");
+		if (tok == NULL){
+			continue;
+		}
+		if (strcmp(tok, "dims") == 0){
+			while ((tok = strtok(NULL, " \t\r\n")) != NULL && num_dims < METRICS_MAX_DIMS){
+				dims[num_dims++] = (size_t)atol(tok);
+			}
+		} else if (strcmp(tok, "type") == 0){
+			tok = strtok(NULL, " \t\r\n");
+			if (tok != NULL && strcmp(tok, "float32") != 0){
+				printf("ERROR: %s holds %s values, fields are read as float32\n", data_path, tok);
+				exit(-1);
+			}
+		}
+	}
+	fclose(fp);
+	return num_dims;
+}
+
+/*
+ * Function: arenaBaseline
+ * -------------------------------------------------------------------------------
+ * returns: the baseline buffer, allocating it on first use
+ * -------------------------------------------------------------------------------
+ */
+float *arenaBaseline(struct buffer_arena *arena){
+	if (arena->baseline == NULL){
+		arena->baseline = arenaAlloc(arena->num_elements);
+	}
+	return arena->baseline;
+}
+
+/*
+ * Function: arenaOutput
+ * -------------------------------------------------------------------------------
+ * returns: where the last decompression left its output, normally the arena
+ * output buffer
+ * -------------------------------------------------------------------------------
+ */
+const float *arenaOutput(struct buffer_arena *arena){
+	return (const float *)arena->lib->data_ptr(arena->output_view, NULL);
+}
+
+/*
+ * Function: arenaResetOutput
+ * -------------------------------------------------------------------------------
+ * Points the output view back at the arena buffer if a plugin replaced it.
+ * -------------------------------------------------------------------------------
+ */
+void arenaResetOutput(struct buffer_arena *arena){
+	if (arena->lib->data_ptr(arena->output_view, NULL) != arena->output){
+		arena->lib->data_free(arena->output_view);
+		arena->output_view = arena->lib->data_new_nonowning(pressio_float_dtype, arena->output, arena->num_dims, arena->dims);
+	}
+}
+
+/*
+ * Function: arenaLocalize
+ * -------------------------------------------------------------------------------
+ * Gives the calling process its own copy of the input, compressed stream and
+ * baseline, and a fresh shared output mapping. Called by a campaign worker
+ * after it is bound to a NUMA node, the copies are first touched there and
+ * so live in that node's memory. The inherited buffers are only released
+ * from this process; the parent's copies are untouched.
+ * -------------------------------------------------------------------------------
+ */
+void arenaLocalize(struct buffer_arena *arena){
+	size_t bytes = sizeof(float) * arena->num_elements;
+
+	float *input = arenaAlloc(arena->num_elements);
+	memcpy(input, arena->input, bytes);
+	arena->lib->data_free(arena->input_view);
+	if (!arena->borrowed_input){
+		free(arena->input);
+	}
+	arena->borrowed_input = 0;
+	arena->input = input;
+	arena->input_view = arena->lib->data_new_nonowning(pressio_float_dtype, arena->input, arena->num_dims, arena->dims);
+
+	if (arena->baseline != NULL){
+		float *baseline = arenaAlloc(arena->num_elements);
+		memcpy(baseline, arena->baseline, bytes);
+		free(arena->baseline);
+		arena->baseline = baseline;
+	}
+
+	size_t compressed_size;
+	const void *stream = arena->lib->data_ptr(arena->compressed, &compressed_size);
+	void *compressed = malloc(compressed_size);
+	if (compressed == NULL){
+		printf("ERROR: could not allocate %zu bytes\n", compressed_size);
+		exit(-1);
+	}
+	memcpy(compressed, stream, compressed_size);
+	arena->lib->data_free(arena->compressed);
+	arena->compressed = arena->lib->data_new_move(pressio_byte_dtype, compressed, 1, &compressed_size, pressio_data_libc_free_fn, NULL);
+
+	// Pages of the new output are touched first by this worker's trials
+	arena->lib->data_free(arena->output_view);
+	munmap(arena->output, bytes);
+	arena->output = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (arena->output == MAP_FAILED){
+		perror("ERROR: ");
+		exit(-1);
+	}
+	arena->output_view = arena->lib->data_new_nonowning(pressio_float_dtype, arena->output, arena->num_dims, arena->dims);
+}
+
+/*
+ * Function: arenaAttach
+ * -------------------------------------------------------------------------------
+ * Points the arena at a compressed stream and baseline kept elsewhere, so
+ * one loaded field can be injected with streams cached by the caller.
+ * Trials flip bits of the stream in place and restore them. Neither buffer
+ * is owned by the arena, arenaDetach must be called before they are freed.
+ *
+ * baseline: the stream decompressed fault-free, NULL if not needed
+ * -------------------------------------------------------------------------------
+ */
+void arenaAttach(struct buffer_arena *arena, void *stream, size_t compressed_size, float *baseline){
+	arena->lib->data_free(arena->compressed);
+	arena->compressed = arena->lib->data_new_nonowning(pressio_byte_dtype, stream, 1, &compressed_size);
+	free(arena->baseline);
+	arena->baseline = baseline;
+}
+
+/*
+ * Function: arenaDetach
+ * -------------------------------------------------------------------------------
+ * Forgets an attached stream and baseline without freeing them.
+ * -------------------------------------------------------------------------------
+ */
+void arenaDetach(struct buffer_arena *arena){
+	arena->lib->data_free(arena->compressed);
+	arena->compressed = arena->lib->data_new_empty(pressio_byte_dtype, 0, NULL);
+	arena->baseline = NULL;
+}
+
+/*
+ * Function: arenaFree
+ * -------------------------------------------------------------------------------
+ * Releases the views first, then the buffers they pointed at.
+ * -------------------------------------------------------------------------------
+ */
+void arenaFree(struct buffer_arena *arena){
+	if (arena == NULL){
+		return;
+	}
+	arena->lib->data_free(arena->input_view);
+	arena->lib->data_free(arena->compressed);
+	arena->lib->data_free(arena->output_view);
+	munmap(arena->output, sizeof(float) * arena->num_elements);
+	if (!arena->borrowed_input){
+		free(arena->input);
+	}
+	free(arena->baseline);
+	free(arena);
+}
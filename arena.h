@@ -0,0 +1,65 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+#include "libpressio.h"
+#include "library.h"
+#include "metrics.h"
+
+/*
+ * Buffer arena.
+ * -------------------------------------------------------------------------------
+ * Owns every large buffer of a campaign for its whole life: the input field,
+ * the compressed stream, the fault-free baseline and the output of the
+ * current trial. libpressio only ever sees non-owning views of the float
+ * buffers, so nothing is copied or freed behind our back:
+ *
+ *   input        read once from disk, compressed once
+ *   compressed   produced by the compressor and kept; trials flip a bit in
+ *                place and flip it back afterwards
+ *   baseline     the clean stream decompressed once, only when needed
+ *   output       shared (MAP_SHARED) mapping the trial decompresses into,
+ *                so forked trial workers write where the parent can see it
+ *
+ * Some compressor plugins replace the output buffer instead of filling it.
+ * arenaOutput then hands out the plugin's buffer so metrics still read the
+ * decompressed data in place, and arenaResetOutput points the view back at
+ * the arena before the next trial.
+ *
+ * The views belong to the libpressio build the arena was made for, the
+ * linked one unless made with arenaShare.
+ * -------------------------------------------------------------------------------
+ */
+struct buffer_arena {
+	// libpressio build the views below were made with
+	const struct pressio_library *lib;
+	size_t dims[METRICS_MAX_DIMS];
+	int num_dims;
+	size_t num_elements;
+
+	float *input;
+	// Input belongs to the caller (arenaWrap) and is never freed here
+	int borrowed_input;
+	float *baseline;
+	float *output;
+
+	struct pressio_data *input_view;
+	struct pressio_data *compressed;
+	struct pressio_data *output_view;
+};
+
+struct buffer_arena *arenaCreate(size_t const *dims, int num_dims);
+struct buffer_arena *arenaWrap(size_t const *dims, int num_dims, float *input);
+struct buffer_arena *arenaShare(struct buffer_arena *arena, const struct pressio_library *lib);
+void arenaLoad(struct buffer_arena *arena, const char *data_path);
+int arenaFieldDims(const char *data_path, size_t *dims);
+float *arenaBaseline(struct buffer_arena *arena);
+const float *arenaOutput(struct buffer_arena *arena);
+void arenaResetOutput(struct buffer_arena *arena);
+void arenaLocalize(struct buffer_arena *arena);
+void arenaAttach(struct buffer_arena *arena, void *stream, size_t compressed_size, float *baseline);
+void arenaDetach(struct buffer_arena *arena);
+void arenaFree(struct buffer_arena *arena);
+
+#endif
@@ -0,0 +1,337 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#include "batch.h"
+#include "arena.h"
+#include "container.h"
+#include "injector.h"
+#include "crash.h"
+#include "trace.h"
+
+/*
+ * Function: addField
+ * -------------------------------------------------------------------------------
+ * Appends a field to a growing list.
+ * -------------------------------------------------------------------------------
+ */
+static void addField(struct batch_field **fields, int *count, int *capacity, const char *path, const size_t *dims, int num_dims){
+	if (*count == *capacity){
+		*capacity = *capacity ? *capacity * 2 : 16;
+		*fields = realloc(*fields, sizeof(struct batch_field) * *capacity);
+		if (*fields == NULL){
+			printf("ERROR: could not allocate the batch manifest\n");
+			exit(-1);
+		}
+	}
+	struct batch_field *field = &(*fields)[(*count)++];
+	snprintf(field->path, sizeof(field->path), "%s", path);
+	memcpy(field->dims, dims, sizeof(size_t) * num_dims);
+	field->num_dims = num_dims;
+	if (num_dims < 1){
+		printf("ERROR: No dimensions for %s, give them in the manifest or with -d\n", path);
+		exit(-1);
+	}
+}
+
+static int compareFields(const void *a, const void *b){
+	return strcmp(((const struct batch_field *)a)->path, ((const struct batch_field *)b)->path);
+}
+
+/*
+ * Function: batchFields
+ * -------------------------------------------------------------------------------
+ * Lists the fields of a batch. A directory contributes each of its .bin,
+ * .dat and .f32 files in name order, so timesteps run in sequence.
+ *
+ * source: manifest file or directory
+ * default_dims: dimensions of fields that do not give their own
+ *
+ * returns: the number of fields, stored in a new array in *fields
+ * -------------------------------------------------------------------------------
+ */
+int batchFields(const char *source, const size_t *default_dims, int default_num_dims, struct batch_field **fields){
+	int count = 0, capacity = 0;
+	struct stat st;
+	char path[4096];
+
+	*fields = NULL;
+	if (stat(source, &st) != 0){
+		perror("ERROR: ");
+		exit(-1);
+	}
+
+	if (S_ISDIR(st.st_mode)){
+		DIR *dir = opendir(source);
+		struct dirent *entry;
+		if (dir == NULL){
+			perror("ERROR: ");
+			exit(-1);
+		}
+		while ((entry = readdir(dir)) != NULL){
+			const char *ext = strrchr(entry->d_name, '.');
+			if (entry->d_name[0] == '.' || ext == NULL || (strcmp(ext, ".bin") && strcmp(ext, ".dat") && strcmp(ext, ".f32"))){
+				continue;
+			}
+			snprintf(path, sizeof(path), "%s/%s", source, entry->d_name);
+			if (stat(path, &st) == 0 && S_ISREG(st.st_mode)){
+				size_t dims[METRICS_MAX_DIMS];
+				int num_dims = arenaFieldDims(path, dims);
+				if (num_dims){
+					addField(fields, &count, &capacity, path, dims, num_dims);
+				} else {
+					addField(fields, &count, &capacity, path, default_dims, default_num_dims);
+				}
+			}
+		}
+		closedir(dir);
+		qsort(*fields, count, sizeof(struct batch_field), compareFields);
+		return count;
+	}
+
+	FILE *fp = fopen(source, "r");
+	char line[8192];
+	if (fp == NULL){
+		perror("ERROR: ");
+		exit(-1);
+	}
+	while (fgets(line, sizeof(line), fp) != NULL){
+		size_t dims[METRICS_MAX_DIMS];
+		int num_dims = 0;
+		char *comment = strchr(line, '#');
+		if (comment != NULL){
+			*comment = '\0';
+		}
+		char *tok = strtok(line, " \t\r\n");
+		if (tok == NULL){
+			continue;
+		}
+		snprintf(path, sizeof(path), "%s", tok);
+		while ((tok = strtok(NULL, " \t\r\n")) != NULL && num_dims < METRICS_MAX_DIMS){
+			dims[num_dims++] = (size_t)atol(tok);
+		}
+		if (num_dims == 0){
+			num_dims = arenaFieldDims(path, dims);
+		}
+		if (num_dims){
+			addField(fields, &count, &capacity, path, dims, num_dims);
+		} else {
+			addField(fields, &count, &capacity, path, default_dims, default_num_dims);
+		}
+	}
+	fclose(fp);
+	return count;
+}
+
+/*
+ * A field moving through the pipeline.
+ */
+struct batch_slot {
+	const struct batch_field *field;
+	struct buffer_arena *arena;
+	// Rows of the field's campaign, copied to results_path by the writer
+	FILE *rows;
+	char results_path[4096];
+	double seconds;
+};
+
+/*
+ * Function: readField
+ * -------------------------------------------------------------------------------
+ * Reader stage: allocates the field's arena and reads it from disk.
+ * -------------------------------------------------------------------------------
+ */
+static void *readField(void *arg){
+	struct batch_slot *slot = arg;
+	struct timeval start, stop;
+
+	traceTrack(TRACE_TRACK_READER);
+	gettimeofday(&start, NULL);
+	slot->arena = arenaCreate(slot->field->dims, slot->field->num_dims);
+	arenaLoad(slot->arena, slot->field->path);
+	gettimeofday(&stop, NULL);
+	slot->seconds = elapsedSeconds(&start, &stop);
+	return NULL;
+}
+
+/*
+ * Function: writeField
+ * -------------------------------------------------------------------------------
+ * Output stage: stores the field's rows in its results file and makes them
+ * durable. The field's arena is left to the main thread, which may be
+ * forking while this runs, to release.
+ * -------------------------------------------------------------------------------
+ */
+static void *writeField(void *arg){
+	struct batch_slot *slot = arg;
+	char buf[65536];
+	size_t n;
+
+	traceTrack(TRACE_TRACK_WRITER);
+	int64_t span = traceBegin(TRACE_WRITE);
+	FILE *out = fopen(slot->results_path, "w");
+	if (out == NULL){
+		perror("ERROR: ");
+		exit(-1);
+	}
+	rewind(slot->rows);
+	while ((n = fread(buf, 1, sizeof(buf), slot->rows)) > 0){
+		fwrite(buf, 1, n, out);
+	}
+	fflush(out);
+	fsync(fileno(out));
+	fclose(out);
+	traceEnd(TRACE_WRITE, span, 0, 0, -1);
+	fclose(slot->rows);
+	return NULL;
+}
+
+/*
+ * Function: fieldResultsPaths
+ * -------------------------------------------------------------------------------
+ * Names each field's results file after the field, data/x/hurricane_1.bin
+ * becomes results_dir/hurricane_1.csv; containers are named by containerName.
+ * A field whose name is already taken (a/x.bin and b/x.bin) gets the
+ * first free suffix, results_dir/x_2.csv.
+ *
+ * paths: receives num_fields paths
+ * -------------------------------------------------------------------------------
+ */
+static void fieldResultsPaths(const struct batch_field *fields, int num_fields, const char *results_dir, char (*paths)[4096]){
+	int i, j, copy;
+
+	for (i = 0; i < num_fields; i++){
+		const char *field_path = fields[i].path;
+		char name[1024];
+		if (containerIsSpec(field_path)){
+			containerName(field_path, name, sizeof(name));
+		} else {
+			const char *file = strrchr(field_path, '/');
+			file = file ? file + 1 : field_path;
+			const char *ext = strrchr(file, '.');
+			int len = ext && ext != file ? (int)(ext - file) : (int)strlen(file);
+			snprintf(name, sizeof(name), "%.*s", len, file);
+		}
+		snprintf(paths[i], sizeof(paths[i]), "%s/%s.csv", results_dir, name);
+		for (copy = 2, j = 0; j < i; j++){
+			if (strcmp(paths[i], paths[j]) == 0){
+				snprintf(paths[i], sizeof(paths[i]), "%s/%s_%d.csv", results_dir, name, copy++);
+				j = -1;
+			}
+		}
+		if (copy > 2){
+			printf("WARNING: Results name of %s is taken, writing %s\n", field_path, paths[i]);
+		}
+	}
+}
+
+/*
+ * Function: runBatch
+ * -------------------------------------------------------------------------------
+ * Runs the campaign described by opts on every field, one results CSV per
+ * field in results_dir. The results path and stream of opts are ignored.
+ * -------------------------------------------------------------------------------
+ */
+void runBatch(const struct batch_field *fields, int num_fields, const struct campaign_options *opts, const char *results_dir){
+	pthread_t reader, writer;
+	int writing = 0;
+	int i;
+
+	if (mkdir(results_dir, 0755) != 0 && errno != EEXIST){
+		perror("ERROR: ");
+		exit(-1);
+	}
+	if (num_fields == 0){
+		printf("WARNING: No fields to run\n");
+		return;
+	}
+
+	char (*results_paths)[4096] = malloc(sizeof(*results_paths) * num_fields);
+	if (results_paths == NULL){
+		printf("ERROR: could not allocate %d results paths\n", num_fields);
+		exit(-1);
+	}
+	fieldResultsPaths(fields, num_fields, results_dir, results_paths);
+
+	struct batch_slot *written = NULL;
+	struct batch_slot *next = calloc(1, sizeof(struct batch_slot));
+	next->field = &fields[0];
+	if (pthread_create(&reader, NULL, readField, next) != 0){
+		printf("ERROR: could not start the reader thread\n");
+		exit(-1);
+	}
+
+	for (i = 0; i < num_fields; i++){
+		struct timeval wait_start, wait_stop, start, stop;
+
+		gettimeofday(&wait_start, NULL);
+		pthread_join(reader, NULL);
+		gettimeofday(&wait_stop, NULL);
+		struct batch_slot *slot = next;
+
+		// Read ahead while this field is injected
+		if (i + 1 < num_fields){
+			next = calloc(1, sizeof(struct batch_slot));
+			next->field = &fields[i + 1];
+			if (pthread_create(&reader, NULL, readField, next) != 0){
+				printf("ERROR: could not start the reader thread\n");
+				exit(-1);
+			}
+		}
+
+		printf("Batch Field %d/%d: %s (read %lfs, waited %lfs)\n", i + 1, num_fields, slot->field->path, slot->seconds, elapsedSeconds(&wait_start, &wait_stop));
+		gettimeofday(&start, NULL);
+		struct injector *inj = injectorCreate(opts->compressor, opts->error_bounding_mode, opts->error_bound, slot->arena);
+		crashRefreshModules();
+		if (opts->compressor_threads > 1){
+			injectorSetThreads(inj, opts->compressor_threads);
+		}
+		injectorCompress(inj);
+		if (campaignNeedsBaseline(opts)){
+			injectorBaseline(inj);
+		}
+		printf("Compression Ratio: %lf\n", inj->compression_ratio);
+		printf("Compressed Data Size: %zu\n", inj->compressed_size);
+		printf("Time to Compress: %lf\n", inj->compress_time);
+
+		struct campaign_options field_opts = *opts;
+		slot->rows = tmpfile();
+		if (slot->rows == NULL){
+			perror("ERROR: ");
+			exit(-1);
+		}
+		field_opts.results_path = NULL;
+		field_opts.results_file = slot->rows;
+		runCampaign(inj, &field_opts);
+		injectorFree(inj);
+		gettimeofday(&stop, NULL);
+		printf("Batch Field Time: %lf\n", elapsedSeconds(&start, &stop));
+
+		// Output of the previous field must be done before this one starts;
+		// its arena is released here, away from the forks of the campaigns
+		if (writing){
+			pthread_join(writer, NULL);
+			arenaFree(written->arena);
+			free(written);
+		}
+		snprintf(slot->results_path, sizeof(slot->results_path), "%s", results_paths[i]);
+		written = slot;
+		fflush(stdout);
+		if (pthread_create(&writer, NULL, writeField, slot) != 0){
+			printf("ERROR: could not start the writer thread\n");
+			exit(-1);
+		}
+		writing = 1;
+	}
+	pthread_join(writer, NULL);
+	arenaFree(written->arena);
+	free(written);
+	free(results_paths);
+	printf("Batch Fields: %d, results in %s\n", num_fields, results_dir);
+}
@@ -0,0 +1,43 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stddef.h>
+
+#include "campaign.h"
+#include "metrics.h"
+
+/*
+ * Batch campaigns over many fields and timesteps.
+ * -------------------------------------------------------------------------------
+ * Runs the same campaign on every field of a manifest, or every field file of
+ * a directory, in one process. Three stages overlap:
+ *
+ *   read     a reader thread loads field i+1 into its own arena
+ *   inject   the main thread compresses field i and runs its campaign
+ *   output   a writer thread stores the rows of field i-1 in its results
+ *            file; the main thread releases its arena once it is stored
+ *
+ * Each stage holds at most one field, so no more than three fields are ever
+ * in memory. The threads only read and write buffers; everything that
+ * touches the compressor, frees libpressio data or forks stays on the main
+ * thread.
+ *
+ * Results are named after their field, results_dir/x.csv for x.bin; fields
+ * of the same name (a/x.bin, b/x.bin) get x_2.csv and so on, in order.
+ *
+ * Manifest lines are "path [dim ...]", '#' starts a comment. Fields without
+ * dimensions, and every file of a directory, take them from their .dims
+ * sidecar (see gen_field.c) or container metadata, else use -d.
+ * -------------------------------------------------------------------------------
+ */
+
+struct batch_field {
+	char path[4096];
+	size_t dims[METRICS_MAX_DIMS];
+	int num_dims;
+};
+
+int batchFields(const char *source, const size_t *default_dims, int default_num_dims, struct batch_field **fields);
+void runBatch(const struct batch_field *fields, int num_fields, const struct campaign_options *opts, const char *results_dir);
+
+#endif
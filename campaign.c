@@ -0,0 +1,1011 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <poll.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include "campaign.h"
+#include "crash.h"
+#include "numa.h"
+#include "sketch.h"
+#include "telemetry.h"
+#include "trace.h"
+
+// Trial outcomes, in the order they are reported
+static const char *STATUS_NAMES[] = {
+	"Completed", "SegFault", "Timeout", "VersionError", "StepLengthError", "CoreDump", "MemoryCapExceeded", "Unknown"
+};
+#define STATUS_COUNT (sizeof(STATUS_NAMES) / sizeof(STATUS_NAMES[0]))
+
+// Optional metric columns reported as -1 when not computed
+#define PROPAGATION_NA "-1,-1,-1,-1,-1"
+#define SKETCH_NA "-1,-1,-1,-1,-1,-1,-1"
+
+/*
+ * Function: campaignHeader
+ * -------------------------------------------------------------------------------
+ * returns: the CSV header of campaign results
+ * -------------------------------------------------------------------------------
+ */
+const char *campaignHeader(void){
+	return "DataSize,CompressionRatio,ErrorInfo,ByteLocation,FlipLocation,DecompressionTime,Incorrect,MaxDifference,RMSE,PSNR,Status,Traceback,"
+		"ChangedElements,FirstChangedIndex,LastChangedIndex,ChangeBoundingBox,AffectedBlocks,"
+		"ErrorP50,ErrorP99,ErrorP999,NaNOutputs,InfOutputs,SubnormalOutputs,ErrorHistogram,"
+		"SSIM,PearsonCorrelation,RangeRelativeMaxError,MaxULP,MeanULP,"
+		"PeakRSSKB,Allocations,PeakHeapBytes,FailedAllocationBytes,GroupSize,Effect,Protection";
+}
+
+/*
+ * Function: campaignNeedsBaseline
+ * -------------------------------------------------------------------------------
+ * returns: nonzero if the campaign reads the fault-free output, for
+ * propagation metrics, group testing or classification
+ * -------------------------------------------------------------------------------
+ */
+int campaignNeedsBaseline(const struct campaign_options *opts){
+	return opts->propagation || opts->group_size > 1 || opts->classify_only;
+}
+
+/*
+ * Function: campaignPairHeader
+ * -------------------------------------------------------------------------------
+ * returns: the CSV header of an A/B campaign, one row per trial with the
+ * columns of build A (the linked one) and build B side by side
+ * -------------------------------------------------------------------------------
+ */
+const char *campaignPairHeader(void){
+	return "DataSize,CompressionRatioA,CompressionRatioB,ErrorInfo,ByteLocation,FlipLocation,StatusA,StatusB,"
+		"DecompressionTimeA,DecompressionTimeB,IncorrectA,IncorrectB,MaxDifferenceA,MaxDifferenceB,RMSEA,RMSEB,PSNRA,PSNRB,"
+		"EffectA,EffectB,PeakRSSKBA,PeakRSSKBB,SameOutput";
+}
+
+/*
+ * Function: campaignStatusName
+ * -------------------------------------------------------------------------------
+ * returns: the Status column of an outcome, NULL past the last one
+ * -------------------------------------------------------------------------------
+ */
+const char *campaignStatusName(int outcome){
+	if (outcome < 0 || outcome >= (int)STATUS_COUNT){
+		return NULL;
+	}
+	return STATUS_NAMES[outcome];
+}
+
+/*
+ * Function: trialMetrics
+ * -------------------------------------------------------------------------------
+ * Computes every requested metric of a decompressed output, reading it in
+ * place, and formats the metric columns of the CSV row into result.
+ * -------------------------------------------------------------------------------
+ */
+static void trialMetrics(struct injector *inj, const struct campaign_options *opts, const float *output, struct trial_result *result){
+	struct buffer_arena *arena = inj->arena;
+	struct error_sketch sketch;
+	size_t used = 0;
+	int d;
+
+	if (opts->classify_only){
+		if (opts->group_size > 1 && result->identical){
+			result->effect = EFFECT_BENIGN;
+		} else {
+			result->effect = classifyOutput(arena->input, arena->baseline, output, arena->num_elements, opts->error_bounding_mode, opts->error_bound, opts->default_bound, inj->baseline_violates);
+		}
+		struct error_metrics classified = { result->effect == EFFECT_VIOLATION ? 1 : result->effect == EFFECT_CHANGED ? -1 : 0, -1, -1, -1 };
+		result->errors = classified;
+		snprintf(result->metrics, sizeof(result->metrics), "%d,-1,-1,-1", classified.number_of_incorrect);
+		snprintf(result->extra, sizeof(result->extra), PROPAGATION_NA "," SKETCH_NA ",-1,-1,-1,-1,-1");
+		return;
+	}
+
+	if (opts->sketch){
+		sketchInit(&sketch, 0);
+	}
+	// Quality metrics other than SSIM come out of the same pass
+	struct quality_metrics qm;
+	int q = opts->quality_selected;
+	qualityInit(&qm, q);
+	calculateErrorMetrics(arena->input, output, arena->num_elements, opts->error_bounding_mode, opts->error_bound, opts->default_bound, opts->sketch ? &sketch : NULL, q ? &qm : NULL, 0, &result->errors);
+	snprintf(result->metrics, sizeof(result->metrics), "%d,%f,%f,%f", result->errors.number_of_incorrect, result->errors.max_diff, result->errors.rmse, result->errors.psnr);
+
+	size_t changed_elements = 0;
+	if (opts->propagation){
+		struct propagation_metrics pm;
+		calculatePropagation(arena->baseline, output, arena->dims, arena->num_dims, opts->block_edge, &pm);
+		changed_elements = pm.changed;
+		used += snprintf(result->extra + used, sizeof(result->extra) - used, "%zu,%lld,%lld,", pm.changed, pm.first_changed, pm.last_changed);
+		if (pm.changed == 0){
+			used += snprintf(result->extra + used, sizeof(result->extra) - used, "NA");
+		}
+		for (d = 0; d < arena->num_dims && pm.changed; d++){
+			used += snprintf(result->extra + used, sizeof(result->extra) - used, "%s%zu:%zu", d ? " " : "", pm.box_min[d], pm.box_max[d]);
+		}
+		used += snprintf(result->extra + used, sizeof(result->extra) - used, ",%zu", pm.affected_blocks);
+	} else {
+		used += snprintf(result->extra + used, sizeof(result->extra) - used, PROPAGATION_NA);
+	}
+
+	if (opts->sketch){
+		used += snprintf(result->extra + used, sizeof(result->extra) - used, ",%e,%e,%e,%llu,%llu,%llu,",
+			sketchQuantile(&sketch, 0.5), sketchQuantile(&sketch, 0.99), sketchQuantile(&sketch, 0.999),
+			(unsigned long long)sketch.nan_outputs, (unsigned long long)sketch.inf_outputs, (unsigned long long)sketch.subnormal_outputs);
+		used += sketchFormatHistogram(&sketch, result->extra + used, sizeof(result->extra) - used);
+		sketchFree(&sketch);
+	} else {
+		used += snprintf(result->extra + used, sizeof(result->extra) - used, "," SKETCH_NA);
+	}
+
+	if (q){
+		calculateSSIM(arena->input, output, arena->dims, arena->num_dims, &qm);
+	}
+	char ssim[32] = "-1", pearson[32] = "-1", range[32] = "-1", max_ulp[32] = "-1", mean_ulp[32] = "-1";
+	if (q & QUALITY_SSIM){
+		snprintf(ssim, sizeof(ssim), "%f", qm.ssim);
+	}
+	if (q & QUALITY_PEARSON){
+		snprintf(pearson, sizeof(pearson), "%f", qm.pearson);
+	}
+	if (q & QUALITY_RANGE){
+		snprintf(range, sizeof(range), "%e", qm.range_rel_max_error);
+	}
+	if (q & QUALITY_ULP){
+		snprintf(max_ulp, sizeof(max_ulp), "%.0f", qm.max_ulp);
+		snprintf(mean_ulp, sizeof(mean_ulp), "%f", qm.mean_ulp);
+	}
+	if (used < sizeof(result->extra)){
+		snprintf(result->extra + used, sizeof(result->extra) - used, ",%s,%s,%s,%s,%s", ssim, pearson, range, max_ulp, mean_ulp);
+	}
+
+	// Only a known unchanged output tells a benign trial from one within the bound
+	int unchanged = -1;
+	if (opts->propagation){
+		unchanged = changed_elements == 0;
+	} else if (opts->group_size > 1){
+		unchanged = result->identical;
+	}
+	if (unchanged == 1){
+		result->effect = EFFECT_BENIGN;
+	} else if (unchanged == 0){
+		result->effect = result->errors.number_of_incorrect > 0 ? EFFECT_VIOLATION : result->errors.number_of_incorrect == 0 ? EFFECT_WITHIN_BOUND : EFFECT_CHANGED;
+	}
+}
+
+/*
+ * Function: parseTraceback
+ * -------------------------------------------------------------------------------
+ * Pulls the "/module(+offset)" frames out of the "Receiving Sig N: " line
+ * written by the crash handler and joins them with " <- ", the Traceback
+ * format comp_inj_runner.py has always written. crash_buckets.py
+ * symbolizes and buckets them offline.
+ * -------------------------------------------------------------------------------
+ */
+static void parseTraceback(const char *output, char *traceback, size_t size){
+	const char *line = strstr(output, "Receiving Sig ");
+	size_t used = 0;
+
+	snprintf(traceback, size, "Unknown");
+	if (line == NULL){
+		return;
+	}
+	const char *end = strchr(line, '\n');
+	if (end == NULL){
+		end = line + strlen(line);
+	}
+	const char *p = line;
+	while (p < end && used + 1 < size){
+		const char *start = memchr(p, '/', end - p);
+		if (start == NULL){
+			break;
+		}
+		const char *close = memchr(start, ')', end - start);
+		if (close == NULL){
+			break;
+		}
+		while (close + 1 < end && close[1] == ')'){
+			close++;
+		}
+		int n = snprintf(traceback + used, size - used, "%s%.*s", used ? " <- " : "", (int)(close - start + 1), start);
+		if (n < 0 || (size_t)n >= size - used){
+			break;
+		}
+		used += n;
+		p = close + 1;
+	}
+	if (used == 0){
+		snprintf(traceback, size, "Unknown");
+	}
+}
+
+/*
+ * Function: collectOutput
+ * -------------------------------------------------------------------------------
+ * Reads a trial's stdout until it exits or the deadline passes. Output past
+ * CAMPAIGN_OUTPUT_LIMIT is drained and dropped so the trial never blocks.
+ *
+ * returns: 1 if the trial timed out
+ * -------------------------------------------------------------------------------
+ */
+static int collectOutput(int fd, const struct timeval *deadline, char *buf, size_t size){
+	size_t used = 0;
+	char scratch[4096];
+
+	for (;;){
+		struct timeval now;
+		gettimeofday(&now, NULL);
+		long remaining = (deadline->tv_sec - now.tv_sec) * 1000 + (deadline->tv_usec - now.tv_usec) / 1000;
+		if (remaining <= 0){
+			buf[used] = '\0';
+			return 1;
+		}
+
+		struct pollfd pfd = { fd, POLLIN, 0 };
+		int ready = poll(&pfd, 1, remaining);
+		if (ready < 0){
+			if (errno == EINTR){
+				continue;
+			}
+			break;
+		}
+		if (ready == 0){
+			continue;
+		}
+
+		ssize_t n;
+		if (used + 1 < size){
+			n = read(fd, buf + used, size - used - 1);
+		} else {
+			n = read(fd, scratch, sizeof(scratch));
+		}
+		if (n < 0 && errno == EINTR){
+			continue;
+		}
+		if (n <= 0){
+			break;
+		}
+		if (used + 1 < size){
+			used += n;
+		}
+	}
+	buf[used] = '\0';
+	return 0;
+}
+
+/*
+ * Function: classifyTrial
+ * -------------------------------------------------------------------------------
+ * Maps how a trial ended onto the runner's outcome classes.
+ *
+ * returns: an index into STATUS_NAMES
+ * -------------------------------------------------------------------------------
+ */
+static int classifyTrial(const struct trial_result *result, int capped, int timed_out, int status, const char *output){
+	if (result->completed){
+		return 0;
+	}
+	if (timed_out){
+		return 2;
+	}
+	// Whatever crashed, it started with an allocation the cap refused; under
+	// a cap, a SIGKILL we did not send is the kernel's OOM killer. Without
+	// one it may be anyone's and stays Unknown.
+	if (capped && (result->memory.failed || (WIFSIGNALED(status) && WTERMSIG(status) == SIGKILL))){
+		return 6;
+	}
+	if (WIFSIGNALED(status) && WCOREDUMP(status)){
+		return 5;
+	}
+	if (strstr(output, "Wrong version")){
+		return 3;
+	}
+	if (strstr(output, "Sig 11") || (WIFSIGNALED(status) && WTERMSIG(status) == SIGSEGV)){
+		return 1;
+	}
+	if (strstr(output, "stepLength")){
+		return 4;
+	}
+	// Other crash signals used to leave a core file behind
+	if (strstr(output, "Receiving Sig ")){
+		return 5;
+	}
+	return 7;
+}
+
+/*
+ * Function: profileAdd
+ * -------------------------------------------------------------------------------
+ * Adds seconds to a profile counter, in nanoseconds.
+ * -------------------------------------------------------------------------------
+ */
+static void profileAdd(long *counter, double seconds){
+	__sync_fetch_and_add(counter, (long)(seconds * 1e9));
+}
+
+/*
+ * Function: profileDecompression
+ * -------------------------------------------------------------------------------
+ * Splits the wall time of one forked decompression over the profile.
+ * -------------------------------------------------------------------------------
+ */
+static void profileDecompression(struct campaign_profile *profile, const struct trial_result *result, int outcome, double seconds){
+	long ns = (long)(seconds * 1e9), max;
+
+	__sync_fetch_and_add(&profile->decompressions, 1);
+	if (result->completed){
+		profileAdd(&profile->flip_ns, result->flip_time);
+		profileAdd(&profile->decompress_ns, result->decompress_time);
+		profileAdd(&profile->metrics_ns, result->metrics_time);
+		profileAdd(&profile->process_ns, seconds - result->flip_time - result->decompress_time - result->metrics_time);
+	} else {
+		profileAdd(&profile->decompress_ns, seconds);
+	}
+	if (outcome < CAMPAIGN_PROFILE_OUTCOMES){
+		__sync_fetch_and_add(&profile->outcome_count[outcome], 1);
+		__sync_fetch_and_add(&profile->outcome_ns[outcome], ns);
+		while ((max = profile->outcome_max_ns[outcome]) < ns && !__sync_bool_compare_and_swap(&profile->outcome_max_ns[outcome], max, ns)){
+		}
+	}
+}
+
+/*
+ * Function: forkTrial
+ * -------------------------------------------------------------------------------
+ * Flips count consecutive stream bits from first_bit (byte * 8 + bit), or
+ * the count bits listed in bits, decompresses in a forked child and
+ * classifies how it ended. When group
+ * testing, the child also compares the output with the baseline and skips
+ * the metrics of a group that cannot be cleared.
+ *
+ * output: receives what the child printed
+ * usage: receives the child's resource usage
+ *
+ * returns: the outcome, an index into STATUS_NAMES
+ * -------------------------------------------------------------------------------
+ */
+static int forkTrial(struct injector *inj, const struct campaign_options *opts, struct trial_result *result, char *output, const int *bits, int first_bit, int count, struct rusage *usage){
+	int fds[2];
+	int status = 0;
+	int timed_out;
+	int grouping = opts->group_size > 1;
+	struct timeval start, end;
+	pid_t pid;
+
+	traceSample();
+	int64_t span = traceBegin(TRACE_TRIAL);
+	gettimeofday(&start, NULL);
+	result->completed = 0;
+	result->identical = 0;
+	result->effect = -1;
+	result->protect.status = -1;
+	memset(&result->memory, 0, sizeof(struct memcap_stats));
+	// Checked once per process, before the first trial child needs it
+	if (opts->classify_only && inj->baseline_violates < 0){
+		struct buffer_arena *arena = inj->arena;
+		inj->baseline_violates = baselineViolates(arena->input, arena->baseline, arena->num_elements, opts->error_bounding_mode, opts->error_bound, opts->default_bound);
+	}
+	fflush(stdout);
+	if (pipe(fds) != 0){
+		perror("ERROR: ");
+		exit(-1);
+	}
+
+	pid = fork();
+	if (pid < 0){
+		perror("ERROR: ");
+		exit(-1);
+	}
+	if (pid == 0){
+		// Trial worker: anything the decompressor prints goes to the parent
+		close(fds[0]);
+		dup2(fds[1], STDOUT_FILENO);
+		close(fds[1]);
+		if (opts->crash_handler){
+			crashInstall();
+		}
+
+		struct timeval phase_start, phase_end;
+		gettimeofday(&phase_start, NULL);
+		// Verification lands in shared memory even if the decompression crashes
+		inj->check = &result->protect;
+		memcapInstall(&result->memory, (size_t)opts->memory_limit_mb * 1024 * 1024);
+		const float *decompressed = bits ? injectorScatterTrial(inj, bits, count, &result->decompress_time)
+			: injectorGroupTrial(inj, first_bit, count, &result->decompress_time);
+		memcapRemove();
+		// A plugin that replaced the output buffer (SZ) left the output in
+		// this child's memory, copy it where the parent can read it
+		if (decompressed != inj->arena->output){
+			memcpy(inj->arena->output, decompressed, sizeof(float) * inj->arena->num_elements);
+			decompressed = inj->arena->output;
+		}
+		gettimeofday(&phase_end, NULL);
+		result->flip_time = elapsedSeconds(&phase_start, &phase_end) - result->decompress_time;
+		if (grouping){
+			result->identical = memcmp(decompressed, inj->arena->baseline, sizeof(float) * inj->arena->num_elements) == 0;
+		}
+		int64_t metrics_span = traceBegin(TRACE_METRICS);
+		if (!grouping || count == 1 || result->identical || opts->group_within_bound){
+			trialMetrics(inj, opts, decompressed, result);
+		}
+		traceEnd(TRACE_METRICS, metrics_span, first_bit, count, -1);
+		gettimeofday(&phase_start, NULL);
+		result->metrics_time = elapsedSeconds(&phase_end, &phase_start);
+		result->completed = 1;
+		fflush(stdout);
+		_exit(0);
+	}
+
+	close(fds[1]);
+	struct timeval deadline;
+	gettimeofday(&deadline, NULL);
+	deadline.tv_sec += opts->timeout_limit;
+	timed_out = collectOutput(fds[0], &deadline, output, CAMPAIGN_OUTPUT_LIMIT);
+	int64_t crash_span = traceBegin(TRACE_CRASH);
+	if (timed_out){
+		kill(pid, SIGKILL);
+	}
+	close(fds[0]);
+	memset(usage, 0, sizeof(struct rusage));
+	while (wait4(pid, &status, 0, usage) < 0 && errno == EINTR){
+	}
+
+	int outcome = classifyTrial(result, opts->memory_limit_mb > 0, timed_out, status, output);
+	if (outcome != 0){
+		traceEnd(TRACE_CRASH, crash_span, first_bit, count, outcome);
+	}
+	traceEnd(TRACE_TRIAL, span, first_bit, count, outcome);
+	if (opts->profile){
+		gettimeofday(&end, NULL);
+		profileDecompression(opts->profile, result, outcome, elapsedSeconds(&start, &end));
+	}
+	return outcome;
+}
+
+/*
+ * Function: writeTrial
+ * -------------------------------------------------------------------------------
+ * Writes the CSV row of one (byte, bit) trial to out and its record to
+ * record, either of which may be NULL.
+ *
+ * group: bits decompressed together to classify this one, 1 if alone
+ * -------------------------------------------------------------------------------
+ */
+static void writeTrial(struct injector *inj, const struct campaign_options *opts, const struct trial_result *result, const char *output, int outcome, int byte, int bit, int group, const struct rusage *usage, FILE *out, struct trial_record *record){
+	char traceback[4096] = "NA";
+	struct timeval start, end;
+	int64_t span = traceBegin(TRACE_WRITE);
+	gettimeofday(&start, NULL);
+	if (outcome == 1 || (outcome == 5 && strstr(output, "Receiving Sig "))){
+		parseTraceback(output, traceback, sizeof(traceback));
+	}
+
+	if (record){
+		struct error_metrics none = { -1, -1, -1, -1 };
+		record->byte = byte;
+		record->bit = bit;
+		record->status = outcome;
+		record->group_size = group;
+		record->effect = outcome == 0 ? result->effect : -1;
+		record->decompress_time = outcome == 0 ? result->decompress_time : outcome == 2 ? opts->timeout_limit : -1;
+		record->errors = outcome == 0 ? result->errors : none;
+		record->peak_rss_kb = usage->ru_maxrss;
+		record->allocations = result->memory.allocations;
+		record->peak_heap_bytes = result->memory.peak_bytes;
+		record->failed_allocation_bytes = result->memory.failed_size;
+	}
+	if (out == NULL){
+		if (opts->profile){
+			gettimeofday(&end, NULL);
+			profileAdd(&opts->profile->output_ns, elapsedSeconds(&start, &end));
+		}
+		traceEnd(TRACE_WRITE, span, 8 * byte + bit, 1, outcome);
+		return;
+	}
+
+	fprintf(out, "%ld,", (long)(sizeof(float) * inj->arena->num_elements));
+	if (outcome == 0){
+		fprintf(out, "%lf,%0.12f,%d,%d,%lf,%s,%s,NA,%s", inj->compression_ratio, opts->error_bound, byte, bit, result->decompress_time, result->metrics, STATUS_NAMES[outcome], result->extra);
+	} else {
+		char time_taken[32] = "-1";
+		if (outcome == 2){
+			snprintf(time_taken, sizeof(time_taken), "%d", opts->timeout_limit);
+		}
+		fprintf(out, "-1,%0.12f,%d,%d,%s,-1,-1,-1,-1,%s,%s,%s,%s,-1,-1,-1,-1,-1", opts->error_bound, byte, bit, time_taken, STATUS_NAMES[outcome], traceback, PROPAGATION_NA, SKETCH_NA);
+	}
+	fprintf(out, ",%ld,%lu,%zu,%zu,%d,%s,%s\n", usage->ru_maxrss, result->memory.allocations, result->memory.peak_bytes, result->memory.failed_size, group,
+		effectName(outcome == 0 ? result->effect : -1), protectStatusName(result->protect.status));
+	fflush(out);
+	if (opts->profile){
+		gettimeofday(&end, NULL);
+		profileAdd(&opts->profile->output_ns, elapsedSeconds(&start, &end));
+	}
+	traceEnd(TRACE_WRITE, span, 8 * byte + bit, 1, outcome);
+}
+
+/*
+ * Function: runTrial
+ * -------------------------------------------------------------------------------
+ * Runs one (byte, bit) trial in a forked child and writes its CSV row to
+ * out and its record to record, either of which may be NULL.
+ *
+ * returns: the outcome, an index into STATUS_NAMES
+ * -------------------------------------------------------------------------------
+ */
+static int runTrial(struct injector *inj, const struct campaign_options *opts, struct trial_result *result, char *output, int byte, int bit, FILE *out, struct trial_record *record){
+	struct rusage usage;
+	int outcome = forkTrial(inj, opts, result, output, NULL, 8 * byte + bit, 1, &usage);
+	writeTrial(inj, opts, result, output, outcome, byte, bit, 1, &usage, out, record);
+	return outcome;
+}
+
+/*
+ * Function: runPair
+ * -------------------------------------------------------------------------------
+ * Runs one (byte, bit) trial against both builds of an A/B campaign, one
+ * after the other, and writes their paired CSV row to out. SameOutput
+ * compares the two decompressed outputs, each left in its build's arena
+ * output, when both trials completed, NA otherwise.
+ *
+ * returns: the outcome of build A
+ * -------------------------------------------------------------------------------
+ */
+static int runPair(struct injector *inj, const struct campaign_options *opts, struct trial_result *result, char *output, int byte, int bit, FILE *out){
+	struct injector *variant = opts->variant;
+	struct trial_record a, b;
+	struct rusage usage;
+	const char *same = "NA";
+
+	int outcome = forkTrial(inj, opts, result, output, NULL, 8 * byte + bit, 1, &usage);
+	writeTrial(inj, opts, result, output, outcome, byte, bit, 1, &usage, NULL, &a);
+
+	int variant_outcome = forkTrial(variant, opts, result, output, NULL, 8 * byte + bit, 1, &usage);
+	writeTrial(variant, opts, result, output, variant_outcome, byte, bit, 1, &usage, NULL, &b);
+	if (outcome == 0 && variant_outcome == 0){
+		same = memcmp(inj->arena->output, variant->arena->output, sizeof(float) * inj->arena->num_elements) == 0 ? "1" : "0";
+	}
+
+	fprintf(out, "%ld,%lf,%lf,%0.12f,%d,%d,%s,%s,%lf,%lf,%d,%d,%f,%f,%f,%f,%f,%f,%s,%s,%ld,%ld,%s\n", (long)(sizeof(float) * inj->arena->num_elements),
+		inj->compression_ratio, variant->compression_ratio, opts->error_bound, byte, bit, STATUS_NAMES[a.status], STATUS_NAMES[b.status],
+		a.decompress_time, b.decompress_time, a.errors.number_of_incorrect, b.errors.number_of_incorrect, a.errors.max_diff, b.errors.max_diff,
+		a.errors.rmse, b.errors.rmse, a.errors.psnr, b.errors.psnr, effectName(a.effect), effectName(b.effect), a.peak_rss_kb, b.peak_rss_kb, same);
+	fflush(out);
+	return outcome;
+}
+
+/*
+ * State shared by every worker of a campaign.
+ */
+struct campaign_shared {
+	// Next byte to hand out
+	int next_byte;
+	// Decompressions run by group testing, to compare with the trials
+	long decompressions;
+	// Trials by protection outcome, and the nanoseconds spent verifying
+	long protection[PROTECT_DETECTED + 1];
+	long verify_ns;
+	// When each worker ran out of bytes, for the idle spans of the trace
+	int64_t worker_done[TELEMETRY_MAX_WORKERS];
+	// Trial and outcome counters, mapped separately
+	struct campaign_telemetry *telemetry;
+};
+
+/*
+ * State of one worker, passed down the group testing recursion.
+ */
+struct campaign_worker {
+	struct injector *inj;
+	const struct campaign_options *opts;
+	struct campaign_shared *shared;
+	struct trial_result *result;
+	char *output;
+	FILE *out;
+	int worker;
+	int report;
+};
+
+/*
+ * Function: recordTrials
+ * -------------------------------------------------------------------------------
+ * Counts count trials of one outcome that took seconds altogether.
+ * -------------------------------------------------------------------------------
+ */
+static void recordTrials(struct campaign_worker *w, int outcome, int count, double seconds){
+	int i;
+	for (i = 0; i < count; i++){
+		telemetryRecord(w->shared->telemetry, w->worker, outcome, seconds / count);
+	}
+	if (w->result->protect.status >= 0){
+		__sync_fetch_and_add(&w->shared->protection[w->result->protect.status], count);
+		__sync_fetch_and_add(&w->shared->verify_ns, (long)(w->result->protect.verify_time * 1e9));
+	}
+	if (w->report){
+		telemetryTick(w->shared->telemetry, w->opts->telemetry_path, w->opts->telemetry_interval, STATUS_NAMES, STATUS_COUNT);
+	}
+}
+
+/*
+ * Function: trialRecord
+ * -------------------------------------------------------------------------------
+ * returns: where the record of stream bit b goes, NULL without records
+ * -------------------------------------------------------------------------------
+ */
+static struct trial_record *trialRecord(const struct campaign_options *opts, int b){
+	return opts->records ? &opts->records[b - 8 * opts->start_byte] : NULL;
+}
+
+/*
+ * Function: testGroup
+ * -------------------------------------------------------------------------------
+ * Classifies stream bits [first, last) with as few decompressions as it
+ * can. The whole group is tried once; if that clears it, every bit gets the
+ * group's row. Otherwise each half is tested the same way, down to single
+ * bits. A group known to fail whose first half was cleared must fail in
+ * its second half, which is then split without being tried whole.
+ *
+ * known_failing: nonzero to skip trying this group whole
+ *
+ * returns: nonzero if the group was cleared
+ * -------------------------------------------------------------------------------
+ */
+static int testGroup(struct campaign_worker *w, int first, int last, int known_failing){
+	const struct campaign_options *opts = w->opts;
+	struct trial_result *result = w->result;
+	int count = last - first;
+	struct timeval start, end;
+	struct rusage usage;
+	int b;
+
+	if (!known_failing || count == 1){
+		gettimeofday(&start, NULL);
+		int outcome = forkTrial(w->inj, opts, result, w->output, NULL, first, count, &usage);
+		gettimeofday(&end, NULL);
+		__sync_fetch_and_add(&w->shared->decompressions, 1);
+
+		int cleared = outcome == 0 && (result->identical || (opts->group_within_bound && result->errors.number_of_incorrect == 0));
+		if (count == 1 || cleared){
+			for (b = first; b < last; b++){
+				writeTrial(w->inj, opts, result, w->output, outcome, b / 8, b % 8, count, &usage, w->out, trialRecord(opts, b));
+			}
+			recordTrials(w, outcome, count, elapsedSeconds(&start, &end));
+			return cleared;
+		}
+	}
+
+	int middle = first + count / 2;
+	int first_cleared = testGroup(w, first, middle, 0);
+	testGroup(w, middle, last, first_cleared);
+	return 0;
+}
+
+/*
+ * Function: campaignTrials
+ * -------------------------------------------------------------------------------
+ * Takes bytes from the shared counter until none are left and runs all
+ * 8 trials of each one, writing rows to out. When group testing, the bytes
+ * of one group are taken together.
+ *
+ * worker: index of the calling worker in the telemetry
+ * report: nonzero if this process also rewrites the telemetry file
+ * -------------------------------------------------------------------------------
+ */
+static void campaignTrials(struct injector *inj, const struct campaign_options *opts, struct campaign_shared *shared, int end_byte, FILE *out, int worker, int report){
+	int group = opts->group_size > 1 ? opts->group_size : 1;
+	int step = (group + 7) / 8;
+	int byte, b;
+
+	// Shared with the trial workers so they can hand back their results
+	struct trial_result *result = mmap(NULL, sizeof(struct trial_result), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (result == MAP_FAILED){
+		perror("ERROR: ");
+		exit(-1);
+	}
+	struct campaign_worker w = { inj, opts, shared, result, malloc(CAMPAIGN_OUTPUT_LIMIT), out, worker, report };
+
+	while ((byte = __sync_fetch_and_add(&shared->next_byte, step)) <= end_byte){
+		int last = 8 * (byte + step > end_byte + 1 ? end_byte + 1 : byte + step);
+		if (group == 1){
+			for (b = 8 * byte; b < last; b++){
+				struct timeval start, end;
+				gettimeofday(&start, NULL);
+				int outcome = opts->variant ? runPair(inj, opts, result, w.output, b / 8, b % 8, out)
+					: runTrial(inj, opts, result, w.output, b / 8, b % 8, out, trialRecord(opts, b));
+				gettimeofday(&end, NULL);
+				recordTrials(&w, outcome, 1, elapsedSeconds(&start, &end));
+			}
+			continue;
+		}
+		for (b = 8 * byte; b < last; b += group){
+			testGroup(&w, b, b + group < last ? b + group : last, 0);
+		}
+	}
+
+	free(w.output);
+	munmap(result, sizeof(struct trial_result));
+}
+
+/*
+ * Function: campaignSerialTrials
+ * -------------------------------------------------------------------------------
+ * Forked trials always run serially: they already run one per worker, and
+ * an OpenMP pool made before fork() is not usable in a trial child, whose
+ * parallel regions can hang until the trial times out. Drops the
+ * compressor of inj, and of variant unless NULL, to one thread, its OpenMP
+ * runtime and OMP_NUM_THREADS included, keeping what they had in saved.
+ * -------------------------------------------------------------------------------
+ */
+void campaignSerialTrials(struct injector *inj, struct injector *variant, struct trial_threads *saved){
+	const char *omp = getenv("OMP_NUM_THREADS");
+
+	saved->threads = inj->threads;
+	saved->variant_threads = variant ? variant->threads : 1;
+	saved->omp_set = omp != NULL;
+	snprintf(saved->omp, sizeof(saved->omp), "%s", omp ? omp : "");
+	setenv("OMP_NUM_THREADS", "1", 1);
+	injectorSetThreads(inj, 1);
+	if (variant){
+		injectorSetThreads(variant, 1);
+	}
+}
+
+/*
+ * Function: campaignRestoreThreads
+ * -------------------------------------------------------------------------------
+ * Gives the compressors back the threads campaignSerialTrials took, for
+ * whatever compresses after the trials.
+ * -------------------------------------------------------------------------------
+ */
+void campaignRestoreThreads(struct injector *inj, struct injector *variant, const struct trial_threads *saved){
+	if (saved->omp_set){
+		setenv("OMP_NUM_THREADS", saved->omp, 1);
+	} else {
+		unsetenv("OMP_NUM_THREADS");
+	}
+	if (saved->threads > 1){
+		injectorSetThreads(inj, saved->threads);
+	}
+	if (variant && saved->variant_threads > 1){
+		injectorSetThreads(variant, saved->variant_threads);
+	}
+}
+
+/*
+ * Function: campaignTrial
+ * -------------------------------------------------------------------------------
+ * Runs a single trial the way a campaign does, in a forked child, without
+ * writing a row. The decompressed output of a completed trial is left in
+ * the arena output buffer until the next trial, copied there by the child
+ * when the plugin replaced that buffer.
+ *
+ * returns: the outcome, an index into STATUS_NAMES
+ * -------------------------------------------------------------------------------
+ */
+int campaignTrial(struct injector *inj, const struct campaign_options *opts, int byte, int bit, struct trial_record *record){
+	struct trial_result *result = mmap(NULL, sizeof(struct trial_result), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (result == MAP_FAILED){
+		perror("ERROR: ");
+		exit(-1);
+	}
+	char *output = malloc(CAMPAIGN_OUTPUT_LIMIT);
+	struct trial_threads threads;
+
+	campaignSerialTrials(inj, NULL, &threads);
+	int outcome = runTrial(inj, opts, result, output, byte, bit, NULL, record);
+	campaignRestoreThreads(inj, NULL, &threads);
+
+	free(output);
+	munmap(result, sizeof(struct trial_result));
+	return outcome;
+}
+
+/*
+ * Function: campaignScatterTrial
+ * -------------------------------------------------------------------------------
+ * Like campaignTrial, but flips every listed stream bit (byte * 8 + bit)
+ * at once. The record holds the first bit, GroupSize the number flipped.
+ *
+ * returns: the outcome, an index into STATUS_NAMES
+ * -------------------------------------------------------------------------------
+ */
+int campaignScatterTrial(struct injector *inj, const struct campaign_options *opts, const int *bits, int count, struct trial_record *record){
+	struct trial_result *result = mmap(NULL, sizeof(struct trial_result), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	struct rusage usage;
+	if (result == MAP_FAILED){
+		perror("ERROR: ");
+		exit(-1);
+	}
+	char *output = malloc(CAMPAIGN_OUTPUT_LIMIT);
+	int first = count ? bits[0] : 0;
+
+	int outcome = forkTrial(inj, opts, result, output, bits, first, count, &usage);
+	writeTrial(inj, opts, result, output, outcome, first / 8, first % 8, count, &usage, NULL, record);
+
+	free(output);
+	munmap(result, sizeof(struct trial_result));
+	return outcome;
+}
+
+/*
+ * Function: copyRows
+ * -------------------------------------------------------------------------------
+ * Appends a worker's rows to the results file.
+ * -------------------------------------------------------------------------------
+ */
+static void copyRows(FILE *rows, FILE *out){
+	char buf[65536];
+	size_t n;
+
+	rewind(rows);
+	while ((n = fread(buf, 1, sizeof(buf), rows)) > 0){
+		fwrite(buf, 1, n, out);
+	}
+}
+
+/*
+ * Function: runCampaign
+ * -------------------------------------------------------------------------------
+ * Runs every bit of every byte in [start_byte, end_byte] against the
+ * compressed stream held by the injector and prints outcome totals.
+ * The injector must already have compressed the field, and decompressed the
+ * baseline when campaignNeedsBaseline says so.
+ * -------------------------------------------------------------------------------
+ */
+void runCampaign(struct injector *inj, const struct campaign_options *opts){
+	size_t compressed_size;
+	int end_byte = opts->end_byte;
+	int workers = opts->workers > 1 ? opts->workers : 1;
+	FILE *out = stdout;
+	size_t s;
+	int w;
+
+	struct trial_threads threads;
+	campaignSerialTrials(inj, opts->variant, &threads);
+
+	injectorStream(inj, &compressed_size);
+	if (end_byte >= (int)compressed_size){
+		printf("WARNING: Clamping campaign end from byte %d to %zu\n", end_byte, compressed_size - 1);
+		end_byte = (int)compressed_size - 1;
+	}
+	if (opts->variant){
+		injectorStream(opts->variant, &compressed_size);
+		if (end_byte >= (int)compressed_size){
+			printf("WARNING: Clamping campaign end from byte %d to %zu, the end of the stream of build B\n", end_byte, compressed_size - 1);
+			end_byte = (int)compressed_size - 1;
+		}
+	}
+
+	if (opts->results_file){
+		out = opts->results_file;
+	} else if (opts->results_path){
+		out = fopen(opts->results_path, "a");
+		if (out == NULL){
+			perror("ERROR: ");
+			exit(-1);
+		}
+	}
+	if (ftell(out) <= 0){
+		fprintf(out, "%s\n", opts->variant ? campaignPairHeader() : campaignHeader());
+	}
+	// A trial child that exits through stdio must not flush the header again
+	fflush(out);
+
+	struct campaign_shared *shared = mmap(NULL, sizeof(struct campaign_shared), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (shared == MAP_FAILED){
+		perror("ERROR: ");
+		exit(-1);
+	}
+	memset(shared, 0, sizeof(struct campaign_shared));
+	shared->next_byte = opts->start_byte;
+	long total_trials = end_byte >= opts->start_byte ? 8L * (end_byte - opts->start_byte + 1) : 0;
+	shared->telemetry = telemetryCreate(workers, total_trials);
+	struct campaign_telemetry *telemetry = shared->telemetry;
+
+	printf("Campaign Range: %d to %d\n", opts->start_byte, end_byte);
+	if (opts->telemetry_path){
+		printf("Campaign Telemetry: %s every %ds\n", opts->telemetry_path, opts->telemetry_interval);
+		telemetryWrite(telemetry, opts->telemetry_path, STATUS_NAMES, STATUS_COUNT);
+	}
+	if (workers == 1){
+		campaignTrials(inj, opts, shared, end_byte, out, 0, 1);
+	} else {
+		int nodes = numaNodes();
+		printf("Campaign Workers: %d across %d NUMA nodes\n", workers, nodes);
+		fflush(stdout);
+		fflush(out);
+
+		// Each worker writes its own rows, they are appended once all finish
+		FILE **rows = malloc(sizeof(FILE *) * workers);
+		pid_t *pids = malloc(sizeof(pid_t) * workers);
+		for (w = 0; w < workers; w++){
+			rows[w] = tmpfile();
+			if (rows[w] == NULL){
+				perror("ERROR: ");
+				exit(-1);
+			}
+			pids[w] = fork();
+			if (pids[w] < 0){
+				perror("ERROR: ");
+				exit(-1);
+			}
+			if (pids[w] == 0){
+				numaBind(w % nodes);
+				// Build B copies the input it shares before build A releases it
+				if (opts->variant){
+					arenaLocalize(opts->variant->arena);
+				}
+				arenaLocalize(inj->arena);
+				traceTrack(TRACE_TRACK_WORKERS + w);
+				campaignTrials(inj, opts, shared, end_byte, rows[w], w, 0);
+				if (w < TELEMETRY_MAX_WORKERS){
+					shared->worker_done[w] = traceNow();
+				}
+				fflush(rows[w]);
+				fflush(stdout);
+				_exit(0);
+			}
+		}
+		// Reap workers as they finish, rewriting the telemetry file meanwhile
+		int running = workers;
+		while (running > 0){
+			for (w = 0; w < workers; w++){
+				int status;
+				if (pids[w] == 0){
+					continue;
+				}
+				pid_t done = waitpid(pids[w], &status, opts->telemetry_path ? WNOHANG : 0);
+				if (done <= 0){
+					continue;
+				}
+				if (!WIFEXITED(status) || WEXITSTATUS(status) != 0){
+					printf("WARNING: Campaign worker %d did not finish, its bytes may be incomplete\n", w);
+				}
+				pids[w] = 0;
+				running--;
+			}
+			if (running > 0 && opts->telemetry_path){
+				usleep(100000);
+				telemetryTick(telemetry, opts->telemetry_path, opts->telemetry_interval, STATUS_NAMES, STATUS_COUNT);
+			}
+		}
+		int64_t done = traceNow();
+		for (w = 0; w < workers && w < TELEMETRY_MAX_WORKERS; w++){
+			traceSpan(TRACE_IDLE, TRACE_TRACK_WORKERS + w, shared->worker_done[w], done);
+		}
+		for (w = 0; w < workers; w++){
+			copyRows(rows[w], out);
+			fclose(rows[w]);
+		}
+		free(rows);
+		free(pids);
+	}
+
+	if (opts->telemetry_path){
+		telemetryWrite(telemetry, opts->telemetry_path, STATUS_NAMES, STATUS_COUNT);
+	}
+	printf("Campaign Trials: %ld\n", telemetry->trials);
+	if (opts->group_size > 1){
+		printf("Group Testing Decompressions: %ld\n", shared->decompressions);
+	}
+	for (s = 0; s < STATUS_COUNT; s++){
+		printf("%s: %ld\n", STATUS_NAMES[s], telemetry->outcomes[s]);
+	}
+	if (inj->protection){
+		long verified = shared->protection[PROTECT_CLEAN] + shared->protection[PROTECT_CORRECTED] + shared->protection[PROTECT_DETECTED];
+		for (s = 0; s <= PROTECT_DETECTED; s++){
+			printf("Protection %s: %ld (%.4f)\n", protectStatusName(s), shared->protection[s], verified ? (double)shared->protection[s] / verified : 0.0);
+		}
+		printf("Mean Verify Time: %lf\n", verified ? shared->verify_ns / 1e9 / verified : 0.0);
+	}
+
+	telemetryFree(telemetry);
+	munmap(shared, sizeof(struct campaign_shared));
+	if (out != stdout && out != opts->results_file){
+		fclose(out);
+	} else {
+		fflush(out);
+	}
+	campaignRestoreThreads(inj, opts->variant, &threads);
+}
@@ -0,0 +1,208 @@
+#ifndef CAMPAIGN_H
+#define CAMPAIGN_H
+
+#include <stdio.h>
+
+#include "injector.h"
+#include "memcap.h"
+#include "metrics.h"
+
+/*
+ * Injection campaigns.
+ * -------------------------------------------------------------------------------
+ * Runs every (byte, bit) trial of a byte range against one compressed
+ * stream inside a single comp_inj process. The field is loaded and
+ * compressed once and the baseline is decompressed once. Each trial runs in
+ * a forked child that shares the arena copy-on-write. A segfault, abort or
+ * hang inside the decompressor therefore only ends that trial. Results are
+ * written as CSV rows with the columns comp_inj_runner.py has always
+ * produced.
+ *
+ * With more than one worker, workers are pinned round-robin to the NUMA
+ * nodes and each keeps node-local copies of the arena buffers. Bytes are
+ * handed out one at a time from a shared counter, so rows are grouped by
+ * byte but the bytes are not in order.
+ *
+ * Throughput, outcome totals, worker utilization, trial latency and an ETA
+ * can be followed live through a telemetry file, see telemetry.h; a
+ * timeline of every phase can be recorded with trace.h.
+ *
+ * With group testing, group_size consecutive bits are flipped together and
+ * decompressed once. A group whose output is bit-identical to the baseline
+ * clears all of its bits; any other group is halved until single bits are
+ * tried on their own. Cleared bits get the group's row, with its size in the
+ * GroupSize column (1 for bits tried alone). Two flips that undo each other
+ * would clear a group wrongly; group_within_bound, which also clears groups
+ * whose output stays inside the error bound, makes that more likely, as
+ * the group's metrics stand in for each bit's.
+ *
+ * The Effect column classes every completed trial (see EFFECT_* in
+ * metrics.h) when the fault-free output is at hand to tell a benign trial
+ * apart, NA otherwise. With classify_only that class is all a trial
+ * computes: no RMSE, PSNR or other metric, only a compare against the
+ * baseline and a bound check of the changed elements that stops at the
+ * first violation. Incorrect is then 1 for a violation, 0 within the bound
+ * and -1 without a pointwise bound; MaxDifference, RMSE and PSNR are -1.
+ *
+ * An A/B campaign runs every trial against a second libpressio build too
+ * (variant, loaded with library.h and compressing the same input) and
+ * writes one row per trial with both builds' status, metrics and Effect
+ * side by side (campaignPairHeader) and whether the two outputs are
+ * bit-identical. Each build flips the bit in its own stream, so the pair
+ * compares what the same fault position does to either build; streams of
+ * different layouts are not aligned. Telemetry counts the pair as one
+ * trial of build A's outcome. Group testing and records are not used.
+ *
+ * When the injector protects its stream (protect.h), the Protection column
+ * says whether the trial's verification found it Clean, Corrected or
+ * Detected, for crashed trials too, and the totals give the rates and the
+ * mean time spent verifying. A group's verification counts for every bit
+ * of the group.
+ * -------------------------------------------------------------------------------
+ */
+
+// Bytes of decompressor stdout kept per trial for classification
+#define CAMPAIGN_OUTPUT_LIMIT 16384
+// Longest CSV row a trial can produce
+#define CAMPAIGN_ROW_LIMIT 65536
+// Outcome classes a profile has room for
+#define CAMPAIGN_PROFILE_OUTCOMES 16
+
+/*
+ * One trial in structured form, for callers that want more than CSV rows.
+ * Fields a trial did not get to are -1, like in the CSV.
+ */
+struct trial_record {
+	int byte;
+	int bit;
+	// Index into the status names, see campaignStatusName
+	int status;
+	// Bits decompressed together to classify this one, 1 if tried alone
+	int group_size;
+	// EFFECT_* class of a completed trial, -1 when not known
+	int effect;
+	double decompress_time;
+	struct error_metrics errors;
+	long peak_rss_kb;
+	unsigned long allocations;
+	size_t peak_heap_bytes;
+	size_t failed_allocation_bytes;
+};
+
+/*
+ * Where the time of a campaign went, in nanoseconds summed over every
+ * decompression (a trial, or a group when group testing) of every worker.
+ * Lives in shared memory and is only updated with atomic adds. A
+ * decompression that did not complete counts wholly as decompress_ns.
+ */
+struct campaign_profile {
+	long decompressions;
+	// In the trial child: flipping the bits and setting up the views,
+	// decompressing, computing the metrics
+	long flip_ns;
+	long decompress_ns;
+	long metrics_ns;
+	// In the worker: fork, pipe, wait and classification around the child
+	long process_ns;
+	// Formatting and writing rows and records
+	long output_ns;
+	// Wall time of each decompression by outcome
+	long outcome_count[CAMPAIGN_PROFILE_OUTCOMES];
+	long outcome_ns[CAMPAIGN_PROFILE_OUTCOMES];
+	long outcome_max_ns[CAMPAIGN_PROFILE_OUTCOMES];
+};
+
+struct campaign_options {
+	const char *compressor;
+	const char *error_bounding_mode;
+	float error_bound;
+	float default_bound;
+
+	// Inclusive byte range, all 8 bits of every byte are flipped
+	int start_byte;
+	int end_byte;
+	// Seconds before a trial is killed and recorded as a Timeout
+	int timeout_limit;
+	// MB a trial's decompression may allocate before it fails, 0 for no cap
+	int memory_limit_mb;
+	// CSV results file, NULL writes to stdout
+	const char *results_path;
+	// Open results stream used instead of results_path, left open
+	FILE *results_file;
+	// Worker processes, spread over the NUMA nodes; each runs its own trials
+	int workers;
+	// Compressor threads for compression and the baseline, trials run serially
+	int compressor_threads;
+	// Prometheus text file rewritten every telemetry_interval seconds, NULL for none
+	const char *telemetry_path;
+	int telemetry_interval;
+	// Shared (MAP_SHARED) array with one record per trial, indexed
+	// (byte - start_byte) * 8 + bit, filled alongside the rows; NULL for none
+	struct trial_record *records;
+	// Bits tested together by group testing, 0 or 1 tries every bit alone
+	int group_size;
+	// Also clear groups whose output differs but stays inside the bound
+	int group_within_bound;
+	// Shared (MAP_SHARED) time breakdown added to by every trial; NULL for none
+	struct campaign_profile *profile;
+	// Only classify trials (Effect column), skipping every metric
+	int classify_only;
+	// Second build, compressed from the same input, each trial is also run
+	// against for an A/B campaign; NULL for none
+	struct injector *variant;
+	// Install the crash handler in every trial child, for hosts that do not
+	// install it themselves (see crash.h)
+	int crash_handler;
+
+	int propagation;
+	int block_edge;
+	int sketch;
+	int quality_selected;
+};
+
+/*
+ * Outcome of one trial, filled by the trial worker in shared memory.
+ */
+struct trial_result {
+	int completed;
+	// Output bit-identical to the baseline, only checked when group testing
+	int identical;
+	// EFFECT_* class, -1 when not known
+	int effect;
+	double decompress_time;
+	// Child side of the profile, see struct campaign_profile
+	double flip_time;
+	double metrics_time;
+	// Allocations of the decompression, see memcap.h
+	struct memcap_stats memory;
+	// Verification of a protected stream, status -1 without protection
+	struct protect_check protect;
+	struct error_metrics errors;
+	// "Incorrect,MaxDifference,RMSE,PSNR" and the optional metric columns
+	char metrics[128];
+	char extra[CAMPAIGN_ROW_LIMIT];
+};
+
+/*
+ * Compressor threads put aside while forked trials run, see
+ * campaignSerialTrials.
+ */
+struct trial_threads {
+	int threads;
+	int variant_threads;
+	// OMP_NUM_THREADS before the trials, if it was set
+	int omp_set;
+	char omp[32];
+};
+
+const char *campaignHeader(void);
+const char *campaignPairHeader(void);
+const char *campaignStatusName(int outcome);
+int campaignNeedsBaseline(const struct campaign_options *opts);
+int campaignTrial(struct injector *inj, const struct campaign_options *opts, int byte, int bit, struct trial_record *record);
+int campaignScatterTrial(struct injector *inj, const struct campaign_options *opts, const int *bits, int count, struct trial_record *record);
+void runCampaign(struct injector *inj, const struct campaign_options *opts);
+void campaignSerialTrials(struct injector *inj, struct injector *variant, struct trial_threads *saved);
+void campaignRestoreThreads(struct injector *inj, struct injector *variant, const struct trial_threads *saved);
+
+#endif
@@ -0,0 +1,386 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <zlib.h>
+
+#include "capture.h"
+
+// Number of slots in the deduplication index shared by a campaign
+#define CAPTURE_INDEX_SLOTS (1 << 20)
+// Unchanged elements allowed inside a run before it is split in two
+#define CAPTURE_RUN_GAP 4
+// Seeds of the record hash and of the second hash verifying a match
+#define CAPTURE_HASH_SEED 0x9E3779B97F4A7C15ull
+#define CAPTURE_CHECK_SEED 0xD6E8FEB86659FD93ull
+
+/*
+ * One stored diff in the deduplication index: the hash its record is keyed
+ * by, 0 for a free slot, with the diff's length and second hash.
+ */
+struct capture_entry {
+	uint64_t hash;
+	uint64_t raw_size;
+	uint64_t check;
+};
+
+struct capture {
+	int archive_fd;
+	int index_fd;
+	struct capture_entry *index;
+	const float *baseline;
+	size_t num_elements;
+};
+
+/*
+ * Function: captureHash
+ * -------------------------------------------------------------------------------
+ * Hashes an encoded diff 8 bytes at a time. Never returns 0, which is reserved
+ * for outputs identical to the baseline.
+ *
+ * seed: CAPTURE_HASH_SEED or CAPTURE_CHECK_SEED
+ *
+ * returns: 64-bit content hash
+ * -------------------------------------------------------------------------------
+ */
+static uint64_t captureHash(const unsigned char *buf, size_t len, uint64_t seed){
+	uint64_t h = seed ^ len;
+	size_t i = 0;
+	for (; i + 8 <= len; i += 8){
+		uint64_t w;
+		memcpy(&w, buf + i, 8);
+		h ^= w;
+		h *= 0xBF58476D1CE4E5B9ull;
+		h ^= h >> 31;
+	}
+	for (; i < len; i++){
+		h ^= buf[i];
+		h *= 0x94D049BB133111EBull;
+	}
+	h ^= h >> 29;
+	h *= 0xBF58476D1CE4E5B9ull;
+	h ^= h >> 32;
+	return h ? h : 1;
+}
+
+/*
+ * Function: captureWriteAll
+ * -------------------------------------------------------------------------------
+ * Writes a whole buffer, retrying on short writes and interrupts.
+ *
+ * returns: 0, or -1 if the write failed
+ * -------------------------------------------------------------------------------
+ */
+static int captureWriteAll(int fd, const void *buf, size_t len){
+	const char *p = buf;
+	while (len > 0){
+		ssize_t w = write(fd, p, len);
+		if (w < 0){
+			if (errno == EINTR){
+				continue;
+			}
+			perror("ERROR: capture write");
+			return -1;
+		}
+		p += w;
+		len -= w;
+	}
+	return 0;
+}
+
+/*
+ * Function: captureAppend
+ * -------------------------------------------------------------------------------
+ * Appends a record header and its payload to the archive as one contiguous
+ * block, holding an flock on the archive so concurrent writers cannot
+ * interleave.
+ *
+ * returns: 0, or -1 if the record could not be written
+ * -------------------------------------------------------------------------------
+ */
+static int captureAppend(struct capture *cap, const struct capture_record_header *hdr, const void *payload){
+	int failed;
+
+	flock(cap->archive_fd, LOCK_EX);
+	failed = captureWriteAll(cap->archive_fd, hdr, sizeof(*hdr));
+	if (!failed && hdr->payload_size > 0){
+		failed = captureWriteAll(cap->archive_fd, payload, hdr->payload_size);
+	}
+	flock(cap->archive_fd, LOCK_UN);
+	return failed;
+}
+
+/*
+ * Function: captureCompress
+ * -------------------------------------------------------------------------------
+ * zlib compresses a buffer into a newly allocated one.
+ *
+ * returns: the compressed buffer, its size in out_size
+ * -------------------------------------------------------------------------------
+ */
+static unsigned char *captureCompress(const void *raw, size_t raw_size, size_t *out_size){
+	uLongf bound = compressBound(raw_size);
+	unsigned char *out = malloc(bound);
+	if (out == NULL || compress2(out, &bound, raw, raw_size, 1) != Z_OK){
+		printf("ERROR: capture compression failed\n");
+		free(out);
+		*out_size = 0;
+		return NULL;
+	}
+	*out_size = bound;
+	return out;
+}
+
+/*
+ * Function: captureEncode
+ * -------------------------------------------------------------------------------
+ * Scans an output against the baseline and encodes the changed elements as
+ * (start, count, values) runs. Elements are compared bitwise so NaN payloads
+ * and signed zeros count as changes. Runs separated by at most
+ * CAPTURE_RUN_GAP unchanged elements are merged, which is smaller than a
+ * second run header.
+ *
+ * returns: the encoded runs (NULL if nothing changed), the encoded size in
+ * raw_size and the number of changed elements in num_changed
+ * -------------------------------------------------------------------------------
+ */
+static unsigned char *captureEncode(const struct capture *cap, const float *output, size_t *raw_size, uint64_t *num_changed){
+	const uint32_t *a = (const uint32_t *)cap->baseline;
+	const uint32_t *b = (const uint32_t *)output;
+	size_t n = cap->num_elements;
+	size_t used = 0, capacity = 0;
+	unsigned char *buf = NULL;
+	size_t i = 0;
+
+	*num_changed = 0;
+	while (i < n){
+		if (a[i] == b[i]){
+			i++;
+			continue;
+		}
+		// Extend the run until CAPTURE_RUN_GAP consecutive elements match
+		uint64_t start = i;
+		size_t end = i + 1;
+		size_t j = i + 1;
+		(*num_changed)++;
+		while (j < n && j - end <= CAPTURE_RUN_GAP){
+			if (a[j] != b[j]){
+				(*num_changed)++;
+				end = j + 1;
+			}
+			j++;
+		}
+		uint64_t run = end - start;
+
+		size_t need = used + 2 * sizeof(uint64_t) + run * sizeof(float);
+		if (need > capacity){
+			capacity = need * 2;
+			buf = realloc(buf, capacity);
+			if (buf == NULL){
+				printf("ERROR: capture out of memory\n");
+				exit(-1);
+			}
+		}
+		memcpy(buf + used, &start, sizeof(uint64_t));
+		memcpy(buf + used + sizeof(uint64_t), &run, sizeof(uint64_t));
+		memcpy(buf + used + 2 * sizeof(uint64_t), output + start, run * sizeof(float));
+		used = need;
+		i = end;
+	}
+	*raw_size = used;
+	return buf;
+}
+
+/*
+ * Function: captureStore
+ * -------------------------------------------------------------------------------
+ * Appends the record of an encoded diff: a reference when the shared index
+ * already holds the same diff (same hash, length and second hash), else the
+ * compressed diff. The index is a memory mapped open addressing table shared
+ * by every process writing to the same archive. It stays under an exclusive
+ * flock until a new diff is on disk, so it never names a payload that was
+ * not stored. A different diff with the same hash is keyed by the next free
+ * hash. A full index stores every diff.
+ * -------------------------------------------------------------------------------
+ */
+static void captureStore(struct capture *cap, struct capture_record_header *hdr, const unsigned char *raw, size_t raw_size){
+	uint64_t hash = captureHash(raw, raw_size, CAPTURE_HASH_SEED);
+	uint64_t check = captureHash(raw, raw_size, CAPTURE_CHECK_SEED);
+	size_t slot = hash & (CAPTURE_INDEX_SLOTS - 1);
+	struct capture_entry *entry = NULL;
+	size_t probes, payload_size = 0;
+	unsigned char *payload;
+
+	flock(cap->index_fd, LOCK_EX);
+	for (probes = 0; probes < CAPTURE_INDEX_SLOTS; probes++){
+		if (cap->index[slot].hash == 0){
+			entry = &cap->index[slot];
+			break;
+		}
+		if (cap->index[slot].hash == hash){
+			if (cap->index[slot].raw_size == raw_size && cap->index[slot].check == check){
+				hdr->kind = CAPTURE_REFERENCE;
+				hdr->hash = hash;
+				captureAppend(cap, hdr, NULL);
+				flock(cap->index_fd, LOCK_UN);
+				return;
+			}
+			// Collision, look the next hash up from its own slot
+			hash = hash + 1 ? hash + 1 : 1;
+			slot = hash & (CAPTURE_INDEX_SLOTS - 1);
+			continue;
+		}
+		slot = (slot + 1) & (CAPTURE_INDEX_SLOTS - 1);
+	}
+
+	payload = captureCompress(raw, raw_size, &payload_size);
+	if (payload == NULL){
+		printf("ERROR: could not capture byte %d bit %d\n", hdr->byte, hdr->bit);
+		flock(cap->index_fd, LOCK_UN);
+		return;
+	}
+	hdr->kind = CAPTURE_DIFF;
+	hdr->hash = hash;
+	hdr->raw_size = raw_size;
+	hdr->payload_size = payload_size;
+	if (captureAppend(cap, hdr, payload) == 0 && fdatasync(cap->archive_fd) == 0 && entry != NULL){
+		entry->raw_size = raw_size;
+		entry->check = check;
+		entry->hash = hash;
+	}
+	flock(cap->index_fd, LOCK_UN);
+	free(payload);
+}
+
+/*
+ * Function: captureOpen
+ * -------------------------------------------------------------------------------
+ * Opens (or creates) a campaign archive. The process that creates the
+ * archive also stores the compressed baseline. A
+ * sidecar "<archive_path>.idx" holds the deduplication index.
+ *
+ * archive_path: path of the per-campaign archive
+ * baseline: fault-free decompressed output, must outlive the capture
+ * num_elements: number of floats in baseline and in every captured output
+ *
+ * returns: the capture handle, exits on failure
+ * -------------------------------------------------------------------------------
+ */
+struct capture *captureOpen(const char *archive_path, const float *baseline, size_t num_elements){
+	struct capture *cap = calloc(1, sizeof(struct capture));
+	size_t index_bytes = sizeof(struct capture_entry) * CAPTURE_INDEX_SLOTS;
+	char *index_path;
+	struct stat st;
+
+	index_path = malloc(strlen(archive_path) + 5);
+	sprintf(index_path, "%s.idx", archive_path);
+	cap->index_fd = open(index_path, O_RDWR | O_CREAT, 0644);
+	free(index_path);
+	if (cap->index_fd < 0){
+		perror("ERROR: ");
+		exit(-1);
+	}
+
+	// The index lock also serializes archive creation
+	flock(cap->index_fd, LOCK_EX);
+	if (fstat(cap->index_fd, &st) == 0 && (size_t)st.st_size < index_bytes){
+		if (ftruncate(cap->index_fd, index_bytes) != 0){
+			perror("ERROR: ");
+			exit(-1);
+		}
+	}
+	cap->archive_fd = open(archive_path, O_WRONLY | O_APPEND | O_CREAT, 0644);
+	if (cap->archive_fd < 0){
+		perror("ERROR: ");
+		exit(-1);
+	}
+	if (fstat(cap->archive_fd, &st) == 0 && st.st_size == 0){
+		struct capture_file_header fhdr;
+		struct capture_record_header hdr;
+		size_t payload_size;
+		unsigned char *payload;
+
+		memset(&fhdr, 0, sizeof(fhdr));
+		memcpy(fhdr.magic, CAPTURE_FILE_MAGIC, 8);
+		fhdr.version = CAPTURE_VERSION;
+		fhdr.element_size = sizeof(float);
+		fhdr.num_elements = num_elements;
+		captureWriteAll(cap->archive_fd, &fhdr, sizeof(fhdr));
+
+		payload = captureCompress(baseline, num_elements * sizeof(float), &payload_size);
+		memset(&hdr, 0, sizeof(hdr));
+		hdr.magic = CAPTURE_RECORD_MAGIC;
+		hdr.kind = CAPTURE_BASELINE;
+		hdr.byte = -1;
+		hdr.bit = -1;
+		hdr.num_changed = num_elements;
+		hdr.raw_size = num_elements * sizeof(float);
+		hdr.payload_size = payload_size;
+		captureAppend(cap, &hdr, payload);
+		free(payload);
+	}
+	flock(cap->index_fd, LOCK_UN);
+
+	cap->index = mmap(NULL, index_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, cap->index_fd, 0);
+	if (cap->index == MAP_FAILED){
+		perror("ERROR: ");
+		exit(-1);
+	}
+
+	cap->baseline = baseline;
+	cap->num_elements = num_elements;
+	return cap;
+}
+
+/*
+ * Function: captureRecord
+ * -------------------------------------------------------------------------------
+ * Appends the record of a corrupted output to the archive.
+ *
+ * byte: the byte position that was injected into
+ * bit: the bit of that byte that was flipped
+ * output: decompressed output of the trial
+ * -------------------------------------------------------------------------------
+ */
+void captureRecord(struct capture *cap, int byte, int bit, const float *output){
+	struct capture_record_header hdr;
+	size_t raw_size = 0;
+	unsigned char *raw;
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.magic = CAPTURE_RECORD_MAGIC;
+	hdr.byte = byte;
+	hdr.bit = bit;
+
+	raw = captureEncode(cap, output, &raw_size, &hdr.num_changed);
+	if (raw == NULL){
+		hdr.kind = CAPTURE_REFERENCE;
+		hdr.hash = 0;
+		captureAppend(cap, &hdr, NULL);
+		return;
+	}
+	captureStore(cap, &hdr, raw, raw_size);
+	free(raw);
+}
+
+/*
+ * Function: captureClose
+ * -------------------------------------------------------------------------------
+ * Releases the archive.
+ * -------------------------------------------------------------------------------
+ */
+void captureClose(struct capture *cap){
+	if (cap == NULL){
+		return;
+	}
+	munmap(cap->index, sizeof(struct capture_entry) * CAPTURE_INDEX_SLOTS);
+	close(cap->index_fd);
+	close(cap->archive_fd);
+	free(cap);
+}
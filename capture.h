@@ -0,0 +1,63 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Sparse corrupted-output capture.
+ * -------------------------------------------------------------------------------
+ * Corrupted outputs are stored as the difference from the fault-free baseline
+ * in a single per-campaign archive. Each trial appends one record keyed by
+ * (byte, bit). The difference is encoded as (index run, values) records,
+ * compressed with zlib, and deduplicated across trials (and across the
+ * processes of a campaign) by content hash, a match being confirmed by the
+ * diff's length and a second hash. A diff is entered in the shared index only
+ * once its record is on disk.
+ *
+ * Archive layout (native byte order):
+ *   struct capture_file_header
+ *   struct capture_record_header + payload, repeated
+ *
+ * The first record is always the zlib compressed baseline (CAPTURE_BASELINE).
+ * A CAPTURE_DIFF payload decompresses to a sequence of runs, each run being a
+ * uint64 start index, a uint64 element count and count float values.
+ * A CAPTURE_REFERENCE record has no payload; its output is the one of the
+ * CAPTURE_DIFF record carrying the same hash. Hash 0 means "identical to the
+ * baseline".
+ * -------------------------------------------------------------------------------
+ */
+
+#define CAPTURE_FILE_MAGIC "CARTSCAP"
+#define CAPTURE_RECORD_MAGIC 0x43455243u
+#define CAPTURE_VERSION 1
+
+#define CAPTURE_BASELINE 0
+#define CAPTURE_DIFF 1
+#define CAPTURE_REFERENCE 2
+
+struct capture_file_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t element_size;
+	uint64_t num_elements;
+};
+
+struct capture_record_header {
+	uint32_t magic;
+	uint32_t kind;
+	int32_t byte;
+	int32_t bit;
+	uint64_t hash;
+	uint64_t num_changed;
+	uint64_t raw_size;
+	uint64_t payload_size;
+};
+
+struct capture;
+
+struct capture *captureOpen(const char *archive_path, const float *baseline, size_t num_elements);
+void captureRecord(struct capture *cap, int byte, int bit, const float *output);
+void captureClose(struct capture *cap);
+
+#endif
@@ -0,0 +1,82 @@
+import array
+import struct
+import sys
+import zlib
+
+# Layout must match capture.h
+FILE_HEADER = struct.Struct("=8sIIQ")
+RECORD_HEADER = struct.Struct("=IIiiQQQQ")
+RUN_HEADER = struct.Struct("=QQ")
+RECORD_MAGIC = 0x43455243
+BASELINE = 0
+DIFF = 1
+REFERENCE = 2
+
+
+# Reads every record of a capture archive.
+# Returns the baseline as a float array, a dict of hash -> compressed diff
+# payload and a dict of (byte, bit) -> (hash, changed element count).
+def read_archive(path):
+	baseline = None
+	payloads = {}
+	trials = {}
+	with open(path, "rb") as f:
+		magic, version, element_size, num_elements = FILE_HEADER.unpack(f.read(FILE_HEADER.size))
+		if magic != b"CARTSCAP" or element_size != 4:
+			print("Not a capture archive: {}".format(path))
+			exit(-1)
+		while True:
+			header = f.read(RECORD_HEADER.size)
+			if len(header) < RECORD_HEADER.size:
+				break
+			rmagic, kind, byte, bit, digest, num_changed, raw_size, payload_size = RECORD_HEADER.unpack(header)
+			if rmagic != RECORD_MAGIC:
+				print("Corrupt record, stopping at offset {}".format(f.tell()))
+				break
+			payload = f.read(payload_size)
+			if kind == BASELINE:
+				baseline = array.array("f", zlib.decompress(payload))
+			else:
+				if kind == DIFF:
+					payloads[digest] = payload
+				trials[(byte, bit)] = (digest, num_changed)
+	return baseline, payloads, trials
+
+
+# Rebuilds the corrupted output of one trial from the baseline and its diff.
+def reconstruct(baseline, payloads, digest):
+	output = array.array("f", baseline)
+	if digest == 0:
+		return output
+	raw = zlib.decompress(payloads[digest])
+	offset = 0
+	while offset < len(raw):
+		start, count = RUN_HEADER.unpack_from(raw, offset)
+		offset = offset + RUN_HEADER.size
+		output[start:start + count] = array.array("f", raw[offset:offset + 4 * count])
+		offset = offset + 4 * count
+	return output
+
+
+def main():
+	if len(sys.argv) != 2 and len(sys.argv) != 5:
+		print("Usage: capture_reader.py archive [byte bit output.bin]")
+		exit(-1)
+
+	baseline, payloads, trials = read_archive(sys.argv[1].strip())
+	print("Trials Captured: {}".format(len(trials)))
+	print("Unique Corrupted Outputs: {}".format(len(payloads)))
+
+	if len(sys.argv) == 5:
+		key = (int(sys.argv[2]), int(sys.argv[3]))
+		if key not in trials:
+			print("Byte {} Bit {} was not captured".format(key[0], key[1]))
+			exit(-1)
+		digest, num_changed = trials[key]
+		print("Changed Elements: {}".format(num_changed))
+		with open(sys.argv[4].strip(), "wb") as out:
+			reconstruct(baseline, payloads, digest).tofile(out)
+
+
+if __name__ == '__main__':
+	main()
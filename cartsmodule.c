@@ -0,0 +1,802 @@
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "arena.h"
+#include "injector.h"
+#include "campaign.h"
+#include "crash.h"
+#include "metrics.h"
+
+/*
+ * Python bindings.
+ * -------------------------------------------------------------------------------
+ * The carts module runs the injection engine inside the Python process
+ * instead of through comp_inj and its stdout:
+ *
+ *   import numpy as np, carts
+ *   field = np.fromfile("data/Hurricane/hurricane_1_500_500.bin", np.float32).reshape(100, 500, 500)
+ *   inj = carts.Injector(field, "sz", "ABS", 1e-3)
+ *   inj.compress()
+ *   trial = inj.inject_and_decompress(120, 3)
+ *   cols = inj.campaign(0, 4999, workers=16)
+ *   status = np.asarray(cols["status"])
+ *
+ * Fields are read in place through the buffer protocol (C contiguous
+ * float32, up to METRICS_MAX_DIMS axes, the last axis fastest). Outputs and
+ * result columns are returned as carts.Buffer objects, which NumPy, Arrow
+ * (pa.py_buffer) and memoryview wrap without copying. Views of the stream,
+ * baseline and trial output keep their Injector alive; the trial output is
+ * overwritten by the next trial.
+ *
+ * Trials still run in forked children, so a crashing decompressor only ends
+ * its trial. Each child installs the crash handler (see crash.h), the
+ * interpreter's own handlers are left alone. The GIL is released while
+ * compressing, decompressing and computing metrics. Allocation counters are
+ * not gathered here, see memcap.h.
+ * -------------------------------------------------------------------------------
+ */
+
+/*
+ * A block of memory exposed through the buffer protocol.
+ */
+typedef struct {
+	PyObject_HEAD
+	void *data;
+	// Object owning data, NULL when data was malloc'ed for this buffer
+	PyObject *owner;
+	const char *format;
+	Py_ssize_t itemsize;
+	int ndim;
+	Py_ssize_t shape[METRICS_MAX_DIMS];
+	Py_ssize_t strides[METRICS_MAX_DIMS];
+} BufferObject;
+
+typedef struct {
+	PyObject_HEAD
+	Py_buffer field;
+	struct buffer_arena *arena;
+	struct injector *inj;
+	// Kept here, the injector and campaign options point at them
+	char compressor[8];
+	char mode[16];
+	float error_bound;
+	float default_bound;
+	int compressed;
+} InjectorObject;
+
+static PyTypeObject BufferType;
+static PyTypeObject InjectorType;
+
+static int bufferGet(BufferObject *self, Py_buffer *view, int flags){
+	Py_ssize_t len = self->itemsize;
+	int d;
+
+	if (flags & PyBUF_WRITABLE){
+		PyErr_SetString(PyExc_BufferError, "carts buffers are read-only");
+		return -1;
+	}
+	for (d = 0; d < self->ndim; d++){
+		len *= self->shape[d];
+	}
+	view->obj = (PyObject *)self;
+	Py_INCREF(self);
+	view->buf = self->data;
+	view->len = len;
+	view->readonly = 1;
+	view->itemsize = self->itemsize;
+	view->format = (flags & PyBUF_FORMAT) ? (char *)self->format : NULL;
+	view->ndim = self->ndim;
+	view->shape = (flags & PyBUF_ND) ? self->shape : NULL;
+	view->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? self->strides : NULL;
+	view->suboffsets = NULL;
+	view->internal = NULL;
+	return 0;
+}
+
+static void bufferDealloc(BufferObject *self){
+	if (self->owner){
+		Py_DECREF(self->owner);
+	} else {
+		free(self->data);
+	}
+	Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+/*
+ * Function: newBuffer
+ * -------------------------------------------------------------------------------
+ * Wraps data in a C contiguous carts.Buffer. With an owner the data is
+ * borrowed from it, otherwise the buffer takes the malloc'ed data over.
+ *
+ * shape: extents in Python order, slowest first
+ * -------------------------------------------------------------------------------
+ */
+static PyObject *newBuffer(void *data, PyObject *owner, const char *format, Py_ssize_t itemsize, int ndim, const Py_ssize_t *shape){
+	BufferObject *buf = PyObject_New(BufferObject, &BufferType);
+	int d;
+
+	if (buf == NULL){
+		if (owner == NULL){
+			free(data);
+		}
+		return NULL;
+	}
+	buf->data = data;
+	buf->owner = owner;
+	Py_XINCREF(owner);
+	buf->format = format;
+	buf->itemsize = itemsize;
+	buf->ndim = ndim;
+	for (d = ndim - 1; d >= 0; d--){
+		buf->shape[d] = shape[d];
+		buf->strides[d] = d == ndim - 1 ? itemsize : buf->strides[d + 1] * shape[d + 1];
+	}
+	return (PyObject *)buf;
+}
+
+/*
+ * Function: getField
+ * -------------------------------------------------------------------------------
+ * Gets a C contiguous float32 view of obj, up to METRICS_MAX_DIMS axes.
+ *
+ * returns: 0, or -1 with a Python exception set
+ * -------------------------------------------------------------------------------
+ */
+static int getField(PyObject *obj, Py_buffer *view, const char *name){
+	if (PyObject_GetBuffer(obj, view, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) != 0){
+		return -1;
+	}
+	const char *format = view->format ? view->format : "B";
+	if (format[0] == '@' || format[0] == '=' || format[0] == '<'){
+		format++;
+	}
+	if (strcmp(format, "f") != 0 || view->itemsize != sizeof(float)){
+		PyErr_Format(PyExc_TypeError, "%s must be float32, not format '%s'", name, view->format ? view->format : "B");
+		PyBuffer_Release(view);
+		return -1;
+	}
+	if (view->ndim < 1 || view->ndim > METRICS_MAX_DIMS){
+		PyErr_Format(PyExc_ValueError, "%s must have 1 to %d dimensions", name, METRICS_MAX_DIMS);
+		PyBuffer_Release(view);
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Function: getPair
+ * -------------------------------------------------------------------------------
+ * Gets two fields of the same number of elements.
+ *
+ * returns: 0, or -1 with a Python exception set and nothing held
+ * -------------------------------------------------------------------------------
+ */
+static int getPair(PyObject *a, PyObject *b, Py_buffer *va, Py_buffer *vb, const char *name_a, const char *name_b){
+	if (getField(a, va, name_a) != 0){
+		return -1;
+	}
+	if (getField(b, vb, name_b) != 0){
+		PyBuffer_Release(va);
+		return -1;
+	}
+	if (va->len != vb->len){
+		PyErr_Format(PyExc_ValueError, "%s and %s differ in size", name_a, name_b);
+		PyBuffer_Release(va);
+		PyBuffer_Release(vb);
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Function: fieldDims
+ * -------------------------------------------------------------------------------
+ * Converts a Python shape to libpressio dims, dims[0] fastest varying.
+ * -------------------------------------------------------------------------------
+ */
+static void fieldDims(const Py_buffer *view, size_t *dims){
+	int d;
+	for (d = 0; d < view->ndim; d++){
+		dims[d] = (size_t)view->shape[view->ndim - 1 - d];
+	}
+}
+
+/*
+ * Function: checkMode
+ * -------------------------------------------------------------------------------
+ * Validates the compressor and mode as ValueErrors, before
+ * injectorTryCreate reports anything else libpressio rejects.
+ *
+ * returns: 0, or -1 with a Python exception set
+ * -------------------------------------------------------------------------------
+ */
+static int checkMode(const char *compressor, const char *mode){
+	static const char *sz_modes[] = { "ABS", "PW_REL", "PSNR", NULL };
+	static const char *zfp_modes[] = { "Accuracy", "Rate", "Precision", NULL };
+	const char **modes;
+	int i;
+
+	if (strcmp(compressor, "sz") == 0){
+		modes = sz_modes;
+	} else if (strcmp(compressor, "zfp") == 0){
+		modes = zfp_modes;
+	} else {
+		PyErr_Format(PyExc_ValueError, "invalid compressor '%s', expected sz or zfp", compressor);
+		return -1;
+	}
+	for (i = 0; modes[i]; i++){
+		if (strcmp(mode, modes[i]) == 0){
+			return 0;
+		}
+	}
+	PyErr_Format(PyExc_ValueError, "invalid error bounding mode '%s' for %s", mode, compressor);
+	return -1;
+}
+
+/*
+ * Function: checkQuality
+ * -------------------------------------------------------------------------------
+ * Validates a quality metric list before parseQualityMetrics sees it.
+ *
+ * returns: the selected metrics, or -1 with a Python exception set
+ * -------------------------------------------------------------------------------
+ */
+static int checkQuality(const char *list){
+	static const char *names[] = { "ssim", "pearson", "range", "ulp", "all", NULL };
+	const char *pt = list;
+
+	if (list == NULL || list[0] == '\0'){
+		return 0;
+	}
+	while (*pt){
+		size_t len = strcspn(pt, ",");
+		int i;
+		for (i = 0; names[i]; i++){
+			if (strlen(names[i]) == len && strncmp(pt, names[i], len) == 0){
+				break;
+			}
+		}
+		if (len && names[i] == NULL){
+			char name[64];
+			snprintf(name, sizeof(name), "%.*s", (int)len, pt);
+			PyErr_Format(PyExc_ValueError, "invalid quality metric '%s'", name);
+			return -1;
+		}
+		pt += len + (pt[len] == ',');
+	}
+	return parseQualityMetrics(list);
+}
+
+static PyObject *errorDict(const struct error_metrics *em){
+	return Py_BuildValue("{s:i,s:f,s:f,s:f}", "incorrect", em->number_of_incorrect, "max_difference", em->max_diff, "rmse", em->rmse, "psnr", em->psnr);
+}
+
+static int injectorInit(InjectorObject *self, PyObject *args, PyObject *kwds){
+	static char *kwlist[] = { "field", "compressor", "mode", "bound", "default_bound", "threads", NULL };
+	PyObject *field;
+	const char *compressor, *mode;
+	float bound, default_bound = -1;
+	int threads = 1;
+	size_t dims[METRICS_MAX_DIMS];
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "Ossf|fi", kwlist, &field, &compressor, &mode, &bound, &default_bound, &threads)){
+		return -1;
+	}
+	if (self->inj){
+		PyErr_SetString(PyExc_RuntimeError, "Injector already initialized");
+		return -1;
+	}
+	if (checkMode(compressor, mode) != 0 || getField(field, &self->field, "field") != 0){
+		return -1;
+	}
+	snprintf(self->compressor, sizeof(self->compressor), "%s", compressor);
+	snprintf(self->mode, sizeof(self->mode), "%s", mode);
+	self->error_bound = bound;
+	self->default_bound = default_bound;
+
+	fieldDims(&self->field, dims);
+	self->arena = arenaWrap(dims, self->field.ndim, (float *)self->field.buf);
+	self->inj = injectorTryCreate(self->compressor, self->mode, bound, self->arena);
+	if (self->inj->error[0] != '\0'){
+		PyErr_SetString(PyExc_RuntimeError, self->inj->error);
+		injectorFree(self->inj);
+		arenaFree(self->arena);
+		PyBuffer_Release(&self->field);
+		self->inj = NULL;
+		self->arena = NULL;
+		return -1;
+	}
+	// Pick up the compressor plugins libpressio just loaded
+	crashRefreshModules();
+	if (threads > 1){
+		injectorSetThreads(self->inj, threads);
+	}
+	return 0;
+}
+
+static void injectorDealloc(InjectorObject *self){
+	injectorFree(self->inj);
+	arenaFree(self->arena);
+	if (self->field.obj){
+		PyBuffer_Release(&self->field);
+	}
+	Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+/*
+ * Function: checkCompressed
+ * -------------------------------------------------------------------------------
+ * returns: 0 once the field is compressed, else -1 with an exception set
+ * -------------------------------------------------------------------------------
+ */
+static int checkCompressed(InjectorObject *self){
+	if (self->inj == NULL || !self->compressed){
+		PyErr_SetString(PyExc_RuntimeError, "compress() the field first");
+		return -1;
+	}
+	return 0;
+}
+
+static PyObject *injectorCompressMethod(InjectorObject *self, PyObject *unused){
+	if (self->inj == NULL){
+		PyErr_SetString(PyExc_RuntimeError, "Injector not initialized");
+		return NULL;
+	}
+	// Views of the stream stay valid because it is only ever made once
+	if (self->compressed){
+		PyErr_SetString(PyExc_RuntimeError, "field already compressed");
+		return NULL;
+	}
+	int failed;
+	Py_BEGIN_ALLOW_THREADS
+	failed = injectorTryCompress(self->inj);
+	Py_END_ALLOW_THREADS
+	if (failed){
+		PyErr_SetString(PyExc_RuntimeError, self->inj->error);
+		return NULL;
+	}
+	self->compressed = 1;
+	return PyFloat_FromDouble(self->inj->compression_ratio);
+}
+
+static PyObject *injectorStreamMethod(InjectorObject *self, PyObject *unused){
+	size_t compressed_size;
+	if (checkCompressed(self) != 0){
+		return NULL;
+	}
+	unsigned char *stream = injectorStream(self->inj, &compressed_size);
+	Py_ssize_t shape[1] = { (Py_ssize_t)compressed_size };
+	return newBuffer(stream, (PyObject *)self, "B", 1, 1, shape);
+}
+
+static PyObject *injectorBaselineMethod(InjectorObject *self, PyObject *unused){
+	const float *baseline;
+	if (checkCompressed(self) != 0){
+		return NULL;
+	}
+	Py_BEGIN_ALLOW_THREADS
+	baseline = injectorTryBaseline(self->inj);
+	Py_END_ALLOW_THREADS
+	if (baseline == NULL){
+		PyErr_SetString(PyExc_RuntimeError, self->inj->error);
+		return NULL;
+	}
+	return newBuffer((void *)baseline, (PyObject *)self, "f", sizeof(float), self->field.ndim, self->field.shape);
+}
+
+/*
+ * Function: campaignOptions
+ * -------------------------------------------------------------------------------
+ * Campaign options of this injector with the runner's defaults.
+ * -------------------------------------------------------------------------------
+ */
+static void campaignOptions(InjectorObject *self, struct campaign_options *opts){
+	memset(opts, 0, sizeof(struct campaign_options));
+	opts->compressor = self->compressor;
+	opts->error_bounding_mode = self->mode;
+	opts->error_bound = self->error_bound;
+	opts->default_bound = self->default_bound;
+	opts->timeout_limit = 30;
+	opts->workers = 1;
+	opts->block_edge = strcmp(self->compressor, "zfp") == 0 ? 4 : 6;
+	opts->telemetry_interval = 10;
+	// The interpreter keeps its handlers, trial children install ours
+	opts->crash_handler = 1;
+}
+
+static PyObject *injectorTrialMethod(InjectorObject *self, PyObject *args, PyObject *kwds){
+	static char *kwlist[] = { "byte", "bit", "timeout", "memory_limit_mb", NULL };
+	struct campaign_options opts;
+	struct trial_record record;
+	size_t compressed_size;
+	int byte, bit;
+
+	if (checkCompressed(self) != 0){
+		return NULL;
+	}
+	campaignOptions(self, &opts);
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "ii|ii", kwlist, &byte, &bit, &opts.timeout_limit, &opts.memory_limit_mb)){
+		return NULL;
+	}
+	injectorStream(self->inj, &compressed_size);
+	if (byte < 0 || (size_t)byte >= compressed_size || bit < 0 || bit > 7){
+		PyErr_Format(PyExc_IndexError, "no bit %d of byte %d in a %zu byte stream", bit, byte, compressed_size);
+		return NULL;
+	}
+
+	Py_BEGIN_ALLOW_THREADS
+	campaignTrial(self->inj, &opts, byte, bit, &record);
+	Py_END_ALLOW_THREADS
+
+	PyObject *output = Py_None;
+	Py_INCREF(output);
+	if (record.status == 0){
+		Py_DECREF(output);
+		output = newBuffer(self->arena->output, (PyObject *)self, "f", sizeof(float), self->field.ndim, self->field.shape);
+		if (output == NULL){
+			return NULL;
+		}
+	}
+	return Py_BuildValue("{s:i,s:i,s:s,s:d,s:i,s:f,s:f,s:f,s:l,s:N}",
+		"byte", byte, "bit", bit, "status", campaignStatusName(record.status), "decompress_time", record.decompress_time,
+		"incorrect", record.errors.number_of_incorrect, "max_difference", record.errors.max_diff, "rmse", record.errors.rmse, "psnr", record.errors.psnr,
+		"peak_rss_kb", record.peak_rss_kb, "output", output);
+}
+
+// Adds one column of the campaign records to a dict
+#define RECORD_COLUMN(dict, name, type, format, field) do { \
+	type *column = malloc(sizeof(type) * (count ? count : 1)); \
+	Py_ssize_t i; \
+	for (i = 0; i < count; i++){ \
+		column[i] = (type)records[i].field; \
+	} \
+	PyObject *buf = newBuffer(column, NULL, format, sizeof(type), 1, &count); \
+	if (buf == NULL || PyDict_SetItemString(dict, name, buf) != 0){ \
+		Py_XDECREF(buf); \
+		goto fail; \
+	} \
+	Py_DECREF(buf); \
+} while (0)
+
+static PyObject *injectorCampaignMethod(InjectorObject *self, PyObject *args, PyObject *kwds){
+	static char *kwlist[] = { "start", "end", "workers", "timeout", "memory_limit_mb", "propagation", "block_edge", "sketch", "quality", "results", "telemetry", "group_size", "within_bound", "classify_only", NULL };
+	struct campaign_options opts;
+	size_t compressed_size;
+	int start = 0, end = -1, propagation = 0, sketch = 0, block_edge = 0;
+	const char *quality = NULL;
+	PyObject *dict = NULL;
+
+	if (checkCompressed(self) != 0){
+		return NULL;
+	}
+	campaignOptions(self, &opts);
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "|iiiiipipzzzipp", kwlist, &start, &end, &opts.workers, &opts.timeout_limit, &opts.memory_limit_mb,
+			&propagation, &block_edge, &sketch, &quality, &opts.results_path, &opts.telemetry_path, &opts.group_size, &opts.group_within_bound, &opts.classify_only)){
+		return NULL;
+	}
+	if ((opts.quality_selected = checkQuality(quality)) < 0){
+		return NULL;
+	}
+	injectorStream(self->inj, &compressed_size);
+	if (end < 0 || (size_t)end >= compressed_size){
+		end = (int)compressed_size - 1;
+	}
+	if (start < 0 || start > end){
+		PyErr_Format(PyExc_IndexError, "empty byte range %d to %d", start, end);
+		return NULL;
+	}
+	opts.start_byte = start;
+	opts.end_byte = end;
+	opts.propagation = propagation;
+	opts.sketch = sketch;
+	if (block_edge > 0){
+		opts.block_edge = block_edge;
+	}
+
+	Py_ssize_t count = 8 * (Py_ssize_t)(end - start + 1);
+	size_t bytes = sizeof(struct trial_record) * count;
+	struct trial_record *records = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (records == MAP_FAILED){
+		return PyErr_SetFromErrno(PyExc_OSError);
+	}
+	Py_ssize_t r;
+	for (r = 0; r < count; r++){
+		records[r].status = -1;
+	}
+	opts.records = records;
+	// Rows are only wanted in a results file
+	if (opts.results_path == NULL){
+		opts.results_file = fopen("/dev/null", "w");
+		if (opts.results_file == NULL){
+			munmap(records, bytes);
+			return PyErr_SetFromErrno(PyExc_OSError);
+		}
+	}
+
+	int failed = 0;
+	Py_BEGIN_ALLOW_THREADS
+	if (campaignNeedsBaseline(&opts) && injectorTryBaseline(self->inj) == NULL){
+		failed = 1;
+	} else {
+		runCampaign(self->inj, &opts);
+	}
+	fflush(stdout);
+	Py_END_ALLOW_THREADS
+	if (opts.results_file){
+		fclose(opts.results_file);
+	}
+	if (failed){
+		PyErr_SetString(PyExc_RuntimeError, self->inj->error);
+		goto fail;
+	}
+
+	dict = PyDict_New();
+	if (dict == NULL){
+		goto fail;
+	}
+	RECORD_COLUMN(dict, "byte", int, "i", byte);
+	RECORD_COLUMN(dict, "bit", int, "i", bit);
+	RECORD_COLUMN(dict, "status", int, "i", status);
+	RECORD_COLUMN(dict, "decompress_time", double, "d", decompress_time);
+	RECORD_COLUMN(dict, "incorrect", int, "i", errors.number_of_incorrect);
+	RECORD_COLUMN(dict, "max_difference", float, "f", errors.max_diff);
+	RECORD_COLUMN(dict, "rmse", float, "f", errors.rmse);
+	RECORD_COLUMN(dict, "psnr", float, "f", errors.psnr);
+	RECORD_COLUMN(dict, "peak_rss_kb", long long, "q", peak_rss_kb);
+	RECORD_COLUMN(dict, "group_size", int, "i", group_size);
+	RECORD_COLUMN(dict, "effect", int, "i", effect);
+	munmap(records, bytes);
+	return dict;
+
+fail:
+	munmap(records, bytes);
+	Py_XDECREF(dict);
+	return NULL;
+}
+
+static PyObject *injectorGetRatio(InjectorObject *self, void *closure){
+	return PyFloat_FromDouble(self->inj ? self->inj->compression_ratio : 0);
+}
+
+static PyObject *injectorGetSize(InjectorObject *self, void *closure){
+	return PyLong_FromSize_t(self->inj ? self->inj->compressed_size : 0);
+}
+
+static PyObject *injectorGetTime(InjectorObject *self, void *closure){
+	return PyFloat_FromDouble(self->inj ? self->inj->compress_time : 0);
+}
+
+static PyObject *errorMetricsFunction(PyObject *module, PyObject *args, PyObject *kwds){
+	static char *kwlist[] = { "original", "output", "mode", "bound", "default_bound", NULL };
+	PyObject *original, *output;
+	const char *mode;
+	float bound, default_bound = -1;
+	Py_buffer vo, vd;
+	struct error_metrics em;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "OOsf|f", kwlist, &original, &output, &mode, &bound, &default_bound)){
+		return NULL;
+	}
+	if (getPair(original, output, &vo, &vd, "original", "output") != 0){
+		return NULL;
+	}
+	Py_BEGIN_ALLOW_THREADS
+	calculateErrorMetrics(vo.buf, vd.buf, vo.len / sizeof(float), mode, bound, default_bound, NULL, NULL, 0, &em);
+	Py_END_ALLOW_THREADS
+	PyBuffer_Release(&vo);
+	PyBuffer_Release(&vd);
+	return errorDict(&em);
+}
+
+static PyObject *qualityFunction(PyObject *module, PyObject *args, PyObject *kwds){
+	static char *kwlist[] = { "original", "output", "metrics", NULL };
+	PyObject *original, *output;
+	const char *list = "all";
+	Py_buffer vo, vd;
+	size_t dims[METRICS_MAX_DIMS];
+	struct quality_metrics qm;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "OO|s", kwlist, &original, &output, &list)){
+		return NULL;
+	}
+	int selected = checkQuality(list);
+	if (selected < 0 || getPair(original, output, &vo, &vd, "original", "output") != 0){
+		return NULL;
+	}
+	fieldDims(&vo, dims);
+	Py_BEGIN_ALLOW_THREADS
+	calculateQuality(vo.buf, vd.buf, dims, vo.ndim, selected, &qm);
+	Py_END_ALLOW_THREADS
+	PyBuffer_Release(&vo);
+	PyBuffer_Release(&vd);
+
+	PyObject *dict = Py_BuildValue("{s:n}", "skipped", (Py_ssize_t)qm.skipped);
+	if (dict == NULL){
+		return NULL;
+	}
+	const struct { int flag; const char *name; double value; } values[] = {
+		{ QUALITY_SSIM, "ssim", qm.ssim }, { QUALITY_PEARSON, "pearson", qm.pearson },
+		{ QUALITY_RANGE, "range_relative_max_error", qm.range_rel_max_error },
+		{ QUALITY_ULP, "max_ulp", qm.max_ulp }, { QUALITY_ULP, "mean_ulp", qm.mean_ulp }
+	};
+	size_t v;
+	for (v = 0; v < sizeof(values) / sizeof(values[0]); v++){
+		if (!(selected & values[v].flag)){
+			continue;
+		}
+		PyObject *value = PyFloat_FromDouble(values[v].value);
+		if (value == NULL || PyDict_SetItemString(dict, values[v].name, value) != 0){
+			Py_XDECREF(value);
+			Py_DECREF(dict);
+			return NULL;
+		}
+		Py_DECREF(value);
+	}
+	return dict;
+}
+
+static PyObject *propagationFunction(PyObject *module, PyObject *args, PyObject *kwds){
+	static char *kwlist[] = { "baseline", "output", "block_edge", NULL };
+	PyObject *baseline, *output;
+	int block_edge = 6;
+	Py_buffer vb, vd;
+	size_t dims[METRICS_MAX_DIMS];
+	struct propagation_metrics pm;
+	int ndim, d;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "OO|i", kwlist, &baseline, &output, &block_edge)){
+		return NULL;
+	}
+	if (block_edge < 1){
+		PyErr_SetString(PyExc_ValueError, "block_edge must be positive");
+		return NULL;
+	}
+	if (getPair(baseline, output, &vb, &vd, "baseline", "output") != 0){
+		return NULL;
+	}
+	ndim = vb.ndim;
+	fieldDims(&vb, dims);
+	Py_BEGIN_ALLOW_THREADS
+	calculatePropagation(vb.buf, vd.buf, dims, ndim, block_edge, &pm);
+	Py_END_ALLOW_THREADS
+	PyBuffer_Release(&vb);
+	PyBuffer_Release(&vd);
+
+	// Bounding box in Python axis order, None when nothing changed
+	PyObject *box = Py_None;
+	Py_INCREF(box);
+	if (pm.changed){
+		Py_DECREF(box);
+		box = PyTuple_New(ndim);
+		if (box == NULL){
+			return NULL;
+		}
+		for (d = 0; d < ndim; d++){
+			PyTuple_SET_ITEM(box, d, Py_BuildValue("(nn)", (Py_ssize_t)pm.box_min[ndim - 1 - d], (Py_ssize_t)pm.box_max[ndim - 1 - d]));
+		}
+	}
+	return Py_BuildValue("{s:n,s:L,s:L,s:N,s:n}", "changed", (Py_ssize_t)pm.changed, "first_changed", pm.first_changed,
+		"last_changed", pm.last_changed, "box", box, "affected_blocks", (Py_ssize_t)pm.affected_blocks);
+}
+
+static PyBufferProcs bufferProcs = {
+	.bf_getbuffer = (getbufferproc)bufferGet,
+};
+
+static PyTypeObject BufferType = {
+	PyVarObject_HEAD_INIT(NULL, 0)
+	.tp_name = "carts.Buffer",
+	.tp_doc = "Read-only memory of a field, stream or result column, for np.asarray or memoryview",
+	.tp_basicsize = sizeof(BufferObject),
+	.tp_flags = Py_TPFLAGS_DEFAULT,
+	.tp_dealloc = (destructor)bufferDealloc,
+	.tp_as_buffer = &bufferProcs,
+};
+
+static PyMethodDef injectorMethods[] = {
+	{ "compress", (PyCFunction)injectorCompressMethod, METH_NOARGS,
+		"compress()\n\nCompresses the field once and returns the compression ratio." },
+	{ "stream", (PyCFunction)injectorStreamMethod, METH_NOARGS,
+		"stream()\n\nThe compressed stream as a uint8 Buffer." },
+	{ "baseline", (PyCFunction)injectorBaselineMethod, METH_NOARGS,
+		"baseline()\n\nThe fault-free decompressed field, decompressed on first use." },
+	{ "inject_and_decompress", (PyCFunction)(void (*)(void))injectorTrialMethod, METH_VARARGS | METH_KEYWORDS,
+		"inject_and_decompress(byte, bit, timeout=30, memory_limit_mb=0)\n\n"
+		"Runs one trial in a forked child. Returns a dict with the status name, decompression\n"
+		"time, error metrics, peak RSS and, when completed, the output (valid until the next trial)." },
+	{ "campaign", (PyCFunction)(void (*)(void))injectorCampaignMethod, METH_VARARGS | METH_KEYWORDS,
+		"campaign(start=0, end=-1, workers=1, timeout=30, memory_limit_mb=0, propagation=False,\n"
+		"         block_edge=0, sketch=False, quality=None, results=None, telemetry=None,\n"
+		"         group_size=0, within_bound=False, classify_only=False)\n\n"
+		"Runs every bit of bytes start..end (inclusive, -1 for the last) like comp_inj -r.\n"
+		"Returns a dict of Buffer columns, one entry per trial; status indexes STATUS_NAMES,\n"
+		"effect indexes EFFECT_NAMES (-1 when not known). classify_only computes the effect alone.\n"
+		"With results the usual CSV rows are also appended to that file." },
+	{ NULL }
+};
+
+static PyGetSetDef injectorGetSet[] = {
+	{ "compression_ratio", (getter)injectorGetRatio, NULL, "Compression ratio, 0 before compress()", NULL },
+	{ "compressed_size", (getter)injectorGetSize, NULL, "Compressed stream size in bytes", NULL },
+	{ "compress_time", (getter)injectorGetTime, NULL, "Seconds the compression took", NULL },
+	{ NULL }
+};
+
+static PyTypeObject InjectorType = {
+	PyVarObject_HEAD_INIT(NULL, 0)
+	.tp_name = "carts.Injector",
+	.tp_doc = "Injector(field, compressor, mode, bound, default_bound=-1, threads=1)\n\n"
+		"Compress-then-corrupt engine over a float32 field, read in place.",
+	.tp_basicsize = sizeof(InjectorObject),
+	.tp_flags = Py_TPFLAGS_DEFAULT,
+	.tp_new = PyType_GenericNew,
+	.tp_init = (initproc)injectorInit,
+	.tp_dealloc = (destructor)injectorDealloc,
+	.tp_methods = injectorMethods,
+	.tp_getset = injectorGetSet,
+};
+
+static PyMethodDef cartsMethods[] = {
+	{ "error_metrics", (PyCFunction)(void (*)(void))errorMetricsFunction, METH_VARARGS | METH_KEYWORDS,
+		"error_metrics(original, output, mode, bound, default_bound=-1)\n\nIncorrect count, max difference, RMSE and PSNR." },
+	{ "quality", (PyCFunction)(void (*)(void))qualityFunction, METH_VARARGS | METH_KEYWORDS,
+		"quality(original, output, metrics='all')\n\nSSIM, Pearson, range relative error and ULP metrics (see comp_inj -M)." },
+	{ "propagation", (PyCFunction)(void (*)(void))propagationFunction, METH_VARARGS | METH_KEYWORDS,
+		"propagation(baseline, output, block_edge=6)\n\nHow far a fault spread relative to the baseline." },
+	{ NULL }
+};
+
+static struct PyModuleDef cartsModule = {
+	PyModuleDef_HEAD_INIT,
+	.m_name = "carts",
+	.m_doc = "In-process bindings of the CARTS injection engine.",
+	.m_size = -1,
+	.m_methods = cartsMethods,
+};
+
+PyMODINIT_FUNC PyInit_carts(void){
+	PyObject *module, *names, *effects;
+	int count = 0, i;
+
+	if (PyType_Ready(&BufferType) < 0 || PyType_Ready(&InjectorType) < 0){
+		return NULL;
+	}
+	crashPrepare();
+	module = PyModule_Create(&cartsModule);
+	if (module == NULL){
+		return NULL;
+	}
+	while (campaignStatusName(count)){
+		count++;
+	}
+	names = PyTuple_New(count);
+	if (names == NULL){
+		Py_DECREF(module);
+		return NULL;
+	}
+	for (i = 0; i < count; i++){
+		PyTuple_SET_ITEM(names, i, PyUnicode_FromString(campaignStatusName(i)));
+	}
+	effects = PyTuple_New(EFFECT_CHANGED + 1);
+	if (effects == NULL){
+		Py_DECREF(names);
+		Py_DECREF(module);
+		return NULL;
+	}
+	for (i = 0; i <= EFFECT_CHANGED; i++){
+		PyTuple_SET_ITEM(effects, i, PyUnicode_FromString(effectName(i)));
+	}
+	Py_INCREF(&BufferType);
+	Py_INCREF(&InjectorType);
+	if (PyModule_AddObject(module, "STATUS_NAMES", names) < 0
+			|| PyModule_AddObject(module, "EFFECT_NAMES", effects) < 0
+			|| PyModule_AddObject(module, "Buffer", (PyObject *)&BufferType) < 0
+			|| PyModule_AddObject(module, "Injector", (PyObject *)&InjectorType) < 0){
+		Py_DECREF(module);
+		return NULL;
+	}
+	return module;
+}
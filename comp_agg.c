@@ -0,0 +1,1007 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <dirent.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+/*
+ * Results aggregation and queries.
+ * -------------------------------------------------------------------------------
+ * Ingests comp_inj result CSVs (or directories of them) with one thread per
+ * file into a columnar store, and answers the common questions directly:
+ *
+ *   outcomes:byte=N      status counts per N-byte region of the stream
+ *   outcomes:bit         status counts per flipped bit
+ *   outcomes:source      status counts per input file (one file per mode)
+ *   outcomes:bound       status counts per error bound
+ *   percentiles:METRIC   P50/P90/P99/P99.9/max of a metric over completed
+ *                        trials per source (MaxDifference, RMSE, PSNR,
+ *                        DecompressionTime, Incorrect, CompressionRatio)
+ *   crashes              crash counts per crash site, the first frame
+ *                        outside comp_inj/libc/libpressio (symbolize and
+ *                        name them with crash_buckets.py)
+ *
+ * Usage: comp_agg [-j threads] [-o store.cagg] [-q query] [-m merged.csv] inputs...
+ *
+ * -o saves the store so later queries skip the CSV parsing, a .cagg file is
+ * accepted anywhere a CSV is. -m concatenates the raw CSVs under a single
+ * header (what combine_csv.py used to do). Inputs may be labelled as
+ * label=path, otherwise the file name without extension is the source.
+ * Query results are written as CSV to stdout.
+ * -------------------------------------------------------------------------------
+ */
+
+#define STORE_MAGIC "CARTSAGG"
+#define STORE_VERSION 2
+// Most comma separated fields read per row
+#define MAX_FIELDS 64
+
+// Outcomes written by comp_inj and the older runner
+static const char *STATUS_NAMES[] = {
+	"Completed", "SegFault", "Timeout", "VersionError", "StepLengthError",
+	"CoreDump", "HardSegFaultCoreDump", "CheckError", "MemoryCapExceeded", "Unknown"
+};
+#define STATUS_COUNT (sizeof(STATUS_NAMES) / sizeof(STATUS_NAMES[0]))
+#define STATUS_UNKNOWN (STATUS_COUNT - 1)
+
+// Modules skipped when looking for the crash site, as in crash_buckets.py
+static const char *HARNESS_MODULES[] = {
+	"comp_inj", "libc.so", "libc-", "libpressio", "liblibpressio", "ld-linux", "libpthread", "linux-vdso", "unknown"
+};
+
+/*
+ * Interned strings (sources, tracebacks), id 0 is the empty string.
+ */
+struct string_table {
+	char **strings;
+	size_t count;
+	size_t capacity;
+	uint32_t *slots;
+	size_t num_slots;
+};
+
+/*
+ * One column per field; rows are appended to every column together.
+ */
+struct column_store {
+	size_t rows;
+	size_t capacity;
+	uint16_t *source;
+	int32_t *byte;
+	uint8_t *bit;
+	uint8_t *status;
+	int32_t *incorrect;
+	uint32_t *traceback;
+	float *bound;
+	float *ratio;
+	float *time;
+	float *max_diff;
+	float *rmse;
+	float *psnr;
+
+	struct string_table sources;
+	struct string_table tracebacks;
+};
+
+struct ingest_job {
+	char **paths;
+	char **labels;
+	struct column_store *chunks;
+	size_t count;
+	size_t next;
+	pthread_mutex_t lock;
+};
+
+/*
+ * Function: hashString
+ * -------------------------------------------------------------------------------
+ * returns: the FNV-1a hash of a string
+ * -------------------------------------------------------------------------------
+ */
+static uint64_t hashString(const char *s, size_t len){
+	uint64_t h = 1469598103934665603ull;
+	size_t i;
+	for (i = 0; i < len; i++){
+		h = (h ^ (unsigned char)s[i]) * 1099511628211ull;
+	}
+	return h;
+}
+
+static void *xrealloc(void *p, size_t bytes){
+	p = realloc(p, bytes);
+	if (p == NULL && bytes){
+		printf("ERROR: out of memory\n");
+		exit(-1);
+	}
+	return p;
+}
+
+/*
+ * Function: internString
+ * -------------------------------------------------------------------------------
+ * returns: the id of a string, adding it to the table if it is new
+ * -------------------------------------------------------------------------------
+ */
+static uint32_t internString(struct string_table *t, const char *s, size_t len){
+	size_t i;
+	if (t->count == 0){
+		t->capacity = 16;
+		t->strings = xrealloc(NULL, sizeof(char *) * t->capacity);
+		t->strings[t->count++] = strdup("");
+	}
+	if (len == 0){
+		return 0;
+	}
+	if (2 * t->count >= t->num_slots){
+		size_t num_slots = t->num_slots ? t->num_slots * 2 : 64;
+		uint32_t *slots = calloc(num_slots, sizeof(uint32_t));
+		for (i = 1; i < t->count; i++){
+			size_t slot = hashString(t->strings[i], strlen(t->strings[i])) & (num_slots - 1);
+			while (slots[slot]){
+				slot = (slot + 1) & (num_slots - 1);
+			}
+			slots[slot] = i;
+		}
+		free(t->slots);
+		t->slots = slots;
+		t->num_slots = num_slots;
+	}
+
+	size_t slot = hashString(s, len) & (t->num_slots - 1);
+	while (t->slots[slot]){
+		const char *existing = t->strings[t->slots[slot]];
+		if (strncmp(existing, s, len) == 0 && existing[len] == '\0'){
+			return t->slots[slot];
+		}
+		slot = (slot + 1) & (t->num_slots - 1);
+	}
+	if (t->count == t->capacity){
+		t->capacity *= 2;
+		t->strings = xrealloc(t->strings, sizeof(char *) * t->capacity);
+	}
+	t->strings[t->count] = strndup(s, len);
+	t->slots[slot] = t->count;
+	return t->count++;
+}
+
+static void freeStrings(struct string_table *t){
+	size_t i;
+	for (i = 0; i < t->count; i++){
+		free(t->strings[i]);
+	}
+	free(t->strings);
+	free(t->slots);
+	memset(t, 0, sizeof(struct string_table));
+}
+
+/*
+ * Function: storeReserve
+ * -------------------------------------------------------------------------------
+ * Grows every column to hold at least rows entries.
+ * -------------------------------------------------------------------------------
+ */
+static void storeReserve(struct column_store *s, size_t rows){
+	if (rows <= s->capacity){
+		return;
+	}
+	size_t capacity = s->capacity ? s->capacity : 4096;
+	while (capacity < rows){
+		capacity *= 2;
+	}
+	s->source = xrealloc(s->source, sizeof(uint16_t) * capacity);
+	s->byte = xrealloc(s->byte, sizeof(int32_t) * capacity);
+	s->bit = xrealloc(s->bit, sizeof(uint8_t) * capacity);
+	s->status = xrealloc(s->status, sizeof(uint8_t) * capacity);
+	s->incorrect = xrealloc(s->incorrect, sizeof(int32_t) * capacity);
+	s->traceback = xrealloc(s->traceback, sizeof(uint32_t) * capacity);
+	s->bound = xrealloc(s->bound, sizeof(float) * capacity);
+	s->ratio = xrealloc(s->ratio, sizeof(float) * capacity);
+	s->time = xrealloc(s->time, sizeof(float) * capacity);
+	s->max_diff = xrealloc(s->max_diff, sizeof(float) * capacity);
+	s->rmse = xrealloc(s->rmse, sizeof(float) * capacity);
+	s->psnr = xrealloc(s->psnr, sizeof(float) * capacity);
+	s->capacity = capacity;
+}
+
+static void storeFree(struct column_store *s){
+	free(s->source);
+	free(s->byte);
+	free(s->bit);
+	free(s->status);
+	free(s->incorrect);
+	free(s->traceback);
+	free(s->bound);
+	free(s->ratio);
+	free(s->time);
+	free(s->max_diff);
+	free(s->rmse);
+	free(s->psnr);
+	freeStrings(&s->sources);
+	freeStrings(&s->tracebacks);
+	memset(s, 0, sizeof(struct column_store));
+}
+
+/*
+ * Function: readFile
+ * -------------------------------------------------------------------------------
+ * returns: the whole file NUL terminated, its length in size
+ * -------------------------------------------------------------------------------
+ */
+static char *readFile(const char *path, size_t *size){
+	FILE *fp = fopen(path, "rb");
+	struct stat st;
+	if (fp == NULL || fstat(fileno(fp), &st) != 0){
+		perror("ERROR: ");
+		exit(-1);
+	}
+	char *buf = xrealloc(NULL, st.st_size + 1);
+	*size = fread(buf, 1, st.st_size, fp);
+	buf[*size] = '\0';
+	fclose(fp);
+	return buf;
+}
+
+static float parseFloat(const char *field){
+	if (field[0] == 'N' && field[1] == 'A'){
+		return NAN;
+	}
+	return strtof(field, NULL);
+}
+
+/*
+ * Function: statusIndex
+ * -------------------------------------------------------------------------------
+ * returns: the index of a status name in STATUS_NAMES
+ * -------------------------------------------------------------------------------
+ */
+static uint8_t statusIndex(const char *field, size_t len){
+	size_t s;
+	for (s = 0; s < STATUS_COUNT; s++){
+		if (strlen(STATUS_NAMES[s]) == len && strncmp(STATUS_NAMES[s], field, len) == 0){
+			return s;
+		}
+	}
+	return STATUS_UNKNOWN;
+}
+
+// Columns read from the CSV header, -1 when a file does not have them
+enum csv_column { COL_BYTE, COL_BIT, COL_STATUS, COL_BOUND, COL_RATIO, COL_TIME, COL_INCORRECT, COL_MAX_DIFF, COL_RMSE, COL_PSNR, COL_TRACEBACK, NUM_COLUMNS };
+static const char *CSV_NAMES[NUM_COLUMNS] = {
+	"ByteLocation", "FlipLocation", "Status", "ErrorInfo", "CompressionRatio", "DecompressionTime",
+	"Incorrect", "MaxDifference", "RMSE", "PSNR", "Traceback"
+};
+
+/*
+ * Function: ingestCsv
+ * -------------------------------------------------------------------------------
+ * Parses one results CSV into a chunk of the store.
+ * -------------------------------------------------------------------------------
+ */
+static void ingestCsv(const char *path, const char *label, struct column_store *s){
+	size_t size;
+	char *buf = readFile(path, &size);
+	char *line = buf, *next;
+	int index[NUM_COLUMNS];
+	const char *fields[MAX_FIELDS];
+	size_t lengths[MAX_FIELDS];
+	int c, n;
+
+	uint16_t source = internString(&s->sources, label, strlen(label));
+	for (c = 0; c < NUM_COLUMNS; c++){
+		index[c] = -1;
+	}
+
+	for (; *line; line = next){
+		char *end = strchr(line, '\n');
+		next = end ? end + 1 : line + strlen(line);
+		if (end == NULL){
+			end = next;
+		}
+		if (end > line && end[-1] == '\r'){
+			end--;
+		}
+		if (end == line){
+			continue;
+		}
+
+		// Split in place, fields are NUL terminated for strtof
+		n = 0;
+		char *p = line;
+		while (n < MAX_FIELDS){
+			char *comma = memchr(p, ',', end - p);
+			char *stop = comma ? comma : end;
+			fields[n] = p;
+			lengths[n] = stop - p;
+			n++;
+			*stop = '\0';
+			if (comma == NULL){
+				break;
+			}
+			p = comma + 1;
+		}
+
+		if (index[COL_STATUS] < 0){
+			int i;
+			for (i = 0; i < n; i++){
+				for (c = 0; c < NUM_COLUMNS; c++){
+					if (strcmp(fields[i], CSV_NAMES[c]) == 0){
+						index[c] = i;
+					}
+				}
+			}
+			if (index[COL_STATUS] < 0 || index[COL_BYTE] < 0 || index[COL_BIT] < 0){
+				printf("ERROR: %s is not a comp_inj results file\n", path);
+				exit(-1);
+			}
+			continue;
+		}
+		if (n <= index[COL_STATUS]){
+			continue;
+		}
+
+		storeReserve(s, s->rows + 1);
+		size_t r = s->rows++;
+		s->source[r] = source;
+		s->byte[r] = atoi(fields[index[COL_BYTE]]);
+		s->bit[r] = atoi(fields[index[COL_BIT]]);
+		s->status[r] = statusIndex(fields[index[COL_STATUS]], lengths[index[COL_STATUS]]);
+		s->bound[r] = index[COL_BOUND] >= 0 && index[COL_BOUND] < n ? parseFloat(fields[index[COL_BOUND]]) : NAN;
+		s->ratio[r] = index[COL_RATIO] >= 0 && index[COL_RATIO] < n ? parseFloat(fields[index[COL_RATIO]]) : NAN;
+		s->time[r] = index[COL_TIME] >= 0 && index[COL_TIME] < n ? parseFloat(fields[index[COL_TIME]]) : NAN;
+		s->incorrect[r] = index[COL_INCORRECT] >= 0 && index[COL_INCORRECT] < n ? atoi(fields[index[COL_INCORRECT]]) : -1;
+		s->max_diff[r] = index[COL_MAX_DIFF] >= 0 && index[COL_MAX_DIFF] < n ? parseFloat(fields[index[COL_MAX_DIFF]]) : NAN;
+		s->rmse[r] = index[COL_RMSE] >= 0 && index[COL_RMSE] < n ? parseFloat(fields[index[COL_RMSE]]) : NAN;
+		s->psnr[r] = index[COL_PSNR] >= 0 && index[COL_PSNR] < n ? parseFloat(fields[index[COL_PSNR]]) : NAN;
+		s->traceback[r] = 0;
+		if (index[COL_TRACEBACK] >= 0 && index[COL_TRACEBACK] < n){
+			const char *t = fields[index[COL_TRACEBACK]];
+			size_t len = lengths[index[COL_TRACEBACK]];
+			if (!(len == 2 && strncmp(t, "NA", 2) == 0) && !(len == 7 && strncmp(t, "Unknown", 7) == 0)){
+				s->traceback[r] = internString(&s->tracebacks, t, len);
+			}
+		}
+	}
+	free(buf);
+}
+
+/*
+ * Function: writeStrings
+ * -------------------------------------------------------------------------------
+ * Writes a string table as a count followed by length prefixed strings.
+ * -------------------------------------------------------------------------------
+ */
+static void writeStrings(const struct string_table *t, FILE *fp){
+	uint64_t count = t->count, i;
+	fwrite(&count, sizeof(count), 1, fp);
+	for (i = 0; i < count; i++){
+		uint32_t len = strlen(t->strings[i]);
+		fwrite(&len, sizeof(len), 1, fp);
+		fwrite(t->strings[i], 1, len, fp);
+	}
+}
+
+/*
+ * Function: saveStore
+ * -------------------------------------------------------------------------------
+ * Writes the store: magic, version, row count, string tables, then each
+ * column as one contiguous array.
+ * -------------------------------------------------------------------------------
+ */
+static void saveStore(const struct column_store *s, const char *path){
+	FILE *fp = fopen(path, "wb");
+	uint32_t version = STORE_VERSION;
+	uint64_t rows = s->rows;
+	if (fp == NULL){
+		perror("ERROR: ");
+		exit(-1);
+	}
+	fwrite(STORE_MAGIC, 1, 8, fp);
+	fwrite(&version, sizeof(version), 1, fp);
+	fwrite(&rows, sizeof(rows), 1, fp);
+	writeStrings(&s->sources, fp);
+	writeStrings(&s->tracebacks, fp);
+	fwrite(s->source, sizeof(uint16_t), rows, fp);
+	fwrite(s->byte, sizeof(int32_t), rows, fp);
+	fwrite(s->bit, sizeof(uint8_t), rows, fp);
+	fwrite(s->status, sizeof(uint8_t), rows, fp);
+	fwrite(s->incorrect, sizeof(int32_t), rows, fp);
+	fwrite(s->traceback, sizeof(uint32_t), rows, fp);
+	fwrite(s->bound, sizeof(float), rows, fp);
+	fwrite(s->ratio, sizeof(float), rows, fp);
+	fwrite(s->time, sizeof(float), rows, fp);
+	fwrite(s->max_diff, sizeof(float), rows, fp);
+	fwrite(s->rmse, sizeof(float), rows, fp);
+	fwrite(s->psnr, sizeof(float), rows, fp);
+	fclose(fp);
+}
+
+/*
+ * Function: readBytes
+ * -------------------------------------------------------------------------------
+ * Cursor read from a loaded store, exits on a truncated file.
+ * -------------------------------------------------------------------------------
+ */
+static void readBytes(void *dst, size_t bytes, const char **p, const char *end){
+	if ((size_t)(end - *p) < bytes){
+		printf("ERROR: truncated store\n");
+		exit(-1);
+	}
+	memcpy(dst, *p, bytes);
+	*p += bytes;
+}
+
+static void readStrings(struct string_table *t, const char **p, const char *end){
+	uint64_t count, i;
+	readBytes(&count, sizeof(count), p, end);
+	for (i = 0; i < count; i++){
+		uint32_t len;
+		readBytes(&len, sizeof(len), p, end);
+		if ((size_t)(end - *p) < len){
+			printf("ERROR: truncated store\n");
+			exit(-1);
+		}
+		// Id 0 is always the empty string, so ids are kept
+		internString(t, *p, len);
+		*p += len;
+	}
+}
+
+/*
+ * Function: loadStore
+ * -------------------------------------------------------------------------------
+ * Reads a store written by saveStore into a chunk.
+ * -------------------------------------------------------------------------------
+ */
+static void loadStore(const char *path, struct column_store *s){
+	size_t size;
+	char *buf = readFile(path, &size);
+	const char *p = buf + 8, *end = buf + size;
+	uint32_t version;
+	uint64_t rows;
+
+	readBytes(&version, sizeof(version), &p, end);
+	if (version != STORE_VERSION){
+		printf("ERROR: %s has store version %u, expected %u\n", path, version, STORE_VERSION);
+		exit(-1);
+	}
+	readBytes(&rows, sizeof(rows), &p, end);
+	readStrings(&s->sources, &p, end);
+	readStrings(&s->tracebacks, &p, end);
+	storeReserve(s, rows);
+	s->rows = rows;
+	readBytes(s->source, sizeof(uint16_t) * rows, &p, end);
+	readBytes(s->byte, sizeof(int32_t) * rows, &p, end);
+	readBytes(s->bit, sizeof(uint8_t) * rows, &p, end);
+	readBytes(s->status, sizeof(uint8_t) * rows, &p, end);
+	readBytes(s->incorrect, sizeof(int32_t) * rows, &p, end);
+	readBytes(s->traceback, sizeof(uint32_t) * rows, &p, end);
+	readBytes(s->bound, sizeof(float) * rows, &p, end);
+	readBytes(s->ratio, sizeof(float) * rows, &p, end);
+	readBytes(s->time, sizeof(float) * rows, &p, end);
+	readBytes(s->max_diff, sizeof(float) * rows, &p, end);
+	readBytes(s->rmse, sizeof(float) * rows, &p, end);
+	readBytes(s->psnr, sizeof(float) * rows, &p, end);
+	free(buf);
+}
+
+static int isStore(const char *path){
+	char magic[8] = { 0 };
+	FILE *fp = fopen(path, "rb");
+	if (fp == NULL){
+		return 0;
+	}
+	size_t n = fread(magic, 1, sizeof(magic), fp);
+	fclose(fp);
+	return n == sizeof(magic) && memcmp(magic, STORE_MAGIC, sizeof(magic)) == 0;
+}
+
+/*
+ * Function: ingestWorker
+ * -------------------------------------------------------------------------------
+ * Thread body: takes files off the job until none are left.
+ * -------------------------------------------------------------------------------
+ */
+static void *ingestWorker(void *arg){
+	struct ingest_job *job = arg;
+	for (;;){
+		pthread_mutex_lock(&job->lock);
+		size_t i = job->next++;
+		pthread_mutex_unlock(&job->lock);
+		if (i >= job->count){
+			return NULL;
+		}
+		if (isStore(job->paths[i])){
+			loadStore(job->paths[i], &job->chunks[i]);
+		} else {
+			ingestCsv(job->paths[i], job->labels[i], &job->chunks[i]);
+		}
+	}
+}
+
+/*
+ * Function: mergeChunk
+ * -------------------------------------------------------------------------------
+ * Appends a chunk to the store, remapping its string ids.
+ * -------------------------------------------------------------------------------
+ */
+static void mergeChunk(struct column_store *dst, const struct column_store *src){
+	uint32_t *sources = xrealloc(NULL, sizeof(uint32_t) * (src->sources.count + 1));
+	uint32_t *tracebacks = xrealloc(NULL, sizeof(uint32_t) * (src->tracebacks.count + 1));
+	size_t i;
+
+	for (i = 0; i < src->sources.count; i++){
+		sources[i] = internString(&dst->sources, src->sources.strings[i], strlen(src->sources.strings[i]));
+	}
+	for (i = 0; i < src->tracebacks.count; i++){
+		tracebacks[i] = internString(&dst->tracebacks, src->tracebacks.strings[i], strlen(src->tracebacks.strings[i]));
+	}
+	if (dst->sources.count > UINT16_MAX){
+		printf("ERROR: too many sources\n");
+		exit(-1);
+	}
+
+	storeReserve(dst, dst->rows + src->rows);
+	size_t base = dst->rows;
+	for (i = 0; i < src->rows; i++){
+		dst->source[base + i] = sources[src->source[i]];
+		dst->traceback[base + i] = src->traceback[i] ? tracebacks[src->traceback[i]] : 0;
+	}
+	memcpy(dst->byte + base, src->byte, sizeof(int32_t) * src->rows);
+	memcpy(dst->bit + base, src->bit, sizeof(uint8_t) * src->rows);
+	memcpy(dst->status + base, src->status, sizeof(uint8_t) * src->rows);
+	memcpy(dst->incorrect + base, src->incorrect, sizeof(int32_t) * src->rows);
+	memcpy(dst->bound + base, src->bound, sizeof(float) * src->rows);
+	memcpy(dst->ratio + base, src->ratio, sizeof(float) * src->rows);
+	memcpy(dst->time + base, src->time, sizeof(float) * src->rows);
+	memcpy(dst->max_diff + base, src->max_diff, sizeof(float) * src->rows);
+	memcpy(dst->rmse + base, src->rmse, sizeof(float) * src->rows);
+	memcpy(dst->psnr + base, src->psnr, sizeof(float) * src->rows);
+	dst->rows += src->rows;
+	free(sources);
+	free(tracebacks);
+}
+
+/*
+ * Function: mergeCsv
+ * -------------------------------------------------------------------------------
+ * Concatenates result CSVs under the first file's header.
+ * -------------------------------------------------------------------------------
+ */
+static void mergeCsv(char **paths, size_t count, const char *output_path){
+	FILE *out = fopen(output_path, "w");
+	char *header = NULL;
+	size_t i;
+	if (out == NULL){
+		perror("ERROR: ");
+		exit(-1);
+	}
+	for (i = 0; i < count; i++){
+		if (isStore(paths[i])){
+			fprintf(stderr, "WARNING: %s is a store, not merged\n", paths[i]);
+			continue;
+		}
+		size_t size;
+		char *buf = readFile(paths[i], &size);
+		char *body = strchr(buf, '\n');
+		body = body ? body + 1 : buf + size;
+		if (header == NULL){
+			header = strndup(buf, body - buf);
+			fwrite(buf, 1, size, out);
+		} else {
+			if ((size_t)(body - buf) != strlen(header) || strncmp(buf, header, body - buf) != 0){
+				fprintf(stderr, "WARNING: %s has a different header\n", paths[i]);
+			}
+			fwrite(body, 1, size - (body - buf), out);
+		}
+		size_t lines = 0;
+		const char *c;
+		for (c = buf; c < buf + size; c++){
+			lines += *c == '\n';
+		}
+		fprintf(stderr, "Lines %s: %zu\n", paths[i], lines);
+		free(buf);
+	}
+	free(header);
+	fclose(out);
+}
+
+/*
+ * Function: queryOutcomes
+ * -------------------------------------------------------------------------------
+ * Status counts grouped by byte region, bit, source or error bound.
+ * -------------------------------------------------------------------------------
+ */
+static void queryOutcomes(const struct column_store *s, const char *group){
+	size_t r, k, st;
+	long region = 0;
+	int by_byte = 0, by_bit = 0, by_source = 0;
+
+	if (strncmp(group, "byte", 4) == 0){
+		by_byte = 1;
+		region = group[4] == '=' ? atol(group + 5) : 1024;
+		if (region <= 0){
+			printf("ERROR: byte region must be positive\n");
+			exit(-1);
+		}
+	} else if (strcmp(group, "bit") == 0){
+		by_bit = 1;
+	} else if (strcmp(group, "source") == 0){
+		by_source = 1;
+	} else if (strcmp(group, "bound") != 0){
+		printf("ERROR: unknown outcome grouping %s\n", group);
+		exit(-1);
+	}
+
+	// Group keys are small integers, bounds are interned by value
+	struct string_table bounds = { 0 };
+	size_t num_keys = 0;
+	long *keys = NULL;
+	for (r = 0; r < s->rows; r++){
+		long key;
+		if (by_byte){
+			key = s->byte[r] / region;
+		} else if (by_bit){
+			key = s->bit[r];
+		} else if (by_source){
+			key = s->source[r];
+		} else {
+			char text[32];
+			snprintf(text, sizeof(text), "%g", s->bound[r]);
+			key = internString(&bounds, text, strlen(text));
+		}
+		if ((size_t)key + 1 > num_keys){
+			keys = xrealloc(keys, sizeof(long) * (key + 1) * STATUS_COUNT);
+			memset(keys + num_keys * STATUS_COUNT, 0, sizeof(long) * (key + 1 - num_keys) * STATUS_COUNT);
+			num_keys = key + 1;
+		}
+		keys[key * STATUS_COUNT + s->status[r]]++;
+	}
+
+	printf("%s,Trials", by_byte ? "RegionStart" : by_bit ? "FlipLocation" : by_source ? "Source" : "ErrorInfo");
+	for (st = 0; st < STATUS_COUNT; st++){
+		printf(",%s", STATUS_NAMES[st]);
+	}
+	printf("\n");
+	for (k = 0; k < num_keys; k++){
+		long trials = 0;
+		for (st = 0; st < STATUS_COUNT; st++){
+			trials += keys[k * STATUS_COUNT + st];
+		}
+		if (trials == 0){
+			continue;
+		}
+		if (by_byte){
+			printf("%ld", (long)k * region);
+		} else if (by_bit){
+			printf("%zu", k);
+		} else if (by_source){
+			printf("%s", s->sources.strings[k]);
+		} else {
+			printf("%s", bounds.strings[k]);
+		}
+		printf(",%ld", trials);
+		for (st = 0; st < STATUS_COUNT; st++){
+			printf(",%ld", keys[k * STATUS_COUNT + st]);
+		}
+		printf("\n");
+	}
+	free(keys);
+	freeStrings(&bounds);
+}
+
+static int compareFloat(const void *a, const void *b){
+	float x = *(const float *)a;
+	float y = *(const float *)b;
+	return (x > y) - (x < y);
+}
+
+/*
+ * Function: queryPercentiles
+ * -------------------------------------------------------------------------------
+ * Percentiles of a metric over the completed trials of every source.
+ * -------------------------------------------------------------------------------
+ */
+static void queryPercentiles(const struct column_store *s, const char *metric){
+	static const double QUANTILES[] = { 0.5, 0.9, 0.99, 0.999 };
+	const float *column = NULL;
+	int incorrect = 0;
+	size_t src, r, q;
+
+	if (strcmp(metric, "MaxDifference") == 0){
+		column = s->max_diff;
+	} else if (strcmp(metric, "RMSE") == 0){
+		column = s->rmse;
+	} else if (strcmp(metric, "PSNR") == 0){
+		column = s->psnr;
+	} else if (strcmp(metric, "DecompressionTime") == 0){
+		column = s->time;
+	} else if (strcmp(metric, "CompressionRatio") == 0){
+		column = s->ratio;
+	} else if (strcmp(metric, "Incorrect") == 0){
+		incorrect = 1;
+	} else {
+		printf("ERROR: unknown metric %s\n", metric);
+		exit(-1);
+	}
+
+	float *values = xrealloc(NULL, sizeof(float) * (s->rows + 1));
+	printf("Source,Metric,Count,P50,P90,P99,P99.9,Max\n");
+	for (src = 1; src < s->sources.count; src++){
+		size_t n = 0;
+		for (r = 0; r < s->rows; r++){
+			if (s->source[r] != src || s->status[r] != 0){
+				continue;
+			}
+			float v = incorrect ? (float)s->incorrect[r] : column[r];
+			if (isfinite(v)){
+				values[n++] = v;
+			}
+		}
+		if (n == 0){
+			continue;
+		}
+		qsort(values, n, sizeof(float), compareFloat);
+		printf("%s,%s,%zu", s->sources.strings[src], metric, n);
+		for (q = 0; q < sizeof(QUANTILES) / sizeof(QUANTILES[0]); q++){
+			printf(",%g", values[(size_t)(QUANTILES[q] * (n - 1))]);
+		}
+		printf(",%g\n", values[n - 1]);
+	}
+	free(values);
+}
+
+/*
+ * Function: crashSite
+ * -------------------------------------------------------------------------------
+ * Picks the frame a crash is bucketed by: the first "/module(+offset)" frame
+ * outside the harness, else the frame after the signal trampoline.
+ *
+ * returns: the length of the frame, its start in site
+ * -------------------------------------------------------------------------------
+ */
+static size_t crashSite(const char *traceback, const char **site){
+	const char *p = traceback, *fallback = NULL;
+	size_t fallback_len = 0;
+	int frame = 0;
+	size_t h;
+
+	while ((p = strchr(p, '/')) != NULL){
+		const char *close = strchr(p, ')');
+		if (close == NULL){
+			break;
+		}
+		const char *name = p, *paren = memchr(p, '(', close - p), *slash;
+		if (paren == NULL){
+			paren = close;
+		}
+		for (slash = p; slash < paren; slash++){
+			if (*slash == '/'){
+				name = slash + 1;
+			}
+		}
+		int harness = 0;
+		for (h = 0; h < sizeof(HARNESS_MODULES) / sizeof(HARNESS_MODULES[0]); h++){
+			if (strncmp(name, HARNESS_MODULES[h], strlen(HARNESS_MODULES[h])) == 0){
+				harness = 1;
+			}
+		}
+		if (!harness){
+			*site = p;
+			return close - p + 1;
+		}
+		if (frame == 1 || fallback == NULL){
+			fallback = p;
+			fallback_len = close - p + 1;
+		}
+		frame++;
+		p = close + 1;
+	}
+	*site = fallback ? fallback : traceback;
+	return fallback ? fallback_len : strlen(traceback);
+}
+
+struct site_count {
+	uint32_t site;
+	long count;
+};
+
+static int compareSiteCount(const void *a, const void *b){
+	long x = ((const struct site_count *)a)->count;
+	long y = ((const struct site_count *)b)->count;
+	return (x < y) - (x > y);
+}
+
+/*
+ * Function: queryCrashes
+ * -------------------------------------------------------------------------------
+ * Crash counts per crash site, most frequent first.
+ * -------------------------------------------------------------------------------
+ */
+static void queryCrashes(const struct column_store *s){
+	struct string_table sites = { 0 };
+	uint32_t *site_of = xrealloc(NULL, sizeof(uint32_t) * (s->tracebacks.count + 1));
+	size_t i, r;
+
+	for (i = 0; i < s->tracebacks.count; i++){
+		const char *site;
+		size_t len = crashSite(s->tracebacks.strings[i], &site);
+		site_of[i] = internString(&sites, site, len);
+	}
+
+	struct site_count *counts = calloc(sites.count + 1, sizeof(struct site_count));
+	for (i = 0; i < sites.count; i++){
+		counts[i].site = i;
+	}
+	for (r = 0; r < s->rows; r++){
+		if (s->traceback[r]){
+			counts[site_of[s->traceback[r]]].count++;
+		}
+	}
+	qsort(counts, sites.count, sizeof(struct site_count), compareSiteCount);
+
+	printf("CrashSite,Count\n");
+	for (i = 0; i < sites.count; i++){
+		if (counts[i].count){
+			printf("%s,%ld\n", sites.strings[counts[i].site], counts[i].count);
+		}
+	}
+	free(counts);
+	free(site_of);
+	freeStrings(&sites);
+}
+
+/*
+ * Function: addInput
+ * -------------------------------------------------------------------------------
+ * Adds a file, or every .csv/.cagg file of a directory, to the input list.
+ * -------------------------------------------------------------------------------
+ */
+static void addInput(const char *arg, char ***paths, char ***labels, size_t *count){
+	const char *path = arg, *equals = strchr(arg, '=');
+	char *label = NULL;
+	struct stat st;
+
+	if (equals && stat(arg, &st) != 0){
+		label = strndup(arg, equals - arg);
+		path = equals + 1;
+	}
+	if (stat(path, &st) != 0){
+		perror("ERROR: ");
+		exit(-1);
+	}
+
+	if (S_ISDIR(st.st_mode)){
+		struct dirent **entries;
+		int n = scandir(path, &entries, NULL, alphasort), i;
+		for (i = 0; i < n; i++){
+			const char *dot = strrchr(entries[i]->d_name, '.');
+			if (dot && (strcmp(dot, ".csv") == 0 || strcmp(dot, ".cagg") == 0)){
+				char child[4096];
+				snprintf(child, sizeof(child), "%s/%s", path, entries[i]->d_name);
+				addInput(child, paths, labels, count);
+			}
+			free(entries[i]);
+		}
+		free(entries);
+		free(label);
+		return;
+	}
+
+	if (label == NULL){
+		const char *base = strrchr(path, '/');
+		base = base ? base + 1 : path;
+		const char *dot = strrchr(base, '.');
+		label = strndup(base, dot ? (size_t)(dot - base) : strlen(base));
+	}
+	*paths = xrealloc(*paths, sizeof(char *) * (*count + 1));
+	*labels = xrealloc(*labels, sizeof(char *) * (*count + 1));
+	(*paths)[*count] = strdup(path);
+	(*labels)[*count] = label;
+	(*count)++;
+}
+
+int main(int argc, char *argv[]){
+	char *store_path = NULL, *query = NULL, *merge_path = NULL;
+	long threads = sysconf(_SC_NPROCESSORS_ONLN);
+	char **paths = NULL, **labels = NULL;
+	size_t count = 0, i;
+	int option_index;
+
+	while ((option_index = getopt(argc, argv, "j:o:q:m:")) != -1){
+		switch (option_index){
+			case 'j':
+				threads = atol(optarg);
+				break;
+			case 'o':
+				store_path = optarg;
+				break;
+			case 'q':
+				query = optarg;
+				break;
+			case 'm':
+				merge_path = optarg;
+				break;
+			default:
+				printf("Options incorrect\n");
+				return 1;
+		}
+	}
+	for (i = optind; i < (size_t)argc; i++){
+		addInput(argv[i], &paths, &labels, &count);
+	}
+	if (count == 0 || (store_path == NULL && query == NULL && merge_path == NULL)){
+		printf("Usage: comp_agg [-j threads] [-o store.cagg] [-q query] [-m merged.csv] inputs...\n");
+		return 1;
+	}
+
+	if (merge_path){
+		mergeCsv(paths, count, merge_path);
+	}
+
+	if (store_path || query){
+		struct ingest_job job;
+		job.paths = paths;
+		job.labels = labels;
+		job.count = count;
+		job.next = 0;
+		job.chunks = calloc(count, sizeof(struct column_store));
+		pthread_mutex_init(&job.lock, NULL);
+
+		if (threads < 1){
+			threads = 1;
+		}
+		if ((size_t)threads > count){
+			threads = count;
+		}
+		pthread_t *workers = malloc(sizeof(pthread_t) * threads);
+		for (i = 0; i < (size_t)threads; i++){
+			pthread_create(&workers[i], NULL, ingestWorker, &job);
+		}
+		for (i = 0; i < (size_t)threads; i++){
+			pthread_join(workers[i], NULL);
+		}
+		free(workers);
+
+		// Chunks are merged in input order so the store is reproducible
+		struct column_store store = { 0 };
+		internString(&store.sources, "", 0);
+		internString(&store.tracebacks, "", 0);
+		for (i = 0; i < count; i++){
+			mergeChunk(&store, &job.chunks[i]);
+			storeFree(&job.chunks[i]);
+		}
+		free(job.chunks);
+		pthread_mutex_destroy(&job.lock);
+
+		if (store_path){
+			saveStore(&store, store_path);
+			fprintf(stderr, "Stored %zu trials from %zu files in %s\n", store.rows, count, store_path);
+		}
+		if (query){
+			if (strncmp(query, "outcomes:", 9) == 0){
+				queryOutcomes(&store, query + 9);
+			} else if (strncmp(query, "percentiles:", 12) == 0){
+				queryPercentiles(&store, query + 12);
+			} else if (strcmp(query, "crashes") == 0){
+				queryCrashes(&store);
+			} else {
+				printf("ERROR: unknown query %s\n", query);
+				return 1;
+			}
+		}
+		storeFree(&store);
+	}
+
+	for (i = 0; i < count; i++){
+		free(paths[i]);
+		free(labels[i]);
+	}
+	free(paths);
+	free(labels);
+	return 0;
+}
@@ -0,0 +1,299 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+
+#include "arena.h"
+#include "injector.h"
+#include "campaign.h"
+#include "scaling.h"
+#include "crash.h"
+
+/*
+ * Campaign throughput benchmark.
+ * -------------------------------------------------------------------------------
+ * How many injection trials per second a node sustains, and how that scales
+ * with workers and field size. Runs the same seeded campaign for every
+ * field size x compressor setting x worker count and writes a JSON report:
+ *
+ *   fields      small 64x64x16, medium 128x128x64, large 256x256x128,
+ *               generated in memory from the seed (-f to choose)
+ *   settings    sz ABS and zfp Accuracy, bounds 1e-2 and 1e-4 (-c to choose)
+ *   workers     1, 2, 4, ... up to the online CPUs (-w "1,2,4,8")
+ *   campaign    -n bytes (8 trials each) from a seeded offset of the stream
+ *
+ * Usage: comp_bench [-o bench.json] [-f small,medium,large] [-c sz,zfp] [-w workers]
+ *                   [-n bytes] [-s seed] [-l timeout]
+ *
+ * Each point reports trials/sec, parallel efficiency against the first
+ * worker count, per-outcome trial latency (mean and max) and where the time
+ * went, summed over all workers: flip, decompress, metrics, process
+ * (fork/wait/classify) and output (rows written to /dev/null). Field load
+ * (generation) and compression are timed once per field and setting.
+ * Campaign progress still goes to stdout; `make bench` keeps the report in
+ * bench.json.
+ * -------------------------------------------------------------------------------
+ */
+
+// Field sizes, smallest first
+#define BENCH_MAX_FIELDS 3
+
+struct bench_field {
+	const char *name;
+	size_t dims[3];
+};
+
+struct bench_setting {
+	const char *compressor;
+	const char *mode;
+	float bound;
+};
+
+static const struct bench_field FIELDS[BENCH_MAX_FIELDS] = {
+	{ "small", { 64, 64, 16 } },
+	{ "medium", { 128, 128, 64 } },
+	{ "large", { 256, 256, 128 } },
+};
+
+static const struct bench_setting SETTINGS[] = {
+	{ "sz", "ABS", 1e-2f },
+	{ "sz", "ABS", 1e-4f },
+	{ "zfp", "Accuracy", 1e-2f },
+	{ "zfp", "Accuracy", 1e-4f },
+};
+#define NUM_SETTINGS (sizeof(SETTINGS) / sizeof(SETTINGS[0]))
+
+/*
+ * Function: mix
+ * -------------------------------------------------------------------------------
+ * splitmix64 finalizer, as in gen_field.c.
+ * -------------------------------------------------------------------------------
+ */
+static uint64_t mix(uint64_t x){
+	x += 0x9e3779b97f4a7c15ULL;
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+	return x ^ (x >> 31);
+}
+
+/*
+ * Function: generateField
+ * -------------------------------------------------------------------------------
+ * Fills the arena input with a smooth seeded field (a few separable waves)
+ * plus 1e-3 noise, so compression ratios look like simulation data.
+ * -------------------------------------------------------------------------------
+ */
+static void generateField(struct buffer_arena *arena, uint64_t seed){
+	double phase[3], freq[3];
+	size_t x, y, z, i = 0;
+	int d;
+
+	for (d = 0; d < 3; d++){
+		phase[d] = 2.0 * M_PI * (mix(seed + 2 * d) >> 11) / 9007199254740992.0;
+		freq[d] = 1 + mix(seed + 2 * d + 1) % 4;
+	}
+	for (z = 0; z < arena->dims[2]; z++){
+		double wz = cos(2.0 * M_PI * freq[2] * z / arena->dims[2] + phase[2]);
+		for (y = 0; y < arena->dims[1]; y++){
+			double wy = sin(2.0 * M_PI * freq[1] * y / arena->dims[1] + phase[1]);
+			for (x = 0; x < arena->dims[0]; x++, i++){
+				double wx = sin(2.0 * M_PI * freq[0] * x / arena->dims[0] + phase[0]);
+				double noise = (mix(seed ^ i) >> 11) / 9007199254740992.0 - 0.5;
+				arena->input[i] = (float)(wx * wy + 0.5 * wz + 1e-3 * noise);
+			}
+		}
+	}
+}
+
+/*
+ * Function: parseNames
+ * -------------------------------------------------------------------------------
+ * returns: nonzero if name is in the comma separated list, or the list is NULL
+ * -------------------------------------------------------------------------------
+ */
+static int parseNames(const char *list, const char *name){
+	size_t n = strlen(name);
+	const char *p = list;
+	if (list == NULL){
+		return 1;
+	}
+	while ((p = strstr(p, name)) != NULL){
+		if ((p == list || p[-1] == ',') && (p[n] == ',' || p[n] == '\0')){
+			return 1;
+		}
+		p += n;
+	}
+	return 0;
+}
+
+/*
+ * Function: writePoint
+ * -------------------------------------------------------------------------------
+ * Writes the JSON object of one worker count.
+ * -------------------------------------------------------------------------------
+ */
+static void writePoint(FILE *out, int workers, long trials, double seconds, double efficiency, const struct campaign_profile *p){
+	int s, first = 1;
+
+	fprintf(out, "        { \"workers\": %d, \"trials\": %ld, \"decompressions\": %ld, \"seconds\": %f, \"trials_per_second\": %f, \"efficiency\": %f,\n",
+		workers, trials, p->decompressions, seconds, seconds > 0 ? trials / seconds : 0, efficiency);
+	fprintf(out, "          \"breakdown_seconds\": { \"flip\": %f, \"decompress\": %f, \"metrics\": %f, \"process\": %f, \"output\": %f },\n",
+		p->flip_ns / 1e9, p->decompress_ns / 1e9, p->metrics_ns / 1e9, p->process_ns / 1e9, p->output_ns / 1e9);
+	fprintf(out, "          \"outcomes\": {");
+	for (s = 0; campaignStatusName(s) != NULL && s < CAMPAIGN_PROFILE_OUTCOMES; s++){
+		if (p->outcome_count[s] == 0){
+			continue;
+		}
+		fprintf(out, "%s \"%s\": { \"count\": %ld, \"mean_latency\": %e, \"max_latency\": %e }", first ? "" : ",", campaignStatusName(s),
+			p->outcome_count[s], p->outcome_ns[s] / 1e9 / p->outcome_count[s], p->outcome_max_ns[s] / 1e9);
+		first = 0;
+	}
+	fprintf(out, " } }");
+}
+
+int main(int argc, char *argv[]){
+	const char *out_path = "bench.json", *field_list = NULL, *compressor_list = NULL, *worker_list = NULL;
+	int workers[SCALING_MAX_POINTS], num_workers = 0;
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	uint64_t seed = 1;
+	int bytes = 16, timeout_limit = 10;
+	int option_index, w;
+	size_t f, s;
+
+	setvbuf(stdout, NULL, _IOLBF, 0);
+	crashInit();
+	while ((option_index = getopt(argc, argv, "o:f:c:w:n:s:l:")) != -1){
+		switch (option_index){
+			case 'o':
+				out_path = optarg;
+				break;
+			case 'f':
+				field_list = optarg;
+				break;
+			case 'c':
+				compressor_list = optarg;
+				break;
+			case 'w':
+				worker_list = optarg;
+				break;
+			case 'n':
+				bytes = atoi(optarg);
+				break;
+			case 's':
+				seed = strtoull(optarg, NULL, 10);
+				break;
+			case 'l':
+				timeout_limit = atoi(optarg);
+				break;
+			default:
+				printf("Usage: comp_bench [-o bench.json] [-f small,medium,large] [-c sz,zfp] [-w workers] [-n bytes] [-s seed] [-l timeout]\n");
+				return 1;
+		}
+	}
+	if (bytes < 1 || timeout_limit < 1){
+		printf("ERROR: Bytes and timeout must be positive\n");
+		return 1;
+	}
+	if (worker_list != NULL){
+		num_workers = parseThreadList(worker_list, workers, SCALING_MAX_POINTS);
+	} else {
+		for (w = 1; w < cpus && num_workers < SCALING_MAX_POINTS - 1; w *= 2){
+			workers[num_workers++] = w;
+		}
+		workers[num_workers++] = cpus > 1 ? (int)cpus : 1;
+	}
+
+	FILE *out = fopen(out_path, "w");
+	FILE *rows = fopen("/dev/null", "w");
+	if (out == NULL || rows == NULL){
+		perror("ERROR: ");
+		return 1;
+	}
+	struct campaign_profile *profile = mmap(NULL, sizeof(struct campaign_profile), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (profile == MAP_FAILED){
+		perror("ERROR: ");
+		return 1;
+	}
+	char host[256] = "unknown";
+	gethostname(host, sizeof(host) - 1);
+	fprintf(out, "{\n  \"host\": \"%s\",\n  \"cpus\": %ld,\n  \"compiler\": \"%s\",\n  \"libpressio\": \"%s\",\n", host, cpus, __VERSION__, pressio_version());
+	fprintf(out, "  \"seed\": %llu,\n  \"bytes\": %d,\n  \"timeout\": %d,\n  \"runs\": [", (unsigned long long)seed, bytes, timeout_limit);
+
+	int first_run = 1;
+	for (f = 0; f < BENCH_MAX_FIELDS; f++){
+		if (!parseNames(field_list, FIELDS[f].name)){
+			continue;
+		}
+		struct timeval start, stop;
+		gettimeofday(&start, NULL);
+		struct buffer_arena *arena = arenaCreate(FIELDS[f].dims, 3);
+		generateField(arena, seed);
+		gettimeofday(&stop, NULL);
+		double load_time = elapsedSeconds(&start, &stop);
+
+		for (s = 0; s < NUM_SETTINGS; s++){
+			const struct bench_setting *setting = &SETTINGS[s];
+			if (!parseNames(compressor_list, setting->compressor)){
+				continue;
+			}
+			struct injector *inj = injectorCreate(setting->compressor, setting->mode, setting->bound, arena);
+			crashRefreshModules();
+			injectorCompress(inj);
+
+			// The same seeded bytes for every worker count
+			struct campaign_options opts = {0};
+			size_t size = inj->compressed_size;
+			opts.compressor = setting->compressor;
+			opts.error_bounding_mode = setting->mode;
+			opts.error_bound = setting->bound;
+			opts.default_bound = -1;
+			opts.start_byte = size > (size_t)bytes ? (int)(mix(seed ^ size) % (size - bytes)) : 0;
+			opts.end_byte = (size_t)(opts.start_byte + bytes) < size ? opts.start_byte + bytes - 1 : (int)size - 1;
+			opts.timeout_limit = timeout_limit;
+			opts.results_file = rows;
+			opts.telemetry_interval = 1;
+			opts.profile = profile;
+
+			fprintf(out, "%s\n    { \"field\": \"%s\", \"dims\": [%zu, %zu, %zu], \"compressor\": \"%s\", \"mode\": \"%s\", \"bound\": %e,\n",
+				first_run ? "" : ",", FIELDS[f].name, FIELDS[f].dims[0], FIELDS[f].dims[1], FIELDS[f].dims[2], setting->compressor, setting->mode, setting->bound);
+			fprintf(out, "      \"compression_ratio\": %f, \"compressed_bytes\": %zu, \"start_byte\": %d, \"load_seconds\": %f, \"compress_seconds\": %f,\n      \"points\": [\n",
+				inj->compression_ratio, size, opts.start_byte, load_time, inj->compress_time);
+			first_run = 0;
+
+			double base_rate = 0;
+			for (w = 0; w < num_workers; w++){
+				memset(profile, 0, sizeof(struct campaign_profile));
+				opts.workers = workers[w];
+				gettimeofday(&start, NULL);
+				runCampaign(inj, &opts);
+				gettimeofday(&stop, NULL);
+
+				double seconds = elapsedSeconds(&start, &stop);
+				long trials = 8L * (opts.end_byte - opts.start_byte + 1);
+				double rate = seconds > 0 ? trials / seconds : 0;
+				if (w == 0){
+					base_rate = rate / workers[0];
+				}
+				double efficiency = base_rate > 0 ? rate / (base_rate * workers[w]) : 0;
+				printf("Bench %s %s %s %g Workers %d: %.1f trials/s, efficiency %.2f\n", FIELDS[f].name, setting->compressor, setting->mode, setting->bound, workers[w], rate, efficiency);
+				writePoint(out, workers[w], trials, seconds, efficiency, profile);
+				fprintf(out, "%s\n", w + 1 < num_workers ? "," : "");
+			}
+			fprintf(out, "      ] }");
+			fflush(out);
+			injectorFree(inj);
+		}
+		arenaFree(arena);
+	}
+	fprintf(out, "\n  ]\n}\n");
+	fclose(out);
+	fclose(rows);
+	munmap(profile, sizeof(struct campaign_profile));
+	printf("Bench Report: %s\n", out_path);
+	return 0;
+}
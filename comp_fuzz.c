@@ -0,0 +1,257 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "libpressio.h"
+
+#include "arena.h"
+#include "injector.h"
+
+/*
+ * Coverage-guided fuzzing of the SZ/ZFP decompressors (libFuzzer).
+ * -------------------------------------------------------------------------------
+ * The field is compressed once with the same compressor setup as comp_inj;
+ * every fuzz input is then decompressed as if it were that compressed stream.
+ * The custom mutator perturbs streams the way faults do (bit flips) and the
+ * way they break decoders (byte splices, edits to header length fields,
+ * truncation), so the fuzzer is not limited to one flip per trial.
+ *
+ * Configured through the environment, since libFuzzer owns the command line:
+ *
+ *   COMP_FUZZ_INPUT       binary float field (e.g. data/Hurricane/...)
+ *   COMP_FUZZ_DIMS        dimensions, "500 500 100"
+ *   COMP_FUZZ_COMPRESSOR  sz or zfp
+ *   COMP_FUZZ_MODE        error bounding mode, as comp_inj -m
+ *   COMP_FUZZ_BOUND       error bound, as comp_inj -e
+ *   COMP_FUZZ_SEED_DIR    optional corpus directory to write the clean
+ *                         compressed stream into as a seed
+ *
+ * Typical use, crashes and hangs are kept as crash-* and timeout-* files:
+ *
+ *   COMP_FUZZ_SEED_DIR=corpus ... ./comp_fuzz corpus -fork=16 -ignore_crashes=1 -ignore_timeouts=1 -timeout=10
+ *   ./comp_fuzz -minimize_crash=1 -runs=10000 crash-<hash>
+ *
+ * Decoder edges are only seen when SZ/ZFP themselves are built with
+ * -fsanitize=fuzzer-no-link; otherwise the fuzzer is guided by libpressio
+ * alone. Decompressors that exit() on bad streams end the input like a crash,
+ * which -fork mode records and moves past.
+ * -------------------------------------------------------------------------------
+ */
+
+// Bytes at the start of a stream treated as header when editing length fields
+#define FUZZ_HEADER_BYTES 64
+// Largest splice or truncation/extension step
+#define FUZZ_MAX_SPLICE 32
+
+size_t LLVMFuzzerMutate(uint8_t *data, size_t size, size_t max_size);
+
+static struct buffer_arena *ARENA;
+static struct injector *INJ;
+// The clean compressed stream, spliced into mutated inputs
+static const uint8_t *SEED;
+static size_t SEED_SIZE;
+
+/*
+ * Function: requireEnv
+ * -------------------------------------------------------------------------------
+ * returns: the value of a required environment variable, exits when unset
+ * -------------------------------------------------------------------------------
+ */
+static const char *requireEnv(const char *name){
+	const char *value = getenv(name);
+	if (value == NULL || value[0] == '\0'){
+		printf("ERROR: %s must be set\n", name);
+		exit(-1);
+	}
+	return value;
+}
+
+/*
+ * Function: LLVMFuzzerInitialize
+ * -------------------------------------------------------------------------------
+ * Loads and compresses the field once, and writes the clean stream as a seed.
+ * -------------------------------------------------------------------------------
+ */
+int LLVMFuzzerInitialize(int *argc, char ***argv){
+	size_t dims[METRICS_MAX_DIMS];
+	int num_dims = 0;
+	(void)argc;
+	(void)argv;
+
+	const char *data_path = requireEnv("COMP_FUZZ_INPUT");
+	const char *compressor = requireEnv("COMP_FUZZ_COMPRESSOR");
+	const char *error_bounding_mode = requireEnv("COMP_FUZZ_MODE");
+	float error_bound = atof(requireEnv("COMP_FUZZ_BOUND"));
+
+	char data_dimensions[256];
+	snprintf(data_dimensions, sizeof(data_dimensions), "%s", requireEnv("COMP_FUZZ_DIMS"));
+	char *pt = strtok(data_dimensions, " ");
+	while (pt != NULL && num_dims < METRICS_MAX_DIMS){
+		dims[num_dims++] = (size_t)atoi(pt);
+		pt = strtok(NULL, " ");
+	}
+
+	ARENA = arenaCreate(dims, num_dims);
+	arenaLoad(ARENA, data_path);
+	INJ = injectorCreate(compressor, error_bounding_mode, error_bound, ARENA);
+	injectorCompress(INJ);
+	SEED = injectorStream(INJ, &SEED_SIZE);
+	printf("Compressed Data Size: %zu\n", SEED_SIZE);
+
+	const char *seed_dir = getenv("COMP_FUZZ_SEED_DIR");
+	if (seed_dir != NULL){
+		char seed_path[4096];
+		snprintf(seed_path, sizeof(seed_path), "%s/seed_%s_%s_%g", seed_dir, compressor, error_bounding_mode, error_bound);
+		FILE *fp = fopen(seed_path, "wb");
+		if (fp == NULL){
+			perror("ERROR: ");
+			exit(-1);
+		}
+		fwrite(SEED, 1, SEED_SIZE, fp);
+		fclose(fp);
+	}
+	return 0;
+}
+
+/*
+ * Function: LLVMFuzzerTestOneInput
+ * -------------------------------------------------------------------------------
+ * Decompresses one input into the arena output. Decompression errors are
+ * expected results, only crashes, hangs and sanitizer reports are findings.
+ * -------------------------------------------------------------------------------
+ */
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size){
+	if (size == 0){
+		return 0;
+	}
+	struct pressio_data *stream = INJ->lib->data_new_nonowning(pressio_byte_dtype, (void *)data, 1, &size);
+	arenaResetOutput(ARENA);
+	INJ->lib->compressor_decompress(INJ->compressor, stream, ARENA->output_view);
+	INJ->lib->data_free(stream);
+	return 0;
+}
+
+/*
+ * Function: nextRandom
+ * -------------------------------------------------------------------------------
+ * xorshift64, seeded by libFuzzer so mutations replay.
+ * -------------------------------------------------------------------------------
+ */
+static uint64_t nextRandom(uint64_t *state){
+	*state ^= *state << 13;
+	*state ^= *state >> 7;
+	*state ^= *state << 17;
+	return *state;
+}
+
+/*
+ * Function: editLengthField
+ * -------------------------------------------------------------------------------
+ * Treats 2, 4 or 8 bytes of the header as an integer of either byte order
+ * and nudges it, doubles it, halves it or sets it to 0 or the stream size.
+ * -------------------------------------------------------------------------------
+ */
+static void editLengthField(uint8_t *data, size_t size, uint64_t *rng){
+	size_t width = (size_t)2 << (nextRandom(rng) % 3);
+	size_t header = size < FUZZ_HEADER_BYTES ? size : FUZZ_HEADER_BYTES;
+	int big_endian = nextRandom(rng) & 1;
+	uint64_t value = 0;
+	size_t i;
+
+	if (header < width){
+		return;
+	}
+	size_t offset = nextRandom(rng) % (header - width + 1);
+	for (i = 0; i < width; i++){
+		size_t b = big_endian ? i : width - 1 - i;
+		value = (value << 8) | data[offset + b];
+	}
+
+	switch (nextRandom(rng) % 6){
+		case 0: value += 1 + nextRandom(rng) % 16; break;
+		case 1: value -= 1 + nextRandom(rng) % 16; break;
+		case 2: value <<= 1; break;
+		case 3: value >>= 1; break;
+		case 4: value = 0; break;
+		default: value = size; break;
+	}
+
+	for (i = 0; i < width; i++){
+		size_t b = big_endian ? width - 1 - i : i;
+		data[offset + b] = (uint8_t)(value >> (8 * i));
+	}
+}
+
+/*
+ * Function: LLVMFuzzerCustomMutator
+ * -------------------------------------------------------------------------------
+ * Mutates a compressed stream in place.
+ *
+ * returns: the new size of the stream
+ * -------------------------------------------------------------------------------
+ */
+size_t LLVMFuzzerCustomMutator(uint8_t *data, size_t size, size_t max_size, unsigned int seed){
+	uint64_t rng = seed ? seed : 0x9E3779B97F4A7C15ull;
+	size_t i;
+
+	if (size == 0){
+		return LLVMFuzzerMutate(data, size, max_size);
+	}
+
+	switch (nextRandom(&rng) % 8){
+		case 0:
+		case 1:
+		case 2: {
+			// The campaign fault model: one bit anywhere
+			size_t pos = nextRandom(&rng) % size;
+			data[pos] ^= (uint8_t)(1 << (nextRandom(&rng) % 8));
+			break;
+		}
+		case 3: {
+			// A burst of adjacent bits
+			size_t bits = 2 + nextRandom(&rng) % 7;
+			size_t first = nextRandom(&rng) % (size * 8);
+			for (i = first; i < first + bits && i < size * 8; i++){
+				data[i / 8] ^= (uint8_t)(1 << (i % 8));
+			}
+			break;
+		}
+		case 4: {
+			// Splice bytes from elsewhere in this stream or the clean one
+			const uint8_t *src = (nextRandom(&rng) & 1) && SEED_SIZE ? SEED : data;
+			size_t src_size = src == SEED ? SEED_SIZE : size;
+			size_t len = 1 + nextRandom(&rng) % FUZZ_MAX_SPLICE;
+			if (len > size){
+				len = size;
+			}
+			if (len > src_size){
+				len = src_size;
+			}
+			size_t from = nextRandom(&rng) % (src_size - len + 1);
+			size_t to = nextRandom(&rng) % (size - len + 1);
+			memmove(data + to, src + from, len);
+			break;
+		}
+		case 5:
+			editLengthField(data, size, &rng);
+			break;
+		case 6: {
+			// Truncate or extend the stream, extending with the clean tail
+			size_t step = 1 + nextRandom(&rng) % FUZZ_MAX_SPLICE;
+			if ((nextRandom(&rng) & 1) && size > step){
+				return size - step;
+			}
+			if (size + step > max_size){
+				step = max_size - size;
+			}
+			for (i = 0; i < step; i++){
+				data[size + i] = size + i < SEED_SIZE ? SEED[size + i] : 0;
+			}
+			return size + step;
+		}
+		default:
+			return LLVMFuzzerMutate(data, size, max_size);
+	}
+	return size;
+}
@@ -1,15 +1,25 @@
 #include <stdio.h>
 #include <stdlib.h> 
 #include <string.h>
-#include <signal.h>
-#include <math.h>
-#include <float.h>
 #include <sys/time.h>
-#include <execinfo.h>
 #include <getopt.h>
 
 #include "libpressio.h"
-#include "sz.h"
+
+#include "arena.h"
+#include "library.h"
+#include "container.h"
+#include "injector.h"
+#include "campaign.h"
+#include "montecarlo.h"
+#include "batch.h"
+#include "scaling.h"
+#include "experiment.h"
+#include "energy.h"
+#include "crash.h"
+#include "trace.h"
+#include "metrics.h"
+#include "sketch.h"
 
 /*
  * GLOBAL VARIABLES
@@ -18,61 +28,14 @@
 int DEBUG = 0;
 // Inject into the compression (1 for True, 0 for False)
 int INJECT = 1;
-
-// Initial Data Pointer
-float *DATA;
-// Faulted Decompressed Data Pointer
-float *RET_DATA;
-
-/*
- * Function: sigHandler
- * -------------------------------------------------------------------------------
- * Handles segmantation faults due to decompression errors.
- *
- * sig: the signal value of the error.
- * -------------------------------------------------------------------------------
- */
-void sigHandler(int sig) {
-	printf("Receiving Sig %d: ", sig);
-	void *buffer[512];
-	char **strings;
-	int j, nptrs;
-
-	nptrs = backtrace(buffer, 512);
-
-	strings = backtrace_symbols(buffer, nptrs);
-	if (strings == NULL){
-		printf("Error with backtrace_symbols\n");
-		exit(-1);
-	}
-
-	for (j = 0; j < nptrs; j++){
-		printf("%s <- ", strings[j]);
-	}
-	printf("\n");
-	free(strings);
-
-	if (DATA){
-		free(DATA);
-	}
-	if (RET_DATA){
-		free(RET_DATA);
-	}
-	exit(sig);
-}
-
-/*
- * Function: startsWith
- * -------------------------------------------------------------------------------
- * Checks if one string starts with a substring
- *
- * returns: True or False
- * -------------------------------------------------------------------------------
- */
-int startsWith(const char *a, const char *b) {
-   if(strncmp(a, b, strlen(b)) == 0) return 1;
-   return 0;
-}
+// Measure error propagation against the fault-free output (1 for True, 0 for False)
+int PROPAGATION = 0;
+// Sketch the error distribution while computing metrics (1 for True, 0 for False)
+int SKETCH = 0;
+// Measure compression and decompression energy with RAPL (1 for True, 0 for False)
+int ENERGY = 0;
+// Only classify the effect of trials, computing no metrics (1 for True, 0 for False)
+int CLASSIFY = 0;
 
 /*
  * Function: printBits
@@ -97,263 +60,6 @@ void printBits(size_t const size, void const * const ptr){
 }
 
 
-/*
- * Function: szCompressionInjection
- * -------------------------------------------------------------------------------
- * Compresses the given data, injects a fault based on given
- * parameters, and returns the new decompressed data.
- *
- * compressor_choice: Compressor to use (sz, zfp)
- * error_bounding_mode: Error bound to use with compressor (sz=ABS,PSNR,PW_REL, zfp=Accuracy,Rate,Precision)
- * data_dimensions: Array of the 5 dimensions of the data.
- * char_loc: The byte position in the commpressed data 
- * to inject into.
- * flip_loc: The bit of the chosen byte to flip.
- * -------------------------------------------------------------------------------
- */
-void szCompressionInjection(char * compressor_choice, char * error_bounding_mode, float error_bound, size_t * dims, int num_dims, int char_loc, int flip_loc, int injection_active){	
-
-	// Initialize Pressio
-	if (DEBUG){
-		printf("Initializing Pressio\n");
-	}
-
-	if (strcmp(compressor_choice, "sz") == 0){
-		// Configure SZ compressor
-		if (DEBUG){
-			printf("Configuring SZ Compressor\n");
-		}
-		// Initialize Pressio with SZ
-		struct pressio* library = pressio_instance();
-    	struct pressio_compressor* compressor = pressio_get_compressor(library, "sz");
-		// Set compression metric to print
-		const char* metrics[] = { "size" };
-    	struct pressio_metrics* metrics_plugin = pressio_new_metrics(library, metrics, 1);
-    	pressio_compressor_set_metrics(compressor, metrics_plugin);
-		// Set values for SZ compression operations
-		struct pressio_options* sz_options = pressio_compressor_get_options(compressor);
-		if (strcmp(error_bounding_mode, "ABS") == 0){
-			pressio_options_set_integer(sz_options, "sz:error_bound_mode", ABS);
-			pressio_options_set_double(sz_options, "sz:abs_err_bound", error_bound);
-		} else if (strcmp(error_bounding_mode, "PW_REL") == 0){
-			pressio_options_set_integer(sz_options, "sz:error_bound_mode", PW_REL);
-			pressio_options_set_double(sz_options, "sz:pw_rel_err_bound", error_bound);
-		} else if (strcmp(error_bounding_mode, "PSNR") == 0){
-			pressio_options_set_integer(sz_options, "sz:error_bound_mode", PSNR);
-			pressio_options_set_double(sz_options, "sz:psnr_err_bound", error_bound);
-		} else {
-			printf("Invalid Error Bounding Mode...\n");
-			printf("Exiting\n");
-			exit(1);
-		}
-		// Check compression operation configurations
-		if (pressio_compressor_check_options(compressor, sz_options)) {
-			printf("%s\n", pressio_compressor_error_msg(compressor));
-			exit(pressio_compressor_error_code(compressor));
-		}
-		if (pressio_compressor_set_options(compressor, sz_options)) {
-			printf("%s\n", pressio_compressor_error_msg(compressor));
-			exit(pressio_compressor_error_code(compressor));
-		}
-
-		// Convert input data to a pressio_data object
-		struct pressio_data* input_data = pressio_data_new_move(pressio_float_dtype, DATA, num_dims, dims, pressio_data_libc_free_fn, NULL);
-		// creates an output dataset pointer
-		struct pressio_data* compressed_data = pressio_data_new_empty(pressio_byte_dtype, 0, NULL);
-		// configure the decompressed output area
-		struct pressio_data* decompressed_data = pressio_data_new_empty(pressio_float_dtype, num_dims, dims);
-
-		// Compress data
-		struct timeval c_start, c_stop;
-		gettimeofday(&c_start, NULL);
-		if (DEBUG){
-			printf("Compressing Data\n");
-		}
-		if (pressio_compressor_compress(compressor, input_data, compressed_data)) {
-			printf("%s\n", pressio_compressor_error_msg(compressor));
-			exit(pressio_compressor_error_code(compressor));
-		}
-		gettimeofday(&c_stop, NULL);
-
-		// Get pointer to compressed data as well as the number of bytes
-		size_t compressed_size;
-		uint8_t * data = (uint8_t *)pressio_data_ptr(compressed_data, &compressed_size);
-
-		// Generate flip mask based on flip_loc
-		uint8_t mask = 0;
-		uint8_t one = 1;
-		mask = mask | (one << flip_loc);
-
-		// XOR with area of byte array and save back to the array
-		if (INJECT && injection_active){
-			data[char_loc] = data[char_loc] ^ mask;
-		}
-
-		// Decompress data
-		struct timeval d_start, d_stop;
-		gettimeofday(&d_start, NULL);
-		if (DEBUG){
-			printf("Decompressing Data\n");
-		}
-		if (pressio_compressor_decompress(compressor, compressed_data, decompressed_data)) {
-			printf("%s\n", pressio_compressor_error_msg(compressor));
-			exit(pressio_compressor_error_code(compressor));
-		}
-		gettimeofday(&d_stop, NULL);
-
-		// Store newly decompressed data in ret data
-		size_t out_bytes;
-    	RET_DATA = (float *)pressio_data_copy(decompressed_data, &out_bytes);
-
-		if (DEBUG){
-			printf("Gathering Metrics\n");
-		}
-		// Get compression ratio and print
-		struct pressio_options* metric_results = pressio_compressor_get_metrics_results(compressor);
-		double compression_ratio = 0;
-		if (pressio_options_get_double(metric_results, "size:compression_ratio", &compression_ratio)) {
-			printf("Failed to get compression ratio\n");
-		}
-		printf("Compression Ratio: %lf\n", compression_ratio);
-		printf("Compressed Data Size: %zu\n", compressed_size);
-
-		// Calculate time taken to decompress and print
-		double time_taken_compress = (double)(c_stop.tv_usec - c_start.tv_usec) / 1000000 + (double)(c_stop.tv_sec - c_start.tv_sec);
-		double time_taken_decompress = (double)(d_stop.tv_usec - d_start.tv_usec) / 1000000 + (double)(d_stop.tv_sec - d_start.tv_sec);
-		printf("Time to Compress: %lf\n", time_taken_compress);
-		printf("Time to Decompress: %lf\n", time_taken_decompress);
-
-		// Free un-nessecary structs
-		pressio_data_free(decompressed_data);
-    	pressio_data_free(compressed_data);
-    	pressio_options_free(sz_options);
-    	pressio_options_free(metric_results);
-    	pressio_compressor_release(compressor);
-    	pressio_release(library);
-
-	} else if (strcmp(compressor_choice, "zfp") == 0){
-		// Configure ZFP compressor
-		if (DEBUG){
-			printf("Configuring ZFP Compressor\n");
-		}
-		// Initialize Pressio with ZFP
-		struct pressio* library = pressio_instance();
-    	struct pressio_compressor* compressor = pressio_get_compressor(library, "zfp");
-		// Set compression metric to print
-		const char* metrics[] = { "size" };
-    	struct pressio_metrics* metrics_plugin = pressio_new_metrics(library, metrics, 1);
-    	pressio_compressor_set_metrics(compressor, metrics_plugin);
-		// Set values for SZ compression operations
-		struct pressio_options* zfp_options = pressio_compressor_get_options(compressor);
-		if (strcmp(error_bounding_mode, "Accuracy") == 0){
-			pressio_options_set_double(zfp_options, "zfp:accuracy", error_bound);
-		} else if (strcmp(error_bounding_mode, "Rate") == 0){
-			pressio_options_set_uinteger(zfp_options, "zfp:type", (unsigned int)3);
-			pressio_options_set_uinteger(zfp_options, "zfp:dims", (unsigned int)num_dims);
-			pressio_options_set_integer(zfp_options, "zfp:wra", 1);
-			pressio_options_set_double(zfp_options, "zfp:rate", (double)error_bound);
-		} else if (strcmp(error_bounding_mode, "Precision") == 0){
-			pressio_options_set_uinteger(zfp_options, "zfp:precision", error_bound);
-		} else {
-			printf("Invalid Error Bounding Mode...\n");
-			printf("Exiting\n");
-			exit(1);
-		}
-		// Check compression operation configurations
-		if (pressio_compressor_check_options(compressor, zfp_options)) {
-			printf("%s\n", pressio_compressor_error_msg(compressor));
-			exit(pressio_compressor_error_code(compressor));
-		}
-		if (pressio_compressor_set_options(compressor, zfp_options)) {
-			printf("%s\n", pressio_compressor_error_msg(compressor));
-			exit(pressio_compressor_error_code(compressor));
-		}
-
-		// Convert input data to a pressio_data object
-		struct pressio_data* input_data = pressio_data_new_move(pressio_float_dtype, DATA, num_dims, dims, pressio_data_libc_free_fn, NULL);
-		// creates an output dataset pointer
-		struct pressio_data* compressed_data = pressio_data_new_empty(pressio_byte_dtype, 0, NULL);
-		// configure the decompressed output area
-		struct pressio_data* decompressed_data = pressio_data_new_empty(pressio_float_dtype, num_dims, dims);
-
-		// Compress data
-		struct timeval c_start, c_stop;
-		gettimeofday(&c_start, NULL);
-		if (DEBUG){
-			printf("Compressing Data\n");
-		}
-		if (pressio_compressor_compress(compressor, input_data, compressed_data)) {
-			printf("%s\n", pressio_compressor_error_msg(compressor));
-			exit(pressio_compressor_error_code(compressor));
-		}
-		gettimeofday(&c_stop, NULL);
-
-		// Get pointer to compressed data as well as the number of bytes
-		size_t compressed_size;
-		uint8_t * data = (uint8_t *)pressio_data_ptr(compressed_data, &compressed_size);
-
-		// Generate flip mask based on flip_loc
-		uint8_t mask = 0;
-		uint8_t one = 1;
-		mask = mask | (one << flip_loc);
-
-		// XOR with area of byte array and save back to the array
-		if (INJECT && injection_active){
-			data[char_loc] = data[char_loc] ^ mask;
-		}
-
-		// Decompress data
-		struct timeval d_start, d_stop;
-		gettimeofday(&d_start, NULL);
-		if (DEBUG){
-			printf("Decompressing Data\n");
-		}
-		if (pressio_compressor_decompress(compressor, compressed_data, decompressed_data)) {
-			printf("%s\n", pressio_compressor_error_msg(compressor));
-			exit(pressio_compressor_error_code(compressor));
-		}
-		gettimeofday(&d_stop, NULL);
-
-		// Store newly decompressed data in ret data
-		size_t out_bytes;
-    	RET_DATA = (float *)pressio_data_copy(decompressed_data, &out_bytes);
-
-		if (DEBUG){
-			printf("Gathering Metrics\n");
-		}
-		// Get compression ratio and print
-		struct pressio_options* metric_results = pressio_compressor_get_metrics_results(compressor);
-		double compression_ratio = 0;
-		if (pressio_options_get_double(metric_results, "size:compression_ratio", &compression_ratio)) {
-			printf("Failed to get compression ratio\n");
-		}
-		printf("Compression Ratio: %lf\n", compression_ratio);
-		printf("Compressed Data Size: %zu\n", compressed_size);
-
-		// Calculate time taken to decompress and print
-		double time_taken_compress = (double)(c_stop.tv_usec - c_start.tv_usec) / 1000000 + (double)(c_stop.tv_sec - c_start.tv_sec);
-		double time_taken_decompress = (double)(d_stop.tv_usec - d_start.tv_usec) / 1000000 + (double)(d_stop.tv_sec - d_start.tv_sec);
-		printf("Time to Compress: %lf\n", time_taken_compress);
-		printf("Time to Decompress: %lf\n", time_taken_decompress);
-
-		// Free un-nessecary structs
-		pressio_data_free(decompressed_data);
-    	pressio_data_free(compressed_data);
-    	pressio_options_free(zfp_options);
-    	pressio_options_free(metric_results);
-    	pressio_compressor_release(compressor);
-    	pressio_release(library);
-	} else {
-		printf("Invalid Compressor...\n");
-		printf("Exiting\n");
-		exit(1);
-	}
-	
-	if (DEBUG) {
-		printf("Successfully decompressed data\n");
-	}
-}
-
 /* 
  * Function: main
  * -------------------------------------------------------------------------------
@@ -365,33 +71,66 @@ void szCompressionInjection(char * compressor_choice, char * error_bounding_mode
  */
 int main(int argc, char *argv[]){
 	int i;
+	// Crash lines are written around stdio, so never hold back a finished line
+	setvbuf(stdout, NULL, _IOLBF, 0);
 	//Catches segmentation faults and other signals
-	if (signal (SIGSEGV, sigHandler) == SIG_ERR){
-        	printf("Error setting segfault handler...\n");
-	}
+	crashInit();
 
 	printf("Starting Experiment\n");
 
 	// PARSE USER INPUT
 	// *******************
 	// Data Characteristics
-	char *data_path;
-    char * data_dimensions;
-    size_t * dims;
-    int data_size = 1;
+	char *data_path = NULL;
+	// Corrupted output written back as an HDF5 dataset (see container.h)
+	char *output_path = NULL;
+    char * data_dimensions = NULL;
 	// Compressor Characteristics
-	char * compressor;
-	char * error_bounding_mode;
-	float error_bound;
-	float default_bound;
+	char * compressor = NULL;
+	char * error_bounding_mode = NULL;
+	float error_bound = 0;
+	float default_bound = -1;
 	// Fault Injection Characteristics
 	int char_loc = 0;
 	int flip_loc = 0;
 	int injection_active = 0;
+	// Propagation Characteristics (0 picks the compressor's block size)
+	int block_edge = 0;
+	// Quality Metric Characteristics (mask of QUALITY_* flags)
+	int quality_selected = 0;
+	// Campaign Characteristics (byte range start:end, results CSV, seconds per trial, workers)
+	char * campaign_range = NULL;
+	char * results_path = NULL;
+	int timeout_limit = 30;
+	int workers = 1;
+	// Trial Memory Cap (MB a trial's decompression may allocate, 0 for none)
+	int trial_memory_mb = 0;
+	// Group Testing (bits flipped together, optionally ":bound" to also clear groups within the bound)
+	char * group_testing = NULL;
+	// Campaign Telemetry (Prometheus text file, seconds between rewrites)
+	char * telemetry_path = NULL;
+	int telemetry_interval = 10;
+	// Batch Characteristics (manifest or directory of fields, -w is then a directory)
+	char * batch_source = NULL;
+	// Compressor Threads (threads per compression, thread counts of a scaling sweep)
+	int compressor_threads = 1;
+	char * scaling_threads = NULL;
+	// Experiment Manifest (JSON study grid, replaces every other option)
+	char * experiment_path = NULL;
+	// Timeline Trace (Chrome trace JSON, optionally ":N" to record 1 in N trials)
+	char * trace_spec = NULL;
+	// A/B Build (colon separated shared libraries of a second libpressio build, see library.h)
+	char * variant_libraries = NULL;
+	// Stream Protection (CRC32C chunk bytes, optionally ":N" for SECDED over the first N bytes, see protect.h)
+	char * protect_spec = NULL;
+	size_t protect_chunk = 0, protect_header = 0;
+	// Monte Carlo Upsets (bit error rates, optionally ":half_width:max_trials:seed", see montecarlo.h)
+	char * upset_spec = NULL;
+	struct montecarlo_options montecarlo;
 
 	// Parse input with getopt
 	int option_index = 0;
-    while (( option_index = getopt(argc, argv, "i:d:c:m:e:x:b:f:a:")) != -1){
+    while (( option_index = getopt(argc, argv, "i:d:c:m:e:x:b:f:a:p:k:q:M:r:w:l:j:t:T:B:n:S:E:P:L:G:o:R:C:A:H:U:")) != -1){
         switch (option_index) {
             case 'i':
                 data_path = optarg;
@@ -424,312 +163,410 @@ int main(int argc, char *argv[]){
 			case 'a':
 				injection_active = atoi(optarg);
 				break;
+			case 'p':
+				PROPAGATION = atoi(optarg);
+				break;
+			case 'k':
+				block_edge = atoi(optarg);
+				break;
+			case 'q':
+				SKETCH = atoi(optarg);
+				break;
+			case 'C':
+				CLASSIFY = atoi(optarg);
+				break;
+			case 'M':
+				quality_selected = parseQualityMetrics(optarg);
+				break;
+			case 'r':
+				campaign_range = optarg;
+				break;
+			case 'w':
+				results_path = optarg;
+				break;
+			case 'l':
+				timeout_limit = atoi(optarg);
+				break;
+			case 'j':
+				workers = atoi(optarg);
+				break;
+			case 't':
+				telemetry_path = optarg;
+				break;
+			case 'T':
+				telemetry_interval = atoi(optarg);
+				break;
+			case 'B':
+				batch_source = optarg;
+				break;
+			case 'n':
+				compressor_threads = atoi(optarg);
+				break;
+			case 'S':
+				scaling_threads = optarg;
+				break;
+			case 'E':
+				experiment_path = optarg;
+				break;
+			case 'P':
+				ENERGY = atoi(optarg);
+				break;
+			case 'L':
+				trial_memory_mb = atoi(optarg);
+				break;
+			case 'G':
+				group_testing = optarg;
+				break;
+			case 'R':
+				trace_spec = optarg;
+				break;
+			case 'A':
+				variant_libraries = optarg;
+				break;
+			case 'H':
+				protect_spec = optarg;
+				break;
+			case 'U':
+				upset_spec = optarg;
+				break;
+			case 'o':
+				output_path = optarg;
+				break;
             default:
                 printf("Options incorrect\n");
                 return 1;
         }
     } 
+	if (trace_spec != NULL){
+		int sample_every = 1;
+		char *colon = strrchr(trace_spec, ':');
+		if (colon != NULL){
+			*colon = '\0';
+			sample_every = atoi(colon + 1);
+			if (sample_every < 1){
+				printf("ERROR: Trace sampling must be path:N with N at least 1\n");
+				exit(-1);
+			}
+		}
+		traceInit(trace_spec, sample_every, campaignStatusName);
+	}
+	if (experiment_path != NULL){
+		runExperiment(experiment_path);
+		printf("End of Experiment\n");
+		return 0;
+	}
+	if ((batch_source == NULL && data_path == NULL) || compressor == NULL || error_bounding_mode == NULL){
+		printf("Options incorrect\n");
+		return 1;
+	}
 
 	// Parse out dims from data_dimensions string
 	int data_dimensions_temp[5] = {0};
     char *pt;
     int num_dims = 0;
-	pt = strtok(data_dimensions, " ");
-    while (pt != NULL) {
+	pt = data_dimensions ? strtok(data_dimensions, " ") : NULL;
+    while (pt != NULL && num_dims < METRICS_MAX_DIMS) {
         data_dimensions_temp[num_dims] = atoi(pt);
         num_dims++;
         pt = strtok (NULL, " ");
     }
 
-    dims = malloc(sizeof(size_t) * num_dims);
+    size_t dims[METRICS_MAX_DIMS];
 	for (i = 0; i < num_dims; i++){
 		dims[i] = (size_t)data_dimensions_temp[i];
 	}
+	// HDF5 and NetCDF selections carry their own dims, generated fields
+	// have them in a sidecar
+	if (data_path != NULL && (num_dims == 0 || containerIsSpec(data_path))){
+		num_dims = arenaFieldDims(data_path, dims);
+		for (i = 0; i < METRICS_MAX_DIMS; i++){
+			data_dimensions_temp[i] = i < num_dims ? (int)dims[i] : 0;
+		}
+	}
+	if (batch_source == NULL && num_dims == 0){
+		printf("Options incorrect\n");
+		return 1;
+	}
+	if (variant_libraries != NULL && (campaign_range == NULL || batch_source != NULL || group_testing != NULL)){
+		printf("ERROR: A/B runs need a campaign range (-r) of one field, without group testing\n");
+		exit(-1);
+	}
+	if (protect_spec != NULL && (protectParse(protect_spec, &protect_chunk, &protect_header) != 0 || batch_source != NULL || variant_libraries != NULL)){
+		printf("ERROR: Stream protection must be chunk or chunk:header bytes, for one field without A/B\n");
+		exit(-1);
+	}
+	if (upset_spec != NULL){
+		if (campaign_range != NULL || batch_source != NULL || variant_libraries != NULL || group_testing != NULL){
+			printf("ERROR: Monte Carlo runs take one field, without a campaign range, A/B or group testing\n");
+			exit(-1);
+		}
+		parseMonteCarlo(upset_spec, &montecarlo);
+	}
 
-	//Determine Data Size from dimensions
-	for (i = 0; i < 5; i++){
-		if (data_dimensions_temp[i] != 0){
-			data_size = data_size * data_dimensions_temp[i];
-		}	
+	if (block_edge <= 0){
+		block_edge = strcmp(compressor, "zfp") == 0 ? 4 : 6;
+	}
+
+	// Campaign settings, shared by single fields and batches
+	struct campaign_options campaign = {0};
+	if (campaign_range != NULL || upset_spec != NULL){
+		campaign.compressor = compressor;
+		campaign.error_bounding_mode = error_bounding_mode;
+		campaign.error_bound = error_bound;
+		campaign.default_bound = default_bound;
+		campaign.end_byte = -1;
+		if (campaign_range != NULL && (sscanf(campaign_range, "%d:%d", &campaign.start_byte, &campaign.end_byte) != 2 || campaign.start_byte < 0 || campaign.end_byte < campaign.start_byte)){
+			printf("ERROR: Campaign range must be start:end\n");
+			exit(-1);
+		}
+		campaign.timeout_limit = timeout_limit;
+		campaign.memory_limit_mb = trial_memory_mb;
+		if (group_testing != NULL){
+			char criterion[16] = "";
+			if (sscanf(group_testing, "%d:%15s", &campaign.group_size, criterion) < 1 || campaign.group_size < 1
+					|| (criterion[0] && strcmp(criterion, "bound") != 0)){
+				printf("ERROR: Group testing must be size or size:bound\n");
+				exit(-1);
+			}
+			campaign.group_within_bound = strcmp(criterion, "bound") == 0;
+		}
+		campaign.results_path = results_path;
+		campaign.workers = workers;
+		campaign.compressor_threads = compressor_threads;
+		campaign.telemetry_path = telemetry_path;
+		campaign.telemetry_interval = telemetry_interval > 0 ? telemetry_interval : 1;
+		campaign.propagation = PROPAGATION;
+		campaign.block_edge = block_edge;
+		campaign.sketch = SKETCH;
+		campaign.quality_selected = quality_selected;
+		// Monte Carlo trials only classify, against the baseline
+		campaign.classify_only = CLASSIFY || upset_spec != NULL;
+	}
+
+	// OpenMP builds read this once, when the compressor first runs
+	if (compressor_threads > 1){
+		char threads_value[16];
+		snprintf(threads_value, sizeof(threads_value), "%d", compressor_threads);
+		setenv("OMP_NUM_THREADS", threads_value, 1);
+	}
+
+	// Run the campaign on every field of a manifest or directory
+	if (batch_source != NULL){
+		if (campaign_range == NULL || results_path == NULL){
+			printf("ERROR: Batch mode needs a campaign range (-r) and a results directory (-w)\n");
+			exit(-1);
+		}
+		struct batch_field *fields;
+		int num_fields = batchFields(batch_source, dims, num_dims, &fields);
+		printf("Batch Source: %s\n", batch_source);
+		printf("Compression Algorithm: %s\n", compressor);
+		printf("Error Bounding Mode: %s\n", error_bounding_mode);
+		printf("Error Bounding Value: %0.12f\n", error_bound);
+		runBatch(fields, num_fields, &campaign, results_path);
+		free(fields);
+		printf("End of Experiment\n");
+		return 0;
 	}
 
 	// COMPRESS & INJECT
 	// *******************
-	// Read data from binary file
-	FILE *fp;
-	DATA= malloc(sizeof(float) * data_size);
-	fp = fopen(data_path,"rb");
-	if (fp == NULL){
-		perror("ERROR: ");
-		exit(-1);
-	} else {
-		fread(DATA, 4,  data_size, fp);
-		fclose(fp);
+	// Read data from binary file into the arena, which owns every buffer until exit
+	struct buffer_arena *arena = arenaCreate(dims, num_dims);
+	arenaLoad(arena, data_path);
+
+	// Time the clean compressor at every thread count of the sweep
+	if (scaling_threads != NULL){
+		int threads[SCALING_MAX_POINTS];
+		int num_threads = parseThreadList(scaling_threads, threads, SCALING_MAX_POINTS);
+		printf("Data File: %s\n", data_path);
+		printf("Compression Algorithm: %s\n", compressor);
+		printf("Error Bounding Mode: %s\n", error_bounding_mode);
+		printf("Error Bounding Value: %0.12f\n", error_bound);
+		runScaling(compressor, error_bounding_mode, error_bound, arena, threads, num_threads, ENERGY, results_path);
+		arenaFree(arena);
+		printf("End of Experiment\n");
+		return 0;
 	}
 
 	// Print out all parameters
 	printf("Data File: %s\n", data_path);
 	printf("Data Dimensions: %d x %d x %d x %d x %d\n", data_dimensions_temp[0], data_dimensions_temp[1], data_dimensions_temp[2], data_dimensions_temp[3], data_dimensions_temp[4]);
-	printf("Original Data Size in Bytes: %ld\n", sizeof(float)*data_size);
+	printf("Original Data Size in Bytes: %ld\n", sizeof(float)*arena->num_elements);
 	printf("Compression Algorithm: %s\n", compressor);
 	printf("Error Bounding Mode: %s\n", error_bounding_mode);
 	printf("Error Bounding Value: %0.12f\n", error_bound);
+	printf("Compressor Threads: %d\n", compressor_threads);
+
+	if (DEBUG){
+		printf("Initializing Pressio\n");
+	}
+	struct injector *inj = injectorCreate(compressor, error_bounding_mode, error_bound, arena);
+	if (compressor_threads > 1){
+		injectorSetThreads(inj, compressor_threads);
+	}
+	// Compressor plugins may have been loaded by now
+	crashRefreshModules();
+	if (DEBUG){
+		printf("Compressing Data\n");
+	}
+	injectorCompress(inj);
+	if (protect_spec != NULL){
+		injectorProtect(inj, protect_chunk, protect_header);
+		printf("Protection: CRC32C per %zu bytes, SECDED over %zu header bytes\n", protect_chunk, inj->protection->header_bytes);
+		printf("Protection Overhead Bytes: %zu (%.4f%% of the stream)\n", inj->protection->overhead_bytes, 100.0 * inj->protection->overhead_bytes / inj->compressed_size);
+		printf("Time to Protect: %lf\n", inj->protection->protect_time);
+	}
+
+	// Decompress the fault-free stream once when measuring propagation, group testing or classifying
+	if (PROPAGATION || CLASSIFY || campaignNeedsBaseline(&campaign)){
+		if (DEBUG){
+			printf("Decompressing Baseline\n");
+		}
+		injectorBaseline(inj);
+	}
+	// The second build of an A/B campaign compresses the same input buffer
+	struct buffer_arena *variant_arena = NULL;
+	if (variant_libraries != NULL){
+		variant_arena = arenaShare(arena, libraryLoad(variant_libraries));
+		campaign.variant = injectorCreate(compressor, error_bounding_mode, error_bound, variant_arena);
+		if (compressor_threads > 1){
+			injectorSetThreads(campaign.variant, compressor_threads);
+		}
+		crashRefreshModules();
+		injectorCompress(campaign.variant);
+		if (campaignNeedsBaseline(&campaign)){
+			injectorBaseline(campaign.variant);
+		}
+		printf("Build A: %s (libpressio %s)\n", arena->lib->name, arena->lib->version());
+		printf("Build B: %s (libpressio %s)\n", variant_arena->lib->name, variant_arena->lib->version());
+		printf("Compression Ratio B: %lf\n", campaign.variant->compression_ratio);
+		printf("Compressed Data Size B: %zu\n", campaign.variant->compressed_size);
+		printf("Time to Compress B: %lf\n", campaign.variant->compress_time);
+	}
+	// Run every trial of a byte range against the one compressed stream
+	if (campaign_range != NULL){
+		printf("Compression Ratio: %lf\n", inj->compression_ratio);
+		printf("Compressed Data Size: %zu\n", inj->compressed_size);
+		printf("Time to Compress: %lf\n", inj->compress_time);
+		runCampaign(inj, &campaign);
+
+		injectorFree(campaign.variant);
+		arenaFree(variant_arena);
+		injectorFree(inj);
+		arenaFree(arena);
+		printf("End of Experiment\n");
+		return 0;
+	}
+	// Estimate the failure probability of every bit error rate
+	if (upset_spec != NULL){
+		printf("Compression Ratio: %lf\n", inj->compression_ratio);
+		printf("Compressed Data Size: %zu\n", inj->compressed_size);
+		printf("Time to Compress: %lf\n", inj->compress_time);
+		runMonteCarlo(inj, &campaign, &montecarlo);
+
+		injectorFree(inj);
+		arenaFree(arena);
+		printf("End of Experiment\n");
+		return 0;
+	}
+
 	printf("Byte Location: %d\n", char_loc);
 	printf("Flip Location: %d\n", flip_loc);
 
-	// Call compression injection function
-	szCompressionInjection(compressor, error_bounding_mode, error_bound, dims, num_dims, char_loc, flip_loc, injection_active);
+	if (DEBUG){
+		printf("Decompressing Data\n");
+	}
+	double time_taken_decompress;
+	const float *output = injectorTrial(inj, char_loc, flip_loc, INJECT && injection_active, &time_taken_decompress);
+	if (DEBUG) {
+		printf("Successfully decompressed data\n");
+	}
+
+	printf("Compression Ratio: %lf\n", inj->compression_ratio);
+	printf("Compressed Data Size: %zu\n", inj->compressed_size);
+	printf("Time to Compress: %lf\n", inj->compress_time);
+	printf("Time to Decompress: %lf\n", time_taken_decompress);
+	if (inj->protection){
+		printf("Protection Outcome: %s\n", protectStatusName(inj->check->status));
+		printf("Time to Verify: %lf\n", inj->check->verify_time);
+	}
 
 	// Print small before and after if debugging is turned on
 	if (DEBUG){	
 		printf("Original Data:\n");
 		for (i = 0; i < 10; i++){
-			printf("%f\n", DATA[i]);
+			printf("%f\n", arena->input[i]);
 		}
 		printf("New data:\n");
 		for (i = 0; i < 10; i++){
-			printf("%f\n", RET_DATA[i]);
+			printf("%f\n", output[i]);
 		}
 	}
 
-	// CALCULATE METRICS
-	// *******************
-	int number_of_incorrect = 0;
-	float max_diff = 0;
-	float rmse_sum = 0;
-	float max_val = -1;
-	float min_val = -1;
-
-	if(startsWith(error_bounding_mode, "ABS")){
-		for (i = 0; i < data_size; i++){
-			float a = DATA[i];
-			float b = RET_DATA[i];
-
-			// RMSE Work
-			float rmse_diff = a - b;
-			rmse_diff = rmse_diff * rmse_diff;
-			rmse_sum = rmse_sum + rmse_diff;
-			
-			//PSNR Work
-			if(a > max_val || max_val == -1){
-				max_val = a;
-			}
-			if(a < min_val || min_val == -1){
-				min_val = a;
-			}
-
-			float diff = fabs(a - b);
-			if(diff > error_bound){
-				if (DEBUG){
-					printf("Before: %f\n", a);
-					printf("After: %f\n", b);
-					printf("Difference: %f\n", diff);
-					printf("Err Bound:  %f\n", error_bound);
-					return 0;
-				}
-				number_of_incorrect++;
-			}
-			if(diff > max_diff){
-				max_diff = diff;
-			}
-		}
-	}else if(startsWith(error_bounding_mode, "PSNR")){
-		number_of_incorrect = -1;
-		for (i = 0; i < data_size; i++){
-			float a = DATA[i];
-			float b = RET_DATA[i];
-
-			// RMSE Work
-			float rmse_diff = a - b;
-			rmse_diff = rmse_diff * rmse_diff;
-			rmse_sum = rmse_sum + rmse_diff;
-			
-			//PSNR Work
-			if(a > max_val || max_val == -1){
-				max_val = a;
-			}
-			if(a < min_val || min_val == -1){
-				min_val = a;
-			}
-
-			float diff = fabs(a - b);
-			if(diff > max_diff){
-				max_diff = diff;
-			}	
-		}
-	}else if(startsWith(error_bounding_mode, "PW_REL")){
-		for(i = 0; i < data_size; i++){
-			float a = DATA[i];
-			float b = RET_DATA[i];
-
-			// RMSE Work
-			float rmse_diff = a - b;
-			rmse_diff = rmse_diff * rmse_diff;
-			rmse_sum = rmse_sum + rmse_diff;
-			
-			//PSNR Work
-			if(a > max_val || max_val == -1){
-				max_val = a;
-			}
-			if(a < min_val || min_val == -1){
-				min_val = a;
-			}
-		
-			float diff = fabs(a - b);
-			float rel_bound = fabs(error_bound * a);
-			if(diff > rel_bound){
-				if (DEBUG){
-					printf("Before: %f\n", a);
-					printf("After: %f\n", b);
-					printf("Difference: %f\n", diff);
-					printf("Rel Bound:  %f\n", rel_bound);
-					return 0;
-				}
-				number_of_incorrect++;
-			}
-			if (diff > max_diff){
-				max_diff = diff;
-			}				
-		}
-	}else if(startsWith(error_bounding_mode, "Accuracy")){
-		for (i = 0; i < data_size; i++){
-			float a = DATA[i];
-			float b = RET_DATA[i];
-
-			// RMSE Work
-			float rmse_diff = a - b;
-			rmse_diff = rmse_diff * rmse_diff;
-			rmse_sum = rmse_sum + rmse_diff;
-			
-			//PSNR Work
-			if(a > max_val || max_val == -1){
-				max_val = a;
-			}
-			if(a < min_val || min_val == -1){
-				min_val = a;
-			}
-
-			float diff = fabs(a - b);
-			if(diff > error_bound){
-				if (DEBUG){
-					printf("Before: %f\n", a);
-					printf("After: %f\n", b);
-					printf("Difference: %f\n", diff);
-					printf("Err Bound:  %f\n", error_bound);
-					return 0;
-				}
-				number_of_incorrect++;
-			}
-			if(diff > max_diff){
-				max_diff = diff;
-			}
-		}
-	} else if(startsWith(error_bounding_mode, "Rate")){
-		for (i = 0; i < data_size; i++){
-			float a = DATA[i];
-			float b = RET_DATA[i];
-
-			// RMSE Work
-			float rmse_diff = a - b;
-			rmse_diff = rmse_diff * rmse_diff;
-			rmse_sum = rmse_sum + rmse_diff;
-			
-			//PSNR Work
-			if(a > max_val || max_val == -1){
-				max_val = a;
-			}
-			if(a < min_val || min_val == -1){
-				min_val = a;
-			}
-
-			float diff = fabs(a - b);
-			if(diff > default_bound && default_bound != -1){
-				if (DEBUG){
-					printf("Before: %f\n", a);
-					printf("After: %f\n", b);
-					printf("Difference: %f\n", diff);
-					printf("Err Bound:  %f\n", default_bound);
-					return 0;
-				}
-				number_of_incorrect++;
-			}
-			if(diff > max_diff){
-				max_diff = diff;
-			}	
+	// Classification alone skips every metric
+	if (CLASSIFY){
+		int baseline_violates = baselineViolates(arena->input, arena->baseline, arena->num_elements, error_bounding_mode, error_bound, default_bound);
+		printf("Trial Effect: %s\n", effectName(classifyOutput(arena->input, arena->baseline, output, arena->num_elements, error_bounding_mode, error_bound, default_bound, baseline_violates)));
+	} else {
+		// CALCULATE METRICS
+		// *******************
+		struct error_metrics errors;
+		struct error_sketch error_sketch;
+		sketchInit(&error_sketch, 0);
+		struct quality_metrics quality;
+		qualityInit(&quality, quality_selected);
+		calculateErrorMetrics(arena->input, output, arena->num_elements, error_bounding_mode, error_bound, default_bound, SKETCH ? &error_sketch : NULL, quality_selected ? &quality : NULL, DEBUG, &errors);
+
+		//Print Metrics
+		printErrorMetrics(&errors);
+
+		// Shape of the error distribution
+		if (SKETCH){
+			sketchPrint(&error_sketch);
 		}
-	} else if(startsWith(error_bounding_mode, "Precision")){
-		number_of_incorrect = -1;
-		for (i = 0; i < data_size; i++){
-			float a = DATA[i];
-			float b = RET_DATA[i];
-
-			// RMSE Work
-			float rmse_diff = a - b;
-			rmse_diff = rmse_diff * rmse_diff;
-			rmse_sum = rmse_sum + rmse_diff;
-			
-			//PSNR Work
-			if(a > max_val || max_val == -1){
-				max_val = a;
-			}
-			if(a < min_val || min_val == -1){
-				min_val = a;
-			}
+		sketchFree(&error_sketch);
 
-			float diff = fabs(a - b);
-			if(diff > max_diff){
-				max_diff = diff;
-			}	
+		// Optional quality metrics against the original data
+		if (quality_selected){
+			calculateSSIM(arena->input, output, dims, num_dims, &quality);
+			printQuality(&quality);
 		}
 	}
-	
 
-	//Calculate Root Mean Square Error 
-	float rmse = rmse_sum / (data_size - 1);
-	rmse = sqrt(rmse);
-
-	//Check RMSE for bad values
-	if (fpclassify(rmse) == FP_INFINITE) {
-		rmse = FLT_MAX;
-	} else if (fpclassify(rmse) == FP_NAN) {
-		rmse = FLT_MAX;
+	// Spatial spread of the fault relative to the fault-free output
+	if (PROPAGATION){
+		struct propagation_metrics propagation;
+		calculatePropagation(arena->baseline, output, dims, num_dims, block_edge, &propagation);
+		printPropagation(&propagation, num_dims);
 	}
 
-	//Calculate PSNR
-	float psnr_control_value = 10000;
-	float psnr = 0;
-	if (rmse == 0){
-		psnr = psnr_control_value;
-	} else {
-		psnr = 20 * log10((max_val - min_val) / rmse);	
-	}	
-
-	//Check PSNR for bad values
-	if (fpclassify(psnr) == FP_INFINITE){
-		psnr = psnr_control_value * -1;
-	} else if (fpclassify(psnr) == FP_NAN) {
-		psnr = psnr_control_value * -1;
-	}
-	
-	//Check Maximum Difference for bad values
-	if (fpclassify(max_diff) == FP_INFINITE){
-		max_diff = FLT_MAX;
-	} else if (fpclassify(max_diff) == FP_NAN) {
-		max_diff = FLT_MAX;
+	// Keep the corrupted field, one dataset per trial, before energy reruns overwrite it
+	if (output_path != NULL){
+		char dataset[64];
+		if (INJECT && injection_active){
+			snprintf(dataset, sizeof(dataset), "/byte_%d_bit_%d", char_loc, flip_loc);
+		} else {
+			snprintf(dataset, sizeof(dataset), "/clean");
+		}
+		containerWrite(output_path, dataset, dims, num_dims, output);
+		printf("Output Dataset: %s:%s\n", output_path, dataset);
 	}
 
-	//Print Metrics
-	printf("Number of Incorrect: %d\n", number_of_incorrect);
-	printf("Maximum Absolute Difference: %f\n", max_diff);
-	printf("Root Mean Squared Error: %f\n", rmse);
-	printf("PSNR: %f\n", psnr);
-
-	if(DATA){
-		free(DATA);
-	}
-	if (RET_DATA){
-		free(RET_DATA);
+	// Energy of the clean compressor, after the trial so it is not disturbed
+	if (ENERGY){
+		if (energyInit()){
+			struct energy_measurement compress_energy, decompress_energy;
+			energyCompress(inj, &compress_energy);
+			energyDecompress(inj, &decompress_energy);
+			energyPrint("Compression", &compress_energy, sizeof(float) * arena->num_elements);
+			energyPrint("Decompression", &decompress_energy, sizeof(float) * arena->num_elements);
+		} else {
+			printf("Energy: RAPL counters not available\n");
+		}
 	}
+
+	injectorFree(inj);
+	arenaFree(arena);
 	printf("End of Experiment\n");
 	return 0;
 }
@@ -1,187 +1,53 @@
-import concurrent.futures
 import subprocess
 import re
 from datetime import datetime
-import time
-import math
 import os
 import sys
 
-# Calls C Program, checks to see if it finished near instantly.
-# If not then wait the timeout period and check every .1 seconds.
-def popen_timeout(command, timeout):
-	p = subprocess.Popen(command, stdout=subprocess.PIPE)
-	time.sleep(.03)
-	if p.poll() is not None:
-		return p.communicate(), p.pid
-	else:
-		for t in range(timeout*10):
-			time.sleep(.1)
-			if p.poll() is not None:
-				return  p.communicate(), p.pid
-		p.kill()
-		return ["Timeout"], p.pid
-
-
-# Call C Program and write results to the output file.
-def experiment(process_id, subprocess_id, data_path, dims_input, compressor, error_mode, error_bound, default_bound, start, end, unique_experiment_id, timeout_limit):
+# Run one comp_inj campaign over a byte range and write its results file.
+# comp_inj compresses the field once and runs every (byte, bit) trial in a
+# forked worker, classifying crashes, hangs and errors itself, so the CSV it
+# writes has the same columns this runner used to assemble trial by trial.
+# The workers are pinned per NUMA node by comp_inj itself. Progress (rate,
+# ETA, outcome totals) is kept in a Prometheus text file next to the results.
+def experiment(process_id, subprocess_id, data_path, dims_input, compressor, error_mode, error_bound, default_bound, start, end, unique_experiment_id, timeout_limit, quality_metrics, propagation, sketch, workers):
 
 	# Get output information to save results
 	output_file = "subprocess_results/{}/process_{}_{}_subprocess_{}_results.csv".format(unique_experiment_id, process_id, unique_experiment_id, subprocess_id)
-	output = open(output_file, "w+")
-	output.write("DataSize,CompressionRatio,ErrorInfo,ByteLocation,FlipLocation,DecompressionTime,Incorrect,MaxDifference,RMSE,PSNR,Status,Traceback\n")
+	if os.path.exists(output_file):
+		os.remove(output_file)
 
 	print("Running Trials. . .\n", flush=True)
 
-	print("Hitting {} to {}".format(start, end), flush=True)
-	for byte in range(start, end+1):
-		for bit in range(8):
-			# Call c program
-			try:
-				proc_result, child_process_id = popen_timeout(['./comp_inj', '-i', data_path, '-d', dims_input, '-c', compressor, '-m', error_mode, '-e', str(error_bound), '-x', str(default_bound), '-b', str(byte), '-f', str(bit), '-a', str(1)], timeout_limit)
-				response = str(proc_result[0])
-			except Exception as e:
-				print(e)
-				exit(-1)
+	telemetry_file = os.path.splitext(output_file)[0] + ".prom"
+	print("Hitting {} to {}, progress in {}".format(start, end, telemetry_file), flush=True)
+	command = ['./comp_inj', '-i', data_path, '-d', dims_input, '-c', compressor, '-m', error_mode, '-e', str(error_bound), '-x', str(default_bound), '-r', "{}:{}".format(start, end), '-w', output_file, '-l', str(timeout_limit), '-j', str(workers), '-t', telemetry_file]
+	if propagation:
+		command = command + ['-p', str(1)]
+	if sketch:
+		command = command + ['-q', str(1)]
+	if quality_metrics:
+		command = command + ['-M', quality_metrics]
+	try:
+		proc_result = subprocess.run(command, stdout=subprocess.PIPE, universal_newlines=True)
+	except Exception as e:
+		print(e)
+		exit(-1)
 
+	if proc_result.returncode != 0 or not os.path.exists(output_file):
+		print("Campaign Failed\n")
+		print("Bytes: {} to {}\n".format(start, end))
+		print(proc_result.stdout)
+		return
 
-			if "Timeout" not in response:
-				# Parse response
-				try:
-					data_size = re.findall(r"(?<=Original Data Size in Bytes: ).+?(?=\\n)", response)[0]
-					error_info = re.findall(r"(?<=Error Bounding Value: ).+?(?=\\n)", response)[0]
-					byte_location = re.findall(r"(?<=Byte Location: ).+?(?=\\n)", response)[0]
-					flip_location = re.findall(r"(?<=Flip Location: ).+?(?=\\n)", response)[0]
-					try:
-						compressed_ratio = re.findall(r"(?<=Compression Ratio: ).+?(?=\\n)", response)[0]
-						time_taken = re.findall(r"(?<=Time to Decompress: ).+?(?=\\n)", response)[0]
-						num_incorrect = re.findall(r"(?<=Number of Incorrect: ).+?(?=\\n)", response)[0]
-						abs_diff = re.findall(r"(?<=Maximum Absolute Difference: ).+?(?=\\n)", response)[0]
-						rmse = re.findall(r"(?<=Root Mean Squared Error: ).+?(?=\\n)", response)[0]
-						psnr = re.findall(r"(?<=PSNR: ).+?(?=\\n)", response)[0]
-						status = "Completed"	
-						traceback = "NA"
-					except:
-						core_file = "core.{}".format(child_process_id)
-						if os.path.exists(core_file):
-							#print("Coredump Occured\n")
-							compressed_ratio = "-1"
-							time_taken = "-1"
-							num_incorrect = "-1"
-							abs_diff = "-1"
-							rmse = "-1"
-							psnr = "-1"
-							status = "CoreDump"
-							traceback = "NA"
-							os.system("rm {}".format(core_file))	
-						elif "Wrong version" in response:
-							#print("Version Error Occured\n")
-							compressed_ratio = "-1"
-							time_taken = "-1"
-							num_incorrect = "-1"
-							abs_diff = "-1"
-							rmse = "-1"
-							psnr = "-1"
-							status = "VersionError"
-							traceback = "NA"
-						elif "Sig 11" in response:
-							#print("Segfault Occured\n")
-							compressed_ratio = "-1"
-							time_taken = "-1"	
-							num_incorrect = "-1"
-							abs_diff = "-1"
-							rmse = "-1"
-							psnr = "-1"
-							status = "SegFault"
-							try:
-								traceback = re.findall(r"(?<=Receiving Sig 11: ).+?(?=\\n)", response)[0]
-								traceback = re.findall(r"\/+.*?\)+", traceback)
-								traceback = ' <- '.join(traceback)	
-							except:
-								traceback = "Unknown"
-						elif "stepLength" in response:
-							#print("StepLength Error Occured\n")
-							compressed_ratio = "-1"
-							time_taken = "-1"	
-							num_incorrect = "-1"
-							abs_diff = "-1"
-							rmse = "-1"
-							psnr = "-1"
-							status = "StepLengthError"
-							traceback = "NA"
-						else:
-							print("Unkown Output\n")
-							print("Byte: {} Bit: {}\n".format(byte, bit))
-							print(response)
-							print("\n")
-							compressed_ratio = "-1"
-							time_taken = "-1"
-							num_incorrect = "-1"
-							abs_diff = "-1"
-							rmse = "-1"
-							psnr = "-1"
-							status = "Unknown"
-							traceback = "NA"
-				except:
-					core_file = "core.{}".format(child_process_id)
-					if os.path.exists(core_file):
-						#print("HardSegFault Occured\n")
-						error_info = error_mode
-						byte_location = str(byte)
-						flip_location = str(bit)
-						data_size = "NA"
-						compressed_ratio = "-1"
-						time_taken = "-1"
-						num_incorrect = "-1"
-						abs_diff = "-1"
-						rmse = "-1"
-						psnr = "-1"
-						status = "HardSegFaultCoreDump"
-						traceback = "NA"
-						os.system("rm {}".format(core_file))
-					else:
-						print("Check Error Occured\n")
-						print("Byte: {} Bit: {}\n".format(byte, bit))
-						#print("Child ID: {}\n".format(child_process_id))
-						error_info = error_mode
-						byte_location = str(byte)
-						flip_location = str(bit)
-						data_size = "NA"
-						compressed_ratio = "-1"
-						time_taken = "-1"
-						num_incorrect = "-1"
-						abs_diff = "-1"
-						rmse = "-1"
-						psnr = "-1"
-						status = "CheckError"
-						traceback = "NA"
-			else:
-				print("TimeOut Occurred\n")
-				print("Byte: {} Bit: {}\n".format(byte, bit))
-				error_info = error_mode
-				byte_location = str(byte)
-				flip_location = str(bit)
-				data_size = "NA"
-				compressed_ratio = "-1"
-				time_taken = "{}".format(timeout_limit)
-				num_incorrect = "-1"
-				abs_diff = "-1"
-				rmse = "-1"
-				psnr = "-1"
-				status = "Timeout"
-				traceback = "NA"
-	
-			# Print out to file
-			output_row = "{},{},{},{},{},{},{},{},{},{},{},{}\n".format(data_size, compressed_ratio, error_info, byte_location, flip_location, time_taken, num_incorrect, abs_diff, rmse, psnr, status, traceback)
-			output.write(output_row)
-			output.flush()
-		
-	#Close output file
-	output.close()
+	# Outcome totals of the campaign
+	summary = re.findall(r"(?<=Campaign Trials: ).+", proc_result.stdout)
+	if summary:
+		print("Finished {} to {}: {} trials".format(start, end, summary[0]), flush=True)
 
 
 def main():
-	if len(sys.argv) != 13:
+	if len(sys.argv) != 13 and len(sys.argv) != 14:
 		print("Incorrect Number of Arguements. . .")
 		exit(-1)
 
@@ -198,58 +64,28 @@ def main():
 	unique_experiment_id = sys.argv[10].strip()
 	output_file_name = sys.argv[11].strip()
 	timeout_limit = int(sys.argv[12])
+	# Optional comma separated extra metrics: propagation (comp_inj -p),
+	# sketch (comp_inj -q) and the quality metrics of comp_inj -M (ssim,
+	# pearson,range,ulp). Each costs every trial a pass over the field,
+	# sketch also a histogram in every row, so none run by default.
+	extra_metrics = sys.argv[13].strip().split(",") if len(sys.argv) == 14 else []
+	propagation = "propagation" in extra_metrics
+	sketch = "sketch" in extra_metrics
+	quality_metrics = ",".join(m for m in extra_metrics if m and m not in ("propagation", "sketch"))
 
 	print(dims_input)
 
 	print("Starting Experiment:")
 	startTime = datetime.now()
 
-	# Split given range of byte positions into maximum number of cpu's
-	bins = os.cpu_count()
-	print("Splitting {}-{} of the data into {} bins".format(start_range,end_range,bins))
-
-	bin_ranges = []
-	positions_per_range = math.floor((end_range - start_range) / bins)
-	start_value = start_range
-	end_value = start_value + positions_per_range
-
-	first = 0
-	while True:
-		if first == 0:
-			first = 1
-			start_value = start_range
-			end_value = start_value + positions_per_range 
-		else:
-			start_value = end_value + 1
-			end_value = start_value + positions_per_range
-		if (end_value >= end_range):
-			end_value = end_range
-			bin_ranges.append([start_value, end_value])
-			break
-		else:
-			bin_ranges.append([start_value, end_value])
+	# One campaign over the whole range with a worker per cpu, comp_inj
+	# places the workers on the NUMA nodes and balances bytes between them
+	workers = len(os.sched_getaffinity(0))
+	print("Running {}-{} of the data with {} workers".format(start_range, end_range, workers))
 
-	print("Ranges are as follows:\n")
-	for item in bin_ranges:
-		print(item)
-
-	# Start running all of the subprocesses
-	output_files = []
 	subprocess_id = 0
-
-	
-	with concurrent.futures.ProcessPoolExecutor(max_workers=os.cpu_count()) as executor:
-		for ranges in bin_ranges:
-			start = ranges[0]
-			end = ranges[1]
-			print("Sending {} to {} to subprocess #{}".format(start, end, subprocess_id), flush=True)
-			executor.submit(experiment, process_id, subprocess_id, data_path, dims_input, compressor, error_mode, error_bound, default_bound, start, end, unique_experiment_id, timeout_limit)
-			output_files.append("subprocess_results/{}/process_{}_{}_subprocess_{}_results.csv".format(unique_experiment_id, process_id, unique_experiment_id, subprocess_id))
-			subprocess_id = subprocess_id + 1
-	
-
-	# For debugging
-	#experiment(process_id, subprocess_id, data_path, dims_input, compressor, error_mode, error_bound, bin_ranges[0][0], bin_ranges[0][1], unique_experiment_id, timeout_limit)
+	experiment(process_id, subprocess_id, data_path, dims_input, compressor, error_mode, error_bound, default_bound, start_range, end_range, unique_experiment_id, timeout_limit, quality_metrics, propagation, sketch, workers)
+	output_files = ["subprocess_results/{}/process_{}_{}_subprocess_{}_results.csv".format(unique_experiment_id, process_id, unique_experiment_id, subprocess_id)]
 
 	print("Time To Completion:\n")
 	print(datetime.now() - startTime)
@@ -258,21 +94,9 @@ def main():
 	print("Cleaning up subprocess files\n")
 
 	process_output_file = "results/" + str(process_id) + "_" + output_file_name
-	with open(process_output_file, "w+") as process_results:
-		result_file = 0
-		for result in output_files:
-			with open(result) as res_file:
-				count = 0
-				for line in res_file:
-					if count != 0:
-						process_results.write(line)
-					else:
-						if result_file == 0:
-							count = 1
-							result_file = 1
-							process_results.write(line)
-						else:
-							count = 1
+	existing_files = [result for result in output_files if os.path.exists(result)]
+	if existing_files:
+		subprocess.run(['./comp_agg', '-m', process_output_file] + existing_files)
 
 	
 	# Clear results for this experiment
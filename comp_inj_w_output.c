@@ -11,6 +11,8 @@
 #include "libpressio.h"
 #include "sz.h"
 
+#include "capture.h"
+
 /*
  * GLOBAL VARIABLES
  */
@@ -25,6 +27,10 @@ float *DATA;
 float* TMP_DATA;
 // Faulted Decompressed Data Pointer
 float *RET_DATA;
+// Fault-Free Decompressed Data Pointer (only filled when capturing)
+float *BASELINE_DATA;
+// Corrupted output capture archive (NULL writes Corrupted_Output.bin)
+char *CAPTURE_PATH = NULL;
 
 /*
  * Function: sigHandler
@@ -63,6 +69,9 @@ void sigHandler(int sig) {
 	if (RET_DATA){
 		free(RET_DATA);
 	}
+	if (BASELINE_DATA){
+		free(BASELINE_DATA);
+	}
 	exit(sig);
 }
 
@@ -184,6 +193,21 @@ void szCompressionInjection(char * compressor_choice, char * error_bounding_mode
 		size_t compressed_size;
 		uint8_t * data = (uint8_t *)pressio_data_ptr(compressed_data, &compressed_size);
 
+		// Decompress the fault-free stream first when capturing outputs
+		if (CAPTURE_PATH){
+			if (DEBUG){
+				printf("Decompressing Baseline\n");
+			}
+			struct pressio_data* baseline_data = pressio_data_new_empty(pressio_float_dtype, num_dims, dims);
+			if (pressio_compressor_decompress(compressor, compressed_data, baseline_data)) {
+				printf("%s\n", pressio_compressor_error_msg(compressor));
+				exit(pressio_compressor_error_code(compressor));
+			}
+			size_t baseline_bytes;
+			BASELINE_DATA = (float *)pressio_data_copy(baseline_data, &baseline_bytes);
+			pressio_data_free(baseline_data);
+		}
+
 		// Generate flip mask based on flip_loc
 		uint8_t mask = 0;
 		uint8_t one = 1;
@@ -297,6 +321,21 @@ void szCompressionInjection(char * compressor_choice, char * error_bounding_mode
 		size_t compressed_size;
 		uint8_t * data = (uint8_t *)pressio_data_ptr(compressed_data, &compressed_size);
 
+		// Decompress the fault-free stream first when capturing outputs
+		if (CAPTURE_PATH){
+			if (DEBUG){
+				printf("Decompressing Baseline\n");
+			}
+			struct pressio_data* baseline_data = pressio_data_new_empty(pressio_float_dtype, num_dims, dims);
+			if (pressio_compressor_decompress(compressor, compressed_data, baseline_data)) {
+				printf("%s\n", pressio_compressor_error_msg(compressor));
+				exit(pressio_compressor_error_code(compressor));
+			}
+			size_t baseline_bytes;
+			BASELINE_DATA = (float *)pressio_data_copy(baseline_data, &baseline_bytes);
+			pressio_data_free(baseline_data);
+		}
+
 		// Generate flip mask based on flip_loc
 		uint8_t mask = 0;
 		uint8_t one = 1;
@@ -397,7 +436,7 @@ int main(int argc, char *argv[]){
 
 	// Parse input with getopt
 	int option_index = 0;
-    while (( option_index = getopt(argc, argv, "i:d:c:m:e:b:f:a:s:")) != -1){
+    while (( option_index = getopt(argc, argv, "i:d:c:m:e:b:f:a:s:o:")) != -1){
         switch (option_index) {
             case 'i':
                 data_path = optarg;
@@ -430,6 +469,9 @@ int main(int argc, char *argv[]){
 			case 's':
 				starts_and_ends = optarg;
 				break;
+			case 'o':
+				CAPTURE_PATH = optarg;
+				break;
             default:
                 printf("Options incorrect\n");
                 return 1;
@@ -842,16 +884,24 @@ int main(int argc, char *argv[]){
 	//	TMP_DATA[i] = (float)RET_DATA[i];
 	//}
 
-	printf("Writing out output:\n");
-	FILE *ofp;
-	char *output_path = "Corrupted_Output.bin";
-	ofp = fopen(output_path,"wb");
-	if (ofp == NULL){
-		perror("ERROR: ");
-		exit(-1);
+	if (CAPTURE_PATH){
+		// Store only the difference from the baseline in the campaign archive
+		printf("Capturing output: %s\n", CAPTURE_PATH);
+		struct capture *cap = captureOpen(CAPTURE_PATH, BASELINE_DATA, data_size);
+		captureRecord(cap, injection_active ? char_loc : -1, injection_active ? flip_loc : -1, RET_DATA);
+		captureClose(cap);
 	} else {
-		fwrite(RET_DATA, 4,  data_size, ofp);
-		fclose(ofp);
+		printf("Writing out output:\n");
+		FILE *ofp;
+		char *output_path = "Corrupted_Output.bin";
+		ofp = fopen(output_path,"wb");
+		if (ofp == NULL){
+			perror("ERROR: ");
+			exit(-1);
+		} else {
+			fwrite(RET_DATA, 4,  data_size, ofp);
+			fclose(ofp);
+		}
 	}
 
 	if(DATA){
@@ -863,6 +913,9 @@ int main(int argc, char *argv[]){
 	if (RET_DATA){
 		free(RET_DATA);
 	}
+	if (BASELINE_DATA){
+		free(BASELINE_DATA);
+	}
 	printf("End of Experiment\n");
 	return 0;
 }
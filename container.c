@@ -0,0 +1,536 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef CARTS_HDF5
+#include <hdf5.h>
+#endif
+#ifdef CARTS_NETCDF
+#include <netcdf.h>
+#endif
+
+#include "container.h"
+#include "metrics.h"
+
+// Most axes of a container variable, before single indices drop some
+#define CONTAINER_MAX_RANK 32
+
+#define FORMAT_HDF5 0
+#define FORMAT_NETCDF 1
+
+// File extensions followed by ':' that mark a container path
+static const struct {
+	const char *extension;
+	int format;
+} EXTENSIONS[] = {
+	{ ".h5", FORMAT_HDF5 }, { ".hdf5", FORMAT_HDF5 }, { ".he5", FORMAT_HDF5 },
+	{ ".nc", FORMAT_NETCDF }, { ".nc4", FORMAT_NETCDF }, { ".cdf", FORMAT_NETCDF }
+};
+
+/*
+ * An open container variable and the hyperslab selected from it.
+ * Axes are slowest first, as the libraries count them.
+ */
+struct container_variable {
+	char file[4096];
+	char name[1024];
+	// Hyperslab between the brackets, empty for the whole variable
+	char slab[1024];
+	int format;
+	int rank;
+	size_t extent[CONTAINER_MAX_RANK];
+	// Chunk extent along the slowest axis, 0 when not chunked
+	size_t chunk;
+	size_t start[CONTAINER_MAX_RANK];
+	size_t count[CONTAINER_MAX_RANK];
+	// Axes given as a single index, left out of the field dims
+	int dropped[CONTAINER_MAX_RANK];
+#ifdef CARTS_HDF5
+	hid_t h5_file;
+	hid_t h5_dataset;
+#endif
+#ifdef CARTS_NETCDF
+	int nc_id;
+	int nc_var;
+#endif
+};
+
+/*
+ * Function: splitSpec
+ * -------------------------------------------------------------------------------
+ * Finds the ':' that separates a container file from its variable.
+ *
+ * returns: the offset of that ':', -1 if path is not a container path
+ * -------------------------------------------------------------------------------
+ */
+static int splitSpec(const char *path, int *format){
+	size_t e;
+	for (e = 0; e < sizeof(EXTENSIONS) / sizeof(EXTENSIONS[0]); e++){
+		size_t len = strlen(EXTENSIONS[e].extension);
+		const char *at = path;
+		while ((at = strstr(at, EXTENSIONS[e].extension)) != NULL){
+			if (at[len] == ':'){
+				*format = EXTENSIONS[e].format;
+				return (int)(at + len - path);
+			}
+			at += len;
+		}
+	}
+	return -1;
+}
+
+/*
+ * Function: containerIsSpec
+ * -------------------------------------------------------------------------------
+ * returns: nonzero if path names a variable inside an HDF5 or NetCDF file
+ * -------------------------------------------------------------------------------
+ */
+int containerIsSpec(const char *path){
+	int format;
+	return path != NULL && splitSpec(path, &format) >= 0;
+}
+
+/*
+ * Function: containerName
+ * -------------------------------------------------------------------------------
+ * Names a selection for use in file names: data/hurricane.h5:/TCf48[0:10,:]
+ * becomes hurricane_TCf48_0-10_-.
+ * -------------------------------------------------------------------------------
+ */
+void containerName(const char *spec, char *name, size_t size){
+	int format;
+	int colon = splitSpec(spec, &format);
+	const char *file = spec;
+	const char *c;
+	size_t used = 0;
+
+	for (c = spec; c < spec + colon; c++){
+		if (*c == '/'){
+			file = c + 1;
+		}
+	}
+	// File name without its extension, then the variable and hyperslab
+	const char *ext = file;
+	for (c = file; c < spec + colon; c++){
+		if (*c == '.'){
+			ext = c;
+		}
+	}
+	if (ext == file){
+		ext = spec + colon;
+	}
+	for (c = file; *c && used + 1 < size; c++){
+		if (c >= ext && c < spec + colon){
+			continue;
+		}
+		if (*c == ']' || ((c == spec + colon || c[-1] == ':') && *c == '/')){
+			continue;
+		}
+		if (c > spec + colon && *c == ':'){
+			name[used++] = '-';
+		} else if ((*c >= 'a' && *c <= 'z') || (*c >= 'A' && *c <= 'Z') || (*c >= '0' && *c <= '9') || *c == '-' || *c == '.'){
+			name[used++] = *c;
+		} else {
+			name[used++] = '_';
+		}
+	}
+	name[used] = '\0';
+}
+
+/*
+ * Function: parseSlab
+ * -------------------------------------------------------------------------------
+ * Turns the hyperslab text into start and count for every axis, exits on a
+ * malformed or out of range selection.
+ * -------------------------------------------------------------------------------
+ */
+static void parseSlab(struct container_variable *v){
+	char copy[sizeof(v->slab)];
+	char *entry, *save = NULL;
+	int d = 0;
+
+	for (d = 0; d < v->rank; d++){
+		v->start[d] = 0;
+		v->count[d] = v->extent[d];
+		v->dropped[d] = 0;
+	}
+	if (v->slab[0] == '\0'){
+		return;
+	}
+
+	snprintf(copy, sizeof(copy), "%s", v->slab);
+	d = 0;
+	for (entry = strtok_r(copy, ",", &save); entry != NULL; entry = strtok_r(NULL, ",", &save), d++){
+		char *colon = strchr(entry, ':');
+		long start = 0, end = d < v->rank ? (long)v->extent[d] : 0;
+		char *rest;
+		if (d >= v->rank){
+			break;
+		}
+		if (colon == NULL){
+			start = strtol(entry, &rest, 10);
+			end = start + 1;
+			v->dropped[d] = 1;
+		} else {
+			*colon = '\0';
+			if (strspn(entry, " ") != strlen(entry)){
+				start = strtol(entry, &rest, 10);
+			}
+			if (strspn(colon + 1, " ") != strlen(colon + 1)){
+				end = strtol(colon + 1, &rest, 10);
+			}
+		}
+		if (start < 0 || end > (long)v->extent[d] || start >= end){
+			printf("ERROR: Invalid hyperslab [%s] for %s (axis %d has %zu entries)\n", v->slab, v->name, d, v->extent[d]);
+			exit(-1);
+		}
+		v->start[d] = (size_t)start;
+		v->count[d] = (size_t)(end - start);
+	}
+	if (d != v->rank){
+		printf("ERROR: Hyperslab [%s] of %s needs %d entries\n", v->slab, v->name, v->rank);
+		exit(-1);
+	}
+}
+
+#ifdef CARTS_HDF5
+/*
+ * Function: openHDF5
+ * -------------------------------------------------------------------------------
+ * Opens an HDF5 dataset and reads its shape and chunking.
+ * -------------------------------------------------------------------------------
+ */
+static void openHDF5(struct container_variable *v){
+	hsize_t dims[CONTAINER_MAX_RANK], chunk[CONTAINER_MAX_RANK];
+	int d;
+
+	v->h5_file = H5Fopen(v->file, H5F_ACC_RDONLY, H5P_DEFAULT);
+	if (v->h5_file < 0){
+		printf("ERROR: Could not open HDF5 file %s\n", v->file);
+		exit(-1);
+	}
+	v->h5_dataset = H5Dopen2(v->h5_file, v->name, H5P_DEFAULT);
+	if (v->h5_dataset < 0){
+		printf("ERROR: No dataset %s in %s\n", v->name, v->file);
+		exit(-1);
+	}
+
+	hid_t type = H5Dget_type(v->h5_dataset);
+	H5T_class_t type_class = H5Tget_class(type);
+	H5Tclose(type);
+	if (type_class != H5T_FLOAT && type_class != H5T_INTEGER){
+		printf("ERROR: Dataset %s is not numeric\n", v->name);
+		exit(-1);
+	}
+
+	hid_t space = H5Dget_space(v->h5_dataset);
+	v->rank = H5Sget_simple_extent_ndims(space);
+	if (v->rank < 1 || v->rank > CONTAINER_MAX_RANK){
+		printf("ERROR: Dataset %s has %d dimensions\n", v->name, v->rank);
+		exit(-1);
+	}
+	H5Sget_simple_extent_dims(space, dims, NULL);
+	H5Sclose(space);
+	for (d = 0; d < v->rank; d++){
+		v->extent[d] = (size_t)dims[d];
+	}
+
+	hid_t create = H5Dget_create_plist(v->h5_dataset);
+	v->chunk = 0;
+	if (H5Pget_layout(create) == H5D_CHUNKED && H5Pget_chunk(create, v->rank, chunk) == v->rank){
+		v->chunk = (size_t)chunk[0];
+	}
+	H5Pclose(create);
+}
+
+/*
+ * Function: readHDF5
+ * -------------------------------------------------------------------------------
+ * Reads rows [row, row + rows) of the slowest axis of the selection into
+ * data, converting to float.
+ * -------------------------------------------------------------------------------
+ */
+static void readHDF5(struct container_variable *v, size_t row, size_t rows, float *data){
+	hsize_t offset[CONTAINER_MAX_RANK], count[CONTAINER_MAX_RANK];
+	int d;
+
+	for (d = 0; d < v->rank; d++){
+		offset[d] = v->start[d];
+		count[d] = v->count[d];
+	}
+	offset[0] = row;
+	count[0] = rows;
+
+	hid_t space = H5Dget_space(v->h5_dataset);
+	hid_t memory = H5Screate_simple(v->rank, count, NULL);
+	herr_t err = H5Sselect_hyperslab(space, H5S_SELECT_SET, offset, NULL, count, NULL);
+	if (err >= 0){
+		err = H5Dread(v->h5_dataset, H5T_NATIVE_FLOAT, memory, space, H5P_DEFAULT, data);
+	}
+	H5Sclose(memory);
+	H5Sclose(space);
+	if (err < 0){
+		printf("ERROR: Could not read %s from %s\n", v->name, v->file);
+		exit(-1);
+	}
+}
+#endif
+
+#ifdef CARTS_NETCDF
+/*
+ * Function: checkNetCDF
+ * -------------------------------------------------------------------------------
+ * Exits with the library's message if a NetCDF call failed.
+ * -------------------------------------------------------------------------------
+ */
+static void checkNetCDF(int status, const struct container_variable *v){
+	if (status != NC_NOERR){
+		printf("ERROR: %s:%s: %s\n", v->file, v->name, nc_strerror(status));
+		exit(-1);
+	}
+}
+
+/*
+ * Function: openNetCDF
+ * -------------------------------------------------------------------------------
+ * Opens a NetCDF variable and reads its shape and chunking.
+ * -------------------------------------------------------------------------------
+ */
+static void openNetCDF(struct container_variable *v){
+	int dim_ids[NC_MAX_VAR_DIMS];
+	size_t chunk[NC_MAX_VAR_DIMS];
+	int storage;
+	nc_type type;
+	int d;
+
+	checkNetCDF(nc_open(v->file, NC_NOWRITE, &v->nc_id), v);
+	// Variables are not paths in NetCDF, a leading '/' is tolerated
+	checkNetCDF(nc_inq_varid(v->nc_id, v->name[0] == '/' ? v->name + 1 : v->name, &v->nc_var), v);
+	checkNetCDF(nc_inq_vartype(v->nc_id, v->nc_var, &type), v);
+	if (type == NC_CHAR || type == NC_STRING){
+		printf("ERROR: Variable %s is not numeric\n", v->name);
+		exit(-1);
+	}
+	checkNetCDF(nc_inq_varndims(v->nc_id, v->nc_var, &v->rank), v);
+	if (v->rank < 1 || v->rank > CONTAINER_MAX_RANK){
+		printf("ERROR: Variable %s has %d dimensions\n", v->name, v->rank);
+		exit(-1);
+	}
+	checkNetCDF(nc_inq_vardimid(v->nc_id, v->nc_var, dim_ids), v);
+	for (d = 0; d < v->rank; d++){
+		checkNetCDF(nc_inq_dimlen(v->nc_id, dim_ids[d], &v->extent[d]), v);
+	}
+
+	// Classic files have no chunks and report contiguous storage
+	v->chunk = 0;
+	if (nc_inq_var_chunking(v->nc_id, v->nc_var, &storage, chunk) == NC_NOERR && storage == NC_CHUNKED){
+		v->chunk = chunk[0];
+	}
+}
+
+/*
+ * Function: readNetCDF
+ * -------------------------------------------------------------------------------
+ * Reads rows [row, row + rows) of the slowest axis of the selection into
+ * data, converting to float.
+ * -------------------------------------------------------------------------------
+ */
+static void readNetCDF(struct container_variable *v, size_t row, size_t rows, float *data){
+	size_t start[CONTAINER_MAX_RANK], count[CONTAINER_MAX_RANK];
+
+	memcpy(start, v->start, sizeof(size_t) * v->rank);
+	memcpy(count, v->count, sizeof(size_t) * v->rank);
+	start[0] = row;
+	count[0] = rows;
+	checkNetCDF(nc_get_vara_float(v->nc_id, v->nc_var, start, count, data), v);
+}
+#endif
+
+/*
+ * Function: openVariable
+ * -------------------------------------------------------------------------------
+ * Opens the variable named by a container path and parses its hyperslab.
+ * -------------------------------------------------------------------------------
+ */
+static void openVariable(const char *spec, struct container_variable *v){
+	int colon = splitSpec(spec, &v->format);
+
+	snprintf(v->file, sizeof(v->file), "%.*s", colon, spec);
+	snprintf(v->name, sizeof(v->name), "%s", spec + colon + 1);
+	v->slab[0] = '\0';
+	char *bracket = strchr(v->name, '[');
+	if (bracket != NULL){
+		char *close = strrchr(bracket, ']');
+		if (close == NULL || close[1] != '\0'){
+			printf("ERROR: Unterminated hyperslab in %s\n", spec);
+			exit(-1);
+		}
+		*close = '\0';
+		snprintf(v->slab, sizeof(v->slab), "%s", bracket + 1);
+		*bracket = '\0';
+	}
+
+	if (v->format == FORMAT_HDF5){
+#ifdef CARTS_HDF5
+		openHDF5(v);
+#else
+		printf("ERROR: %s: built without HDF5 support (HDF5=true in the Makefile)\n", v->file);
+		exit(-1);
+#endif
+	} else {
+#ifdef CARTS_NETCDF
+		openNetCDF(v);
+#else
+		printf("ERROR: %s: built without NetCDF support (NETCDF=true in the Makefile)\n", v->file);
+		exit(-1);
+#endif
+	}
+	parseSlab(v);
+}
+
+/*
+ * Function: readRows
+ * -------------------------------------------------------------------------------
+ * Reads rows [row, row + rows) of the slowest axis with the file's library.
+ * -------------------------------------------------------------------------------
+ */
+static void readRows(struct container_variable *v, size_t row, size_t rows, float *data){
+#ifdef CARTS_HDF5
+	if (v->format == FORMAT_HDF5){
+		readHDF5(v, row, rows, data);
+	}
+#endif
+#ifdef CARTS_NETCDF
+	if (v->format == FORMAT_NETCDF){
+		readNetCDF(v, row, rows, data);
+	}
+#endif
+}
+
+static void closeVariable(struct container_variable *v){
+#ifdef CARTS_HDF5
+	if (v->format == FORMAT_HDF5){
+		H5Dclose(v->h5_dataset);
+		H5Fclose(v->h5_file);
+	}
+#endif
+#ifdef CARTS_NETCDF
+	if (v->format == FORMAT_NETCDF){
+		nc_close(v->nc_id);
+	}
+#endif
+}
+
+/*
+ * Function: containerDims
+ * -------------------------------------------------------------------------------
+ * Reads the dims of a container selection, dropped axes left out.
+ *
+ * dims: receives the dims, dims[0] fastest varying like -d
+ *
+ * returns: the number of dims, exits if the file cannot be read
+ * -------------------------------------------------------------------------------
+ */
+int containerDims(const char *spec, size_t *dims){
+	struct container_variable *v = calloc(1, sizeof(struct container_variable));
+	int num_dims = 0;
+	int d;
+
+	openVariable(spec, v);
+	for (d = v->rank - 1; d >= 0; d--){
+		if (v->dropped[d]){
+			continue;
+		}
+		if (num_dims == METRICS_MAX_DIMS){
+			printf("ERROR: %s selects more than %d dimensions\n", spec, METRICS_MAX_DIMS);
+			exit(-1);
+		}
+		dims[num_dims++] = v->count[d];
+	}
+	// Every axis was a single index
+	if (num_dims == 0){
+		dims[num_dims++] = 1;
+	}
+	closeVariable(v);
+	free(v);
+	return num_dims;
+}
+
+/*
+ * Function: containerRead
+ * -------------------------------------------------------------------------------
+ * Reads a container selection of num_elements values into data, one
+ * chunk-aligned slab of the slowest axis at a time.
+ * -------------------------------------------------------------------------------
+ */
+void containerRead(const char *spec, float *data, size_t num_elements){
+	struct container_variable *v = calloc(1, sizeof(struct container_variable));
+	size_t row_elements = 1;
+	int d;
+
+	openVariable(spec, v);
+	for (d = 1; d < v->rank; d++){
+		row_elements *= v->count[d];
+	}
+	if (row_elements * v->count[0] != num_elements){
+		printf("ERROR: %s selects %zu values, the given dimensions hold %zu\n", spec, row_elements * v->count[0], num_elements);
+		exit(-1);
+	}
+
+	size_t step = v->chunk;
+	if (step == 0){
+		step = CONTAINER_SLAB_BYTES / (sizeof(float) * row_elements);
+		step = step ? step : 1;
+	}
+	size_t row = v->start[0];
+	size_t end = v->start[0] + v->count[0];
+	while (row < end){
+		size_t next = (row / step + 1) * step;
+		next = next < end ? next : end;
+		readRows(v, row, next - row, data + (row - v->start[0]) * row_elements);
+		row = next;
+	}
+	closeVariable(v);
+	free(v);
+}
+
+/*
+ * Function: containerWrite
+ * -------------------------------------------------------------------------------
+ * Writes a field as a float32 dataset of an HDF5 file, creating the file
+ * if needed and replacing a dataset of the same name.
+ *
+ * dims: the field dims, dims[0] fastest varying
+ * -------------------------------------------------------------------------------
+ */
+void containerWrite(const char *path, const char *name, size_t const *dims, int num_dims, const float *data){
+#ifdef CARTS_HDF5
+	hsize_t extent[METRICS_MAX_DIMS];
+	int d;
+
+	hid_t file = access(path, F_OK) == 0 ? H5Fopen(path, H5F_ACC_RDWR, H5P_DEFAULT) : H5Fcreate(path, H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+	if (file < 0){
+		printf("ERROR: Could not open HDF5 file %s for writing\n", path);
+		exit(-1);
+	}
+	if (H5Lexists(file, name, H5P_DEFAULT) > 0){
+		H5Ldelete(file, name, H5P_DEFAULT);
+	}
+	for (d = 0; d < num_dims; d++){
+		extent[d] = dims[num_dims - 1 - d];
+	}
+	hid_t space = H5Screate_simple(num_dims, extent, NULL);
+	hid_t dataset = H5Dcreate2(file, name, H5T_IEEE_F32LE, space, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+	if (dataset < 0 || H5Dwrite(dataset, H5T_NATIVE_FLOAT, H5S_ALL, H5S_ALL, H5P_DEFAULT, data) < 0){
+		printf("ERROR: Could not write %s to %s\n", name, path);
+		exit(-1);
+	}
+	H5Dclose(dataset);
+	H5Sclose(space);
+	H5Fclose(file);
+#else
+	printf("ERROR: %s: built without HDF5 support (HDF5=true in the Makefile)\n", path);
+	exit(-1);
+#endif
+}
@@ -0,0 +1,39 @@
+#ifndef CONTAINER_H
+#define CONTAINER_H
+
+#include <stddef.h>
+
+/*
+ * HDF5 and NetCDF fields.
+ * -------------------------------------------------------------------------------
+ * A data path naming a variable inside a container is read directly,
+ * without extracting it to a raw .bin first:
+ *
+ *   data/hurricane.h5:/TCf48               whole HDF5 dataset
+ *   data/hurricane.h5:/TCf48[10:20,:,100:300]
+ *   data/cesm.nc:TS[5,:,:]                NetCDF variable, one time step
+ *
+ * The optional hyperslab has one entry per axis, slowest first: start:end
+ * (end exclusive, either may be left out) or a single index, which drops
+ * that axis. Dims come from the file, so -d, manifest dims and experiment
+ * dims may be left out. Values of any integer or float type are converted
+ * to float by the library as they are read straight into the arena input,
+ * one slab of the slowest axis at a time, cut at the variable's chunk
+ * boundaries so no chunk is decompressed twice.
+ *
+ * HDF5 is built in with HDF5=true in the Makefile (-DCARTS_HDF5), NetCDF
+ * with NETCDF=true (-DCARTS_NETCDF). Decompressed (corrupted) outputs can
+ * be written back as HDF5 datasets with containerWrite.
+ * -------------------------------------------------------------------------------
+ */
+
+// Largest slab read at once from an unchunked variable
+#define CONTAINER_SLAB_BYTES (64UL << 20)
+
+int containerIsSpec(const char *path);
+void containerName(const char *spec, char *name, size_t size);
+int containerDims(const char *spec, size_t *dims);
+void containerRead(const char *spec, float *data, size_t num_elements);
+void containerWrite(const char *path, const char *name, size_t const *dims, int num_dims, const float *data);
+
+#endif
@@ -0,0 +1,237 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <signal.h>
+#include <unistd.h>
+#include <link.h>
+#include <execinfo.h>
+#include <sys/resource.h>
+
+#include "crash.h"
+
+// Signals that end a trial with a crash line
+static const int CRASH_SIGNALS[] = { SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT };
+
+struct crash_module {
+	uintptr_t base;
+	uintptr_t start;
+	uintptr_t end;
+	char name[256];
+};
+
+// Everything the handler touches is allocated up front
+static struct crash_module MODULES[CRASH_MAX_MODULES];
+static int NUM_MODULES = 0;
+static char EXE_PATH[256];
+static char CRASH_LINE[CRASH_MAX_FRAMES * 300];
+static char ALT_STACK[65536];
+
+/*
+ * Function: addModule
+ * -------------------------------------------------------------------------------
+ * dl_iterate_phdr callback recording the address range of one module.
+ * -------------------------------------------------------------------------------
+ */
+static int addModule(struct dl_phdr_info *info, size_t size, void *data){
+	struct crash_module *m;
+	uintptr_t start = UINTPTR_MAX, end = 0;
+	int i;
+	(void)size;
+	(void)data;
+
+	if (NUM_MODULES == CRASH_MAX_MODULES){
+		return 1;
+	}
+	for (i = 0; i < info->dlpi_phnum; i++){
+		const ElfW(Phdr) *ph = &info->dlpi_phdr[i];
+		if (ph->p_type != PT_LOAD){
+			continue;
+		}
+		if (info->dlpi_addr + ph->p_vaddr < start){
+			start = info->dlpi_addr + ph->p_vaddr;
+		}
+		if (info->dlpi_addr + ph->p_vaddr + ph->p_memsz > end){
+			end = info->dlpi_addr + ph->p_vaddr + ph->p_memsz;
+		}
+	}
+	if (start >= end){
+		return 0;
+	}
+
+	m = &MODULES[NUM_MODULES++];
+	m->base = info->dlpi_addr;
+	m->start = start;
+	m->end = end;
+	// The executable is reported without a name
+	snprintf(m->name, sizeof(m->name), "%s", info->dlpi_name && info->dlpi_name[0] ? info->dlpi_name : EXE_PATH);
+	return 0;
+}
+
+/*
+ * Function: crashRefreshModules
+ * -------------------------------------------------------------------------------
+ * Re-reads the loaded modules. Call again after libraries are dlopen'ed, such
+ * as compressor plugins loaded by libpressio.
+ * -------------------------------------------------------------------------------
+ */
+void crashRefreshModules(void){
+	NUM_MODULES = 0;
+	dl_iterate_phdr(addModule, NULL);
+}
+
+/*
+ * Function: appendText
+ * -------------------------------------------------------------------------------
+ * Async-signal-safe string append, truncating at the end of CRASH_LINE.
+ * -------------------------------------------------------------------------------
+ */
+static size_t appendText(size_t used, const char *text){
+	while (*text && used + 1 < sizeof(CRASH_LINE)){
+		CRASH_LINE[used++] = *text++;
+	}
+	return used;
+}
+
+/*
+ * Function: appendHex
+ * -------------------------------------------------------------------------------
+ * Async-signal-safe "0x..." append.
+ * -------------------------------------------------------------------------------
+ */
+static size_t appendHex(size_t used, uintptr_t value){
+	char digits[2 + sizeof(uintptr_t) * 2 + 1];
+	int n = sizeof(digits) - 1;
+
+	digits[n] = '\0';
+	do {
+		digits[--n] = "0123456789abcdef"[value & 0xf];
+		value >>= 4;
+	} while (value);
+	digits[--n] = 'x';
+	digits[--n] = '0';
+	return appendText(used, digits + n);
+}
+
+/*
+ * Function: crashHandler
+ * -------------------------------------------------------------------------------
+ * Writes the crash line and ends the process with the signal number as its
+ * exit status, like the original handler. Only async-signal-safe calls are
+ * made: backtrace() was primed in crashPrepare so it no longer allocates.
+ * -------------------------------------------------------------------------------
+ */
+static void crashHandler(int sig){
+	void *frames[CRASH_MAX_FRAMES];
+	size_t used = 0;
+	int nptrs, i, j;
+	char number[4] = { 0 };
+
+	number[0] = '0' + (sig / 10) % 10;
+	number[1] = '0' + sig % 10;
+	used = appendText(used, "Receiving Sig ");
+	used = appendText(used, sig >= 10 ? number : number + 1);
+	used = appendText(used, ": ");
+
+	nptrs = backtrace(frames, CRASH_MAX_FRAMES);
+	// Frame 0 is this handler
+	for (i = 1; i < nptrs; i++){
+		uintptr_t addr = (uintptr_t)frames[i];
+		const struct crash_module *m = NULL;
+		for (j = 0; j < NUM_MODULES; j++){
+			if (addr >= MODULES[j].start && addr < MODULES[j].end){
+				m = &MODULES[j];
+				break;
+			}
+		}
+		if (i > 1){
+			used = appendText(used, " <- ");
+		}
+		if (m){
+			used = appendText(used, m->name);
+			used = appendText(used, "(+");
+			used = appendHex(used, addr - m->base);
+		} else {
+			used = appendText(used, "/unknown(");
+			used = appendHex(used, addr);
+		}
+		used = appendText(used, ")");
+	}
+	used = appendText(used, "\n");
+
+	size_t written = 0;
+	while (written < used){
+		ssize_t n = write(STDOUT_FILENO, CRASH_LINE + written, used - written);
+		if (n <= 0){
+			break;
+		}
+		written += n;
+	}
+	_exit(sig);
+}
+
+/*
+ * Function: crashPrepare
+ * -------------------------------------------------------------------------------
+ * Records the loaded modules and does the handler's one-time setup, without
+ * installing it. Hosts that keep their own handlers (Python) call this once
+ * and crashInstall only in the trial children they fork.
+ * -------------------------------------------------------------------------------
+ */
+void crashPrepare(void){
+	void *prime[1];
+
+	// The first backtrace() loads libgcc, which must not happen in the handler
+	backtrace(prime, 1);
+
+	ssize_t n = readlink("/proc/self/exe", EXE_PATH, sizeof(EXE_PATH) - 1);
+	EXE_PATH[n > 0 ? n : 0] = '\0';
+	crashRefreshModules();
+}
+
+/*
+ * Function: crashInstall
+ * -------------------------------------------------------------------------------
+ * Disables core dumps and installs the crash handler on an alternate stack
+ * so stack overflows are caught too. crashPrepare must have run first.
+ * -------------------------------------------------------------------------------
+ */
+void crashInstall(void){
+	struct rlimit no_core = { 0, 0 };
+	struct sigaction action;
+	stack_t stack;
+	size_t i;
+
+	if (setrlimit(RLIMIT_CORE, &no_core) != 0){
+		perror("WARNING: ");
+	}
+
+	stack.ss_sp = ALT_STACK;
+	stack.ss_size = sizeof(ALT_STACK);
+	stack.ss_flags = 0;
+	if (sigaltstack(&stack, NULL) != 0){
+		perror("WARNING: ");
+	}
+
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = crashHandler;
+	action.sa_flags = SA_ONSTACK | SA_RESETHAND;
+	sigemptyset(&action.sa_mask);
+	for (i = 0; i < sizeof(CRASH_SIGNALS) / sizeof(CRASH_SIGNALS[0]); i++){
+		if (sigaction(CRASH_SIGNALS[i], &action, NULL) != 0){
+			printf("Error setting segfault handler...\n");
+		}
+	}
+}
+
+/*
+ * Function: crashInit
+ * -------------------------------------------------------------------------------
+ * Prepares and installs the crash handler for the whole process.
+ * -------------------------------------------------------------------------------
+ */
+void crashInit(void){
+	crashPrepare();
+	crashInstall();
+}
@@ -0,0 +1,33 @@
+#ifndef CRASH_H
+#define CRASH_H
+
+/*
+ * Crash capture.
+ * -------------------------------------------------------------------------------
+ * Records where a trial crashed without leaving async-signal-safe code. The
+ * handler takes the raw return addresses with backtrace(), maps each one to
+ * the module it belongs to and writes a single line straight to stdout:
+ *
+ *   Receiving Sig 11: /path/to/module(+0x1234) <- /path/to/libSZ.so(+0x5678)
+ *
+ * Offsets are relative to the module's load address, ready for
+ * crash_buckets.py to symbolize offline. Core dumps are disabled, crashes
+ * are counted from this line instead.
+ *
+ * The command line tools install the handler for the whole process. The
+ * Python module only prepares it and has each trial child install it (see
+ * campaign_options.crash_handler), leaving the interpreter's own alone.
+ * -------------------------------------------------------------------------------
+ */
+
+// Most return addresses recorded per crash
+#define CRASH_MAX_FRAMES 64
+// Most loaded modules tracked
+#define CRASH_MAX_MODULES 256
+
+void crashInit(void);
+void crashPrepare(void);
+void crashInstall(void);
+void crashRefreshModules(void);
+
+#endif
@@ -0,0 +1,127 @@
+import csv
+import hashlib
+import os
+import re
+import subprocess
+import sys
+
+# Symbolizes the crash tracebacks of comp_inj results offline and buckets
+# crashes by the compressor code location they happened in.
+#
+# comp_inj records each crash as raw "/module(+offset)" frames. Every unique
+# (module, offset) is symbolized once with a single addr2line call per module.
+# A crash's signature is the first frame outside of comp_inj, libc and
+# libpressio (normally an SZ or ZFP function), so the same fault site gets the
+# same CrashID across runs, trials and result files.
+#
+# Usage: python3 crash_buckets.py buckets.csv results.csv [results.csv ...]
+# Writes buckets.csv (one row per crash site) and buckets_trials.csv (the
+# CrashID of every crashed trial).
+
+FRAME = re.compile(r"(/[^()]*)\(\+?(0x[0-9a-fA-F]+)\)")
+
+# Modules that only ever show up around the fault, never as its cause
+HARNESS_MODULES = ("comp_inj", "libc.so", "libc-", "libpressio", "liblibpressio", "ld-linux", "libpthread", "linux-vdso", "unknown")
+
+
+def parse_frames(traceback):
+	return [(module, int(offset, 16)) for module, offset in FRAME.findall(traceback)]
+
+
+def symbolize(frames):
+	# Return addresses point after the call, step back into it
+	by_module = {}
+	for module, offset in frames:
+		by_module.setdefault(module, set()).add(offset)
+
+	symbols = {}
+	for module, offsets in by_module.items():
+		offsets = sorted(offsets)
+		if not os.path.exists(module):
+			for offset in offsets:
+				symbols[(module, offset)] = ("??", "??:0")
+			continue
+		command = ["addr2line", "-f", "-C", "-e", module] + [hex(max(offset - 1, 0)) for offset in offsets]
+		try:
+			lines = subprocess.run(command, stdout=subprocess.PIPE, universal_newlines=True).stdout.splitlines()
+		except OSError as e:
+			print("addr2line failed: {}".format(e))
+			lines = []
+		for i, offset in enumerate(offsets):
+			if 2 * i + 1 < len(lines):
+				symbols[(module, offset)] = (lines[2 * i], lines[2 * i + 1])
+			else:
+				symbols[(module, offset)] = ("??", "??:0")
+	return symbols
+
+
+def crash_site(stack):
+	for module, offset in stack:
+		name = os.path.basename(module)
+		if not any(name.startswith(harness) for harness in HARNESS_MODULES):
+			return module, offset
+	# No compressor frame, use the frame right after the signal trampoline
+	return stack[1] if len(stack) > 1 else stack[0]
+
+
+def signature(module, offset, symbols):
+	function, location = symbols[(module, offset)]
+	if function == "??" or location.startswith("??"):
+		key = "{}:{:#x}".format(os.path.basename(module), offset)
+	else:
+		# Drop discriminators such as "(discriminator 2)"
+		key = "{}:{}:{}".format(os.path.basename(module), function, location.split(" ")[0])
+	return "C" + hashlib.sha1(key.encode()).hexdigest()[:10]
+
+
+def main():
+	if len(sys.argv) < 3:
+		print("Usage: python3 crash_buckets.py buckets.csv results.csv [results.csv ...]")
+		exit(-1)
+
+	buckets_file = sys.argv[1]
+	trials = []
+	stacks = {}
+	for results_file in sys.argv[2:]:
+		with open(results_file) as results:
+			for row in csv.DictReader(results):
+				stack = tuple(parse_frames(row.get("Traceback", "")))
+				if not stack:
+					continue
+				trials.append((row["ByteLocation"], row["FlipLocation"], row["Status"], stack))
+				stacks.setdefault(stack, 0)
+				stacks[stack] += 1
+
+	print("{} crashed trials, {} unique stacks".format(len(trials), len(stacks)))
+	symbols = symbolize({frame for stack in stacks for frame in stack})
+
+	buckets = {}
+	stack_ids = {}
+	for stack, count in stacks.items():
+		module, offset = crash_site(stack)
+		crash_id = signature(module, offset, symbols)
+		stack_ids[stack] = crash_id
+		if crash_id not in buckets:
+			function, location = symbols[(module, offset)]
+			symbolized = " <- ".join("{} {}".format(*symbols[frame]) for frame in stack)
+			buckets[crash_id] = {"count": 0, "module": os.path.basename(module), "function": function, "location": location, "stack": symbolized}
+		buckets[crash_id]["count"] += count
+
+	with open(buckets_file, "w", newline="") as out:
+		writer = csv.writer(out)
+		writer.writerow(["CrashID", "Count", "Module", "Function", "Location", "Stack"])
+		for crash_id, bucket in sorted(buckets.items(), key=lambda item: -item[1]["count"]):
+			writer.writerow([crash_id, bucket["count"], bucket["module"], bucket["function"], bucket["location"], bucket["stack"]])
+
+	trials_file = os.path.splitext(buckets_file)[0] + "_trials.csv"
+	with open(trials_file, "w", newline="") as out:
+		writer = csv.writer(out)
+		writer.writerow(["ByteLocation", "FlipLocation", "Status", "CrashID"])
+		for byte, bit, status, stack in trials:
+			writer.writerow([byte, bit, status, stack_ids[stack]])
+
+	print("{} crash sites written to {}".format(len(buckets), buckets_file))
+
+
+if __name__ == '__main__':
+	main()
@@ -0,0 +1,205 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+
+#include "energy.h"
+
+#define POWERCAP_PATH "/sys/class/powercap"
+
+struct energy_domain {
+	char energy_path[512];
+	int dram;
+	uint64_t max_range;
+};
+
+static struct energy_domain DOMAINS[ENERGY_MAX_DOMAINS];
+static int NUM_DOMAINS = -1;
+
+/*
+ * Function: readCounter
+ * -------------------------------------------------------------------------------
+ * returns: 1 and the value of a sysfs counter, 0 if it cannot be read
+ * -------------------------------------------------------------------------------
+ */
+static int readCounter(const char *path, uint64_t *value){
+	FILE *fp = fopen(path, "r");
+	unsigned long long v;
+	if (fp == NULL){
+		return 0;
+	}
+	int ok = fscanf(fp, "%llu", &v) == 1;
+	fclose(fp);
+	*value = v;
+	return ok;
+}
+
+/*
+ * Function: energyInit
+ * -------------------------------------------------------------------------------
+ * Finds the readable package and DRAM domains. Package domains are the
+ * top level zones (intel-rapl:N); of their subzones only "dram" is kept,
+ * core and uncore are already part of the package.
+ *
+ * returns: the number of domains, 0 when energy cannot be measured
+ * -------------------------------------------------------------------------------
+ */
+int energyInit(void){
+	DIR *dir;
+	struct dirent *entry;
+
+	if (NUM_DOMAINS >= 0){
+		return NUM_DOMAINS;
+	}
+	NUM_DOMAINS = 0;
+	dir = opendir(POWERCAP_PATH);
+	if (dir == NULL){
+		return 0;
+	}
+	while ((entry = readdir(dir)) != NULL && NUM_DOMAINS < ENERGY_MAX_DOMAINS){
+		char path[512], name[64] = "";
+		uint64_t value;
+		// Zones are <control type>:<package>[:<subzone>]. intel-rapl-mmio
+		// zones report the same package energy again and are skipped.
+		char *colon = strchr(entry->d_name, ':');
+		if (colon == NULL || strncmp(entry->d_name, "intel-rapl:", 11) != 0){
+			continue;
+		}
+		int subzone = strchr(colon + 1, ':') != NULL;
+
+		snprintf(path, sizeof(path), "%s/%s/name", POWERCAP_PATH, entry->d_name);
+		FILE *fp = fopen(path, "r");
+		if (fp == NULL){
+			continue;
+		}
+		if (fscanf(fp, "%63s", name) != 1){
+			name[0] = '\0';
+		}
+		fclose(fp);
+		if (subzone && strcmp(name, "dram") != 0){
+			continue;
+		}
+
+		struct energy_domain *d = &DOMAINS[NUM_DOMAINS];
+		snprintf(d->energy_path, sizeof(d->energy_path), "%s/%s/energy_uj", POWERCAP_PATH, entry->d_name);
+		snprintf(path, sizeof(path), "%s/%s/max_energy_range_uj", POWERCAP_PATH, entry->d_name);
+		if (!readCounter(d->energy_path, &value) || !readCounter(path, &d->max_range)){
+			continue;
+		}
+		d->dram = strcmp(name, "dram") == 0;
+		NUM_DOMAINS++;
+	}
+	closedir(dir);
+	return NUM_DOMAINS;
+}
+
+/*
+ * Function: energySample
+ * -------------------------------------------------------------------------------
+ * Reads every counter and the time.
+ * -------------------------------------------------------------------------------
+ */
+void energySample(struct energy_sample *sample){
+	int i;
+	for (i = 0; i < NUM_DOMAINS; i++){
+		if (!readCounter(DOMAINS[i].energy_path, &sample->uj[i])){
+			sample->uj[i] = 0;
+		}
+	}
+	gettimeofday(&sample->time, NULL);
+}
+
+/*
+ * Function: energyDelta
+ * -------------------------------------------------------------------------------
+ * Joules used between two samples, summed over packages and over DRAM.
+ * A counter that went backwards wrapped once at its max_energy_range_uj.
+ * -------------------------------------------------------------------------------
+ */
+void energyDelta(const struct energy_sample *start, const struct energy_sample *stop, double *package_joules, double *dram_joules){
+	int i;
+	*package_joules = 0;
+	*dram_joules = 0;
+	for (i = 0; i < NUM_DOMAINS; i++){
+		uint64_t delta;
+		if (stop->uj[i] >= start->uj[i]){
+			delta = stop->uj[i] - start->uj[i];
+		} else {
+			delta = DOMAINS[i].max_range - start->uj[i] + stop->uj[i];
+		}
+		if (DOMAINS[i].dram){
+			*dram_joules += delta / 1e6;
+		} else {
+			*package_joules += delta / 1e6;
+		}
+	}
+}
+
+/*
+ * Function: finishMeasurement
+ * -------------------------------------------------------------------------------
+ * Turns the totals of a repeated operation into per-run figures.
+ * -------------------------------------------------------------------------------
+ */
+static void finishMeasurement(const struct energy_sample *start, const struct energy_sample *stop, int runs, struct energy_measurement *m){
+	energyDelta(start, stop, &m->package_joules, &m->dram_joules);
+	m->runs = runs;
+	m->seconds = elapsedSeconds(&start->time, &stop->time) / runs;
+	m->package_joules /= runs;
+	m->dram_joules /= runs;
+}
+
+/*
+ * Function: energyCompress
+ * -------------------------------------------------------------------------------
+ * Compresses the field repeatedly for at least ENERGY_MIN_SECONDS.
+ * -------------------------------------------------------------------------------
+ */
+void energyCompress(struct injector *inj, struct energy_measurement *m){
+	struct energy_sample start, stop;
+	int runs = 0;
+
+	energySample(&start);
+	do {
+		injectorCompress(inj);
+		runs++;
+		gettimeofday(&stop.time, NULL);
+	} while (elapsedSeconds(&start.time, &stop.time) < ENERGY_MIN_SECONDS);
+	energySample(&stop);
+	finishMeasurement(&start, &stop, runs, m);
+}
+
+/*
+ * Function: energyDecompress
+ * -------------------------------------------------------------------------------
+ * Decompresses the clean stream repeatedly for at least ENERGY_MIN_SECONDS.
+ * -------------------------------------------------------------------------------
+ */
+void energyDecompress(struct injector *inj, struct energy_measurement *m){
+	struct energy_sample start, stop;
+	double decompress_time;
+	int runs = 0;
+
+	energySample(&start);
+	do {
+		injectorTrial(inj, -1, 0, 0, &decompress_time);
+		runs++;
+		gettimeofday(&stop.time, NULL);
+	} while (elapsedSeconds(&start.time, &stop.time) < ENERGY_MIN_SECONDS);
+	energySample(&stop);
+	finishMeasurement(&start, &stop, runs, m);
+}
+
+/*
+ * Function: energyPrint
+ * -------------------------------------------------------------------------------
+ * Prints the energy of one operation and its cost per GB of field.
+ * -------------------------------------------------------------------------------
+ */
+void energyPrint(const char *operation, const struct energy_measurement *m, size_t bytes){
+	double gb = bytes / 1e9;
+	printf("%s Energy Runs: %d\n", operation, m->runs);
+	printf("%s Package Energy: %lf\n", operation, m->package_joules);
+	printf("%s DRAM Energy: %lf\n", operation, m->dram_joules);
+	printf("%s Energy per GB: %lf\n", operation, (m->package_joules + m->dram_joules) / gb);
+}
@@ -0,0 +1,52 @@
+#ifndef ENERGY_H
+#define ENERGY_H
+
+#include <stdint.h>
+#include <sys/time.h>
+
+#include "injector.h"
+
+/*
+ * Energy accounting with RAPL.
+ * -------------------------------------------------------------------------------
+ * Reads the package and DRAM energy counters the kernel exposes under
+ * /sys/class/powercap (intel-rapl, also used for AMD packages). Counters are
+ * cumulative microjoules that wrap at max_energy_range_uj; a wrap between
+ * two samples is unwrapped with that range. RAPL only updates about once a
+ * millisecond, so an operation is repeated until ENERGY_MIN_SECONDS have
+ * passed and the energy is divided over the runs.
+ *
+ * The counters cover the whole package, not just this process: measure on
+ * an otherwise idle node. Most systems only let root read energy_uj; when
+ * no counter can be read, energyInit returns 0 and callers skip energy.
+ * -------------------------------------------------------------------------------
+ */
+
+// Most RAPL domains read
+#define ENERGY_MAX_DOMAINS 32
+// Shortest measurement, in seconds, before energy is reported
+#define ENERGY_MIN_SECONDS 0.5
+
+struct energy_sample {
+	uint64_t uj[ENERGY_MAX_DOMAINS];
+	struct timeval time;
+};
+
+/*
+ * Energy of one operation, averaged over its repeats.
+ */
+struct energy_measurement {
+	int runs;
+	double seconds;
+	double package_joules;
+	double dram_joules;
+};
+
+int energyInit(void);
+void energySample(struct energy_sample *sample);
+void energyDelta(const struct energy_sample *start, const struct energy_sample *stop, double *package_joules, double *dram_joules);
+void energyCompress(struct injector *inj, struct energy_measurement *m);
+void energyDecompress(struct injector *inj, struct energy_measurement *m);
+void energyPrint(const char *operation, const struct energy_measurement *m, size_t bytes);
+
+#endif
@@ -0,0 +1,562 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "experiment.h"
+#include "arena.h"
+#include "container.h"
+#include "injector.h"
+#include "campaign.h"
+#include "crash.h"
+#include "json.h"
+
+struct experiment_dataset {
+	// Names the results files, never holds a '/'
+	char name[1024];
+	const char *path;
+	size_t dims[METRICS_MAX_DIMS];
+	int num_dims;
+};
+
+// One compressor, mode and bound
+struct experiment_setting {
+	const char *compressor;
+	const char *mode;
+	float bound;
+	float default_bound;
+};
+
+enum stage_kind { STAGE_LOAD, STAGE_COMPRESS, STAGE_BASELINE };
+
+/*
+ * A node of the experiment DAG and its cached output.
+ */
+struct stage {
+	enum stage_kind kind;
+	int dataset;
+	int setting;
+	int deps[2];
+	int num_deps;
+	// Stages and campaigns still to run that need this one
+	int consumers;
+	// Nonzero while something depending on it runs, never evicted then
+	int pins;
+
+	int resident;
+	size_t bytes;
+	long last_use;
+	int runs;
+
+	struct buffer_arena *arena;
+	unsigned char *stream;
+	size_t stream_size;
+	double compression_ratio;
+	double compress_time;
+	float *baseline;
+};
+
+struct stage_cache {
+	struct stage *stages;
+	int count;
+	size_t used;
+	size_t peak;
+	size_t limit;
+	long clock;
+	int evictions;
+	int over_limit;
+	int threads;
+	const struct experiment_dataset *datasets;
+	const struct experiment_setting *settings;
+};
+
+static const char *STAGE_NAMES[] = { "Load", "Compress", "Baseline" };
+
+/*
+ * Function: requireMember
+ * -------------------------------------------------------------------------------
+ * returns: a member of the manifest that must be there, exits when it is not
+ * -------------------------------------------------------------------------------
+ */
+static const struct json_value *requireMember(const struct json_value *object, const char *key, enum json_type type){
+	const struct json_value *v = jsonGet(object, key);
+	if (v == NULL || v->type != type){
+		printf("ERROR: Experiment manifest needs \"%s\"\n", key);
+		exit(-1);
+	}
+	return v;
+}
+
+/*
+ * Function: freeStage
+ * -------------------------------------------------------------------------------
+ * Drops a stage's output from the cache.
+ * -------------------------------------------------------------------------------
+ */
+static void freeStage(struct stage_cache *c, struct stage *st){
+	if (!st->resident){
+		return;
+	}
+	if (st->kind == STAGE_LOAD){
+		arenaFree(st->arena);
+		st->arena = NULL;
+	} else if (st->kind == STAGE_COMPRESS){
+		free(st->stream);
+		st->stream = NULL;
+	} else {
+		free(st->baseline);
+		st->baseline = NULL;
+	}
+	c->used -= st->bytes;
+	st->resident = 0;
+}
+
+/*
+ * Function: reserve
+ * -------------------------------------------------------------------------------
+ * Evicts the least recently used idle stages until bytes more fit under
+ * the memory limit. Pinned stages are kept even if that means going over.
+ * -------------------------------------------------------------------------------
+ */
+static void reserve(struct stage_cache *c, size_t bytes){
+	while (c->used + bytes > c->limit){
+		struct stage *victim = NULL;
+		int i;
+		for (i = 0; i < c->count; i++){
+			struct stage *st = &c->stages[i];
+			if (st->resident && st->pins == 0 && (victim == NULL || st->last_use < victim->last_use)){
+				victim = st;
+			}
+		}
+		if (victim == NULL){
+			if (!c->over_limit){
+				printf("WARNING: Experiment cache over its memory limit, every cached stage is in use\n");
+			}
+			c->over_limit = 1;
+			return;
+		}
+		printf("Stage Evict: %s %s\n", STAGE_NAMES[victim->kind], c->datasets[victim->dataset].name);
+		freeStage(c, victim);
+		c->evictions++;
+	}
+}
+
+/*
+ * Function: stageInjector
+ * -------------------------------------------------------------------------------
+ * returns: an injector for a stage's setting on the stage's loaded dataset
+ * -------------------------------------------------------------------------------
+ */
+static struct injector *stageInjector(struct stage_cache *c, const struct stage *st, struct buffer_arena *arena){
+	const struct experiment_setting *set = &c->settings[st->setting];
+	struct injector *inj = injectorCreate(set->compressor, set->mode, set->bound, arena);
+	crashRefreshModules();
+	if (c->threads > 1){
+		injectorSetThreads(inj, c->threads);
+	}
+	return inj;
+}
+
+/*
+ * Function: ensureStage
+ * -------------------------------------------------------------------------------
+ * Makes a stage's output resident, computing it and its dependencies if
+ * they are not cached.
+ * -------------------------------------------------------------------------------
+ */
+static void ensureStage(struct stage_cache *c, int index){
+	struct stage *st = &c->stages[index];
+	const struct experiment_dataset *ds = &c->datasets[st->dataset];
+	size_t field_bytes = sizeof(float);
+	int d;
+
+	st->last_use = ++c->clock;
+	if (st->resident){
+		return;
+	}
+	// Each dependency stays pinned until this stage is computed
+	for (d = 0; d < st->num_deps; d++){
+		ensureStage(c, st->deps[d]);
+		c->stages[st->deps[d]].pins++;
+	}
+	for (d = 0; d < ds->num_dims; d++){
+		field_bytes *= ds->dims[d];
+	}
+
+	if (st->kind == STAGE_LOAD){
+		// Input plus the shared output mapping
+		reserve(c, 2 * field_bytes);
+		st->arena = arenaCreate(ds->dims, ds->num_dims);
+		arenaLoad(st->arena, ds->path);
+		st->bytes = 2 * field_bytes;
+	} else if (st->kind == STAGE_COMPRESS){
+		struct buffer_arena *arena = c->stages[st->deps[0]].arena;
+		// Streams are at most about the size of the field
+		reserve(c, field_bytes);
+		struct injector *inj = stageInjector(c, st, arena);
+		injectorCompress(inj);
+		const unsigned char *stream = injectorStream(inj, &st->stream_size);
+		st->stream = malloc(st->stream_size);
+		if (st->stream == NULL){
+			printf("ERROR: could not allocate %zu bytes\n", st->stream_size);
+			exit(-1);
+		}
+		memcpy(st->stream, stream, st->stream_size);
+		st->compression_ratio = inj->compression_ratio;
+		st->compress_time = inj->compress_time;
+		st->bytes = st->stream_size;
+		arenaDetach(arena);
+		injectorFree(inj);
+	} else {
+		struct buffer_arena *arena = c->stages[st->deps[0]].arena;
+		struct stage *compressed = &c->stages[st->deps[1]];
+		reserve(c, field_bytes);
+		struct injector *inj = stageInjector(c, st, arena);
+		arenaAttach(arena, compressed->stream, compressed->stream_size, NULL);
+		injectorBaseline(inj);
+		st->baseline = arena->baseline;
+		st->bytes = field_bytes;
+		arenaDetach(arena);
+		injectorFree(inj);
+	}
+	st->resident = 1;
+	st->runs++;
+	c->used += st->bytes;
+	if (c->used > c->peak){
+		c->peak = c->used;
+	}
+	printf("Stage %s: %s", STAGE_NAMES[st->kind], ds->name);
+	if (st->kind != STAGE_LOAD){
+		printf(" %s %s %g", c->settings[st->setting].compressor, c->settings[st->setting].mode, c->settings[st->setting].bound);
+	}
+	printf("%s\n", st->runs > 1 ? " (recomputed)" : "");
+
+	for (d = 0; d < st->num_deps; d++){
+		c->stages[st->deps[d]].pins--;
+	}
+}
+
+/*
+ * Function: releaseStage
+ * -------------------------------------------------------------------------------
+ * Called when one consumer of a stage is done; frees it after the last.
+ * -------------------------------------------------------------------------------
+ */
+static void releaseStage(struct stage_cache *c, int index){
+	struct stage *st = &c->stages[index];
+	st->consumers--;
+	if (st->consumers <= 0 && st->pins == 0){
+		freeStage(c, st);
+	}
+}
+
+/*
+ * Function: datasetName
+ * -------------------------------------------------------------------------------
+ * Names a dataset in its results files: the manifest's "name", else the
+ * field file without its directory and extension (data/x/hurricane_1.bin
+ * becomes hurricane_1) or containerName of a selection. Exits on a given
+ * name with a '/', which would point the results outside results_dir.
+ * -------------------------------------------------------------------------------
+ */
+static void datasetName(const char *path, const char *given, char *name, size_t size){
+	if (given != NULL){
+		if (given[0] == '\0' || strchr(given, '/') != NULL){
+			printf("ERROR: Dataset name \"%s\" must be non-empty and without '/'\n", given);
+			exit(-1);
+		}
+		snprintf(name, size, "%s", given);
+		return;
+	}
+	if (containerIsSpec(path)){
+		containerName(path, name, size);
+		return;
+	}
+	const char *file = strrchr(path, '/');
+	file = file ? file + 1 : path;
+	const char *ext = strrchr(file, '.');
+	int len = ext && ext != file ? (int)(ext - file) : (int)strlen(file);
+	snprintf(name, size, "%.*s", len, file);
+}
+
+/*
+ * Function: makeDirectory
+ * -------------------------------------------------------------------------------
+ * Creates a directory and any missing parents.
+ * -------------------------------------------------------------------------------
+ */
+static void makeDirectory(const char *path){
+	char partial[4096];
+	size_t i;
+
+	snprintf(partial, sizeof(partial), "%s", path);
+	for (i = 1; partial[i]; i++){
+		if (partial[i] == '/'){
+			partial[i] = '\0';
+			mkdir(partial, 0755);
+			partial[i] = '/';
+		}
+	}
+	if (mkdir(partial, 0755) != 0 && errno != EEXIST){
+		perror("ERROR: ");
+		exit(-1);
+	}
+}
+
+/*
+ * Function: copyManifest
+ * -------------------------------------------------------------------------------
+ * Keeps the manifest next to the results it produced.
+ * -------------------------------------------------------------------------------
+ */
+static void copyManifest(const char *manifest_path, const char *results_dir){
+	char path[4096], buf[65536];
+	size_t n;
+
+	snprintf(path, sizeof(path), "%s/manifest.json", results_dir);
+	FILE *in = fopen(manifest_path, "rb");
+	FILE *out = fopen(path, "wb");
+	if (in == NULL || out == NULL){
+		perror("WARNING: ");
+	} else {
+		while ((n = fread(buf, 1, sizeof(buf), in)) > 0){
+			fwrite(buf, 1, n, out);
+		}
+	}
+	if (in){
+		fclose(in);
+	}
+	if (out){
+		fclose(out);
+	}
+}
+
+/*
+ * Function: runExperiment
+ * -------------------------------------------------------------------------------
+ * Builds the stage DAG of a manifest and runs every cell, dataset by dataset,
+ * so each loaded field and compressed stream is reused while it is cached.
+ * -------------------------------------------------------------------------------
+ */
+void runExperiment(const char *manifest_path){
+	struct json_value *manifest = jsonParseFile(manifest_path);
+	const struct json_value *dataset_list = requireMember(manifest, "datasets", JSON_ARRAY);
+	const struct json_value *compressor_list = requireMember(manifest, "compressors", JSON_ARRAY);
+	const struct json_value *ranges = jsonGet(manifest, "ranges");
+	const struct json_value *settings_json = jsonGet(manifest, "campaign");
+	const char *results_dir = jsonString(manifest, "results", NULL);
+	size_t i, j, k;
+	int d, s;
+
+	if (results_dir == NULL){
+		printf("ERROR: Experiment manifest needs \"results\"\n");
+		exit(-1);
+	}
+
+	int num_datasets = (int)dataset_list->count;
+	struct experiment_dataset *datasets = calloc(num_datasets, sizeof(struct experiment_dataset));
+	for (d = 0; d < num_datasets; d++){
+		const struct json_value *entry = &dataset_list->items[d];
+		datasets[d].path = requireMember(entry, "path", JSON_STRING)->string;
+		datasetName(datasets[d].path, jsonString(entry, "name", NULL), datasets[d].name, sizeof(datasets[d].name));
+		// Containers and generated fields know their own dims
+		if (jsonGet(entry, "dims") == NULL && (datasets[d].num_dims = arenaFieldDims(datasets[d].path, datasets[d].dims)) > 0){
+			continue;
+		}
+		const struct json_value *dims = requireMember(entry, "dims", JSON_ARRAY);
+		for (i = 0; i < dims->count && i < METRICS_MAX_DIMS; i++){
+			datasets[d].dims[i] = (size_t)dims->items[i].number;
+		}
+		datasets[d].num_dims = (int)i;
+	}
+
+	// Every bound of every compressor entry is its own setting
+	int num_settings = 0;
+	for (i = 0; i < compressor_list->count; i++){
+		num_settings += (int)requireMember(&compressor_list->items[i], "bounds", JSON_ARRAY)->count;
+	}
+	struct experiment_setting *settings = calloc(num_settings, sizeof(struct experiment_setting));
+	s = 0;
+	for (i = 0; i < compressor_list->count; i++){
+		const struct json_value *entry = &compressor_list->items[i];
+		const struct json_value *bounds = jsonGet(entry, "bounds");
+		for (j = 0; j < bounds->count; j++, s++){
+			settings[s].compressor = requireMember(entry, "compressor", JSON_STRING)->string;
+			settings[s].mode = requireMember(entry, "mode", JSON_STRING)->string;
+			settings[s].bound = (float)bounds->items[j].number;
+			settings[s].default_bound = (float)jsonNumber(entry, "default_bound", -1);
+		}
+	}
+
+	int num_ranges = ranges && ranges->type == JSON_ARRAY && ranges->count ? (int)ranges->count : 1;
+	int *range_start = malloc(sizeof(int) * num_ranges);
+	int *range_end = malloc(sizeof(int) * num_ranges);
+	for (k = 0; k < (size_t)num_ranges; k++){
+		range_start[k] = 0;
+		range_end[k] = INT_MAX;
+		if (ranges && ranges->type == JSON_ARRAY && ranges->count){
+			const struct json_value *r = &ranges->items[k];
+			if (r->type != JSON_ARRAY || r->count != 2 || r->items[0].number < 0 || r->items[1].number < r->items[0].number){
+				printf("ERROR: Experiment ranges must be [start, end] pairs\n");
+				exit(-1);
+			}
+			range_start[k] = (int)r->items[0].number;
+			range_end[k] = r->items[1].number < INT_MAX ? (int)r->items[1].number : INT_MAX;
+		}
+	}
+
+	struct campaign_options base = {0};
+	base.timeout_limit = (int)jsonNumber(settings_json, "timeout", 30);
+	base.memory_limit_mb = (int)jsonNumber(settings_json, "trial_memory_mb", 0);
+	base.workers = (int)jsonNumber(settings_json, "workers", 1);
+	base.compressor_threads = (int)jsonNumber(settings_json, "threads", 1);
+	base.propagation = (int)jsonNumber(settings_json, "propagation", 0);
+	base.block_edge = (int)jsonNumber(settings_json, "block_edge", 0);
+	base.sketch = (int)jsonNumber(settings_json, "sketch", 0);
+	base.group_size = (int)jsonNumber(settings_json, "group_size", 0);
+	base.group_within_bound = (int)jsonNumber(settings_json, "group_within_bound", 0);
+	base.classify_only = (int)jsonNumber(settings_json, "classify_only", 0);
+	base.quality_selected = parseQualityMetrics(jsonString(settings_json, "quality", ""));
+	base.telemetry_path = jsonString(settings_json, "telemetry", NULL);
+	base.telemetry_interval = (int)jsonNumber(settings_json, "telemetry_interval", 10);
+	if (base.telemetry_interval < 1){
+		base.telemetry_interval = 1;
+	}
+	int needs_baseline = campaignNeedsBaseline(&base);
+
+	// Stages: loads, then compressions, then baselines, indexed by dataset and setting
+	struct stage_cache cache = {0};
+	cache.count = num_datasets + 2 * num_datasets * num_settings;
+	cache.stages = calloc(cache.count, sizeof(struct stage));
+	cache.datasets = datasets;
+	cache.settings = settings;
+	cache.threads = base.compressor_threads;
+	double limit_mb = jsonNumber(manifest, "memory_limit_mb", 0);
+	if (limit_mb > 0){
+		cache.limit = (size_t)(limit_mb * 1024 * 1024);
+	} else {
+		cache.limit = (size_t)sysconf(_SC_PHYS_PAGES) * (size_t)sysconf(_SC_PAGESIZE) / 2;
+	}
+	for (d = 0; d < num_datasets; d++){
+		int load = d;
+		cache.stages[load].kind = STAGE_LOAD;
+		cache.stages[load].dataset = d;
+		for (s = 0; s < num_settings; s++){
+			int compress = num_datasets + d * num_settings + s;
+			int baseline = compress + num_datasets * num_settings;
+			struct stage *cs = &cache.stages[compress];
+			struct stage *bs = &cache.stages[baseline];
+			cs->kind = STAGE_COMPRESS;
+			cs->dataset = d;
+			cs->setting = s;
+			cs->deps[0] = load;
+			cs->num_deps = 1;
+			cache.stages[load].consumers += 1 + num_ranges;
+			cs->consumers += num_ranges;
+			if (needs_baseline){
+				bs->kind = STAGE_BASELINE;
+				bs->dataset = d;
+				bs->setting = s;
+				bs->deps[0] = load;
+				bs->deps[1] = compress;
+				bs->num_deps = 2;
+				bs->consumers = num_ranges;
+				cache.stages[load].consumers++;
+				cs->consumers++;
+			}
+		}
+	}
+
+	makeDirectory(results_dir);
+	copyManifest(manifest_path, results_dir);
+	int cells = num_datasets * num_settings * num_ranges;
+	printf("Experiment: %s\n", manifest_path);
+	printf("Experiment Cells: %d (%d datasets, %d settings, %d ranges)\n", cells, num_datasets, num_settings, num_ranges);
+	printf("Experiment Memory Limit: %zu MB\n", cache.limit / (1024 * 1024));
+
+	for (d = 0; d < num_datasets; d++){
+		for (s = 0; s < num_settings; s++){
+			int load = d;
+			int compress = num_datasets + d * num_settings + s;
+			int baseline = compress + num_datasets * num_settings;
+			for (k = 0; k < (size_t)num_ranges; k++){
+				const struct experiment_setting *set = &settings[s];
+
+				ensureStage(&cache, load);
+				cache.stages[load].pins++;
+				ensureStage(&cache, compress);
+				cache.stages[compress].pins++;
+				if (needs_baseline){
+					ensureStage(&cache, baseline);
+					cache.stages[baseline].pins++;
+				}
+				struct stage *cs = &cache.stages[compress];
+				struct buffer_arena *arena = cache.stages[load].arena;
+
+				struct injector *inj = stageInjector(&cache, cs, arena);
+				arenaAttach(arena, cs->stream, cs->stream_size, needs_baseline ? cache.stages[baseline].baseline : NULL);
+				inj->compression_ratio = cs->compression_ratio;
+				inj->compressed_size = cs->stream_size;
+				inj->compress_time = cs->compress_time;
+
+				char results_path[4096];
+				struct campaign_options opts = base;
+				opts.compressor = set->compressor;
+				opts.error_bounding_mode = set->mode;
+				opts.error_bound = set->bound;
+				opts.default_bound = set->default_bound;
+				opts.start_byte = range_start[k];
+				opts.end_byte = range_end[k] < (int)cs->stream_size ? range_end[k] : (int)cs->stream_size - 1;
+				if (opts.block_edge <= 0){
+					opts.block_edge = strcmp(set->compressor, "zfp") == 0 ? 4 : 6;
+				}
+				snprintf(results_path, sizeof(results_path), "%s/%s_%s_%s_%g_%d_%d.csv", results_dir, datasets[d].name, set->compressor, set->mode, set->bound, opts.start_byte, opts.end_byte);
+				opts.results_path = results_path;
+				remove(results_path);
+
+				printf("Experiment Cell: %s %s %s %g bytes %d to %d\n", datasets[d].name, set->compressor, set->mode, set->bound, opts.start_byte, opts.end_byte);
+				if (opts.start_byte <= opts.end_byte){
+					runCampaign(inj, &opts);
+				} else {
+					printf("WARNING: Range starts past the %zu byte stream, skipped\n", cs->stream_size);
+				}
+
+				arenaDetach(arena);
+				injectorFree(inj);
+				cache.stages[load].pins--;
+				cache.stages[compress].pins--;
+				releaseStage(&cache, load);
+				releaseStage(&cache, compress);
+				if (needs_baseline){
+					cache.stages[baseline].pins--;
+					releaseStage(&cache, baseline);
+				}
+			}
+			// The compression consumed its load
+			releaseStage(&cache, load);
+			if (needs_baseline){
+				releaseStage(&cache, load);
+				releaseStage(&cache, compress);
+			}
+		}
+	}
+
+	int runs = 0, distinct = 0;
+	for (i = 0; i < (size_t)cache.count; i++){
+		runs += cache.stages[i].runs;
+		distinct += cache.stages[i].runs > 0;
+		freeStage(&cache, &cache.stages[i]);
+	}
+	printf("Experiment Stages Run: %d (%d distinct, %d evictions)\n", runs, distinct, cache.evictions);
+	printf("Experiment Peak Cache: %zu MB\n", cache.peak / (1024 * 1024));
+
+	free(cache.stages);
+	free(range_start);
+	free(range_end);
+	free(settings);
+	free(datasets);
+	jsonFree(manifest);
+}
@@ -0,0 +1,40 @@
+#ifndef EXPERIMENT_H
+#define EXPERIMENT_H
+
+/*
+ * Experiment manifests.
+ * -------------------------------------------------------------------------------
+ * Runs a whole study grid (dataset x compressor x mode x bound x byte range)
+ * from one JSON file instead of one positional command line per cell:
+ *
+ *   {
+ *     "results": "results/hurricane_sweep",
+ *     "memory_limit_mb": 8192,
+ *     "campaign": { "timeout": 30, "trial_memory_mb": 4096, "workers": 16, "threads": 1,
+ *                   "propagation": 1, "sketch": 1, "quality": "ssim,ulp", "group_size": 64,
+ *                   "classify_only": 0 },
+ *     "datasets": [ { "name": "hurricane", "path": "data/Hurricane/hurricane_1_500_500.bin",
+ *                     "dims": [500, 500, 100] } ],
+ *     "compressors": [ { "compressor": "sz", "mode": "ABS", "bounds": [1e-2, 1e-3] },
+ *                      { "compressor": "zfp", "mode": "Accuracy", "bounds": [1e-3] } ],
+ *     "ranges": [ [0, 4999], [5000, 9999] ]
+ *   }
+ *
+ * Cells are executed as a DAG of stages: load (per dataset), compress (per
+ * dataset and compressor setting) and baseline decompress (per compressed
+ * stream, only with propagation, group testing or classify_only), feeding one campaign per
+ * byte range. Each stage runs once and its output is shared by every cell that needs it. A
+ * stage is freed when nothing left needs it; when the cache would exceed
+ * memory_limit_mb (default half the machine), the least recently used idle
+ * stage is evicted and recomputed if needed again.
+ *
+ * Every cell writes results/<dataset>_<compressor>_<mode>_<bound>_<start>_<end>.csv
+ * and a copy of the manifest is kept next to them. A dataset without a
+ * "name" is named after its file, without the directory and extension.
+ * Ranges default to the whole stream and are clamped to its size.
+ * -------------------------------------------------------------------------------
+ */
+
+void runExperiment(const char *manifest_path);
+
+#endif
@@ -0,0 +1,544 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+/*
+ * Synthetic fields.
+ * -------------------------------------------------------------------------------
+ * Writes headerless float32 or float64 fields of any size and up to five
+ * dimensions, so campaign cost can be measured against field size,
+ * dimensionality and smoothness without hunting for more data:
+ *
+ *   smooth   product of low frequency sines plus a few Gaussian bumps
+ *   grf      Gaussian random field with power spectrum P(k) ~ k^-alpha
+ *            (-a, default 3; larger is smoother), synthesized from -M
+ *            random Fourier modes with unit variance
+ *   noise    white noise, uniform in [-1, 1]
+ *
+ * -N adds white noise of that amplitude to any kind, -n turns that fraction
+ * of the points into NaN and -z that fraction of 32^d blocks into constant
+ * regions holding the -F value (default 0).
+ *
+ * Usage: gen_field -o out.bin -d "dims" [-k smooth|grf|noise] [-t float32|float64]
+ *                  [-s seed] [-a alpha] [-M modes] [-N noise] [-n nan] [-z constant]
+ *                  [-F fill] [-j threads]
+ *
+ * Dims are given as for comp_inj -d, fastest first. Every value depends only
+ * on the seed and its position, so the output is the same for any thread
+ * count. The field is generated and written one slab of the slowest axes at
+ * a time, the threads splitting each slab by rows, so fields larger than
+ * memory are fine.
+ *
+ * Next to the output, out.bin.dims records the dims, the value type and the
+ * command line; comp_inj, batches and experiments read their dims from it
+ * when none are given.
+ * -------------------------------------------------------------------------------
+ */
+
+#define GEN_MAX_DIMS 5
+// Bytes generated and written at once
+#define GEN_CHUNK_BYTES (64UL << 20)
+// Edge of the blocks -z turns constant
+#define GEN_BLOCK_EDGE 32
+// Gaussian bumps of the smooth kind
+#define GEN_BUMPS 3
+
+// Independent streams of the counter based generator
+#define SALT_NOISE 0x6e6f697365ULL
+#define SALT_NAN 0x6e616eULL
+#define SALT_CONSTANT 0x636f6e7374ULL
+
+enum field_kind { KIND_SMOOTH, KIND_GRF, KIND_NOISE };
+
+/*
+ * Everything the workers need to produce any row of the field. The
+ * smooth and grf kinds are sums of separable terms, so each term is kept as
+ * one table per axis and a value is a product of table entries.
+ */
+struct field_spec {
+	size_t dims[GEN_MAX_DIMS];
+	int num_dims;
+	enum field_kind kind;
+	uint64_t seed;
+	double noise;
+	double nan_fraction;
+	double constant_fraction;
+	double fill;
+
+	// Terms of the separable sum, table[d][term * dims[d] + x]
+	int terms;
+	double *re[GEN_MAX_DIMS];
+	double *im[GEN_MAX_DIMS];
+	double *weight;
+};
+
+/*
+ * One slab of rows and the part of it a worker fills.
+ */
+struct slab_job {
+	const struct field_spec *spec;
+	size_t first_row;
+	size_t num_rows;
+	int is_double;
+	void *out;
+	double min, max, sum;
+	size_t finite;
+};
+
+static void *xmalloc(size_t size){
+	void *ptr = malloc(size);
+	if (ptr == NULL){
+		printf("ERROR: could not allocate %zu bytes\n", size);
+		exit(-1);
+	}
+	return ptr;
+}
+
+/*
+ * Function: mix
+ * -------------------------------------------------------------------------------
+ * splitmix64 finalizer, the counter based generator behind every random
+ * value here.
+ * -------------------------------------------------------------------------------
+ */
+static inline uint64_t mix(uint64_t x){
+	x += 0x9e3779b97f4a7c15ULL;
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+	return x ^ (x >> 31);
+}
+
+/*
+ * Function: uniform
+ * -------------------------------------------------------------------------------
+ * returns: a value in [0, 1) determined by the seed, stream and counter
+ * -------------------------------------------------------------------------------
+ */
+static inline double uniform(uint64_t seed, uint64_t stream, uint64_t counter){
+	return (mix(mix(seed ^ stream) + counter) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/*
+ * Function: gaussian
+ * -------------------------------------------------------------------------------
+ * returns: a standard normal value (Box-Muller) for the counter
+ * -------------------------------------------------------------------------------
+ */
+static double gaussian(uint64_t seed, uint64_t stream, uint64_t counter){
+	double u = uniform(seed, stream, 2 * counter);
+	double v = uniform(seed, stream, 2 * counter + 1);
+	return sqrt(-2.0 * log(1.0 - u)) * cos(2.0 * M_PI * v);
+}
+
+static void allocTables(struct field_spec *spec, int terms){
+	int d;
+	spec->terms = terms;
+	spec->weight = xmalloc(sizeof(double) * terms);
+	for (d = 0; d < spec->num_dims; d++){
+		spec->re[d] = xmalloc(sizeof(double) * terms * spec->dims[d]);
+		spec->im[d] = xmalloc(sizeof(double) * terms * spec->dims[d]);
+	}
+}
+
+/*
+ * Function: setupSmooth
+ * -------------------------------------------------------------------------------
+ * Term 0 is prod_d sin(pi f_d x_d + phi_d) with f_d in 1..4 periods over
+ * the axis, the other terms are Gaussian bumps exp(-(x_d - c_d)^2 / 2s^2)
+ * of half amplitude. Coordinates are scaled to [0, 1] on every axis.
+ * Only the real tables are used.
+ * -------------------------------------------------------------------------------
+ */
+static void setupSmooth(struct field_spec *spec){
+	uint64_t counter = 0;
+	int d, t;
+	size_t x;
+
+	allocTables(spec, 1 + GEN_BUMPS);
+	spec->weight[0] = 1.0;
+	for (t = 1; t <= GEN_BUMPS; t++){
+		spec->weight[t] = 0.5;
+	}
+	for (d = 0; d < spec->num_dims; d++){
+		size_t n = spec->dims[d];
+		double scale = n > 1 ? 1.0 / (n - 1) : 0.0;
+		double periods = 1 + (int)(4 * uniform(spec->seed, d, counter++));
+		double phase = 2.0 * M_PI * uniform(spec->seed, d, counter++);
+		for (x = 0; x < n; x++){
+			spec->re[d][x] = sin(M_PI * periods * x * scale + phase);
+			spec->im[d][x] = 0.0;
+		}
+		for (t = 1; t <= GEN_BUMPS; t++){
+			double center = 0.2 + 0.6 * uniform(spec->seed, d, counter++);
+			double width = 0.05 + 0.15 * uniform(spec->seed, d, counter++);
+			for (x = 0; x < n; x++){
+				double u = (x * scale - center) / width;
+				spec->re[d][t * n + x] = exp(-0.5 * u * u);
+				spec->im[d][t * n + x] = 0.0;
+			}
+		}
+	}
+}
+
+/*
+ * Function: setupGrf
+ * -------------------------------------------------------------------------------
+ * Random Fourier modes a_m cos(k_m . x + phi_m). |k| is drawn log-uniform
+ * between one period over the longest axis and the grid Nyquist frequency,
+ * in a uniform random direction, so a_m^2 ~ P(|k|) |k|^d with
+ * P(k) = k^-alpha. exp(i k.x) = prod_d exp(i k_d x_d), so each mode is
+ * one complex table per axis with the phase folded into axis 0.
+ * -------------------------------------------------------------------------------
+ */
+static void setupGrf(struct field_spec *spec, int modes, double alpha){
+	size_t longest = 1, x;
+	double variance = 0.0;
+	int d, m;
+
+	allocTables(spec, modes);
+	for (d = 0; d < spec->num_dims; d++){
+		if (spec->dims[d] > longest){
+			longest = spec->dims[d];
+		}
+	}
+	double k_min = 1.0, k_max = longest / 2.0 > 1.0 ? longest / 2.0 : 1.0;
+	for (m = 0; m < modes; m++){
+		double direction[GEN_MAX_DIMS], norm = 0.0;
+		for (d = 0; d < spec->num_dims; d++){
+			direction[d] = gaussian(spec->seed, 1, (uint64_t)m * GEN_MAX_DIMS + d);
+			norm += direction[d] * direction[d];
+		}
+		norm = norm > 0.0 ? sqrt(norm) : 1.0;
+		double k = k_min * pow(k_max / k_min, uniform(spec->seed, 2, m));
+		double phase = 2.0 * M_PI * uniform(spec->seed, 3, m);
+		spec->weight[m] = sqrt(pow(k, spec->num_dims - alpha));
+		variance += 0.5 * spec->weight[m] * spec->weight[m];
+
+		for (d = 0; d < spec->num_dims; d++){
+			size_t n = spec->dims[d];
+			double wave = 2.0 * M_PI * k * direction[d] / norm / longest;
+			for (x = 0; x < n; x++){
+				double angle = wave * x + (d == 0 ? phase : 0.0);
+				spec->re[d][m * n + x] = cos(angle);
+				spec->im[d][m * n + x] = sin(angle);
+			}
+		}
+	}
+	for (m = 0; m < modes; m++){
+		spec->weight[m] /= sqrt(variance);
+	}
+}
+
+/*
+ * Function: fillRow
+ * -------------------------------------------------------------------------------
+ * Computes one row (all of axis 0) of the field into values.
+ *
+ * coords: coordinates of the row on axes 1 and up
+ * index: linear index of the row's first element
+ * -------------------------------------------------------------------------------
+ */
+static void fillRow(const struct field_spec *spec, const size_t *coords, size_t index, double *values){
+	size_t n = spec->dims[0], x;
+	int t, d;
+
+	if (spec->kind == KIND_NOISE){
+		for (x = 0; x < n; x++){
+			values[x] = 2.0 * uniform(spec->seed, SALT_NOISE, index + x) - 1.0;
+		}
+	} else {
+		memset(values, 0, sizeof(double) * n);
+		for (t = 0; t < spec->terms; t++){
+			// Product of the other axes' entries, then one pass along the row
+			double row_re = spec->weight[t], row_im = 0.0;
+			for (d = 1; d < spec->num_dims; d++){
+				size_t at = t * spec->dims[d] + coords[d];
+				double re = row_re * spec->re[d][at] - row_im * spec->im[d][at];
+				row_im = row_re * spec->im[d][at] + row_im * spec->re[d][at];
+				row_re = re;
+			}
+			const double *re0 = spec->re[0] + t * n;
+			const double *im0 = spec->im[0] + t * n;
+			for (x = 0; x < n; x++){
+				values[x] += row_re * re0[x] - row_im * im0[x];
+			}
+		}
+		if (spec->noise > 0.0){
+			for (x = 0; x < n; x++){
+				values[x] += spec->noise * (2.0 * uniform(spec->seed, SALT_NOISE, index + x) - 1.0);
+			}
+		}
+	}
+
+	if (spec->constant_fraction > 0.0){
+		// Blocks are numbered on the grid of GEN_BLOCK_EDGE blocks
+		uint64_t block_row = 0;
+		for (d = spec->num_dims - 1; d >= 1; d--){
+			block_row = block_row * ((spec->dims[d] + GEN_BLOCK_EDGE - 1) / GEN_BLOCK_EDGE) + coords[d] / GEN_BLOCK_EDGE;
+		}
+		size_t blocks_x = (n + GEN_BLOCK_EDGE - 1) / GEN_BLOCK_EDGE, b;
+		for (b = 0; b < blocks_x; b++){
+			if (uniform(spec->seed, SALT_CONSTANT, block_row * blocks_x + b) < spec->constant_fraction){
+				size_t end = (b + 1) * GEN_BLOCK_EDGE < n ? (b + 1) * GEN_BLOCK_EDGE : n;
+				for (x = b * GEN_BLOCK_EDGE; x < end; x++){
+					values[x] = spec->fill;
+				}
+			}
+		}
+	}
+	if (spec->nan_fraction > 0.0){
+		for (x = 0; x < n; x++){
+			if (uniform(spec->seed, SALT_NAN, index + x) < spec->nan_fraction){
+				values[x] = NAN;
+			}
+		}
+	}
+}
+
+/*
+ * Function: slabWorker
+ * -------------------------------------------------------------------------------
+ * Fills a run of rows of the current slab and keeps their statistics.
+ * -------------------------------------------------------------------------------
+ */
+static void *slabWorker(void *arg){
+	struct slab_job *job = arg;
+	const struct field_spec *spec = job->spec;
+	size_t n = spec->dims[0], r, x;
+	double *values = xmalloc(sizeof(double) * n);
+	size_t coords[GEN_MAX_DIMS] = {0};
+	int d;
+
+	job->min = INFINITY;
+	job->max = -INFINITY;
+	job->sum = 0.0;
+	job->finite = 0;
+	for (r = 0; r < job->num_rows; r++){
+		size_t row = job->first_row + r, rest = row;
+		for (d = 1; d < spec->num_dims; d++){
+			coords[d] = rest % spec->dims[d];
+			rest /= spec->dims[d];
+		}
+		fillRow(spec, coords, row * n, values);
+
+		for (x = 0; x < n; x++){
+			if (!isnan(values[x])){
+				job->min = values[x] < job->min ? values[x] : job->min;
+				job->max = values[x] > job->max ? values[x] : job->max;
+				job->sum += values[x];
+				job->finite++;
+			}
+		}
+		if (job->is_double){
+			memcpy((double *)job->out + r * n, values, sizeof(double) * n);
+		} else {
+			float *out = (float *)job->out + r * n;
+			for (x = 0; x < n; x++){
+				out[x] = (float)values[x];
+			}
+		}
+	}
+	free(values);
+	return NULL;
+}
+
+/*
+ * Function: writeSidecar
+ * -------------------------------------------------------------------------------
+ * Writes out_path.dims: the command line as a comment, the dims (fastest
+ * first, as given to -d) and the value type.
+ * -------------------------------------------------------------------------------
+ */
+static void writeSidecar(const char *out_path, const struct field_spec *spec, const char *type, int argc, char *argv[]){
+	char path[4096];
+	int i;
+	snprintf(path, sizeof(path), "%s.dims", out_path);
+	FILE *fp = fopen(path, "w");
+	if (fp == NULL){
+		perror("ERROR: ");
+		exit(-1);
+	}
+	fprintf(fp, "#");
+	for (i = 0; i < argc; i++){
+		fprintf(fp, strchr(argv[i], ' ') ? " \"%s\"" : " %s", argv[i]);
+	}
+	fprintf(fp, "\ndims");
+	for (i = 0; i < spec->num_dims; i++){
+		fprintf(fp, " %zu", spec->dims[i]);
+	}
+	fprintf(fp, "\ntype %s\n", type);
+	fclose(fp);
+}
+
+int main(int argc, char *argv[]){
+	struct field_spec spec = { .kind = KIND_GRF, .seed = 1 };
+	char *out_path = NULL, *dims_arg = NULL, *kind = "grf", *type = "float32";
+	long threads = sysconf(_SC_NPROCESSORS_ONLN);
+	double alpha = 3.0;
+	int modes = 128;
+	int option_index, i;
+
+	while ((option_index = getopt(argc, argv, "o:d:k:t:s:a:M:N:n:z:F:j:")) != -1){
+		switch (option_index){
+			case 'o':
+				out_path = optarg;
+				break;
+			case 'd':
+				dims_arg = optarg;
+				break;
+			case 'k':
+				kind = optarg;
+				break;
+			case 't':
+				type = optarg;
+				break;
+			case 's':
+				spec.seed = strtoull(optarg, NULL, 10);
+				break;
+			case 'a':
+				alpha = atof(optarg);
+				break;
+			case 'M':
+				modes = atoi(optarg);
+				break;
+			case 'N':
+				spec.noise = atof(optarg);
+				break;
+			case 'n':
+				spec.nan_fraction = atof(optarg);
+				break;
+			case 'z':
+				spec.constant_fraction = atof(optarg);
+				break;
+			case 'F':
+				spec.fill = atof(optarg);
+				break;
+			case 'j':
+				threads = atol(optarg);
+				break;
+			default:
+				printf("Options incorrect\n");
+				return 1;
+		}
+	}
+	if (out_path == NULL || dims_arg == NULL){
+		printf("Usage: gen_field -o out.bin -d \"dims\" [-k smooth|grf|noise] [-t float32|float64] [-s seed] [-a alpha] [-M modes] [-N noise] [-n nan] [-z constant] [-F fill] [-j threads]\n");
+		return 1;
+	}
+
+	char *dims_copy = strdup(dims_arg), *pt;
+	for (pt = strtok(dims_copy, " ,"); pt != NULL && spec.num_dims < GEN_MAX_DIMS; pt = strtok(NULL, " ,")){
+		spec.dims[spec.num_dims++] = (size_t)atol(pt);
+	}
+	free(dims_copy);
+	size_t num_elements = 1;
+	for (i = 0; i < spec.num_dims; i++){
+		num_elements *= spec.dims[i];
+	}
+	if (spec.num_dims == 0 || num_elements == 0){
+		printf("ERROR: Dims must be positive, fastest first (\"500 500 100\")\n");
+		return 1;
+	}
+	if (strcmp(kind, "smooth") == 0){
+		spec.kind = KIND_SMOOTH;
+		setupSmooth(&spec);
+	} else if (strcmp(kind, "grf") == 0){
+		if (modes < 1){
+			printf("ERROR: A random field needs at least one mode\n");
+			return 1;
+		}
+		spec.kind = KIND_GRF;
+		setupGrf(&spec, modes, alpha);
+	} else if (strcmp(kind, "noise") == 0){
+		spec.kind = KIND_NOISE;
+	} else {
+		printf("ERROR: Unknown field kind %s (smooth, grf or noise)\n", kind);
+		return 1;
+	}
+	int is_double = strcmp(type, "float64") == 0;
+	if (!is_double && strcmp(type, "float32") != 0){
+		printf("ERROR: Unknown value type %s (float32 or float64)\n", type);
+		return 1;
+	}
+	size_t value_size = is_double ? sizeof(double) : sizeof(float);
+
+	FILE *fp = fopen(out_path, "wb");
+	if (fp == NULL){
+		perror("ERROR: ");
+		return 1;
+	}
+	size_t row_bytes = spec.dims[0] * value_size;
+	size_t num_rows = num_elements / spec.dims[0];
+	size_t chunk_rows = GEN_CHUNK_BYTES / row_bytes > 0 ? GEN_CHUNK_BYTES / row_bytes : 1;
+	if (chunk_rows > num_rows){
+		chunk_rows = num_rows;
+	}
+	if (threads < 1){
+		threads = 1;
+	}
+	if ((size_t)threads > chunk_rows){
+		threads = chunk_rows;
+	}
+	void *chunk = xmalloc(chunk_rows * row_bytes);
+	struct slab_job *jobs = xmalloc(sizeof(struct slab_job) * threads);
+	pthread_t *workers = xmalloc(sizeof(pthread_t) * threads);
+	double min = INFINITY, max = -INFINITY, sum = 0.0;
+	size_t finite = 0, row;
+	struct timeval start, end;
+
+	gettimeofday(&start, NULL);
+	for (row = 0; row < num_rows; row += chunk_rows){
+		size_t rows = num_rows - row < chunk_rows ? num_rows - row : chunk_rows;
+		size_t per_worker = (rows + threads - 1) / threads, first = 0;
+		int started = 0;
+		for (i = 0; i < threads && first < rows; i++, first += per_worker){
+			jobs[i].spec = &spec;
+			jobs[i].first_row = row + first;
+			jobs[i].num_rows = rows - first < per_worker ? rows - first : per_worker;
+			jobs[i].is_double = is_double;
+			jobs[i].out = (char *)chunk + first * row_bytes;
+			pthread_create(&workers[i], NULL, slabWorker, &jobs[i]);
+			started++;
+		}
+		for (i = 0; i < started; i++){
+			pthread_join(workers[i], NULL);
+			min = jobs[i].min < min ? jobs[i].min : min;
+			max = jobs[i].max > max ? jobs[i].max : max;
+			sum += jobs[i].sum;
+			finite += jobs[i].finite;
+		}
+		if (fwrite(chunk, row_bytes, rows, fp) != rows){
+			perror("ERROR: ");
+			return 1;
+		}
+	}
+	if (fclose(fp) != 0){
+		perror("ERROR: ");
+		return 1;
+	}
+	gettimeofday(&end, NULL);
+	writeSidecar(out_path, &spec, type, argc, argv);
+
+	printf("Field: %s (%s, %s)\n", out_path, kind, type);
+	printf("Elements: %zu\n", num_elements);
+	printf("Value Range: %g %g\n", finite ? min : NAN, finite ? max : NAN);
+	printf("Mean: %g\n", finite ? sum / finite : NAN);
+	printf("NaN Values: %zu\n", num_elements - finite);
+	printf("Generation Time: %f\n", (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1e6);
+
+	free(workers);
+	free(jobs);
+	free(chunk);
+	for (i = 0; i < spec.num_dims && spec.terms; i++){
+		free(spec.re[i]);
+		free(spec.im[i]);
+	}
+	free(spec.weight);
+	return 0;
+}
@@ -0,0 +1,439 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/time.h>
+
+#include "libpressio.h"
+#include "sz.h"
+
+#include "injector.h"
+#include "trace.h"
+
+/*
+ * Function: elapsedSeconds
+ * -------------------------------------------------------------------------------
+ * returns: seconds between two gettimeofday readings
+ * -------------------------------------------------------------------------------
+ */
+double elapsedSeconds(const struct timeval *start, const struct timeval *stop){
+	return (double)(stop->tv_usec - start->tv_usec) / 1000000 + (double)(stop->tv_sec - start->tv_sec);
+}
+
+/*
+ * Function: injectorFail
+ * -------------------------------------------------------------------------------
+ * Keeps the message and code of a failed call on the injector.
+ * -------------------------------------------------------------------------------
+ */
+static void injectorFail(struct injector *inj, const char *message, int code){
+	snprintf(inj->error, sizeof(inj->error), "%s", message);
+	inj->error_code = code;
+}
+
+/*
+ * Function: injectorExit
+ * -------------------------------------------------------------------------------
+ * Prints the message of a failed call and exits with its code, like the
+ * original tool.
+ * -------------------------------------------------------------------------------
+ */
+static void injectorExit(struct injector *inj){
+	printf("%s\n", inj->error);
+	exit(inj->error_code);
+}
+
+/*
+ * Function: injectorTryCreate
+ * -------------------------------------------------------------------------------
+ * Configures the chosen compressor through libpressio.
+ *
+ * compressor_choice: Compressor to use (sz, zfp)
+ * error_bounding_mode: Error bound to use with compressor (sz=ABS,PSNR,PW_REL, zfp=Accuracy,Rate,Precision)
+ * error_bound: the value of the error bound
+ * arena: the buffers the compressor will work on
+ *
+ * returns: the injector; for invalid options inj->error holds the message
+ * and it can only be freed
+ * -------------------------------------------------------------------------------
+ */
+struct injector *injectorTryCreate(const char *compressor_choice, const char *error_bounding_mode, float error_bound, struct buffer_arena *arena){
+	struct injector *inj = calloc(1, sizeof(struct injector));
+	struct pressio_options *options;
+	if (inj == NULL){
+		printf("ERROR: could not allocate the injector\n");
+		exit(-1);
+	}
+	inj->arena = arena;
+	inj->lib = arena->lib;
+	inj->compressor_choice = compressor_choice;
+	inj->threads = 1;
+	inj->baseline_violates = -1;
+	inj->check = &inj->last_check;
+	inj->last_check.status = -1;
+
+	if (strcmp(compressor_choice, "sz") != 0 && strcmp(compressor_choice, "zfp") != 0){
+		injectorFail(inj, "Invalid Compressor...\nExiting", 1);
+		return inj;
+	}
+
+	// Initialize Pressio with the compressor
+	inj->library = inj->lib->instance();
+	inj->compressor = inj->lib->get_compressor(inj->library, compressor_choice);
+	// Set compression metric to print
+	const char* metrics[] = { "size" };
+	struct pressio_metrics* metrics_plugin = inj->lib->new_metrics(inj->library, metrics, 1);
+	inj->lib->compressor_set_metrics(inj->compressor, metrics_plugin);
+
+	// Set values for the compression operations
+	options = inj->lib->compressor_get_options(inj->compressor);
+	if (strcmp(compressor_choice, "sz") == 0){
+		if (strcmp(error_bounding_mode, "ABS") == 0){
+			inj->lib->options_set_integer(options, "sz:error_bound_mode", ABS);
+			inj->lib->options_set_double(options, "sz:abs_err_bound", error_bound);
+		} else if (strcmp(error_bounding_mode, "PW_REL") == 0){
+			inj->lib->options_set_integer(options, "sz:error_bound_mode", PW_REL);
+			inj->lib->options_set_double(options, "sz:pw_rel_err_bound", error_bound);
+		} else if (strcmp(error_bounding_mode, "PSNR") == 0){
+			inj->lib->options_set_integer(options, "sz:error_bound_mode", PSNR);
+			inj->lib->options_set_double(options, "sz:psnr_err_bound", error_bound);
+		} else {
+			injectorFail(inj, "Invalid Error Bounding Mode...\nExiting", 1);
+		}
+	} else {
+		if (strcmp(error_bounding_mode, "Accuracy") == 0){
+			inj->lib->options_set_double(options, "zfp:accuracy", error_bound);
+		} else if (strcmp(error_bounding_mode, "Rate") == 0){
+			inj->lib->options_set_uinteger(options, "zfp:type", (unsigned int)3);
+			inj->lib->options_set_uinteger(options, "zfp:dims", (unsigned int)arena->num_dims);
+			inj->lib->options_set_integer(options, "zfp:wra", 1);
+			inj->lib->options_set_double(options, "zfp:rate", (double)error_bound);
+		} else if (strcmp(error_bounding_mode, "Precision") == 0){
+			inj->lib->options_set_uinteger(options, "zfp:precision", error_bound);
+		} else {
+			injectorFail(inj, "Invalid Error Bounding Mode...\nExiting", 1);
+		}
+	}
+
+	// Check compression operation configurations
+	if (inj->error[0] == '\0' && (inj->lib->compressor_check_options(inj->compressor, options) || inj->lib->compressor_set_options(inj->compressor, options))) {
+		injectorFail(inj, inj->lib->compressor_error_msg(inj->compressor), inj->lib->compressor_error_code(inj->compressor));
+	}
+	inj->lib->options_free(options);
+	return inj;
+}
+
+/*
+ * Function: injectorCreate
+ * -------------------------------------------------------------------------------
+ * injectorTryCreate for the command line tools.
+ *
+ * returns: the injector, exits on invalid options like the original tool
+ * -------------------------------------------------------------------------------
+ */
+struct injector *injectorCreate(const char *compressor_choice, const char *error_bounding_mode, float error_bound, struct buffer_arena *arena){
+	struct injector *inj = injectorTryCreate(compressor_choice, error_bounding_mode, error_bound, arena);
+	if (inj->error[0] != '\0'){
+		injectorExit(inj);
+	}
+	return inj;
+}
+
+/*
+ * Function: injectorSetThreads
+ * -------------------------------------------------------------------------------
+ * Sets how many threads the compressor may use. ZFP switches to its OpenMP
+ * execution policy above one thread (compression only, ZFP decompresses
+ * serially on the CPU). Plugins that take the generic pressio:nthreads
+ * option get it as well; plugins that ignore it are left as they are. An
+ * OpenMP build of SZ gets it through its OpenMP runtime.
+ * -------------------------------------------------------------------------------
+ */
+void injectorSetThreads(struct injector *inj, int threads){
+	struct pressio_options *options = inj->lib->compressor_get_options(inj->compressor);
+
+	if (threads < 1){
+		threads = 1;
+	}
+	inj->lib->options_set_uinteger(options, "pressio:nthreads", (unsigned int)threads);
+	if (strcmp(inj->compressor_choice, "zfp") == 0){
+		inj->lib->options_set_string(options, "zfp:execution_name", threads > 1 ? "omp" : "serial");
+		inj->lib->options_set_uinteger(options, "zfp:omp_threads", (unsigned int)threads);
+	}
+	if (inj->lib->compressor_set_options(inj->compressor, options)) {
+		printf("WARNING: Compressor threads not set: %s\n", inj->lib->compressor_error_msg(inj->compressor));
+	} else {
+		inj->threads = threads;
+	}
+	inj->lib->options_free(options);
+	librarySetOpenMPThreads(inj->lib, threads);
+}
+
+/*
+ * Function: injectorTryCompress
+ * -------------------------------------------------------------------------------
+ * Compresses the arena input into the arena compressed stream and records
+ * the compression ratio, compressed size and time taken.
+ *
+ * returns: 0, or -1 with the compressor's message in inj->error
+ * -------------------------------------------------------------------------------
+ */
+int injectorTryCompress(struct injector *inj){
+	struct timeval c_start, c_stop;
+	int64_t span = traceBegin(TRACE_COMPRESS);
+
+	gettimeofday(&c_start, NULL);
+	if (inj->lib->compressor_compress(inj->compressor, inj->arena->input_view, inj->arena->compressed)) {
+		injectorFail(inj, inj->lib->compressor_error_msg(inj->compressor), inj->lib->compressor_error_code(inj->compressor));
+		traceEnd(TRACE_COMPRESS, span, 0, 0, -1);
+		return -1;
+	}
+	gettimeofday(&c_stop, NULL);
+	traceEnd(TRACE_COMPRESS, span, 0, 0, -1);
+	inj->compress_time = elapsedSeconds(&c_start, &c_stop);
+
+	inj->lib->data_ptr(inj->arena->compressed, &inj->compressed_size);
+	struct pressio_options* metric_results = inj->lib->compressor_get_metrics_results(inj->compressor);
+	inj->compression_ratio = 0;
+	if (inj->lib->options_get_double(metric_results, "size:compression_ratio", &inj->compression_ratio)) {
+		printf("Failed to get compression ratio\n");
+	}
+	inj->lib->options_free(metric_results);
+	return 0;
+}
+
+/*
+ * Function: injectorCompress
+ * -------------------------------------------------------------------------------
+ * injectorTryCompress that exits when the compressor fails.
+ * -------------------------------------------------------------------------------
+ */
+void injectorCompress(struct injector *inj){
+	if (injectorTryCompress(inj) != 0){
+		injectorExit(inj);
+	}
+}
+
+/*
+ * Function: injectorProtect
+ * -------------------------------------------------------------------------------
+ * Protects the compressed stream (see protect.h), replacing any earlier
+ * protection. Must follow the compression it protects.
+ *
+ * chunk_bytes: bytes per CRC32C
+ * header_bytes: bytes at the start of the stream under SECDED, 0 for none
+ * -------------------------------------------------------------------------------
+ */
+void injectorProtect(struct injector *inj, size_t chunk_bytes, size_t header_bytes){
+	size_t compressed_size;
+	const uint8_t *stream = injectorStream(inj, &compressed_size);
+
+	protectFree(inj->protection);
+	inj->protection = protectCreate(stream, compressed_size, chunk_bytes, header_bytes);
+}
+
+/*
+ * Function: injectorStream
+ * -------------------------------------------------------------------------------
+ * returns: the compressed stream, its size in compressed_size
+ * -------------------------------------------------------------------------------
+ */
+unsigned char *injectorStream(struct injector *inj, size_t *compressed_size){
+	return (unsigned char *)inj->lib->data_ptr(inj->arena->compressed, compressed_size);
+}
+
+/*
+ * Function: injectorTryBaseline
+ * -------------------------------------------------------------------------------
+ * Decompresses the fault-free stream into the arena baseline. Only the first
+ * call decompresses; the baseline is shared by every trial afterwards.
+ *
+ * returns: the baseline, or NULL with the compressor's message in inj->error
+ * -------------------------------------------------------------------------------
+ */
+const float *injectorTryBaseline(struct injector *inj){
+	struct buffer_arena *arena = inj->arena;
+	if (arena->baseline != NULL){
+		return arena->baseline;
+	}
+
+	int64_t span = traceBegin(TRACE_BASELINE);
+	float *baseline = arenaBaseline(arena);
+	struct pressio_data *view = inj->lib->data_new_nonowning(pressio_float_dtype, baseline, arena->num_dims, arena->dims);
+	if (inj->lib->compressor_decompress(inj->compressor, arena->compressed, view)) {
+		injectorFail(inj, inj->lib->compressor_error_msg(inj->compressor), inj->lib->compressor_error_code(inj->compressor));
+		inj->lib->data_free(view);
+		free(arena->baseline);
+		arena->baseline = NULL;
+		traceEnd(TRACE_BASELINE, span, 0, 0, -1);
+		return NULL;
+	}
+	// Plugins that replace the output buffer cost one copy, once per campaign
+	const float *decompressed = inj->lib->data_ptr(view, NULL);
+	if (decompressed != baseline){
+		memcpy(baseline, decompressed, sizeof(float) * arena->num_elements);
+	}
+	inj->lib->data_free(view);
+	traceEnd(TRACE_BASELINE, span, 0, 0, -1);
+	return baseline;
+}
+
+/*
+ * Function: injectorBaseline
+ * -------------------------------------------------------------------------------
+ * injectorTryBaseline that exits when the compressor fails.
+ *
+ * returns: the baseline
+ * -------------------------------------------------------------------------------
+ */
+const float *injectorBaseline(struct injector *inj){
+	const float *baseline = injectorTryBaseline(inj);
+	if (baseline == NULL){
+		injectorExit(inj);
+	}
+	return baseline;
+}
+
+/*
+ * Function: injectorTrial
+ * -------------------------------------------------------------------------------
+ * Runs one trial: flips a bit of the compressed stream, decompresses into the
+ * arena output and restores the bit so the stream is clean for the next
+ * trial.
+ *
+ * char_loc: The byte position in the compressed data to inject into.
+ * flip_loc: The bit of the chosen byte to flip.
+ * injection_active: 0 decompresses the clean stream
+ * decompress_time: set to the seconds spent decompressing
+ *
+ * returns: the decompressed output, read in place
+ * -------------------------------------------------------------------------------
+ */
+const float *injectorTrial(struct injector *inj, int char_loc, int flip_loc, int injection_active, double *decompress_time){
+	if (!injection_active || char_loc < 0){
+		return injectorGroupTrial(inj, 0, 0, decompress_time);
+	}
+	return injectorGroupTrial(inj, 8 * char_loc + flip_loc, 1, decompress_time);
+}
+
+/*
+ * Function: flipBits
+ * -------------------------------------------------------------------------------
+ * Flips the listed stream bits (byte * 8 + bit), or count consecutive ones
+ * starting at bit first when bits is NULL.
+ * -------------------------------------------------------------------------------
+ */
+static void flipBits(uint8_t *data, const int *bits, int first, int count){
+	int i;
+	for (i = 0; i < count; i++){
+		int b = bits ? bits[i] : first + i;
+		data[b / 8] ^= (uint8_t)(1 << (b % 8));
+	}
+}
+
+/*
+ * Function: flippedTrial
+ * -------------------------------------------------------------------------------
+ * Flips bits of the stream as flipBits does, verifies a protected stream,
+ * decompresses into the arena output and restores the stream.
+ *
+ * returns: the decompressed output, read in place
+ * -------------------------------------------------------------------------------
+ */
+static const float *flippedTrial(struct injector *inj, const int *bits, int first_bit, int count, double *decompress_time){
+	struct timeval d_start, d_stop;
+	size_t compressed_size;
+	uint8_t *data = injectorStream(inj, &compressed_size);
+
+	int64_t span = traceBegin(TRACE_FLIP);
+	arenaResetOutput(inj->arena);
+	flipBits(data, bits, first_bit, count);
+	inj->check->num_fixed = 0;
+	if (inj->protection){
+		protectVerify(inj->protection, data, compressed_size, inj->check);
+	}
+	traceEnd(TRACE_FLIP, span, first_bit, count, -1);
+
+	span = traceBegin(TRACE_DECOMPRESS);
+	gettimeofday(&d_start, NULL);
+	if (inj->lib->compressor_decompress(inj->compressor, inj->arena->compressed, inj->arena->output_view)) {
+		printf("%s\n", inj->lib->compressor_error_msg(inj->compressor));
+		exit(inj->lib->compressor_error_code(inj->compressor));
+	}
+	gettimeofday(&d_stop, NULL);
+	*decompress_time = elapsedSeconds(&d_start, &d_stop);
+	traceEnd(TRACE_DECOMPRESS, span, first_bit, count, -1);
+
+	span = traceBegin(TRACE_FLIP);
+	flipBits(data, bits, first_bit, count);
+	// Bits the protection corrected were already flipped back
+	flipBits(data, inj->check->fixed, 0, inj->check->num_fixed);
+	traceEnd(TRACE_FLIP, span, first_bit, count, -1);
+	return arenaOutput(inj->arena);
+}
+
+/*
+ * Function: injectorGroupTrial
+ * -------------------------------------------------------------------------------
+ * Like injectorTrial, but flips count consecutive bits of the stream at once,
+ * for group testing. Bits are numbered byte * 8 + bit; count 0 decompresses
+ * the clean stream.
+ *
+ * returns: the decompressed output, read in place
+ * -------------------------------------------------------------------------------
+ */
+const float *injectorGroupTrial(struct injector *inj, int first_bit, int count, double *decompress_time){
+	size_t compressed_size;
+	injectorStream(inj, &compressed_size);
+
+	if (count > 0 && (first_bit < 0 || (size_t)(first_bit + count - 1) / 8 >= compressed_size)){
+		printf("ERROR: Byte Location %d Out of Bounds (%zu compressed bytes)\n", (first_bit + count - 1) / 8, compressed_size);
+		exit(-1);
+	}
+	return flippedTrial(inj, NULL, first_bit, count, decompress_time);
+}
+
+/*
+ * Function: injectorScatterTrial
+ * -------------------------------------------------------------------------------
+ * Like injectorGroupTrial, but flips count bits anywhere in the stream at
+ * once, for multiple upsets. The bits must be distinct, a bit listed twice
+ * is flipped back.
+ *
+ * returns: the decompressed output, read in place
+ * -------------------------------------------------------------------------------
+ */
+const float *injectorScatterTrial(struct injector *inj, const int *bits, int count, double *decompress_time){
+	size_t compressed_size;
+	int i;
+	injectorStream(inj, &compressed_size);
+
+	for (i = 0; i < count; i++){
+		if (bits[i] < 0 || (size_t)bits[i] / 8 >= compressed_size){
+			printf("ERROR: Byte Location %d Out of Bounds (%zu compressed bytes)\n", bits[i] / 8, compressed_size);
+			exit(-1);
+		}
+	}
+	return flippedTrial(inj, bits, count ? bits[0] : 0, count, decompress_time);
+}
+
+/*
+ * Function: injectorFree
+ * -------------------------------------------------------------------------------
+ * Releases the compressor; the arena is owned by the caller.
+ * -------------------------------------------------------------------------------
+ */
+void injectorFree(struct injector *inj){
+	if (inj == NULL){
+		return;
+	}
+	protectFree(inj->protection);
+	// An injector for an invalid compressor never got either
+	if (inj->compressor){
+		inj->lib->compressor_release(inj->compressor);
+	}
+	if (inj->library){
+		inj->lib->release(inj->library);
+	}
+	free(inj);
+}
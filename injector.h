@@ -0,0 +1,76 @@
+#ifndef INJECTOR_H
+#define INJECTOR_H
+
+#include <stddef.h>
+#include <sys/time.h>
+
+#include "libpressio.h"
+#include "arena.h"
+#include "protect.h"
+
+/*
+ * Compress-then-corrupt engine.
+ * -------------------------------------------------------------------------------
+ * Holds a configured SZ or ZFP compressor and the arena it works on. The
+ * field is compressed once; every trial flips one bit of the compressed
+ * stream in place, decompresses into the arena output and flips the bit back.
+ *
+ * Compressors run serially unless given more threads: ZFP through its OpenMP
+ * execution policy, OpenMP builds of SZ through OMP_NUM_THREADS, which must
+ * be set before the first compression, and the OpenMP runtime afterwards.
+ * Forked trials always run serially (see campaignSerialTrials).
+ *
+ * With a protection (see protect.h) every trial verifies, and where it can
+ * corrects, the stream after the flip and before decompressing; the
+ * outcome goes to *check.
+ *
+ * The Try calls report a compressor error with its message in inj->error
+ * and return; the others exit with it, as the command line tools always did.
+ * -------------------------------------------------------------------------------
+ */
+struct injector {
+	// libpressio build of the arena, see library.h
+	const struct pressio_library *lib;
+	struct pressio *library;
+	struct pressio_compressor *compressor;
+	const char *compressor_choice;
+	struct buffer_arena *arena;
+	// Threads the compressor may use
+	int threads;
+
+	double compression_ratio;
+	size_t compressed_size;
+	double compress_time;
+
+	// Whether the baseline leaves the campaign's pointwise bound, -1 until
+	// checked (see baselineViolates)
+	int baseline_violates;
+
+	// Protection of the compressed stream, NULL for none
+	struct stream_protection *protection;
+	// Where trials report their verification, normally last_check
+	struct protect_check *check;
+	struct protect_check last_check;
+
+	// Message and exit code of the last failed Try call
+	char error[512];
+	int error_code;
+};
+
+struct injector *injectorTryCreate(const char *compressor_choice, const char *error_bounding_mode, float error_bound, struct buffer_arena *arena);
+struct injector *injectorCreate(const char *compressor_choice, const char *error_bounding_mode, float error_bound, struct buffer_arena *arena);
+void injectorSetThreads(struct injector *inj, int threads);
+int injectorTryCompress(struct injector *inj);
+void injectorCompress(struct injector *inj);
+void injectorProtect(struct injector *inj, size_t chunk_bytes, size_t header_bytes);
+unsigned char *injectorStream(struct injector *inj, size_t *compressed_size);
+const float *injectorTryBaseline(struct injector *inj);
+const float *injectorBaseline(struct injector *inj);
+const float *injectorTrial(struct injector *inj, int char_loc, int flip_loc, int injection_active, double *decompress_time);
+const float *injectorGroupTrial(struct injector *inj, int first_bit, int count, double *decompress_time);
+const float *injectorScatterTrial(struct injector *inj, const int *bits, int count, double *decompress_time);
+void injectorFree(struct injector *inj);
+
+double elapsedSeconds(const struct timeval *start, const struct timeval *stop);
+
+#endif
@@ -0,0 +1,259 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "json.h"
+
+struct json_parser {
+	const char *path;
+	const char *text;
+	size_t pos;
+};
+
+static void parseValue(struct json_parser *p, struct json_value *value);
+
+/*
+ * Function: parseError
+ * -------------------------------------------------------------------------------
+ * Reports where parsing stopped and exits.
+ * -------------------------------------------------------------------------------
+ */
+static void parseError(struct json_parser *p, const char *message){
+	int line = 1;
+	size_t i;
+	for (i = 0; i < p->pos; i++){
+		if (p->text[i] == '\n'){
+			line++;
+		}
+	}
+	printf("ERROR: %s:%d: %s\n", p->path, line, message);
+	exit(-1);
+}
+
+static void skipSpace(struct json_parser *p){
+	while (isspace((unsigned char)p->text[p->pos])){
+		p->pos++;
+	}
+}
+
+static void expect(struct json_parser *p, char c){
+	skipSpace(p);
+	if (p->text[p->pos] != c){
+		char message[32];
+		snprintf(message, sizeof(message), "expected '%c'", c);
+		parseError(p, message);
+	}
+	p->pos++;
+}
+
+static char *parseString(struct json_parser *p){
+	size_t used = 0, end;
+	expect(p, '"');
+	// Decoded strings are never longer than they are written
+	for (end = p->pos; p->text[end] && p->text[end] != '"'; end++){
+		if (p->text[end] == '\\' && p->text[end + 1]){
+			end++;
+		}
+	}
+	char *s = malloc(end - p->pos + 1);
+	while (p->text[p->pos] != '"'){
+		char c = p->text[p->pos++];
+		if (c == '\0'){
+			parseError(p, "unterminated string");
+		}
+		if (c == '\\'){
+			c = p->text[p->pos++];
+			switch (c){
+				case 'n': c = '\n'; break;
+				case 't': c = '\t'; break;
+				case 'r': c = '\r'; break;
+				case 'b': c = '\b'; break;
+				case 'f': c = '\f'; break;
+				case 'u': s[used++] = '\\'; break;
+				case '\0': parseError(p, "unterminated string"); break;
+				default: break;
+			}
+		}
+		s[used++] = c;
+	}
+	p->pos++;
+	s[used] = '\0';
+	return s;
+}
+
+/*
+ * Function: appendItem
+ * -------------------------------------------------------------------------------
+ * returns: a new zeroed element at the end of an array or object
+ * -------------------------------------------------------------------------------
+ */
+static struct json_value *appendItem(struct json_value *value, char *key){
+	value->items = realloc(value->items, sizeof(struct json_value) * (value->count + 1));
+	if (value->type == JSON_OBJECT){
+		value->keys = realloc(value->keys, sizeof(char *) * (value->count + 1));
+		value->keys[value->count] = key;
+	}
+	memset(&value->items[value->count], 0, sizeof(struct json_value));
+	return &value->items[value->count++];
+}
+
+static void parseValue(struct json_parser *p, struct json_value *value){
+	skipSpace(p);
+	char c = p->text[p->pos];
+	memset(value, 0, sizeof(struct json_value));
+
+	if (c == '{'){
+		value->type = JSON_OBJECT;
+		p->pos++;
+		skipSpace(p);
+		if (p->text[p->pos] == '}'){
+			p->pos++;
+			return;
+		}
+		for (;;){
+			skipSpace(p);
+			char *key = parseString(p);
+			expect(p, ':');
+			// Parse into a local, appending may move the items
+			struct json_value member;
+			parseValue(p, &member);
+			*appendItem(value, key) = member;
+			skipSpace(p);
+			if (p->text[p->pos] == ','){
+				p->pos++;
+				continue;
+			}
+			expect(p, '}');
+			return;
+		}
+	}
+	if (c == '['){
+		value->type = JSON_ARRAY;
+		p->pos++;
+		skipSpace(p);
+		if (p->text[p->pos] == ']'){
+			p->pos++;
+			return;
+		}
+		for (;;){
+			struct json_value element;
+			parseValue(p, &element);
+			*appendItem(value, NULL) = element;
+			skipSpace(p);
+			if (p->text[p->pos] == ','){
+				p->pos++;
+				continue;
+			}
+			expect(p, ']');
+			return;
+		}
+	}
+	if (c == '"'){
+		value->type = JSON_STRING;
+		value->string = parseString(p);
+		return;
+	}
+	if (strncmp(p->text + p->pos, "true", 4) == 0 || strncmp(p->text + p->pos, "false", 5) == 0){
+		value->type = JSON_BOOL;
+		value->number = c == 't';
+		p->pos += c == 't' ? 4 : 5;
+		return;
+	}
+	if (strncmp(p->text + p->pos, "null", 4) == 0){
+		value->type = JSON_NULL;
+		p->pos += 4;
+		return;
+	}
+	char *end;
+	value->type = JSON_NUMBER;
+	value->number = strtod(p->text + p->pos, &end);
+	if (end == p->text + p->pos){
+		parseError(p, "expected a value");
+	}
+	p->pos = end - p->text;
+}
+
+/*
+ * Function: jsonParseFile
+ * -------------------------------------------------------------------------------
+ * returns: the parsed document, exits on unreadable or invalid files
+ * -------------------------------------------------------------------------------
+ */
+struct json_value *jsonParseFile(const char *path){
+	FILE *fp = fopen(path, "rb");
+	if (fp == NULL){
+		perror("ERROR: ");
+		exit(-1);
+	}
+	fseek(fp, 0, SEEK_END);
+	long size = ftell(fp);
+	rewind(fp);
+	char *text = malloc(size + 1);
+	if (text == NULL || fread(text, 1, size, fp) != (size_t)size){
+		printf("ERROR: could not read %s\n", path);
+		exit(-1);
+	}
+	text[size] = '\0';
+	fclose(fp);
+
+	struct json_parser p = { path, text, 0 };
+	struct json_value *root = malloc(sizeof(struct json_value));
+	parseValue(&p, root);
+	skipSpace(&p);
+	if (p.text[p.pos] != '\0'){
+		parseError(&p, "trailing characters");
+	}
+	free(text);
+	return root;
+}
+
+/*
+ * Function: jsonGet
+ * -------------------------------------------------------------------------------
+ * returns: the member of an object, NULL if absent or not an object
+ * -------------------------------------------------------------------------------
+ */
+const struct json_value *jsonGet(const struct json_value *object, const char *key){
+	size_t i;
+	if (object == NULL || object->type != JSON_OBJECT){
+		return NULL;
+	}
+	for (i = 0; i < object->count; i++){
+		if (strcmp(object->keys[i], key) == 0){
+			return &object->items[i];
+		}
+	}
+	return NULL;
+}
+
+double jsonNumber(const struct json_value *object, const char *key, double fallback){
+	const struct json_value *v = jsonGet(object, key);
+	return v && (v->type == JSON_NUMBER || v->type == JSON_BOOL) ? v->number : fallback;
+}
+
+const char *jsonString(const struct json_value *object, const char *key, const char *fallback){
+	const struct json_value *v = jsonGet(object, key);
+	return v && v->type == JSON_STRING ? v->string : fallback;
+}
+
+static void freeContents(struct json_value *value){
+	size_t i;
+	for (i = 0; i < value->count; i++){
+		freeContents(&value->items[i]);
+		if (value->keys){
+			free(value->keys[i]);
+		}
+	}
+	free(value->items);
+	free(value->keys);
+	free(value->string);
+}
+
+void jsonFree(struct json_value *value){
+	if (value == NULL){
+		return;
+	}
+	freeContents(value);
+	free(value);
+}
@@ -0,0 +1,33 @@
+#ifndef JSON_H
+#define JSON_H
+
+#include <stddef.h>
+
+/*
+ * Minimal JSON reader for experiment manifests.
+ * -------------------------------------------------------------------------------
+ * Parses a whole document into a tree. Strings keep their escapes decoded
+ * except \u, which is kept as written; numbers are doubles. Errors report the
+ * line they were found on and exit, like every other input error.
+ * -------------------------------------------------------------------------------
+ */
+
+enum json_type { JSON_NULL, JSON_BOOL, JSON_NUMBER, JSON_STRING, JSON_ARRAY, JSON_OBJECT };
+
+struct json_value {
+	enum json_type type;
+	double number;
+	char *string;
+	// Elements of an array or members of an object, keys only set for members
+	struct json_value *items;
+	char **keys;
+	size_t count;
+};
+
+struct json_value *jsonParseFile(const char *path);
+const struct json_value *jsonGet(const struct json_value *object, const char *key);
+double jsonNumber(const struct json_value *object, const char *key, double fallback);
+const char *jsonString(const struct json_value *object, const char *key, const char *fallback);
+void jsonFree(struct json_value *value);
+
+#endif
@@ -0,0 +1,139 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dlfcn.h>
+
+#include "library.h"
+
+const struct pressio_library PRESSIO_LINKED = {
+	"linked",
+	pressio_instance,
+	pressio_release,
+	pressio_version,
+	pressio_get_compressor,
+	pressio_new_metrics,
+	pressio_compressor_set_metrics,
+	pressio_compressor_get_options,
+	pressio_compressor_check_options,
+	pressio_compressor_set_options,
+	pressio_compressor_compress,
+	pressio_compressor_decompress,
+	pressio_compressor_get_metrics_results,
+	pressio_compressor_error_msg,
+	pressio_compressor_error_code,
+	pressio_compressor_release,
+	pressio_options_free,
+	pressio_options_get_double,
+	pressio_options_set_integer,
+	pressio_options_set_uinteger,
+	pressio_options_set_double,
+	pressio_options_set_string,
+	pressio_data_new_nonowning,
+	pressio_data_new_empty,
+	pressio_data_new_move,
+	pressio_data_ptr,
+	pressio_data_free,
+	NULL,
+};
+
+/*
+ * Function: librarySymbol
+ * -------------------------------------------------------------------------------
+ * returns: a symbol of a loaded build, exits if it has none of that name
+ * -------------------------------------------------------------------------------
+ */
+static void *librarySymbol(void *handle, const char *paths, const char *name){
+	void *symbol = dlsym(handle, name);
+	if (symbol == NULL){
+		printf("ERROR: %s not found in %s: %s\n", name, paths, dlerror());
+		exit(-1);
+	}
+	return symbol;
+}
+
+/*
+ * Function: libraryLoad
+ * -------------------------------------------------------------------------------
+ * Opens a libpressio build in a new link-map namespace.
+ *
+ * paths: colon separated shared libraries loaded in order into the one
+ * namespace, libpressio last (e.g. "sz/lib64/libSZ.so:libpressio/lib64/
+ * liblibpressio.so"). Dependencies listed before libpressio are used in
+ * place of whatever its RUNPATH or LD_LIBRARY_PATH would find; a build
+ * whose libraries carry their own RUNPATH, as spack builds do, only needs
+ * libpressio itself.
+ *
+ * returns: the table of the build, kept for the life of the process; exits
+ * if a library or symbol cannot be loaded
+ * -------------------------------------------------------------------------------
+ */
+const struct pressio_library *libraryLoad(const char *paths){
+	struct pressio_library *lib = calloc(1, sizeof(struct pressio_library));
+	char *list = strdup(paths);
+	char *save = NULL, *path;
+	void *handle = NULL;
+	Lmid_t namespace = LM_ID_NEWLM;
+
+	for (path = strtok_r(list, ":", &save); path != NULL; path = strtok_r(NULL, ":", &save)){
+		handle = dlmopen(namespace, path, RTLD_NOW | RTLD_LOCAL);
+		if (handle == NULL){
+			printf("ERROR: Could not load %s: %s\n", path, dlerror());
+			exit(-1);
+		}
+		if (namespace == LM_ID_NEWLM && dlinfo(handle, RTLD_DI_LMID, &namespace) != 0){
+			printf("ERROR: %s\n", dlerror());
+			exit(-1);
+		}
+	}
+	free(list);
+	if (handle == NULL){
+		printf("ERROR: No library given to load\n");
+		exit(-1);
+	}
+
+	lib->name = strdup(paths);
+	lib->instance = librarySymbol(handle, paths, "pressio_instance");
+	lib->release = librarySymbol(handle, paths, "pressio_release");
+	lib->version = librarySymbol(handle, paths, "pressio_version");
+	lib->get_compressor = librarySymbol(handle, paths, "pressio_get_compressor");
+	lib->new_metrics = librarySymbol(handle, paths, "pressio_new_metrics");
+	lib->compressor_set_metrics = librarySymbol(handle, paths, "pressio_compressor_set_metrics");
+	lib->compressor_get_options = librarySymbol(handle, paths, "pressio_compressor_get_options");
+	lib->compressor_check_options = librarySymbol(handle, paths, "pressio_compressor_check_options");
+	lib->compressor_set_options = librarySymbol(handle, paths, "pressio_compressor_set_options");
+	lib->compressor_compress = librarySymbol(handle, paths, "pressio_compressor_compress");
+	lib->compressor_decompress = librarySymbol(handle, paths, "pressio_compressor_decompress");
+	lib->compressor_get_metrics_results = librarySymbol(handle, paths, "pressio_compressor_get_metrics_results");
+	lib->compressor_error_msg = librarySymbol(handle, paths, "pressio_compressor_error_msg");
+	lib->compressor_error_code = librarySymbol(handle, paths, "pressio_compressor_error_code");
+	lib->compressor_release = librarySymbol(handle, paths, "pressio_compressor_release");
+	lib->options_free = librarySymbol(handle, paths, "pressio_options_free");
+	lib->options_get_double = librarySymbol(handle, paths, "pressio_options_get_double");
+	lib->options_set_integer = librarySymbol(handle, paths, "pressio_options_set_integer");
+	lib->options_set_uinteger = librarySymbol(handle, paths, "pressio_options_set_uinteger");
+	lib->options_set_double = librarySymbol(handle, paths, "pressio_options_set_double");
+	lib->options_set_string = librarySymbol(handle, paths, "pressio_options_set_string");
+	lib->data_new_nonowning = librarySymbol(handle, paths, "pressio_data_new_nonowning");
+	lib->data_new_empty = librarySymbol(handle, paths, "pressio_data_new_empty");
+	lib->data_new_move = librarySymbol(handle, paths, "pressio_data_new_move");
+	lib->data_ptr = librarySymbol(handle, paths, "pressio_data_ptr");
+	lib->data_free = librarySymbol(handle, paths, "pressio_data_free");
+	lib->handle = handle;
+	return lib;
+}
+
+/*
+ * Function: librarySetOpenMPThreads
+ * -------------------------------------------------------------------------------
+ * Sets the thread count of the OpenMP runtime an OpenMP build of SZ runs
+ * its parallel regions with, for the calling thread. Builds without one
+ * are left alone.
+ * -------------------------------------------------------------------------------
+ */
+void librarySetOpenMPThreads(const struct pressio_library *lib, int threads){
+	void (*set_threads)(int) = dlsym(lib->handle ? lib->handle : RTLD_DEFAULT, "omp_set_num_threads");
+	if (set_threads != NULL){
+		set_threads(threads);
+	}
+}
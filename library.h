@@ -0,0 +1,62 @@
+#ifndef LIBRARY_H
+#define LIBRARY_H
+
+#include "libpressio.h"
+
+/*
+ * libpressio builds.
+ * -------------------------------------------------------------------------------
+ * Every libpressio call of the arena and the injector goes through one of
+ * these tables, so one process can drive two builds of the compressor
+ * stack side by side (regular SZ against the SZ_RA build, or two libpressio
+ * releases). PRESSIO_LINKED is the build the program was linked against.
+ * libraryLoad opens another one with dlmopen in a link-map namespace of its
+ * own: its libpressio, SZ and ZFP (and their copies of libstdc++ and libc)
+ * never bind to the linked ones, so plugin registries and compressor
+ * globals of the two builds stay apart.
+ *
+ * Objects made through one table must only be passed to the same table.
+ * Allocations made inside a loaded build are not seen by memcap's counters.
+ * -------------------------------------------------------------------------------
+ */
+struct pressio_library {
+	// The shared libraries of the build, "linked" for PRESSIO_LINKED
+	const char *name;
+
+	__typeof__(pressio_instance) *instance;
+	__typeof__(pressio_release) *release;
+	__typeof__(pressio_version) *version;
+	__typeof__(pressio_get_compressor) *get_compressor;
+	__typeof__(pressio_new_metrics) *new_metrics;
+	__typeof__(pressio_compressor_set_metrics) *compressor_set_metrics;
+	__typeof__(pressio_compressor_get_options) *compressor_get_options;
+	__typeof__(pressio_compressor_check_options) *compressor_check_options;
+	__typeof__(pressio_compressor_set_options) *compressor_set_options;
+	__typeof__(pressio_compressor_compress) *compressor_compress;
+	__typeof__(pressio_compressor_decompress) *compressor_decompress;
+	__typeof__(pressio_compressor_get_metrics_results) *compressor_get_metrics_results;
+	__typeof__(pressio_compressor_error_msg) *compressor_error_msg;
+	__typeof__(pressio_compressor_error_code) *compressor_error_code;
+	__typeof__(pressio_compressor_release) *compressor_release;
+	__typeof__(pressio_options_free) *options_free;
+	__typeof__(pressio_options_get_double) *options_get_double;
+	__typeof__(pressio_options_set_integer) *options_set_integer;
+	__typeof__(pressio_options_set_uinteger) *options_set_uinteger;
+	__typeof__(pressio_options_set_double) *options_set_double;
+	__typeof__(pressio_options_set_string) *options_set_string;
+	__typeof__(pressio_data_new_nonowning) *data_new_nonowning;
+	__typeof__(pressio_data_new_empty) *data_new_empty;
+	__typeof__(pressio_data_new_move) *data_new_move;
+	__typeof__(pressio_data_ptr) *data_ptr;
+	__typeof__(pressio_data_free) *data_free;
+
+	// dlmopen handle of a loaded build, NULL for PRESSIO_LINKED
+	void *handle;
+};
+
+extern const struct pressio_library PRESSIO_LINKED;
+
+const struct pressio_library *libraryLoad(const char *paths);
+void librarySetOpenMPThreads(const struct pressio_library *lib, int threads);
+
+#endif
@@ -0,0 +1,128 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <malloc.h>
+#include <sys/resource.h>
+
+#include "memcap.h"
+
+// Set only inside a trial child, which runs the decompressor single threaded
+static struct memcap_stats *STATS;
+// Address space limit before the cap, restored by memcapRemove
+static struct rlimit SAVED_LIMIT;
+static int CAPPED;
+
+#ifndef MEMCAP_NO_COUNT
+// glibc's allocator, always exported alongside malloc
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void __libc_free(void *ptr);
+
+/*
+ * Function: countAllocation
+ * -------------------------------------------------------------------------------
+ * Records the result of an allocation of size bytes.
+ * -------------------------------------------------------------------------------
+ */
+static void countAllocation(void *ptr, size_t size){
+	if (ptr == NULL){
+		if (size && !STATS->failed){
+			STATS->failed = 1;
+			STATS->failed_size = size;
+		}
+		return;
+	}
+	STATS->allocations++;
+	STATS->live_bytes += malloc_usable_size(ptr);
+	if (STATS->live_bytes > STATS->peak_bytes){
+		STATS->peak_bytes = STATS->live_bytes;
+	}
+}
+
+void *malloc(size_t size){
+	void *ptr = __libc_malloc(size);
+	if (STATS){
+		countAllocation(ptr, size);
+	}
+	return ptr;
+}
+
+void *calloc(size_t count, size_t size){
+	void *ptr = __libc_calloc(count, size);
+	if (STATS){
+		countAllocation(ptr, count * size);
+	}
+	return ptr;
+}
+
+void *realloc(void *old, size_t size){
+	size_t old_size = old && STATS ? malloc_usable_size(old) : 0;
+	void *ptr = __libc_realloc(old, size);
+	if (STATS){
+		if (ptr != NULL || size == 0){
+			STATS->live_bytes -= old_size < STATS->live_bytes ? old_size : STATS->live_bytes;
+		}
+		countAllocation(ptr, size);
+	}
+	return ptr;
+}
+
+void free(void *ptr){
+	if (STATS && ptr){
+		size_t size = malloc_usable_size(ptr);
+		STATS->live_bytes -= size < STATS->live_bytes ? size : STATS->live_bytes;
+	}
+	__libc_free(ptr);
+}
+#endif
+
+/*
+ * Function: memcapInstall
+ * -------------------------------------------------------------------------------
+ * Starts counting allocations into stats and, with a limit, caps the
+ * address space at its current size plus limit_bytes. Only called in a
+ * trial child, the cap and the counting end with it.
+ * -------------------------------------------------------------------------------
+ */
+void memcapInstall(struct memcap_stats *stats, size_t limit_bytes){
+	memset(stats, 0, sizeof(struct memcap_stats));
+	STATS = stats;
+	if (limit_bytes == 0){
+		return;
+	}
+
+	// First field of statm is the address space size in pages
+	unsigned long pages = 0;
+	FILE *fp = fopen("/proc/self/statm", "r");
+	if (fp != NULL){
+		if (fscanf(fp, "%lu", &pages) != 1){
+			pages = 0;
+		}
+		fclose(fp);
+	}
+	struct rlimit limit;
+	rlim_t cap = (rlim_t)pages * (rlim_t)sysconf(_SC_PAGESIZE) + limit_bytes;
+	getrlimit(RLIMIT_AS, &SAVED_LIMIT);
+	limit = SAVED_LIMIT;
+	limit.rlim_cur = limit.rlim_max != RLIM_INFINITY && limit.rlim_max < cap ? limit.rlim_max : cap;
+	if (setrlimit(RLIMIT_AS, &limit) != 0){
+		perror("WARNING: ");
+		return;
+	}
+	CAPPED = 1;
+}
+
+/*
+ * Function: memcapRemove
+ * -------------------------------------------------------------------------------
+ * Stops counting and lifts the cap, so metrics are not limited by it.
+ * -------------------------------------------------------------------------------
+ */
+void memcapRemove(void){
+	STATS = NULL;
+	if (CAPPED){
+		setrlimit(RLIMIT_AS, &SAVED_LIMIT);
+		CAPPED = 0;
+	}
+}
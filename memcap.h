@@ -0,0 +1,39 @@
+#ifndef MEMCAP_H
+#define MEMCAP_H
+
+#include <stddef.h>
+
+/*
+ * Per-trial memory budget.
+ * -------------------------------------------------------------------------------
+ * A corrupted header can make SZ or ZFP ask for an enormous buffer. Inside a
+ * trial child the address space is capped with RLIMIT_AS, so such requests
+ * fail at once instead of swapping or waking the OOM killer on a shared node.
+ *
+ * comp_inj also defines malloc, calloc, realloc and free itself, on top of
+ * glibc's __libc_* allocator. Being in the executable they take precedence
+ * for every library, SZ, ZFP and libpressio's operator new included. Once a
+ * trial installs its stats they count allocations, track live and peak heap
+ * bytes and note the first allocation that failed, which is how a crash
+ * caused by the cap is told apart from other crashes. aligned allocations
+ * (posix_memalign, aligned_alloc) pass through uncounted. Builds where the
+ * interposer cannot take precedence (the Python extension, loaded after
+ * glibc) define MEMCAP_NO_COUNT and keep only the cap; the counters stay 0.
+ * -------------------------------------------------------------------------------
+ */
+
+/*
+ * Allocation counters of one trial, kept in memory the parent can read.
+ */
+struct memcap_stats {
+	unsigned long allocations;
+	size_t live_bytes;
+	size_t peak_bytes;
+	int failed;
+	size_t failed_size;
+};
+
+void memcapInstall(struct memcap_stats *stats, size_t limit_bytes);
+void memcapRemove(void);
+
+#endif
@@ -0,0 +1,737 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <float.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "metrics.h"
+#include "sketch.h"
+
+// Elements compared per step of the compare-and-scan
+#define METRICS_CHUNK 16
+// Elements compared with one memcmp before classification looks closer
+#define CLASSIFY_BLOCK 4096
+
+static const char *EFFECT_NAMES[] = { "Benign", "WithinBound", "Violation", "Changed" };
+
+/*
+ * Function: chunkChangedMask
+ * -------------------------------------------------------------------------------
+ * Compares METRICS_CHUNK elements bitwise, so NaN payloads and signed zeros
+ * are reported as changes.
+ *
+ * returns: a mask with bit k set when element k of the chunk changed
+ * -------------------------------------------------------------------------------
+ */
+static inline unsigned int chunkChangedMask(const uint32_t *a, const uint32_t *b){
+#ifdef __SSE2__
+	unsigned int equal = 0;
+	int k;
+	for (k = 0; k < METRICS_CHUNK; k += 4){
+		__m128i va = _mm_loadu_si128((const __m128i *)(a + k));
+		__m128i vb = _mm_loadu_si128((const __m128i *)(b + k));
+		__m128 eq = _mm_castsi128_ps(_mm_cmpeq_epi32(va, vb));
+		equal |= (unsigned int)_mm_movemask_ps(eq) << k;
+	}
+	return ~equal & ((1u << METRICS_CHUNK) - 1);
+#else
+	unsigned int changed = 0;
+	int k;
+	for (k = 0; k < METRICS_CHUNK; k++){
+		changed |= (unsigned int)(a[k] != b[k]) << k;
+	}
+	return changed;
+#endif
+}
+
+/*
+ * Function: calculatePropagation
+ * -------------------------------------------------------------------------------
+ * Scans a decompressed output against the baseline and records how far the
+ * fault propagated: number of changed elements, their n-dimensional bounding
+ * box, first/last changed linear index and how many compressor blocks were
+ * touched. Unchanged chunks are skipped with a single vector compare, so the
+ * cost on benign trials is one streaming pass over both buffers.
+ *
+ * baseline: fault-free decompressed output
+ * output: decompressed output of the trial
+ * dims: the data dimensions, dims[0] fastest varying
+ * num_dims: number of entries in dims
+ * block_edge: edge length of a compressor block (4 for ZFP)
+ * pm: the metrics to fill in
+ * -------------------------------------------------------------------------------
+ */
+void calculatePropagation(const float *baseline, const float *output, size_t const *dims, int num_dims, size_t block_edge, struct propagation_metrics *pm){
+	const uint32_t *a = (const uint32_t *)baseline;
+	const uint32_t *b = (const uint32_t *)output;
+	size_t blocks_per_dim[METRICS_MAX_DIMS];
+	size_t num_blocks = 1;
+	size_t data_size = 1;
+	unsigned char *block_seen = NULL;
+	size_t i;
+	int d;
+
+	memset(pm, 0, sizeof(struct propagation_metrics));
+	pm->first_changed = -1;
+	pm->last_changed = -1;
+	if (block_edge == 0){
+		block_edge = 1;
+	}
+	for (d = 0; d < num_dims; d++){
+		data_size *= dims[d];
+		blocks_per_dim[d] = (dims[d] + block_edge - 1) / block_edge;
+		num_blocks *= blocks_per_dim[d];
+	}
+
+	for (i = 0; i < data_size; i += METRICS_CHUNK){
+		unsigned int mask;
+		if (i + METRICS_CHUNK <= data_size){
+			mask = chunkChangedMask(a + i, b + i);
+		} else {
+			size_t k;
+			mask = 0;
+			for (k = 0; i + k < data_size; k++){
+				mask |= (unsigned int)(a[i + k] != b[i + k]) << k;
+			}
+		}
+
+		while (mask){
+			size_t idx = i + __builtin_ctz(mask);
+			size_t rem = idx;
+			size_t block = 0;
+			size_t stride = 1;
+			mask &= mask - 1;
+
+			if (pm->changed == 0){
+				pm->first_changed = idx;
+				for (d = 0; d < num_dims; d++){
+					pm->box_min[d] = (size_t)-1;
+				}
+				block_seen = calloc((num_blocks + 7) / 8, 1);
+				if (block_seen == NULL){
+					printf("ERROR: out of memory tracking affected blocks\n");
+					exit(-1);
+				}
+			}
+			pm->changed++;
+			pm->last_changed = idx;
+
+			// Changes are sparse, so the per-element division is cheap
+			for (d = 0; d < num_dims; d++){
+				size_t coord = rem % dims[d];
+				rem /= dims[d];
+				if (coord < pm->box_min[d]){
+					pm->box_min[d] = coord;
+				}
+				if (coord > pm->box_max[d]){
+					pm->box_max[d] = coord;
+				}
+				block += (coord / block_edge) * stride;
+				stride *= blocks_per_dim[d];
+			}
+			if (!(block_seen[block / 8] & (1 << (block % 8)))){
+				block_seen[block / 8] |= 1 << (block % 8);
+				pm->affected_blocks++;
+			}
+		}
+	}
+	free(block_seen);
+}
+
+/*
+ * Function: printPropagation
+ * -------------------------------------------------------------------------------
+ * Prints the propagation metrics in the "Name: value" form parsed by
+ * comp_inj_runner.py. The bounding box is printed as start:end per dimension
+ * (inclusive), or NA when nothing changed.
+ * -------------------------------------------------------------------------------
+ */
+void printPropagation(const struct propagation_metrics *pm, int num_dims){
+	int d;
+
+	printf("Changed Elements: %zu\n", pm->changed);
+	printf("First Changed Index: %lld\n", pm->first_changed);
+	printf("Last Changed Index: %lld\n", pm->last_changed);
+	printf("Change Bounding Box:");
+	if (pm->changed == 0){
+		printf(" NA");
+	} else {
+		for (d = 0; d < num_dims; d++){
+			printf(" %zu:%zu", pm->box_min[d], pm->box_max[d]);
+		}
+	}
+	printf("\n");
+	printf("Affected Blocks: %zu\n", pm->affected_blocks);
+}
+
+/*
+ * Function: parseQualityMetrics
+ * -------------------------------------------------------------------------------
+ * Parses the comma separated -M list (ssim, pearson, range, ulp or all).
+ *
+ * returns: a mask of QUALITY_* flags, exits on an unknown name
+ * -------------------------------------------------------------------------------
+ */
+int parseQualityMetrics(const char *list){
+	char *copy = strdup(list);
+	char *pt;
+	int selected = 0;
+
+	pt = strtok(copy, ",");
+	while (pt != NULL){
+		if (strcmp(pt, "ssim") == 0){
+			selected |= QUALITY_SSIM;
+		} else if (strcmp(pt, "pearson") == 0){
+			selected |= QUALITY_PEARSON;
+		} else if (strcmp(pt, "range") == 0){
+			selected |= QUALITY_RANGE;
+		} else if (strcmp(pt, "ulp") == 0){
+			selected |= QUALITY_ULP;
+		} else if (strcmp(pt, "all") == 0){
+			selected |= QUALITY_SSIM | QUALITY_PEARSON | QUALITY_RANGE | QUALITY_ULP;
+		} else {
+			printf("Invalid Quality Metric: %s\n", pt);
+			printf("Exiting\n");
+			exit(1);
+		}
+		pt = strtok(NULL, ",");
+	}
+	free(copy);
+	return selected;
+}
+
+/*
+ * Function: isFiniteBits
+ * -------------------------------------------------------------------------------
+ * returns: 1 if the float with these bits is neither NaN nor Inf
+ * -------------------------------------------------------------------------------
+ */
+static inline int isFiniteBits(uint32_t bits){
+	return (bits & 0x7F800000u) != 0x7F800000u;
+}
+
+/*
+ * Function: ulpKey
+ * -------------------------------------------------------------------------------
+ * Maps float bits onto integers ordered like the floats, so the ULP distance
+ * of two floats is the difference of their keys. Both zeros map to 0.
+ * -------------------------------------------------------------------------------
+ */
+static inline int64_t ulpKey(uint32_t bits){
+	int64_t key = (int32_t)bits;
+	return key < 0 ? (int64_t)INT32_MIN - key : key;
+}
+
+/*
+ * Function: ssimWindows
+ * -------------------------------------------------------------------------------
+ * Mean SSIM over non-overlapping QUALITY_SSIM_WINDOW wide windows of a 2D or
+ * 3D field. The field is walked one band of windows at a time: the rows of a
+ * band are read contiguously and accumulated into per-window sums, so every
+ * element is read once and the working set is a single band.
+ *
+ * returns: the mean SSIM, NAN if the field has no complete window
+ * -------------------------------------------------------------------------------
+ */
+static double ssimWindows(const float *original, const float *output, size_t nx, size_t ny, size_t nz, double min_val, double range){
+	const size_t w = QUALITY_SSIM_WINDOW;
+	size_t wz = nz > 1 ? w : 1;
+	size_t nwx = nx / w, nwy = ny / w, nwz = nz / wz;
+	double c1 = (0.01 * range) * (0.01 * range);
+	double c2 = (0.03 * range) * (0.03 * range);
+	double ssim_sum = 0;
+	size_t windows = 0;
+	double *acc;
+	size_t wxi, wyi, wzi, dy, dz;
+
+	if (nwx == 0 || nwy == 0 || nwz == 0){
+		return NAN;
+	}
+	// Sums of a, b, a*a, b*b, a*b and the finite pair count per window
+	acc = malloc(sizeof(double) * 6 * nwx);
+
+	for (wzi = 0; wzi < nwz; wzi++){
+		for (wyi = 0; wyi < nwy; wyi++){
+			memset(acc, 0, sizeof(double) * 6 * nwx);
+			for (dz = 0; dz < wz; dz++){
+				for (dy = 0; dy < w; dy++){
+					size_t row = ((wzi * wz + dz) * ny + (wyi * w + dy)) * nx;
+					const float *ra = original + row;
+					const float *rb = output + row;
+					for (wxi = 0; wxi < nwx; wxi++){
+						double sa = 0, sb = 0, saa = 0, sbb = 0, sab = 0, cnt = 0;
+						size_t dx;
+						for (dx = 0; dx < QUALITY_SSIM_WINDOW; dx++){
+							uint32_t ua, ub;
+							float fa = ra[wxi * w + dx];
+							float fb = rb[wxi * w + dx];
+							memcpy(&ua, &fa, sizeof(ua));
+							memcpy(&ub, &fb, sizeof(ub));
+							int ok = isFiniteBits(ua) & isFiniteBits(ub);
+							double a = ok ? fa - min_val : 0;
+							double b = ok ? fb - min_val : 0;
+							sa += a;
+							sb += b;
+							saa += a * a;
+							sbb += b * b;
+							sab += a * b;
+							cnt += ok;
+						}
+						double *win = acc + 6 * wxi;
+						win[0] += sa;
+						win[1] += sb;
+						win[2] += saa;
+						win[3] += sbb;
+						win[4] += sab;
+						win[5] += cnt;
+					}
+				}
+			}
+			for (wxi = 0; wxi < nwx; wxi++){
+				double *win = acc + 6 * wxi;
+				double n = win[5];
+				if (n < 2){
+					continue;
+				}
+				double mu_a = win[0] / n;
+				double mu_b = win[1] / n;
+				double var_a = win[2] / n - mu_a * mu_a;
+				double var_b = win[3] / n - mu_b * mu_b;
+				double cov = win[4] / n - mu_a * mu_b;
+				ssim_sum += ((2 * mu_a * mu_b + c1) * (2 * cov + c2)) / ((mu_a * mu_a + mu_b * mu_b + c1) * (var_a + var_b + c2));
+				windows++;
+			}
+		}
+	}
+	free(acc);
+	return windows ? ssim_sum / windows : NAN;
+}
+
+/*
+ * Function: qualityInit
+ * -------------------------------------------------------------------------------
+ * Prepares quality metrics for calculateErrorMetrics to fill in.
+ *
+ * selected: mask of QUALITY_* flags
+ * -------------------------------------------------------------------------------
+ */
+void qualityInit(struct quality_metrics *qm, int selected){
+	memset(qm, 0, sizeof(struct quality_metrics));
+	qm->selected = selected;
+	qm->ssim = NAN;
+	qm->pearson = NAN;
+	qm->range_rel_max_error = NAN;
+	qm->max_ulp = NAN;
+	qm->mean_ulp = NAN;
+}
+
+/*
+ * Function: calculateSSIM
+ * -------------------------------------------------------------------------------
+ * Adds SSIM, when selected, to quality metrics calculateErrorMetrics filled
+ * in; it needs their value range, so it is a pass of its own.
+ *
+ * dims: the data dimensions, dims[0] fastest varying
+ * num_dims: number of entries in dims
+ * -------------------------------------------------------------------------------
+ */
+void calculateSSIM(const float *original, const float *output, size_t const *dims, int num_dims, struct quality_metrics *qm){
+	size_t eff_dims[METRICS_MAX_DIMS];
+	int num_eff = 0, d;
+
+	for (d = 0; d < num_dims; d++){
+		if (dims[d] > 1){
+			eff_dims[num_eff++] = dims[d];
+		}
+	}
+	if ((qm->selected & QUALITY_SSIM) && !isnan(qm->range) && (num_eff == 2 || num_eff == 3)){
+		qm->ssim = ssimWindows(original, output, eff_dims[0], eff_dims[1], num_eff == 3 ? eff_dims[2] : 1, qm->min_val, qm->range);
+	}
+}
+
+/*
+ * Function: calculateQuality
+ * -------------------------------------------------------------------------------
+ * Computes the selected quality metrics of a decompressed output on their
+ * own, for callers that do not need the error metrics.
+ *
+ * original: the data before compression
+ * output: decompressed output of the trial
+ * dims: the data dimensions, dims[0] fastest varying
+ * num_dims: number of entries in dims
+ * selected: mask of QUALITY_* flags
+ * qm: the metrics to fill in
+ * -------------------------------------------------------------------------------
+ */
+void calculateQuality(const float *original, const float *output, size_t const *dims, int num_dims, int selected, struct quality_metrics *qm){
+	struct error_metrics em;
+	size_t data_size = 1;
+	int d;
+
+	for (d = 0; d < num_dims; d++){
+		data_size *= dims[d];
+	}
+	qualityInit(qm, selected);
+	calculateErrorMetrics(original, output, data_size, "", 0, -1, NULL, qm, 0, &em);
+	calculateSSIM(original, output, dims, num_dims, qm);
+}
+
+/*
+ * Function: printQuality
+ * -------------------------------------------------------------------------------
+ * Prints the selected quality metrics in the "Name: value" form parsed by
+ * comp_inj_runner.py. Metrics that cannot be computed print nan.
+ * -------------------------------------------------------------------------------
+ */
+void printQuality(const struct quality_metrics *qm){
+	if (qm->selected & QUALITY_SSIM){
+		printf("SSIM: %f\n", qm->ssim);
+	}
+	if (qm->selected & QUALITY_PEARSON){
+		printf("Pearson Correlation: %f\n", qm->pearson);
+	}
+	if (qm->selected & QUALITY_RANGE){
+		printf("Value Range Relative Max Error: %e\n", qm->range_rel_max_error);
+	}
+	if (qm->selected & QUALITY_ULP){
+		printf("Max ULP Distance: %.0f\n", qm->max_ulp);
+		printf("Mean ULP Distance: %f\n", qm->mean_ulp);
+	}
+	if (qm->selected){
+		printf("Non-Finite Pairs Skipped: %zu\n", qm->skipped);
+	}
+}
+
+/*
+ * Function: pointwiseBound
+ * -------------------------------------------------------------------------------
+ * Finds the bound every element is checked against in a mode.
+ *
+ * bound: set to the absolute bound, or the relative factor for PW_REL
+ *
+ * returns: 0 without a pointwise bound, 1 absolute, 2 point-wise relative,
+ * 3 the default bound of Rate mode
+ * -------------------------------------------------------------------------------
+ */
+static int pointwiseBound(const char *error_bounding_mode, float error_bound, float default_bound, float *bound){
+	*bound = error_bound;
+	if (strncmp(error_bounding_mode, "ABS", 3) == 0 || strncmp(error_bounding_mode, "Accuracy", 8) == 0){
+		return 1;
+	}
+	if (strncmp(error_bounding_mode, "PW_REL", 6) == 0){
+		return 2;
+	}
+	if (strncmp(error_bounding_mode, "Rate", 4) == 0 && default_bound != -1){
+		*bound = default_bound;
+		return 3;
+	}
+	return 0;
+}
+
+/*
+ * Function: errorMetricsPass
+ * -------------------------------------------------------------------------------
+ * The pass of calculateErrorMetrics, inlined into it once with quality
+ * metrics and once without.
+ * -------------------------------------------------------------------------------
+ */
+static inline __attribute__((always_inline)) void errorMetricsPass(const float *original, const float *output, size_t data_size, const char *error_bounding_mode, float error_bound, float default_bound, struct error_sketch *sketch, struct quality_metrics *qm, int debug, struct error_metrics *em){
+	int number_of_incorrect = 0;
+	float max_diff = 0;
+	float rmse_sum = 0;
+	float max_val = -1;
+	float min_val = -1;
+	size_t i;
+
+	// Quality sums over the finite pairs, centered on the first finite
+	// original to keep the one-pass variances accurate
+	double q_cnt = 0, q_sa = 0, q_sb = 0, q_saa = 0, q_sbb = 0, q_sab = 0, q_ulp_sum = 0;
+	float q_max_diff = 0, q_min = FLT_MAX, q_max = -FLT_MAX, shift = 0;
+	int64_t q_max_ulp = 0;
+	int shifted = 0;
+
+	float bound;
+	int check = pointwiseBound(error_bounding_mode, error_bound, default_bound, &bound);
+	if (!check){
+		number_of_incorrect = -1;
+	}
+
+	for (i = 0; i < data_size; i++){
+		float a = original[i];
+		float b = output[i];
+
+		// RMSE Work
+		float rmse_diff = a - b;
+		rmse_diff = rmse_diff * rmse_diff;
+		rmse_sum = rmse_sum + rmse_diff;
+
+		//PSNR Work
+		if(a > max_val || max_val == -1){
+			max_val = a;
+		}
+		if(a < min_val || min_val == -1){
+			min_val = a;
+		}
+
+		float diff = fabs(a - b);
+		if (sketch){
+			sketchAdd(sketch, diff, b);
+		}
+		if (check){
+			float limit = check == 2 ? fabs(bound * a) : bound;
+			if (diff > limit){
+				if (debug){
+					printf("Before: %f\n", a);
+					printf("After: %f\n", b);
+					printf("Difference: %f\n", diff);
+					printf("Err Bound:  %f\n", limit);
+					exit(0);
+				}
+				number_of_incorrect++;
+			}
+		}
+		if(diff > max_diff){
+			max_diff = diff;
+		}
+
+		if (qm){
+			uint32_t ua, ub;
+			memcpy(&ua, &a, sizeof(ua));
+			memcpy(&ub, &b, sizeof(ub));
+			if (isFiniteBits(ua) && isFiniteBits(ub)){
+				if (!shifted){
+					shift = a;
+					shifted = 1;
+				}
+				double sa = a - shift, sb = b - shift;
+				int64_t ulp = ulpKey(ua) - ulpKey(ub);
+				ulp = ulp < 0 ? -ulp : ulp;
+				q_cnt++;
+				q_sa += sa;
+				q_sb += sb;
+				q_saa += sa * sa;
+				q_sbb += sb * sb;
+				q_sab += sa * sb;
+				q_max_diff = diff > q_max_diff ? diff : q_max_diff;
+				q_min = a < q_min ? a : q_min;
+				q_max = a > q_max ? a : q_max;
+				q_ulp_sum += (double)ulp;
+				q_max_ulp = ulp > q_max_ulp ? ulp : q_max_ulp;
+			}
+		}
+	}
+
+	if (qm){
+		qm->skipped = data_size - (size_t)q_cnt;
+		qm->min_val = q_min;
+		qm->range = q_cnt > 0 ? (double)q_max - (double)q_min : NAN;
+		if (q_cnt > 0){
+			double cov = q_cnt * q_sab - q_sa * q_sb;
+			double var_a = q_cnt * q_saa - q_sa * q_sa;
+			double var_b = q_cnt * q_sbb - q_sb * q_sb;
+			qm->pearson = cov / sqrt(var_a * var_b);
+			qm->range_rel_max_error = qm->range > 0 ? q_max_diff / qm->range : (q_max_diff > 0 ? INFINITY : 0);
+			qm->max_ulp = (double)q_max_ulp;
+			qm->mean_ulp = q_ulp_sum / q_cnt;
+		}
+	}
+
+	//Calculate Root Mean Square Error
+	float rmse = rmse_sum / (data_size - 1);
+	rmse = sqrt(rmse);
+
+	//Check RMSE for bad values
+	if (fpclassify(rmse) == FP_INFINITE || fpclassify(rmse) == FP_NAN) {
+		rmse = FLT_MAX;
+	}
+
+	//Calculate PSNR
+	float psnr_control_value = 10000;
+	float psnr = 0;
+	if (rmse == 0){
+		psnr = psnr_control_value;
+	} else {
+		psnr = 20 * log10((max_val - min_val) / rmse);
+	}
+
+	//Check PSNR for bad values
+	if (fpclassify(psnr) == FP_INFINITE || fpclassify(psnr) == FP_NAN){
+		psnr = psnr_control_value * -1;
+	}
+
+	//Check Maximum Difference for bad values
+	if (fpclassify(max_diff) == FP_INFINITE || fpclassify(max_diff) == FP_NAN){
+		max_diff = FLT_MAX;
+	}
+
+	em->number_of_incorrect = number_of_incorrect;
+	em->max_diff = max_diff;
+	em->rmse = rmse;
+	em->psnr = psnr;
+}
+
+/*
+ * Function: calculateErrorMetrics
+ * -------------------------------------------------------------------------------
+ * Compares a decompressed output with the original data in one pass: number
+ * of elements outside the error bound, maximum absolute difference, RMSE and
+ * PSNR. Reads both buffers in place.
+ *
+ * original: the data before compression
+ * output: decompressed output of the trial
+ * data_size: number of elements
+ * error_bounding_mode: ABS, PSNR, PW_REL, Accuracy, Rate or Precision
+ * error_bound: the error bound given to the compressor
+ * default_bound: absolute bound used to count incorrect elements in Rate mode
+ * sketch: error distribution sketch to feed, or NULL
+ * qm: quality metrics (see qualityInit) computed in the same pass, all but
+ * SSIM (see calculateSSIM), or NULL
+ * debug: print the first out of bound element and end the experiment
+ * em: the metrics to fill in
+ * -------------------------------------------------------------------------------
+ */
+void calculateErrorMetrics(const float *original, const float *output, size_t data_size, const char *error_bounding_mode, float error_bound, float default_bound, struct error_sketch *sketch, struct quality_metrics *qm, int debug, struct error_metrics *em){
+	if (qm){
+		errorMetricsPass(original, output, data_size, error_bounding_mode, error_bound, default_bound, sketch, qm, debug, em);
+	} else {
+		errorMetricsPass(original, output, data_size, error_bounding_mode, error_bound, default_bound, sketch, NULL, debug, em);
+	}
+}
+
+/*
+ * Function: outsideBound
+ * -------------------------------------------------------------------------------
+ * returns: whether element i of output leaves the pointwise bound of the
+ * mode (see pointwiseBound); a NaN where the original is a number is
+ * outside any bound
+ * -------------------------------------------------------------------------------
+ */
+static inline int outsideBound(const float *original, const float *output, size_t i, int check, float bound){
+	float limit = check == 2 ? fabsf(bound * original[i]) : bound;
+	return fabsf(original[i] - output[i]) > limit || (isnan(output[i]) && !isnan(original[i]));
+}
+
+/*
+ * Function: baselineViolates
+ * -------------------------------------------------------------------------------
+ * Checks the fault-free output against the original, stopping at the first
+ * element outside the bound. Run once, before the trials, for
+ * classifyOutput.
+ *
+ * returns: 1 if the baseline itself leaves the bound, 0 if it does not or
+ * the mode has no pointwise bound
+ * -------------------------------------------------------------------------------
+ */
+int baselineViolates(const float *original, const float *baseline, size_t data_size, const char *error_bounding_mode, float error_bound, float default_bound){
+	float bound;
+	int check = pointwiseBound(error_bounding_mode, error_bound, default_bound, &bound);
+	size_t i;
+
+	for (i = 0; check && i < data_size; i++){
+		if (outsideBound(original, baseline, i, check, bound)){
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Function: classifyOutput
+ * -------------------------------------------------------------------------------
+ * Classifies a completed trial without computing any metric. Blocks equal to
+ * the baseline are skipped with memcmp; in a block that differs, the changed
+ * elements are found with the chunk compare and checked against the bound
+ * of the mode, stopping at the first one outside it. A benign trial costs
+ * one compare of output and baseline, nothing more.
+ *
+ * Checking only the changed elements relies on the baseline being inside
+ * the bound. When it is not (Rate mode with a default bound can be), a
+ * changed output is checked element by element against the original over
+ * the whole field, so Effect and Incorrect agree with the full metrics.
+ *
+ * original: the data before compression
+ * baseline: fault-free decompressed output
+ * output: decompressed output of the trial
+ * baseline_violates: see baselineViolates
+ *
+ * returns: one of the EFFECT_* classes
+ * -------------------------------------------------------------------------------
+ */
+int classifyOutput(const float *original, const float *baseline, const float *output, size_t data_size, const char *error_bounding_mode, float error_bound, float default_bound, int baseline_violates){
+	const uint32_t *a = (const uint32_t *)baseline;
+	const uint32_t *b = (const uint32_t *)output;
+	float bound;
+	int check = pointwiseBound(error_bounding_mode, error_bound, default_bound, &bound);
+	int changed = 0;
+	size_t start, i;
+
+	for (start = 0; start < data_size; start += CLASSIFY_BLOCK){
+		size_t end = start + CLASSIFY_BLOCK < data_size ? start + CLASSIFY_BLOCK : data_size;
+		if (memcmp(a + start, b + start, sizeof(float) * (end - start)) == 0){
+			continue;
+		}
+		if (!check){
+			return EFFECT_CHANGED;
+		}
+		if (baseline_violates){
+			for (i = 0; i < data_size; i++){
+				if (outsideBound(original, output, i, check, bound)){
+					return EFFECT_VIOLATION;
+				}
+			}
+			return EFFECT_WITHIN_BOUND;
+		}
+		changed = 1;
+		for (i = start; i < end; i += METRICS_CHUNK){
+			unsigned int mask;
+			if (i + METRICS_CHUNK <= end){
+				mask = chunkChangedMask(a + i, b + i);
+			} else {
+				size_t k;
+				mask = 0;
+				for (k = 0; i + k < end; k++){
+					mask |= (unsigned int)(a[i + k] != b[i + k]) << k;
+				}
+			}
+			while (mask){
+				size_t idx = i + __builtin_ctz(mask);
+				mask &= mask - 1;
+				if (outsideBound(original, output, idx, check, bound)){
+					return EFFECT_VIOLATION;
+				}
+			}
+		}
+	}
+	return changed ? EFFECT_WITHIN_BOUND : EFFECT_BENIGN;
+}
+
+/*
+ * Function: effectName
+ * -------------------------------------------------------------------------------
+ * returns: the Effect column of a class, "NA" for -1 or anything unknown
+ * -------------------------------------------------------------------------------
+ */
+const char *effectName(int effect){
+	if (effect < 0 || effect >= (int)(sizeof(EFFECT_NAMES) / sizeof(EFFECT_NAMES[0]))){
+		return "NA";
+	}
+	return EFFECT_NAMES[effect];
+}
+
+/*
+ * Function: printErrorMetrics
+ * -------------------------------------------------------------------------------
+ * Prints the error-bound metrics in the form parsed by comp_inj_runner.py.
+ * -------------------------------------------------------------------------------
+ */
+void printErrorMetrics(const struct error_metrics *em){
+	printf("Number of Incorrect: %d\n", em->number_of_incorrect);
+	printf("Maximum Absolute Difference: %f\n", em->max_diff);
+	printf("Root Mean Squared Error: %f\n", em->rmse);
+	printf("PSNR: %f\n", em->psnr);
+}
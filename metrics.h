@@ -0,0 +1,109 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stddef.h>
+
+// Largest number of dimensions accepted through -d
+#define METRICS_MAX_DIMS 5
+
+struct error_sketch;
+
+/*
+ * Error-bound metrics reported for every trial.
+ * -------------------------------------------------------------------------------
+ * number_of_incorrect counts elements outside the error bound of the mode
+ * (ABS/Accuracy: error_bound, PW_REL: error_bound * |original|, Rate:
+ * default_bound unless it is -1) and is -1 for modes without a pointwise
+ * bound (PSNR, Precision). Non-finite results are clamped the same way the
+ * runner has always expected: FLT_MAX for max_diff/rmse, -10000 for psnr.
+ * -------------------------------------------------------------------------------
+ */
+struct error_metrics {
+	int number_of_incorrect;
+	float max_diff;
+	float rmse;
+	float psnr;
+};
+
+/*
+ * Effect of a trial that completed, the classes of the classification-only
+ * mode (see classifyOutput): bit-identical to the fault-free output,
+ * changed but inside the pointwise bound, with at least one element
+ * outside it (silent data corruption), or changed in a mode without a
+ * pointwise bound (PSNR, Precision, Rate without default_bound).
+ */
+#define EFFECT_BENIGN 0
+#define EFFECT_WITHIN_BOUND 1
+#define EFFECT_VIOLATION 2
+#define EFFECT_CHANGED 3
+
+/*
+ * Spatial error-propagation metrics.
+ * -------------------------------------------------------------------------------
+ * Describes how far a single fault spread through the decompressed field,
+ * measured against the fault-free (baseline) decompressed output. Indices
+ * follow the libpressio convention: dims[0] is the fastest varying dimension.
+ * -------------------------------------------------------------------------------
+ */
+struct propagation_metrics {
+	// Elements whose bits differ from the baseline
+	size_t changed;
+	// First and last changed linear index, -1 when nothing changed
+	long long first_changed;
+	long long last_changed;
+	// Inclusive bounding box of the changes in each dimension
+	size_t box_min[METRICS_MAX_DIMS];
+	size_t box_max[METRICS_MAX_DIMS];
+	// Distinct block_edge^num_dims blocks containing at least one change
+	size_t affected_blocks;
+};
+
+/*
+ * Additional quality metrics, selected with -M.
+ * -------------------------------------------------------------------------------
+ * Computed against the original data in the pass of calculateErrorMetrics,
+ * SSIM in a band-blocked pass of its own once the value range is known.
+ * Pairs where either value is NaN or Inf are skipped (they are counted by
+ * the -q sketches).
+ * -------------------------------------------------------------------------------
+ */
+#define QUALITY_SSIM 1
+#define QUALITY_PEARSON 2
+#define QUALITY_RANGE 4
+#define QUALITY_ULP 8
+
+// Edge of the SSIM window, windows do not overlap
+#define QUALITY_SSIM_WINDOW 8
+
+struct quality_metrics {
+	int selected;
+	// Mean SSIM over all windows, NAN when the field is not 2D/3D
+	double ssim;
+	double pearson;
+	// Maximum absolute error divided by the value range of the original
+	double range_rel_max_error;
+	double max_ulp;
+	double mean_ulp;
+	// Element pairs skipped because a value was not finite
+	size_t skipped;
+	// Smallest finite original and the value range, NAN without one, for SSIM
+	float min_val;
+	double range;
+};
+
+void calculateErrorMetrics(const float *original, const float *output, size_t data_size, const char *error_bounding_mode, float error_bound, float default_bound, struct error_sketch *sketch, struct quality_metrics *qm, int debug, struct error_metrics *em);
+void printErrorMetrics(const struct error_metrics *em);
+int baselineViolates(const float *original, const float *baseline, size_t data_size, const char *error_bounding_mode, float error_bound, float default_bound);
+int classifyOutput(const float *original, const float *baseline, const float *output, size_t data_size, const char *error_bounding_mode, float error_bound, float default_bound, int baseline_violates);
+const char *effectName(int effect);
+
+int parseQualityMetrics(const char *list);
+void qualityInit(struct quality_metrics *qm, int selected);
+void calculateSSIM(const float *original, const float *output, size_t const *dims, int num_dims, struct quality_metrics *qm);
+void calculateQuality(const float *original, const float *output, size_t const *dims, int num_dims, int selected, struct quality_metrics *qm);
+void printQuality(const struct quality_metrics *qm);
+
+void calculatePropagation(const float *baseline, const float *output, size_t const *dims, int num_dims, size_t block_edge, struct propagation_metrics *pm);
+void printPropagation(const struct propagation_metrics *pm, int num_dims);
+
+#endif
@@ -0,0 +1,540 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "montecarlo.h"
+#include "numa.h"
+#include "trace.h"
+
+// Normal quantile of the 95% interval
+#define WILSON_Z 1.959963984540054
+
+/*
+ * One batch of trials, shared (MAP_SHARED) with the workers running it.
+ * The workers are forked once per run and wait on posted between batches.
+ */
+struct montecarlo_batch {
+	// Process shared, guards generation, stop and done
+	pthread_mutex_t lock;
+	// Signalled when a batch is posted or the workers are stopped
+	pthread_cond_t posted;
+	// Signalled when a worker finishes its share of a batch
+	pthread_cond_t finished;
+	// Batches posted so far, and the last one each worker finished
+	long generation;
+	long done[MONTECARLO_BATCH];
+	int stop;
+
+	int rate;
+	// Index of the batch's first trial within its rate
+	long first;
+	int count;
+	// Next trial of the batch to hand out
+	int next;
+	int upsets[MONTECARLO_BATCH];
+	struct trial_record records[MONTECARLO_BATCH];
+};
+
+/*
+ * Function: splitmix64
+ * -------------------------------------------------------------------------------
+ * returns: the next 64 random bits of a splitmix64 stream
+ * -------------------------------------------------------------------------------
+ */
+static uint64_t splitmix64(uint64_t *state){
+	uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+/*
+ * Function: uniform
+ * -------------------------------------------------------------------------------
+ * returns: a double uniform in [0, 1)
+ * -------------------------------------------------------------------------------
+ */
+static double uniform(uint64_t *state){
+	return (double)(splitmix64(state) >> 11) * 0x1.0p-53;
+}
+
+/*
+ * Function: poisson
+ * -------------------------------------------------------------------------------
+ * Draws from a Poisson distribution: Knuth's product of uniforms for small
+ * means, Hormann's transformed rejection (PTRS) from a mean of 10 on.
+ *
+ * returns: the number drawn
+ * -------------------------------------------------------------------------------
+ */
+static long poisson(uint64_t *state, double mean){
+	if (mean <= 0){
+		return 0;
+	}
+	if (mean < 10){
+		double limit = exp(-mean), product = uniform(state);
+		long k = 0;
+		while (product > limit){
+			k++;
+			product *= uniform(state);
+		}
+		return k;
+	}
+
+	double slam = sqrt(mean), loglam = log(mean);
+	double b = 0.931 + 2.53 * slam;
+	double a = -0.059 + 0.02483 * b;
+	double invalpha = 1.1239 + 1.1328 / (b - 3.4);
+	double vr = 0.9277 - 3.6224 / (b - 2);
+	while (1){
+		double u = uniform(state) - 0.5;
+		double v = uniform(state);
+		double us = 0.5 - fabs(u);
+		long k = (long)floor((2 * a / us + b) * u + mean + 0.43);
+		if (us >= 0.07 && v <= vr){
+			return k;
+		}
+		if (k < 0 || (us < 0.013 && v > us)){
+			continue;
+		}
+		if (log(v) + log(invalpha) - log(a / (us * us) + b) <= -mean + k * loglam - lgamma(k + 1)){
+			return k;
+		}
+	}
+}
+
+/*
+ * Function: compareBits
+ * -------------------------------------------------------------------------------
+ * qsort order of stream bits.
+ * -------------------------------------------------------------------------------
+ */
+static int compareBits(const void *a, const void *b){
+	int x = *(const int *)a, y = *(const int *)b;
+	return (x > y) - (x < y);
+}
+
+/*
+ * Function: drawUpsets
+ * -------------------------------------------------------------------------------
+ * Draws the upsets of one trial from the trial's own stream: their number
+ * from the Poisson distribution, then that many distinct stream bits.
+ *
+ * bits: grown as needed, receives the bits in increasing order
+ *
+ * returns: the number of upsets
+ * -------------------------------------------------------------------------------
+ */
+static int drawUpsets(uint64_t seed, int rate, long trial, double mean, long stream_bits, int **bits, long *capacity){
+	// Mix in seed, rate and trial one at a time, xoring them together would
+	// give (seed, trial) and (seed ^ d, trial ^ d) the same stream
+	uint64_t state = splitmix64(&seed) ^ (uint64_t)rate;
+	state = splitmix64(&state) ^ (uint64_t)trial;
+	state = splitmix64(&state);
+	long count = poisson(&state, mean);
+	long drawn = 0, i, j;
+
+	if (count > stream_bits){
+		count = stream_bits;
+	}
+	if (count > *capacity){
+		*capacity = count;
+		*bits = realloc(*bits, sizeof(int) * count);
+		if (*bits == NULL){
+			printf("ERROR: could not allocate %ld upsets\n", count);
+			exit(-1);
+		}
+	}
+	// Draw the missing bits, then drop repeats, until all are distinct
+	while (drawn < count){
+		for (i = drawn; i < count; i++){
+			(*bits)[i] = (int)(splitmix64(&state) % (uint64_t)stream_bits);
+		}
+		qsort(*bits, count, sizeof(int), compareBits);
+		for (i = 1, j = 1; i < count; i++){
+			if ((*bits)[i] != (*bits)[j - 1]){
+				(*bits)[j++] = (*bits)[i];
+			}
+		}
+		drawn = count ? j : 0;
+	}
+	return (int)count;
+}
+
+/*
+ * Function: wilsonInterval
+ * -------------------------------------------------------------------------------
+ * 95% Wilson score interval of a failure probability, usable at 0 and 1.
+ * -------------------------------------------------------------------------------
+ */
+static void wilsonInterval(long failures, long trials, double *lower, double *upper){
+	double p = (double)failures / trials;
+	double z2 = WILSON_Z * WILSON_Z;
+	double center = (p + z2 / (2.0 * trials)) / (1 + z2 / trials);
+	double spread = WILSON_Z * sqrt(p * (1 - p) / trials + z2 / (4.0 * trials * trials)) / (1 + z2 / trials);
+	*lower = center - spread > 0 ? center - spread : 0;
+	*upper = center + spread < 1 ? center + spread : 1;
+}
+
+/*
+ * Function: parseMonteCarlo
+ * -------------------------------------------------------------------------------
+ * Reads "rates[:half_width[:max_trials[:seed]]]", rates comma separated
+ * (e.g. "1e-7,1e-6,1e-5:0.01:20000:7"). Defaults: a half-width of 0.01,
+ * 10000 trials per rate, seed 0.
+ * -------------------------------------------------------------------------------
+ */
+void parseMonteCarlo(const char *spec, struct montecarlo_options *mc){
+	const char *p = spec;
+	char *end;
+
+	memset(mc, 0, sizeof(struct montecarlo_options));
+	mc->half_width = 0.01;
+	mc->max_trials = 10000;
+	while (mc->num_rates < MONTECARLO_MAX_RATES){
+		double rate = strtod(p, &end);
+		if (end == p || rate < 0 || rate > 1){
+			printf("ERROR: Error rates must be comma separated probabilities: %s\n", spec);
+			exit(-1);
+		}
+		mc->rates[mc->num_rates++] = rate;
+		p = end;
+		if (*p != ','){
+			break;
+		}
+		p++;
+	}
+	if (*p == ':'){
+		unsigned long long seed = 0;
+		int fields = sscanf(p, ":%lf:%ld:%llu", &mc->half_width, &mc->max_trials, &seed);
+		mc->seed = seed;
+		if (fields < 1 || mc->half_width <= 0 || (fields > 1 && mc->max_trials < 1)){
+			printf("ERROR: Monte Carlo runs must be rates[:half_width[:max_trials[:seed]]]: %s\n", spec);
+			exit(-1);
+		}
+	} else if (*p != '\0'){
+		printf("ERROR: Monte Carlo runs must be rates[:half_width[:max_trials[:seed]]]: %s\n", spec);
+		exit(-1);
+	}
+}
+
+/*
+ * Function: batchTrials
+ * -------------------------------------------------------------------------------
+ * Takes trials of a batch until none are left and runs them.
+ * -------------------------------------------------------------------------------
+ */
+static void batchTrials(struct injector *inj, const struct campaign_options *opts, const struct montecarlo_options *mc, struct montecarlo_batch *batch, int rate, long stream_bits){
+	long capacity = 0;
+	int *bits = NULL;
+	int i;
+
+	while ((i = __sync_fetch_and_add(&batch->next, 1)) < batch->count){
+		int count = drawUpsets(mc->seed, rate, batch->first + i, mc->rates[rate] * stream_bits, stream_bits, &bits, &capacity);
+		batch->upsets[i] = count;
+		campaignScatterTrial(inj, opts, bits, count, &batch->records[i]);
+	}
+	free(bits);
+}
+
+/*
+ * Function: batchWorker
+ * -------------------------------------------------------------------------------
+ * Body of forked worker w: takes its share of every posted batch until the
+ * workers are stopped, then exits.
+ * -------------------------------------------------------------------------------
+ */
+static void batchWorker(struct injector *inj, const struct campaign_options *opts, const struct montecarlo_options *mc, struct montecarlo_batch *batch, int w, long stream_bits){
+	long seen = 0;
+
+	pthread_mutex_lock(&batch->lock);
+	while (1){
+		while (batch->generation == seen && !batch->stop){
+			pthread_cond_wait(&batch->posted, &batch->lock);
+		}
+		if (batch->stop){
+			break;
+		}
+		seen = batch->generation;
+		pthread_mutex_unlock(&batch->lock);
+		batchTrials(inj, opts, mc, batch, batch->rate, stream_bits);
+		pthread_mutex_lock(&batch->lock);
+		batch->done[w] = seen;
+		pthread_cond_signal(&batch->finished);
+	}
+	pthread_mutex_unlock(&batch->lock);
+	fflush(stdout);
+	_exit(0);
+}
+
+/*
+ * Function: startWorkers
+ * -------------------------------------------------------------------------------
+ * Forks the workers of a run, each bound to its NUMA node with its own
+ * output mapping, the arena's is shared with the other workers.
+ *
+ * pids: receives the pid of every worker
+ *
+ * returns: the number of workers, 0 to run the trials in this process
+ * -------------------------------------------------------------------------------
+ */
+static int startWorkers(struct injector *inj, const struct campaign_options *opts, const struct montecarlo_options *mc, struct montecarlo_batch *batch, long stream_bits, pid_t *pids){
+	int workers = opts->workers > 1 ? opts->workers : 1;
+	pthread_mutexattr_t lock_attr;
+	pthread_condattr_t cond_attr;
+	int nodes, w;
+
+	if (workers == 1){
+		return 0;
+	}
+	if (workers > MONTECARLO_BATCH){
+		workers = MONTECARLO_BATCH;
+	}
+	pthread_mutexattr_init(&lock_attr);
+	pthread_mutexattr_setpshared(&lock_attr, PTHREAD_PROCESS_SHARED);
+	pthread_mutex_init(&batch->lock, &lock_attr);
+	pthread_mutexattr_destroy(&lock_attr);
+	pthread_condattr_init(&cond_attr);
+	pthread_condattr_setpshared(&cond_attr, PTHREAD_PROCESS_SHARED);
+	pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&batch->posted, &cond_attr);
+	pthread_cond_init(&batch->finished, &cond_attr);
+	pthread_condattr_destroy(&cond_attr);
+
+	nodes = numaNodes();
+	fflush(stdout);
+	for (w = 0; w < workers; w++){
+		pids[w] = fork();
+		if (pids[w] < 0){
+			perror("ERROR: ");
+			exit(-1);
+		}
+		if (pids[w] == 0){
+			numaBind(w % nodes);
+			arenaLocalize(inj->arena);
+			traceTrack(TRACE_TRACK_WORKERS + w);
+			batchWorker(inj, opts, mc, batch, w, stream_bits);
+		}
+	}
+	return workers;
+}
+
+/*
+ * Function: reapWorker
+ * -------------------------------------------------------------------------------
+ * Collects worker w if it has exited, blocking until it does when wait is
+ * set. A worker that did not exit cleanly is reported.
+ *
+ * returns: 1 if the worker is gone, its pid then cleared
+ * -------------------------------------------------------------------------------
+ */
+static int reapWorker(pid_t *pids, int w, int wait){
+	int status;
+	pid_t done = waitpid(pids[w], &status, wait ? 0 : WNOHANG);
+
+	if (done == 0){
+		return 0;
+	}
+	if (done < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0){
+		printf("WARNING: Monte Carlo worker %d did not finish, its trials may be missing\n", w);
+	}
+	pids[w] = 0;
+	return 1;
+}
+
+/*
+ * Function: runBatch
+ * -------------------------------------------------------------------------------
+ * Runs a batch of trials, on the forked workers when there are any. A
+ * worker that dies leaves its trial unrun; should none be left the rest
+ * of the batch runs in this process.
+ * -------------------------------------------------------------------------------
+ */
+static void runBatch(struct injector *inj, const struct campaign_options *opts, const struct montecarlo_options *mc, struct montecarlo_batch *batch, long stream_bits, pid_t *pids, int workers){
+	int live = 0, w;
+
+	pthread_mutex_lock(&batch->lock);
+	batch->generation++;
+	pthread_cond_broadcast(&batch->posted);
+	while (1){
+		live = 0;
+		int waiting = 0;
+		for (w = 0; w < workers; w++){
+			if (pids[w] != 0){
+				live++;
+				waiting += batch->done[w] != batch->generation;
+			}
+		}
+		if (waiting == 0){
+			break;
+		}
+		// Look for dead workers every 100ms
+		struct timespec until;
+		clock_gettime(CLOCK_MONOTONIC, &until);
+		until.tv_nsec += 100000000;
+		if (until.tv_nsec >= 1000000000){
+			until.tv_sec++;
+			until.tv_nsec -= 1000000000;
+		}
+		if (pthread_cond_timedwait(&batch->finished, &batch->lock, &until) == ETIMEDOUT){
+			for (w = 0; w < workers; w++){
+				if (pids[w] != 0 && batch->done[w] != batch->generation){
+					reapWorker(pids, w, 0);
+				}
+			}
+		}
+	}
+	pthread_mutex_unlock(&batch->lock);
+	if (live == 0){
+		batchTrials(inj, opts, mc, batch, batch->rate, stream_bits);
+	}
+}
+
+/*
+ * Function: stopWorkers
+ * -------------------------------------------------------------------------------
+ * Stops the workers of a run and waits for them to exit.
+ * -------------------------------------------------------------------------------
+ */
+static void stopWorkers(struct montecarlo_batch *batch, pid_t *pids, int workers){
+	int w;
+
+	if (workers == 0){
+		return;
+	}
+	pthread_mutex_lock(&batch->lock);
+	batch->stop = 1;
+	pthread_cond_broadcast(&batch->posted);
+	pthread_mutex_unlock(&batch->lock);
+	for (w = 0; w < workers; w++){
+		if (pids[w] != 0){
+			reapWorker(pids, w, 1);
+		}
+	}
+	pthread_cond_destroy(&batch->posted);
+	pthread_cond_destroy(&batch->finished);
+	pthread_mutex_destroy(&batch->lock);
+}
+
+/*
+ * Function: runMonteCarlo
+ * -------------------------------------------------------------------------------
+ * Runs the Monte Carlo trials of every rate against the compressed stream
+ * of the injector, which must already have compressed the field and
+ * decompressed the baseline. opts supplies the bound, the timeout, the
+ * memory cap, the workers and the results file; trials are always
+ * classification only.
+ * -------------------------------------------------------------------------------
+ */
+void runMonteCarlo(struct injector *inj, const struct campaign_options *opts, const struct montecarlo_options *mc){
+	struct campaign_options trial_opts = *opts;
+	size_t compressed_size;
+	long outcomes[CAMPAIGN_PROFILE_OUTCOMES], effects[EFFECT_CHANGED + 1];
+	int num_outcomes = 0, r, i;
+	FILE *out = stdout;
+
+	trial_opts.classify_only = 1;
+	trial_opts.group_size = 0;
+	trial_opts.records = NULL;
+	struct trial_threads threads;
+	campaignSerialTrials(inj, NULL, &threads);
+	injectorStream(inj, &compressed_size);
+	long stream_bits = (long)compressed_size * 8;
+	while (num_outcomes < CAMPAIGN_PROFILE_OUTCOMES && campaignStatusName(num_outcomes)){
+		num_outcomes++;
+	}
+
+	struct montecarlo_batch *batch = mmap(NULL, sizeof(struct montecarlo_batch), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (batch == MAP_FAILED){
+		perror("ERROR: ");
+		exit(-1);
+	}
+	if (opts->results_path){
+		out = fopen(opts->results_path, "a");
+		if (out == NULL){
+			perror("ERROR: ");
+			exit(-1);
+		}
+	}
+	if (ftell(out) <= 0){
+		fprintf(out, "BitErrorRate,ExpectedUpsets,Trials,Failures,FailureProbability,Lower95,Upper95,Converged,MeanUpsets");
+		for (i = 0; i < num_outcomes; i++){
+			fprintf(out, ",%s", campaignStatusName(i));
+		}
+		for (i = 0; i <= EFFECT_CHANGED; i++){
+			fprintf(out, ",%s", effectName(i));
+		}
+		fprintf(out, "\n");
+	}
+	// Trial children must not flush the header again
+	fflush(out);
+	pid_t pids[MONTECARLO_BATCH];
+	int workers = startWorkers(inj, &trial_opts, mc, batch, stream_bits, pids);
+
+	printf("Monte Carlo Stream Bits: %ld\n", stream_bits);
+	for (r = 0; r < mc->num_rates; r++){
+		long trials = 0, failures = 0, upsets = 0;
+		double lower = 0, upper = 1;
+		int converged = 0;
+		memset(outcomes, 0, sizeof(outcomes));
+		memset(effects, 0, sizeof(effects));
+
+		while (trials < mc->max_trials && !converged){
+			batch->rate = r;
+			batch->first = trials;
+			batch->count = mc->max_trials - trials < MONTECARLO_BATCH ? (int)(mc->max_trials - trials) : MONTECARLO_BATCH;
+			batch->next = 0;
+			for (i = 0; i < batch->count; i++){
+				batch->records[i].status = -1;
+				batch->records[i].effect = -1;
+			}
+			if (workers == 0){
+				batchTrials(inj, &trial_opts, mc, batch, r, stream_bits);
+			} else {
+				runBatch(inj, &trial_opts, mc, batch, stream_bits, pids, workers);
+			}
+
+			for (i = 0; i < batch->count; i++){
+				const struct trial_record *record = &batch->records[i];
+				// A trial whose worker died counts as a failure of unknown outcome
+				int status = record->status >= 0 && record->status < num_outcomes ? record->status : num_outcomes - 1;
+				outcomes[status]++;
+				if (status == 0 && record->effect >= 0){
+					effects[record->effect]++;
+				}
+				failures += status != 0 || record->effect == EFFECT_VIOLATION || record->effect == EFFECT_CHANGED;
+				upsets += batch->upsets[i];
+			}
+			trials += batch->count;
+			wilsonInterval(failures, trials, &lower, &upper);
+			converged = (upper - lower) / 2 <= mc->half_width;
+		}
+
+		printf("Error Rate %g: %ld trials, failure probability %f [%f, %f]%s\n", mc->rates[r], trials, (double)failures / trials, lower, upper,
+			converged ? "" : " (not converged)");
+		fprintf(out, "%g,%f,%ld,%ld,%f,%f,%f,%d,%f", mc->rates[r], mc->rates[r] * stream_bits, trials, failures, (double)failures / trials, lower, upper,
+			converged, (double)upsets / trials);
+		for (i = 0; i < num_outcomes; i++){
+			fprintf(out, ",%ld", outcomes[i]);
+		}
+		for (i = 0; i <= EFFECT_CHANGED; i++){
+			fprintf(out, ",%ld", effects[i]);
+		}
+		fprintf(out, "\n");
+		fflush(out);
+	}
+
+	stopWorkers(batch, pids, workers);
+	munmap(batch, sizeof(struct montecarlo_batch));
+	campaignRestoreThreads(inj, NULL, &threads);
+	if (out != stdout){
+		fclose(out);
+	}
+}
@@ -0,0 +1,54 @@
+#ifndef MONTECARLO_H
+#define MONTECARLO_H
+
+#include <stdint.h>
+
+#include "campaign.h"
+
+/*
+ * Monte Carlo upset campaigns.
+ * -------------------------------------------------------------------------------
+ * Estimates, for each bit error rate of a sweep, the probability that a
+ * compressed snapshot comes back unusable. Each trial draws its number of
+ * upsets from a Poisson distribution with mean rate * stream bits,
+ * scatters them over distinct bits of the stream, and decompresses and
+ * classifies like a campaign trial (classification only, see
+ * campaign.h). A trial fails when it does not complete or its output
+ * leaves the pointwise bound (Violation). In a mode without a pointwise
+ * bound any changed output (Changed) counts as failed.
+ *
+ * Trial i of rate r draws from its own counter-based stream, splitmix64
+ * seeded from (seed, r, i), so a trial flips the same bits whichever
+ * worker runs it. Trials run in batches of MONTECARLO_BATCH split across
+ * the workers, which are forked once per run and wait between batches.
+ * After each batch the Wilson score interval of the failure probability is
+ * updated, and a rate stops once the interval's half-width is at most
+ * half_width or max_trials have run. Stopping only looks at
+ * whole batches, so the results are the same for any number of workers.
+ *
+ * Writes one CSV row per rate (the campaign results file, stdout without
+ * one): the failure probability with its 95% interval, whether it
+ * converged, the mean number of upsets and the trials of every outcome and
+ * Effect.
+ * -------------------------------------------------------------------------------
+ */
+
+// Trials between convergence checks
+#define MONTECARLO_BATCH 64
+// Most error rates in one sweep
+#define MONTECARLO_MAX_RATES 64
+
+struct montecarlo_options {
+	// Probability that any one stream bit is upset
+	double rates[MONTECARLO_MAX_RATES];
+	int num_rates;
+	// Target half-width of the 95% interval of the failure probability
+	double half_width;
+	long max_trials;
+	uint64_t seed;
+};
+
+void parseMonteCarlo(const char *spec, struct montecarlo_options *mc);
+void runMonteCarlo(struct injector *inj, const struct campaign_options *opts, const struct montecarlo_options *mc);
+
+#endif
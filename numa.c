@@ -0,0 +1,142 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+
+#include "numa.h"
+
+// CPUs of every node this process may use, filled by numaDiscover
+static cpu_set_t NODE_CPUS[NUMA_MAX_NODES];
+static int NUM_NODES = 0;
+
+/*
+ * Function: parseCpuList
+ * -------------------------------------------------------------------------------
+ * Parses a sysfs cpulist such as "0-7,16-23" into a cpu set.
+ * -------------------------------------------------------------------------------
+ */
+static void parseCpuList(const char *list, cpu_set_t *set){
+	const char *p = list;
+	CPU_ZERO(set);
+	while (*p){
+		char *end;
+		long first = strtol(p, &end, 10);
+		long last = first;
+		if (end == p){
+			break;
+		}
+		if (*end == '-'){
+			p = end + 1;
+			last = strtol(p, &end, 10);
+		}
+		for (; first <= last && first < CPU_SETSIZE; first++){
+			CPU_SET(first, set);
+		}
+		p = *end == ',' ? end + 1 : end;
+	}
+}
+
+/*
+ * Function: numaDiscover
+ * -------------------------------------------------------------------------------
+ * Fills NODE_CPUS once from sysfs.
+ * -------------------------------------------------------------------------------
+ */
+static void numaDiscover(void){
+	cpu_set_t allowed;
+	char path[64], list[4096];
+	int node;
+
+	if (NUM_NODES){
+		return;
+	}
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0){
+		perror("ERROR: ");
+		exit(-1);
+	}
+
+	// Online node numbers use the same list format as cpulist
+	cpu_set_t online;
+	CPU_ZERO(&online);
+	FILE *fp = fopen("/sys/devices/system/node/online", "r");
+	if (fp != NULL){
+		if (fgets(list, sizeof(list), fp) != NULL){
+			parseCpuList(list, &online);
+		}
+		fclose(fp);
+	}
+
+	for (node = 0; node < CPU_SETSIZE; node++){
+		if (!CPU_ISSET(node, &online)){
+			continue;
+		}
+		snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+		fp = fopen(path, "r");
+		if (fp == NULL){
+			continue;
+		}
+		if (fgets(list, sizeof(list), fp) == NULL){
+			list[0] = '\0';
+		}
+		fclose(fp);
+
+		cpu_set_t cpus;
+		parseCpuList(list, &cpus);
+		CPU_AND(&cpus, &cpus, &allowed);
+		if (CPU_COUNT(&cpus) == 0){
+			continue;
+		}
+		if (NUM_NODES == NUMA_MAX_NODES){
+			CPU_OR(&NODE_CPUS[NUM_NODES - 1], &NODE_CPUS[NUM_NODES - 1], &cpus);
+		} else {
+			NODE_CPUS[NUM_NODES++] = cpus;
+		}
+	}
+
+	if (NUM_NODES == 0){
+		NODE_CPUS[0] = allowed;
+		NUM_NODES = 1;
+	}
+}
+
+/*
+ * Function: numaNodes
+ * -------------------------------------------------------------------------------
+ * returns: the number of NUMA nodes with CPUs this process may use
+ * -------------------------------------------------------------------------------
+ */
+int numaNodes(void){
+	numaDiscover();
+	return NUM_NODES;
+}
+
+/*
+ * Function: numaNodeCpus
+ * -------------------------------------------------------------------------------
+ * returns: the number of usable CPUs on a node
+ * -------------------------------------------------------------------------------
+ */
+int numaNodeCpus(int node){
+	numaDiscover();
+	return CPU_COUNT(&NODE_CPUS[node % NUM_NODES]);
+}
+
+/*
+ * Function: numaBind
+ * -------------------------------------------------------------------------------
+ * Restricts the calling process, and every process it forks afterwards, to
+ * the CPUs of one node. Memory it touches first is then allocated on that
+ * node by the kernel's default local policy.
+ *
+ * returns: 0 on success, -1 if the affinity could not be set
+ * -------------------------------------------------------------------------------
+ */
+int numaBind(int node){
+	numaDiscover();
+	if (sched_setaffinity(0, sizeof(cpu_set_t), &NODE_CPUS[node % NUM_NODES]) != 0){
+		perror("WARNING: ");
+		return -1;
+	}
+	return 0;
+}
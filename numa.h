@@ -0,0 +1,20 @@
+#ifndef NUMA_H
+#define NUMA_H
+
+/*
+ * NUMA placement of campaign workers.
+ * -------------------------------------------------------------------------------
+ * Reads the node layout from /sys/devices/system/node, restricted to the
+ * CPUs this process may run on (PBS cpusets included). Nodes without CPUs
+ * are ignored. Without sysfs the whole machine is treated as one node.
+ * -------------------------------------------------------------------------------
+ */
+
+// Most nodes considered, extra nodes are folded into the last one
+#define NUMA_MAX_NODES 64
+
+int numaNodes(void);
+int numaNodeCpus(int node);
+int numaBind(int node);
+
+#endif
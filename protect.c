@@ -0,0 +1,292 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <nmmintrin.h>
+#define PROTECT_SSE42 1
+#endif
+
+#include "protect.h"
+
+// Castagnoli polynomial, reflected
+#define CRC32C_POLY 0x82F63B78u
+
+static const char *PROTECT_STATUS_NAMES[] = { "Clean", "Corrected", "Detected" };
+
+// Byte table of the software CRC32C
+static uint32_t CRC_TABLE[256];
+// -1 until the CPU is checked, then nonzero if it has SSE4.2
+static int CRC_HARDWARE = -1;
+
+// Data bits covered by each Hamming check bit, and the code position of
+// every data bit (positions 1..71 that are not powers of two) and back
+static uint64_t SECDED_MASKS[7];
+static int SECDED_DATA_BIT[128];
+
+/*
+ * Function: protectInit
+ * -------------------------------------------------------------------------------
+ * Fills the CRC table and the SECDED masks and picks the CRC32C
+ * implementation. Only writes the same values, so racing callers are safe.
+ * -------------------------------------------------------------------------------
+ */
+static void protectInit(void){
+	uint32_t n, k;
+	int position, bit = 0, i;
+
+	for (n = 0; n < 256; n++){
+		uint32_t crc = n;
+		for (k = 0; k < 8; k++){
+			crc = crc & 1 ? (crc >> 1) ^ CRC32C_POLY : crc >> 1;
+		}
+		CRC_TABLE[n] = crc;
+	}
+	for (i = 0; i < 128; i++){
+		SECDED_DATA_BIT[i] = -1;
+	}
+	for (position = 1; bit < 64; position++){
+		if ((position & (position - 1)) == 0){
+			continue;
+		}
+		SECDED_DATA_BIT[position] = bit;
+		for (i = 0; i < 7; i++){
+			if (position & (1 << i)){
+				SECDED_MASKS[i] |= 1ULL << bit;
+			}
+		}
+		bit++;
+	}
+#ifdef PROTECT_SSE42
+	__builtin_cpu_init();
+	CRC_HARDWARE = __builtin_cpu_supports("sse4.2") != 0;
+#else
+	CRC_HARDWARE = 0;
+#endif
+}
+
+#ifdef PROTECT_SSE42
+/*
+ * Function: crc32cHardware
+ * -------------------------------------------------------------------------------
+ * CRC32C with the SSE4.2 crc32 instruction, 8 bytes at a time.
+ * -------------------------------------------------------------------------------
+ */
+__attribute__((target("sse4.2")))
+static uint32_t crc32cHardware(uint32_t crc, const uint8_t *data, size_t size){
+	uint64_t crc64 = crc;
+	while (size >= 8){
+		uint64_t word;
+		memcpy(&word, data, 8);
+		crc64 = _mm_crc32_u64(crc64, word);
+		data += 8;
+		size -= 8;
+	}
+	crc = (uint32_t)crc64;
+	while (size--){
+		crc = _mm_crc32_u8(crc, *data++);
+	}
+	return crc;
+}
+#endif
+
+/*
+ * Function: crc32c
+ * -------------------------------------------------------------------------------
+ * returns: the CRC32C of size bytes, continuing from crc (0 to start)
+ * -------------------------------------------------------------------------------
+ */
+uint32_t crc32c(uint32_t crc, const void *data, size_t size){
+	const uint8_t *p = data;
+
+	if (CRC_HARDWARE < 0){
+		protectInit();
+	}
+	crc = ~crc;
+#ifdef PROTECT_SSE42
+	if (CRC_HARDWARE){
+		return ~crc32cHardware(crc, p, size);
+	}
+#endif
+	while (size--){
+		crc = (crc >> 8) ^ CRC_TABLE[(crc ^ *p++) & 0xff];
+	}
+	return ~crc;
+}
+
+/*
+ * Function: secdedCheck
+ * -------------------------------------------------------------------------------
+ * returns: the 8 check bits of a word: 7 Hamming bits, then the parity of
+ * the word and those bits
+ * -------------------------------------------------------------------------------
+ */
+static uint8_t secdedCheck(uint64_t word){
+	uint8_t check = 0;
+	int i;
+	for (i = 0; i < 7; i++){
+		check |= (uint8_t)(__builtin_parityll(word & SECDED_MASKS[i]) << i);
+	}
+	return check | (uint8_t)((__builtin_parityll(word) ^ __builtin_parity(check)) << 7);
+}
+
+/*
+ * Function: headerWord
+ * -------------------------------------------------------------------------------
+ * returns: word w of the header, zero padded past the header or the stream
+ * -------------------------------------------------------------------------------
+ */
+static uint64_t headerWord(const uint8_t *stream, size_t size, size_t header_bytes, size_t w){
+	uint64_t word = 0;
+	size_t end = header_bytes < size ? header_bytes : size;
+	size_t start = 8 * w;
+	if (start < end){
+		memcpy(&word, stream + start, end - start < 8 ? end - start : 8);
+	}
+	return word;
+}
+
+/*
+ * Function: protectParse
+ * -------------------------------------------------------------------------------
+ * Reads a protection spec: "chunk" for CRC32C over chunks of that many
+ * bytes, "chunk:header" to also put SECDED over the first header bytes.
+ *
+ * returns: 0 on success, -1 for a malformed spec
+ * -------------------------------------------------------------------------------
+ */
+int protectParse(const char *spec, size_t *chunk_bytes, size_t *header_bytes){
+	long chunk = 0, header = 0;
+	int fields = sscanf(spec, "%ld:%ld", &chunk, &header);
+	if (fields < 1 || chunk < 1 || header < 0){
+		return -1;
+	}
+	*chunk_bytes = (size_t)chunk;
+	*header_bytes = fields == 2 ? (size_t)header : 0;
+	return 0;
+}
+
+/*
+ * Function: protectCreate
+ * -------------------------------------------------------------------------------
+ * Computes the protection of a clean compressed stream, timing it as the
+ * cost added to compression.
+ *
+ * returns: the protection, exits on bad sizes or allocation failure
+ * -------------------------------------------------------------------------------
+ */
+struct stream_protection *protectCreate(const uint8_t *stream, size_t size, size_t chunk_bytes, size_t header_bytes){
+	struct stream_protection *protection = calloc(1, sizeof(struct stream_protection));
+	struct timeval start, stop;
+	size_t c, w;
+
+	if (protection == NULL || chunk_bytes == 0){
+		printf("ERROR: Invalid stream protection\n");
+		exit(-1);
+	}
+	if (CRC_HARDWARE < 0){
+		protectInit();
+	}
+	protection->chunk_bytes = chunk_bytes;
+	protection->num_chunks = (size + chunk_bytes - 1) / chunk_bytes;
+	protection->header_bytes = header_bytes < size ? header_bytes : size;
+	protection->num_words = (protection->header_bytes + 7) / 8;
+	protection->crcs = malloc(sizeof(uint32_t) * (protection->num_chunks + 1));
+	protection->check = malloc(protection->num_words + 1);
+	if (protection->crcs == NULL || protection->check == NULL){
+		printf("ERROR: could not allocate stream protection\n");
+		exit(-1);
+	}
+
+	gettimeofday(&start, NULL);
+	for (c = 0; c < protection->num_chunks; c++){
+		size_t offset = c * chunk_bytes;
+		protection->crcs[c] = crc32c(0, stream + offset, size - offset < chunk_bytes ? size - offset : chunk_bytes);
+	}
+	for (w = 0; w < protection->num_words; w++){
+		protection->check[w] = secdedCheck(headerWord(stream, size, protection->header_bytes, w));
+	}
+	gettimeofday(&stop, NULL);
+	protection->protect_time = (double)(stop.tv_usec - start.tv_usec) / 1000000 + (double)(stop.tv_sec - start.tv_sec);
+	protection->overhead_bytes = sizeof(uint32_t) * protection->num_chunks + protection->num_words;
+	return protection;
+}
+
+/*
+ * Function: protectVerify
+ * -------------------------------------------------------------------------------
+ * Checks a stream before it is decompressed. Header words with one flipped
+ * bit are corrected in place and the bits listed in check->fixed, so a
+ * caller that flipped bits on purpose can restore its own state. Then
+ * every chunk's CRC32C is compared.
+ * -------------------------------------------------------------------------------
+ */
+void protectVerify(const struct stream_protection *protection, uint8_t *stream, size_t size, struct protect_check *check){
+	struct timeval start, stop;
+	int uncorrectable = 0;
+	size_t c, w;
+
+	gettimeofday(&start, NULL);
+	check->num_fixed = 0;
+	for (w = 0; w < protection->num_words; w++){
+		uint64_t word = headerWord(stream, size, protection->header_bytes, w);
+		uint8_t stored = protection->check[w];
+		int syndrome = (secdedCheck(word) ^ stored) & 0x7f;
+		int parity = __builtin_parityll(word) ^ __builtin_parity(stored);
+		if (syndrome == 0 && parity == 0){
+			continue;
+		}
+		// An even number of flips, or a position past the code
+		int bit = SECDED_DATA_BIT[syndrome];
+		if (!parity || (syndrome & (syndrome - 1)) == 0){
+			uncorrectable |= !parity;
+			continue;
+		}
+		if (bit < 0 || 8 * w + bit / 8 >= protection->header_bytes || check->num_fixed == PROTECT_MAX_FIXES){
+			uncorrectable = 1;
+			continue;
+		}
+		stream[8 * w + bit / 8] ^= (uint8_t)(1 << (bit % 8));
+		check->fixed[check->num_fixed++] = (int)(64 * w + bit);
+	}
+	for (c = 0; c < protection->num_chunks; c++){
+		size_t offset = c * protection->chunk_bytes;
+		size_t length = size - offset < protection->chunk_bytes ? size - offset : protection->chunk_bytes;
+		if (crc32c(0, stream + offset, length) != protection->crcs[c]){
+			uncorrectable = 1;
+			break;
+		}
+	}
+	gettimeofday(&stop, NULL);
+	check->verify_time = (double)(stop.tv_usec - start.tv_usec) / 1000000 + (double)(stop.tv_sec - start.tv_sec);
+	check->status = uncorrectable ? PROTECT_DETECTED : check->num_fixed ? PROTECT_CORRECTED : PROTECT_CLEAN;
+}
+
+/*
+ * Function: protectStatusName
+ * -------------------------------------------------------------------------------
+ * returns: the Protection column of a verification outcome, "NA" for -1
+ * -------------------------------------------------------------------------------
+ */
+const char *protectStatusName(int status){
+	if (status < 0 || status > PROTECT_DETECTED){
+		return "NA";
+	}
+	return PROTECT_STATUS_NAMES[status];
+}
+
+/*
+ * Function: protectFree
+ * -------------------------------------------------------------------------------
+ * Releases a protection, NULL is ignored.
+ * -------------------------------------------------------------------------------
+ */
+void protectFree(struct stream_protection *protection){
+	if (protection == NULL){
+		return;
+	}
+	free(protection->crcs);
+	free(protection->check);
+	free(protection);
+}
@@ -0,0 +1,68 @@
+#ifndef PROTECT_H
+#define PROTECT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Compressed stream protection.
+ * -------------------------------------------------------------------------------
+ * Measures what protecting the compressed stream would cost and catch. The
+ * protection is kept beside the stream, so the decompressor still reads the
+ * stream it always did, and counted as if it were stored with it:
+ *
+ *   CRC32C      of every chunk_bytes of the stream, detects a corrupted
+ *               chunk (SSE4.2 crc32 instruction when the CPU has it, a
+ *               table otherwise)
+ *   SECDED      Hamming (72,64) code over the first header_bytes, where the
+ *               SZ and ZFP headers live: one flipped bit per 8 byte word is
+ *               corrected, two are detected
+ *
+ * protectVerify runs before every decompression of a trial. Header words
+ * are corrected in place first, then every chunk is checked. A trial is
+ * Clean, Corrected (every changed bit repaired, the decompressor sees the
+ * clean stream) or Detected (a chunk still fails). A detected stream is
+ * decompressed anyway, so its row still shows what the fault would have
+ * done unprotected.
+ * -------------------------------------------------------------------------------
+ */
+
+// Stream bits one verification can correct
+#define PROTECT_MAX_FIXES 64
+
+// Outcome of a verification
+#define PROTECT_CLEAN 0
+#define PROTECT_CORRECTED 1
+#define PROTECT_DETECTED 2
+
+struct stream_protection {
+	size_t chunk_bytes;
+	size_t num_chunks;
+	uint32_t *crcs;
+	// Header words under SECDED and their check bytes
+	size_t header_bytes;
+	size_t num_words;
+	uint8_t *check;
+	// Bytes the protection adds to the stream
+	size_t overhead_bytes;
+	// Seconds spent computing the protection after compression
+	double protect_time;
+};
+
+struct protect_check {
+	int status;
+	// Stream bits (byte * 8 + bit) the code flipped back
+	int num_fixed;
+	int fixed[PROTECT_MAX_FIXES];
+	double verify_time;
+};
+
+int protectParse(const char *spec, size_t *chunk_bytes, size_t *header_bytes);
+struct stream_protection *protectCreate(const uint8_t *stream, size_t size, size_t chunk_bytes, size_t header_bytes);
+void protectVerify(const struct stream_protection *protection, uint8_t *stream, size_t size, struct protect_check *check);
+const char *protectStatusName(int status);
+void protectFree(struct stream_protection *protection);
+
+uint32_t crc32c(uint32_t crc, const void *data, size_t size);
+
+#endif
@@ -0,0 +1,172 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+#include "scaling.h"
+#include "injector.h"
+#include "crash.h"
+#include "energy.h"
+
+/*
+ * Timings of one thread count, filled by its child.
+ */
+struct scaling_point {
+	int completed;
+	double compression_ratio;
+	double compress_time;
+	double decompress_time;
+	double compress_joules;
+	double decompress_joules;
+};
+
+/*
+ * Function: parseThreadList
+ * -------------------------------------------------------------------------------
+ * Parses a comma separated list of thread counts, "1,2,4,8,16".
+ *
+ * returns: the number of counts stored in threads
+ * -------------------------------------------------------------------------------
+ */
+int parseThreadList(const char *list, int *threads, int max_threads){
+	int count = 0;
+	const char *p = list;
+
+	while (*p && count < max_threads){
+		char *end;
+		long n = strtol(p, &end, 10);
+		if (end == p || n < 1){
+			printf("ERROR: Thread counts must be positive integers: %s\n", list);
+			exit(-1);
+		}
+		threads[count++] = (int)n;
+		p = *end == ',' ? end + 1 : end;
+		if (*end != ',' && *end != '\0'){
+			printf("ERROR: Thread counts must be comma separated: %s\n", list);
+			exit(-1);
+		}
+	}
+	return count;
+}
+
+/*
+ * Function: scalingPoint
+ * -------------------------------------------------------------------------------
+ * Child side of one thread count: configures a fresh compressor and keeps
+ * the fastest of SCALING_REPEATS compressions and clean decompressions.
+ * -------------------------------------------------------------------------------
+ */
+static void scalingPoint(const char *compressor, const char *error_bounding_mode, float error_bound, struct buffer_arena *arena, int threads, int energy, struct scaling_point *point){
+	char value[16];
+	int r;
+
+	snprintf(value, sizeof(value), "%d", threads);
+	setenv("OMP_NUM_THREADS", value, 1);
+
+	struct injector *inj = injectorCreate(compressor, error_bounding_mode, error_bound, arena);
+	crashRefreshModules();
+	injectorSetThreads(inj, threads);
+
+	for (r = 0; r < SCALING_REPEATS; r++){
+		double decompress_time;
+		injectorCompress(inj);
+		injectorTrial(inj, -1, 0, 0, &decompress_time);
+		if (r == 0 || inj->compress_time < point->compress_time){
+			point->compress_time = inj->compress_time;
+		}
+		if (r == 0 || decompress_time < point->decompress_time){
+			point->decompress_time = decompress_time;
+		}
+	}
+	point->compression_ratio = inj->compression_ratio;
+	point->compress_joules = -1;
+	point->decompress_joules = -1;
+	if (energy && energyInit()){
+		struct energy_measurement m;
+		energyCompress(inj, &m);
+		point->compress_joules = m.package_joules + m.dram_joules;
+		energyDecompress(inj, &m);
+		point->decompress_joules = m.package_joules + m.dram_joules;
+	}
+	point->completed = 1;
+	injectorFree(inj);
+}
+
+/*
+ * Function: runScaling
+ * -------------------------------------------------------------------------------
+ * Runs the sweep and prints one line per thread count. With results_path
+ * the timings are also appended there as CSV.
+ * -------------------------------------------------------------------------------
+ */
+void runScaling(const char *compressor, const char *error_bounding_mode, float error_bound, struct buffer_arena *arena, const int *threads, int num_threads, int energy, const char *results_path){
+	struct scaling_point *points = mmap(NULL, sizeof(struct scaling_point) * num_threads, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	FILE *out = NULL;
+	int i;
+
+	if (points == MAP_FAILED){
+		perror("ERROR: ");
+		exit(-1);
+	}
+	memset(points, 0, sizeof(struct scaling_point) * num_threads);
+	if (results_path){
+		out = fopen(results_path, "a");
+		if (out == NULL){
+			perror("ERROR: ");
+			exit(-1);
+		}
+		if (ftell(out) <= 0){
+			fprintf(out, "Compressor,ErrorMode,ErrorBound,DataSize,CompressionRatio,Threads,CompressTime,DecompressTime,CompressSpeedup,DecompressSpeedup,"
+				"CompressJoules,DecompressJoules,CompressJoulesPerGB,DecompressJoulesPerGB\n");
+		}
+	}
+
+	if (energy && !energyInit()){
+		printf("Energy: RAPL counters not available\n");
+	}
+	for (i = 0; i < num_threads; i++){
+		int status = 0;
+		fflush(stdout);
+		pid_t pid = fork();
+		if (pid < 0){
+			perror("ERROR: ");
+			exit(-1);
+		}
+		if (pid == 0){
+			scalingPoint(compressor, error_bounding_mode, error_bound, arena, threads[i], energy, &points[i]);
+			fflush(stdout);
+			_exit(0);
+		}
+		while (waitpid(pid, &status, 0) < 0 && errno == EINTR){
+		}
+
+		struct scaling_point *p = &points[i];
+		if (!p->completed){
+			printf("Scaling Threads: %d failed\n", threads[i]);
+			continue;
+		}
+		double compress_speedup = points[0].completed && p->compress_time > 0 ? points[0].compress_time / p->compress_time : 0;
+		double decompress_speedup = points[0].completed && p->decompress_time > 0 ? points[0].decompress_time / p->decompress_time : 0;
+		double gb = sizeof(float) * arena->num_elements / 1e9;
+		double compress_per_gb = p->compress_joules >= 0 ? p->compress_joules / gb : -1;
+		double decompress_per_gb = p->decompress_joules >= 0 ? p->decompress_joules / gb : -1;
+		printf("Scaling Threads: %d Compress: %lf Decompress: %lf Speedup: %.2f %.2f\n", threads[i], p->compress_time, p->decompress_time, compress_speedup, decompress_speedup);
+		if (p->compress_joules >= 0){
+			printf("Scaling Threads: %d Energy per GB: %lf %lf\n", threads[i], compress_per_gb, decompress_per_gb);
+		}
+		if (out){
+			fprintf(out, "%s,%s,%0.12f,%ld,%lf,%d,%lf,%lf,%f,%f,%lf,%lf,%lf,%lf\n", compressor, error_bounding_mode, error_bound, (long)(sizeof(float) * arena->num_elements),
+				p->compression_ratio, threads[i], p->compress_time, p->decompress_time, compress_speedup, decompress_speedup,
+				p->compress_joules, p->decompress_joules, compress_per_gb, decompress_per_gb);
+		}
+	}
+
+	if (out){
+		fclose(out);
+	}
+	munmap(points, sizeof(struct scaling_point) * num_threads);
+}
@@ -0,0 +1,27 @@
+#ifndef SCALING_H
+#define SCALING_H
+
+#include "arena.h"
+
+/*
+ * Compressor strong scaling.
+ * -------------------------------------------------------------------------------
+ * Times the clean compression and decompression of one field at each thread
+ * count of a sweep. Every thread count runs in its own forked child, so
+ * OMP_NUM_THREADS is set before the OpenMP runtime of that child starts and
+ * no thread pool is carried over from an earlier count. The best of
+ * SCALING_REPEATS runs is kept, speedups are relative to the first count.
+ * With energy, each count also reports package plus DRAM joules per
+ * compression and decompression (see energy.h), -1 when not measured.
+ * -------------------------------------------------------------------------------
+ */
+
+// Runs per thread count, the fastest is reported
+#define SCALING_REPEATS 3
+// Most thread counts in one sweep
+#define SCALING_MAX_POINTS 64
+
+int parseThreadList(const char *list, int *threads, int max_threads);
+void runScaling(const char *compressor, const char *error_bounding_mode, float error_bound, struct buffer_arena *arena, const int *threads, int num_threads, int energy, const char *results_path);
+
+#endif
@@ -0,0 +1,273 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "sketch.h"
+
+// Smallest compactor size, below this compaction costs more than it saves
+#define SKETCH_KLL_MIN_CAPACITY 8
+
+/*
+ * Function: kllCapacity
+ * -------------------------------------------------------------------------------
+ * Capacity of level h in a sketch with num_levels levels. The top level holds
+ * k items and every level below it two thirds of the one above.
+ * -------------------------------------------------------------------------------
+ */
+static size_t kllCapacity(int h, int num_levels){
+	double cap = ceil(SKETCH_KLL_K * pow(2.0 / 3.0, num_levels - 1 - h));
+	return cap < SKETCH_KLL_MIN_CAPACITY ? SKETCH_KLL_MIN_CAPACITY : (size_t)cap;
+}
+
+/*
+ * Function: kllAddLevel
+ * -------------------------------------------------------------------------------
+ * Adds an empty level on top and recomputes the retained item limit.
+ * -------------------------------------------------------------------------------
+ */
+static void kllAddLevel(struct kll_sketch *kll){
+	int h;
+	if (kll->num_levels == SKETCH_KLL_MAX_LEVELS){
+		printf("ERROR: quantile sketch out of levels\n");
+		exit(-1);
+	}
+	kll->num_levels++;
+	kll->max_retained = 0;
+	for (h = 0; h < kll->num_levels; h++){
+		kll->max_retained += kllCapacity(h, kll->num_levels);
+	}
+}
+
+/*
+ * Function: kllPush
+ * -------------------------------------------------------------------------------
+ * Appends items to one level, growing its storage as needed.
+ * -------------------------------------------------------------------------------
+ */
+static void kllPush(struct kll_sketch *kll, int h, const float *items, size_t n){
+	struct kll_level *level = &kll->levels[h];
+	if (level->size + n > level->capacity){
+		size_t capacity = level->capacity ? level->capacity : SKETCH_KLL_MIN_CAPACITY;
+		while (capacity < level->size + n){
+			capacity *= 2;
+		}
+		level->items = realloc(level->items, sizeof(float) * capacity);
+		if (level->items == NULL){
+			printf("ERROR: quantile sketch out of memory\n");
+			exit(-1);
+		}
+		level->capacity = capacity;
+	}
+	memcpy(level->items + level->size, items, sizeof(float) * n);
+	level->size += n;
+	kll->retained += n;
+}
+
+static int compareFloat(const void *a, const void *b){
+	float x = *(const float *)a;
+	float y = *(const float *)b;
+	return (x > y) - (x < y);
+}
+
+/*
+ * Function: kllCompress
+ * -------------------------------------------------------------------------------
+ * Compacts the lowest full level: its items are sorted and every other one,
+ * starting at a random offset, is promoted to the next level with twice the
+ * weight. An odd item out stays behind.
+ * -------------------------------------------------------------------------------
+ */
+static void kllCompress(struct kll_sketch *kll){
+	int h;
+	for (h = 0; h < kll->num_levels; h++){
+		struct kll_level *level = &kll->levels[h];
+		size_t pairs, i, offset;
+		float leftover = 0;
+		int odd;
+
+		if (level->size < kllCapacity(h, kll->num_levels)){
+			continue;
+		}
+		if (h + 1 == kll->num_levels){
+			kllAddLevel(kll);
+		}
+
+		qsort(level->items, level->size, sizeof(float), compareFloat);
+		odd = level->size & 1;
+		if (odd){
+			leftover = level->items[level->size - 1];
+		}
+		pairs = level->size / 2;
+
+		// xorshift64 picks which item of each pair survives
+		kll->rng ^= kll->rng << 13;
+		kll->rng ^= kll->rng >> 7;
+		kll->rng ^= kll->rng << 17;
+		offset = kll->rng & 1;
+		for (i = 0; i < pairs; i++){
+			level->items[i] = level->items[2 * i + offset];
+		}
+		kll->retained -= level->size;
+		level->size = 0;
+		kllPush(kll, h + 1, level->items, pairs);
+		if (odd){
+			kllPush(kll, h, &leftover, 1);
+		}
+		return;
+	}
+}
+
+/*
+ * Function: kllAdd
+ * -------------------------------------------------------------------------------
+ * Adds one value to the quantile sketch.
+ * -------------------------------------------------------------------------------
+ */
+void kllAdd(struct kll_sketch *kll, float value){
+	struct kll_level *level = &kll->levels[0];
+	kll->count++;
+	if (level->size < level->capacity){
+		level->items[level->size++] = value;
+		kll->retained++;
+	} else {
+		kllPush(kll, 0, &value, 1);
+	}
+	if (kll->retained > kll->max_retained){
+		kllCompress(kll);
+	}
+}
+
+/*
+ * Function: sketchInit
+ * -------------------------------------------------------------------------------
+ * Initializes an empty sketch.
+ *
+ * seed: seeds the KLL compaction coin flips, making sketches reproducible
+ * -------------------------------------------------------------------------------
+ */
+void sketchInit(struct error_sketch *s, uint64_t seed){
+	memset(s, 0, sizeof(struct error_sketch));
+	s->kll.rng = seed ? seed : 0x2545F4914F6CDD1Dull;
+	kllAddLevel(&s->kll);
+}
+
+/*
+ * Function: sketchFree
+ * -------------------------------------------------------------------------------
+ * Releases the storage held by a sketch.
+ * -------------------------------------------------------------------------------
+ */
+void sketchFree(struct error_sketch *s){
+	int h;
+	for (h = 0; h < SKETCH_KLL_MAX_LEVELS; h++){
+		free(s->kll.levels[h].items);
+		s->kll.levels[h].items = NULL;
+		s->kll.levels[h].size = 0;
+		s->kll.levels[h].capacity = 0;
+	}
+}
+
+struct weighted_item {
+	float value;
+	uint64_t weight;
+};
+
+static int compareWeighted(const void *a, const void *b){
+	float x = ((const struct weighted_item *)a)->value;
+	float y = ((const struct weighted_item *)b)->value;
+	return (x > y) - (x < y);
+}
+
+/*
+ * Function: sketchQuantile
+ * -------------------------------------------------------------------------------
+ * Estimates an error quantile from the KLL sketch.
+ *
+ * q: the quantile in [0, 1]
+ *
+ * returns: the estimated error, NAN for an empty sketch
+ * -------------------------------------------------------------------------------
+ */
+double sketchQuantile(const struct error_sketch *s, double q){
+	const struct kll_sketch *kll = &s->kll;
+	struct weighted_item *items;
+	uint64_t total = 0, seen = 0;
+	size_t n = 0, i;
+	int h;
+	double result;
+
+	if (kll->retained == 0){
+		return NAN;
+	}
+	items = malloc(sizeof(struct weighted_item) * kll->retained);
+	for (h = 0; h < kll->num_levels; h++){
+		for (i = 0; i < kll->levels[h].size; i++){
+			items[n].value = kll->levels[h].items[i];
+			items[n].weight = (uint64_t)1 << h;
+			total += items[n].weight;
+			n++;
+		}
+	}
+	qsort(items, n, sizeof(struct weighted_item), compareWeighted);
+
+	result = items[n - 1].value;
+	for (i = 0; i < n; i++){
+		seen += items[i].weight;
+		if ((double)seen >= q * (double)total){
+			result = items[i].value;
+			break;
+		}
+	}
+	free(items);
+	return result;
+}
+
+/*
+ * Function: sketchFormatHistogram
+ * -------------------------------------------------------------------------------
+ * Formats the histogram as lower_bound:count for every non-empty bucket,
+ * separated by spaces. A bucket spans a quarter power of two, the last ones
+ * hold Inf/NaN errors.
+ *
+ * returns: the number of characters written (truncated to fit buf)
+ * -------------------------------------------------------------------------------
+ */
+int sketchFormatHistogram(const struct error_sketch *s, char *buf, size_t size){
+	size_t used = 0;
+	int i;
+
+	buf[0] = '\0';
+	for (i = 0; i < SKETCH_HISTOGRAM_BUCKETS && used < size; i++){
+		if (s->histogram[i]){
+			uint32_t bits = (uint32_t)i << 21;
+			float lower;
+			memcpy(&lower, &bits, sizeof(lower));
+			int n = snprintf(buf + used, size - used, "%s%g:%llu", used ? " " : "", lower, (unsigned long long)s->histogram[i]);
+			if (n < 0){
+				break;
+			}
+			used += n;
+		}
+	}
+	return used < size ? (int)used : (int)size - 1;
+}
+
+/*
+ * Function: sketchPrint
+ * -------------------------------------------------------------------------------
+ * Prints the sketch in the "Name: value" form parsed by comp_inj_runner.py.
+ * -------------------------------------------------------------------------------
+ */
+void sketchPrint(const struct error_sketch *s){
+	char histogram[SKETCH_HISTOGRAM_TEXT];
+
+	printf("Error P50: %e\n", sketchQuantile(s, 0.5));
+	printf("Error P99: %e\n", sketchQuantile(s, 0.99));
+	printf("Error P99.9: %e\n", sketchQuantile(s, 0.999));
+	printf("NaN Outputs: %llu\n", (unsigned long long)s->nan_outputs);
+	printf("Inf Outputs: %llu\n", (unsigned long long)s->inf_outputs);
+	printf("Subnormal Outputs: %llu\n", (unsigned long long)s->subnormal_outputs);
+	sketchFormatHistogram(s, histogram, sizeof(histogram));
+	printf("Error Histogram: %s\n", histogram);
+}
@@ -0,0 +1,96 @@
+#ifndef SKETCH_H
+#define SKETCH_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Streaming error-distribution sketches.
+ * -------------------------------------------------------------------------------
+ * Summarizes the absolute error |original - decompressed| of every element in
+ * the same pass as the other metrics, without keeping the errors around:
+ *
+ *   - a log-bucketed histogram: one bucket per quarter power of two, taken
+ *     straight from the float exponent and the top two mantissa bits,
+ *   - a KLL quantile sketch for p50/p99/p99.9 error (rank error about 1%
+ *     with SKETCH_KLL_K = 200),
+ *   - counts of NaN, Inf and subnormal decompressed values.
+ *
+ * Each trial keeps its own sketch, printed with the trial's row.
+ * -------------------------------------------------------------------------------
+ */
+
+#define SKETCH_HISTOGRAM_BUCKETS 1024
+#define SKETCH_KLL_K 200
+#define SKETCH_KLL_MAX_LEVELS 48
+// Room for every histogram bucket printed as lower_bound:count
+#define SKETCH_HISTOGRAM_TEXT (SKETCH_HISTOGRAM_BUCKETS * 36)
+
+struct kll_level {
+	float *items;
+	size_t size;
+	size_t capacity;
+};
+
+struct kll_sketch {
+	struct kll_level levels[SKETCH_KLL_MAX_LEVELS];
+	int num_levels;
+	// Items currently held over all levels and the limit before compacting
+	size_t retained;
+	size_t max_retained;
+	uint64_t count;
+	uint64_t rng;
+};
+
+struct error_sketch {
+	uint64_t histogram[SKETCH_HISTOGRAM_BUCKETS];
+	struct kll_sketch kll;
+	uint64_t count;
+	uint64_t nan_outputs;
+	uint64_t inf_outputs;
+	uint64_t subnormal_outputs;
+};
+
+void sketchInit(struct error_sketch *s, uint64_t seed);
+void sketchFree(struct error_sketch *s);
+double sketchQuantile(const struct error_sketch *s, double q);
+int sketchFormatHistogram(const struct error_sketch *s, char *buf, size_t size);
+void sketchPrint(const struct error_sketch *s);
+
+void kllAdd(struct kll_sketch *kll, float value);
+
+/*
+ * Function: sketchAdd
+ * -------------------------------------------------------------------------------
+ * Adds one element to the sketch. Inlined because it runs once per element
+ * inside the metric loops.
+ *
+ * diff: absolute error of the element
+ * output: the decompressed value of the element
+ * -------------------------------------------------------------------------------
+ */
+static inline void sketchAdd(struct error_sketch *s, float diff, float output){
+	uint32_t bits, out_bits;
+	__builtin_memcpy(&bits, &diff, sizeof(bits));
+	__builtin_memcpy(&out_bits, &output, sizeof(out_bits));
+	bits &= 0x7FFFFFFFu;
+	out_bits &= 0x7FFFFFFFu;
+
+	s->count++;
+	s->histogram[bits >> 21]++;
+	if (out_bits >= 0x7F800000u){
+		if (out_bits == 0x7F800000u){
+			s->inf_outputs++;
+		} else {
+			s->nan_outputs++;
+		}
+	} else if (out_bits != 0 && out_bits < 0x00800000u){
+		s->subnormal_outputs++;
+	}
+	// NaN errors have no rank, they are already counted in the histogram
+	if (bits <= 0x7F800000u){
+		kllAdd(&s->kll, diff);
+	}
+}
+
+#endif
@@ -0,0 +1,206 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+
+#include "telemetry.h"
+
+static int64_t nowMicroseconds(void){
+	struct timeval now;
+	gettimeofday(&now, NULL);
+	return (int64_t)now.tv_sec * 1000000 + now.tv_usec;
+}
+
+/*
+ * Function: latencyBucket
+ * -------------------------------------------------------------------------------
+ * returns: the histogram bucket of a latency in seconds
+ * -------------------------------------------------------------------------------
+ */
+static int latencyBucket(double latency){
+	double us = latency * 1e6;
+	int e;
+	if (us < 1){
+		return 0;
+	}
+	double frac = frexp(us, &e);
+	// frac is in [0.5, 1), split every power of two in 4
+	int bucket = 1 + (e - 1) * 4 + (int)((frac - 0.5) * 8);
+	return bucket < TELEMETRY_LATENCY_BUCKETS ? bucket : TELEMETRY_LATENCY_BUCKETS - 1;
+}
+
+/*
+ * Function: bucketUpper
+ * -------------------------------------------------------------------------------
+ * returns: the upper bound of a latency bucket in seconds
+ * -------------------------------------------------------------------------------
+ */
+static double bucketUpper(int bucket){
+	if (bucket == 0){
+		return 1e-6;
+	}
+	int e = (bucket - 1) / 4;
+	int sub = (bucket - 1) % 4;
+	return ldexp(1.0 + (sub + 1) / 4.0, e) * 1e-6;
+}
+
+/*
+ * Function: telemetryCreate
+ * -------------------------------------------------------------------------------
+ * Maps the counters shared with every worker forked afterwards.
+ * -------------------------------------------------------------------------------
+ */
+struct campaign_telemetry *telemetryCreate(int num_workers, long total_trials){
+	struct campaign_telemetry *t = mmap(NULL, sizeof(struct campaign_telemetry), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (t == MAP_FAILED){
+		perror("ERROR: ");
+		exit(-1);
+	}
+	memset(t, 0, sizeof(struct campaign_telemetry));
+	t->num_workers = num_workers < TELEMETRY_MAX_WORKERS ? num_workers : TELEMETRY_MAX_WORKERS;
+	t->total_trials = total_trials;
+	t->start_us = nowMicroseconds();
+	t->last_write_us = t->start_us;
+	return t;
+}
+
+/*
+ * Function: telemetryRecord
+ * -------------------------------------------------------------------------------
+ * Counts one finished trial. Safe to call from any worker at once.
+ *
+ * latency: wall clock seconds of the trial, fork to reap
+ * -------------------------------------------------------------------------------
+ */
+void telemetryRecord(struct campaign_telemetry *t, int worker, int outcome, double latency){
+	if (worker >= TELEMETRY_MAX_WORKERS){
+		worker = TELEMETRY_MAX_WORKERS - 1;
+	}
+	if (outcome >= TELEMETRY_MAX_OUTCOMES){
+		outcome = TELEMETRY_MAX_OUTCOMES - 1;
+	}
+	__sync_fetch_and_add(&t->trials, 1);
+	__sync_fetch_and_add(&t->outcomes[outcome], 1);
+	__sync_fetch_and_add(&t->worker_trials[worker], 1);
+	__sync_fetch_and_add(&t->worker_busy_us[worker], (int64_t)(latency * 1e6));
+	__sync_fetch_and_add(&t->latency[latencyBucket(latency)], 1);
+}
+
+/*
+ * Function: latencyQuantile
+ * -------------------------------------------------------------------------------
+ * returns: the upper bound of the bucket holding quantile q, 0 if empty
+ * -------------------------------------------------------------------------------
+ */
+static double latencyQuantile(const long *histogram, long total, double q){
+	long seen = 0;
+	int b;
+	if (total == 0){
+		return 0;
+	}
+	for (b = 0; b < TELEMETRY_LATENCY_BUCKETS; b++){
+		seen += histogram[b];
+		if ((double)seen >= q * (double)total){
+			return bucketUpper(b);
+		}
+	}
+	return bucketUpper(TELEMETRY_LATENCY_BUCKETS - 1);
+}
+
+/*
+ * Function: telemetryWrite
+ * -------------------------------------------------------------------------------
+ * Rewrites the Prometheus text file. The file is written next to path and
+ * renamed over it, so readers never see half a file.
+ * -------------------------------------------------------------------------------
+ */
+void telemetryWrite(struct campaign_telemetry *t, const char *path, const char *const *outcome_names, int num_outcomes){
+	char tmp_path[4096];
+	long histogram[TELEMETRY_LATENCY_BUCKETS];
+	long latency_total = 0;
+	int64_t now = nowMicroseconds();
+	double elapsed = (now - t->start_us) / 1e6;
+	int i;
+
+	// Snapshot, counters keep moving while we write
+	long trials = __sync_fetch_and_add(&t->trials, 0);
+	for (i = 0; i < TELEMETRY_LATENCY_BUCKETS; i++){
+		histogram[i] = __sync_fetch_and_add(&t->latency[i], 0);
+		latency_total += histogram[i];
+	}
+
+	double interval = (now - t->last_write_us) / 1e6;
+	if (interval > 0){
+		t->recent_rate = (trials - t->last_trials) / interval;
+	}
+	t->last_write_us = now;
+	t->last_trials = trials;
+	double rate = elapsed > 0 ? trials / elapsed : 0;
+	long remaining = t->total_trials - trials;
+	double eta_rate = t->recent_rate > 0 ? t->recent_rate : rate;
+	double eta = remaining <= 0 ? 0 : eta_rate > 0 ? remaining / eta_rate : -1;
+
+	snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+	FILE *fp = fopen(tmp_path, "w");
+	if (fp == NULL){
+		perror("WARNING: ");
+		return;
+	}
+	fprintf(fp, "# HELP carts_trials_total Trials finished\n# TYPE carts_trials_total counter\n");
+	fprintf(fp, "carts_trials_total %ld\n", trials);
+	fprintf(fp, "# HELP carts_trials_remaining Trials left in the campaign\n# TYPE carts_trials_remaining gauge\n");
+	fprintf(fp, "carts_trials_remaining %ld\n", remaining > 0 ? remaining : 0);
+	fprintf(fp, "# HELP carts_trials_per_second Trial throughput since the last update and since the start\n# TYPE carts_trials_per_second gauge\n");
+	fprintf(fp, "carts_trials_per_second{window=\"recent\"} %f\n", t->recent_rate);
+	fprintf(fp, "carts_trials_per_second{window=\"campaign\"} %f\n", rate);
+	fprintf(fp, "# HELP carts_eta_seconds Estimated seconds to finish at the recent rate, -1 if unknown\n# TYPE carts_eta_seconds gauge\n");
+	fprintf(fp, "carts_eta_seconds %f\n", eta);
+	fprintf(fp, "# HELP carts_elapsed_seconds Seconds since the campaign started\n# TYPE carts_elapsed_seconds gauge\n");
+	fprintf(fp, "carts_elapsed_seconds %f\n", elapsed);
+
+	fprintf(fp, "# HELP carts_outcomes_total Trials finished per outcome\n# TYPE carts_outcomes_total counter\n");
+	for (i = 0; i < num_outcomes && i < TELEMETRY_MAX_OUTCOMES; i++){
+		fprintf(fp, "carts_outcomes_total{status=\"%s\"} %ld\n", outcome_names[i], __sync_fetch_and_add(&t->outcomes[i], 0));
+	}
+
+	fprintf(fp, "# HELP carts_trial_latency_seconds Trial wall clock time, fork to reap\n# TYPE carts_trial_latency_seconds summary\n");
+	fprintf(fp, "carts_trial_latency_seconds{quantile=\"0.5\"} %e\n", latencyQuantile(histogram, latency_total, 0.5));
+	fprintf(fp, "carts_trial_latency_seconds{quantile=\"0.99\"} %e\n", latencyQuantile(histogram, latency_total, 0.99));
+	fprintf(fp, "carts_trial_latency_seconds_count %ld\n", latency_total);
+
+	fprintf(fp, "# HELP carts_worker_trials_total Trials finished per worker\n# TYPE carts_worker_trials_total counter\n");
+	for (i = 0; i < t->num_workers; i++){
+		fprintf(fp, "carts_worker_trials_total{worker=\"%d\"} %ld\n", i, __sync_fetch_and_add(&t->worker_trials[i], 0));
+	}
+	fprintf(fp, "# HELP carts_worker_utilization Fraction of the campaign a worker spent running trials\n# TYPE carts_worker_utilization gauge\n");
+	for (i = 0; i < t->num_workers; i++){
+		int64_t busy = __sync_fetch_and_add(&t->worker_busy_us[i], 0);
+		fprintf(fp, "carts_worker_utilization{worker=\"%d\"} %f\n", i, elapsed > 0 ? busy / 1e6 / elapsed : 0);
+	}
+	fclose(fp);
+
+	if (rename(tmp_path, path) != 0){
+		perror("WARNING: ");
+	}
+}
+
+/*
+ * Function: telemetryTick
+ * -------------------------------------------------------------------------------
+ * Rewrites the file once interval seconds have passed since the last write.
+ * -------------------------------------------------------------------------------
+ */
+void telemetryTick(struct campaign_telemetry *t, const char *path, int interval, const char *const *outcome_names, int num_outcomes){
+	if (path == NULL){
+		return;
+	}
+	if (nowMicroseconds() - t->last_write_us >= (int64_t)interval * 1000000){
+		telemetryWrite(t, path, outcome_names, num_outcomes);
+	}
+}
+
+void telemetryFree(struct campaign_telemetry *t){
+	munmap(t, sizeof(struct campaign_telemetry));
+}
@@ -0,0 +1,48 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+
+/*
+ * Live campaign telemetry.
+ * -------------------------------------------------------------------------------
+ * Counters live in shared memory and are only ever updated with atomic
+ * adds, so every worker records its trials without locking. The campaign
+ * process periodically rewrites a Prometheus text file from them (for the
+ * node_exporter textfile collector, or just cat/watch) with throughput,
+ * outcome totals, per-worker utilization, trial latency quantiles and an
+ * ETA from the remaining trial count.
+ * -------------------------------------------------------------------------------
+ */
+
+// Most workers and outcome classes tracked
+#define TELEMETRY_MAX_WORKERS 256
+#define TELEMETRY_MAX_OUTCOMES 16
+// Trial latency histogram: 4 buckets per power of two microseconds
+#define TELEMETRY_LATENCY_BUCKETS 256
+
+struct campaign_telemetry {
+	int num_workers;
+	long total_trials;
+	// Campaign start, microseconds since the epoch
+	int64_t start_us;
+
+	long trials;
+	long outcomes[TELEMETRY_MAX_OUTCOMES];
+	long worker_trials[TELEMETRY_MAX_WORKERS];
+	int64_t worker_busy_us[TELEMETRY_MAX_WORKERS];
+	long latency[TELEMETRY_LATENCY_BUCKETS];
+
+	// Writer state, only touched by the campaign process
+	int64_t last_write_us;
+	long last_trials;
+	double recent_rate;
+};
+
+struct campaign_telemetry *telemetryCreate(int num_workers, long total_trials);
+void telemetryRecord(struct campaign_telemetry *t, int worker, int outcome, double latency);
+void telemetryWrite(struct campaign_telemetry *t, const char *path, const char *const *outcome_names, int num_outcomes);
+void telemetryTick(struct campaign_telemetry *t, const char *path, int interval, const char *const *outcome_names, int num_outcomes);
+void telemetryFree(struct campaign_telemetry *t);
+
+#endif
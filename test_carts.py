@@ -0,0 +1,45 @@
+import sys
+import unittest
+
+import numpy as np
+
+import carts
+
+# Checks of the carts Python bindings against a real compressor build.
+#
+# Usage: make carts && python3 test_carts.py [field.bin]
+# The field defaults to the Hurricane sample in data/.
+
+FIELD = "data/Hurricane/hurricane_1_500_500.bin"
+
+
+class TrialOutputTest(unittest.TestCase):
+
+	def setUp(self):
+		self.field = np.fromfile(FIELD, np.float32)
+		self.inj = carts.Injector(self.field, "sz", "ABS", 1e-3)
+		self.inj.compress()
+
+	def test_sz_trial_output(self):
+		# SZ replaces the output buffer, the trial output must still be the
+		# decompressed data and not the arena's untouched buffer
+		baseline = np.array(self.inj.baseline())
+		stream_bytes = len(memoryview(self.inj.stream()))
+		completed = 0
+		for byte in range(stream_bytes // 2, stream_bytes // 2 + 8):
+			trial = self.inj.inject_and_decompress(byte, 0)
+			if trial["status"] != "Completed":
+				continue
+			completed += 1
+			output = np.asarray(trial["output"])
+			self.assertEqual(output.shape, self.field.shape)
+			self.assertAlmostEqual(float(np.abs(output - self.field).max()), trial["max_difference"], places=4)
+		self.assertGreater(completed, 0)
+		# Trials never write into the baseline
+		self.assertTrue(np.array_equal(np.asarray(self.inj.baseline()), baseline))
+
+
+if __name__ == "__main__":
+	if len(sys.argv) > 1:
+		FIELD = sys.argv.pop(1)
+	unittest.main()
@@ -0,0 +1,247 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "trace.h"
+
+/*
+ * One span. Trial spans carry the stream bits they flipped and the outcome.
+ */
+struct trace_event {
+	int64_t start_ns;
+	int64_t duration_ns;
+	int32_t first_bit;
+	int16_t count;
+	int8_t kind;
+	int8_t status;
+};
+
+/*
+ * Events of one track. head counts every event written, the ring keeps the
+ * last TRACE_RING_EVENTS of them.
+ */
+struct trace_ring {
+	long head;
+	struct trace_event events[TRACE_RING_EVENTS];
+};
+
+static const char *KIND_NAMES[TRACE_KINDS] = {
+	"load", "compress", "baseline", "idle", "trial", "flip", "decompress", "metrics", "write", "crash"
+};
+
+// Shared rings, NULL while tracing is off
+static struct trace_ring *RINGS = NULL;
+static const char *TRACE_PATH = NULL;
+static int SAMPLE_EVERY = 1;
+static int64_t TRACE_START = 0;
+// Only the process that started tracing writes the file
+static pid_t TRACE_PID = 0;
+static const char *(*STATUS_NAME)(int) = NULL;
+
+// Track of the calling thread, and whether its current trial is sampled out
+static __thread int TRACK = TRACE_TRACK_MAIN;
+static __thread int SKIP = 0;
+static __thread long TRIALS = 0;
+
+/*
+ * Function: traceNow
+ * -------------------------------------------------------------------------------
+ * returns: monotonic nanoseconds, comparable across processes
+ * -------------------------------------------------------------------------------
+ */
+int64_t traceNow(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/*
+ * Function: traceRecord
+ * -------------------------------------------------------------------------------
+ * Appends an event to a track. The head is published after the event so a
+ * reader never sees a half written one.
+ * -------------------------------------------------------------------------------
+ */
+static void traceRecord(int track, int kind, int64_t start, int64_t end, int first_bit, int count, int status){
+	struct trace_ring *ring = &RINGS[track];
+	long head = ring->head;
+	struct trace_event *e = &ring->events[head % TRACE_RING_EVENTS];
+
+	e->start_ns = start;
+	e->duration_ns = end - start;
+	e->first_bit = first_bit;
+	e->count = (int16_t)count;
+	e->kind = (int8_t)kind;
+	e->status = (int8_t)status;
+	__atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * Function: trackName
+ * -------------------------------------------------------------------------------
+ * Names a track for the thread_name metadata of the viewer.
+ * -------------------------------------------------------------------------------
+ */
+static void trackName(int track, char *name, size_t size){
+	if (track == TRACE_TRACK_MAIN){
+		snprintf(name, size, "main");
+	} else if (track == TRACE_TRACK_READER){
+		snprintf(name, size, "batch reader");
+	} else if (track == TRACE_TRACK_WRITER){
+		snprintf(name, size, "batch writer");
+	} else {
+		snprintf(name, size, "worker %d", track - TRACE_TRACK_WORKERS);
+	}
+}
+
+/*
+ * Function: traceWrite
+ * -------------------------------------------------------------------------------
+ * Writes every track as Chrome trace JSON, complete ("X") events with
+ * microsecond timestamps from the start of tracing. Runs at exit.
+ * -------------------------------------------------------------------------------
+ */
+static void traceWrite(void){
+	long events = 0, dropped = 0, i;
+	int track, first = 1;
+	char name[64];
+
+	if (RINGS == NULL || getpid() != TRACE_PID){
+		return;
+	}
+	FILE *fp = fopen(TRACE_PATH, "w");
+	if (fp == NULL){
+		perror("ERROR: ");
+		return;
+	}
+	fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+	for (track = 0; track < TRACE_MAX_TRACKS; track++){
+		struct trace_ring *ring = &RINGS[track];
+		long head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+		long oldest = head > TRACE_RING_EVENTS ? head - TRACE_RING_EVENTS : 0;
+		if (head == 0){
+			continue;
+		}
+		trackName(track, name, sizeof(name));
+		fprintf(fp, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}", first ? "" : ",", (int)TRACE_PID, track, name);
+		first = 0;
+		for (i = oldest; i < head; i++){
+			const struct trace_event *e = &ring->events[i % TRACE_RING_EVENTS];
+			fprintf(fp, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f", KIND_NAMES[e->kind],
+				e->kind >= TRACE_TRIAL ? "trial" : e->kind == TRACE_IDLE ? "campaign" : "field", (int)TRACE_PID, track,
+				(e->start_ns - TRACE_START) / 1e3, e->duration_ns / 1e3);
+			if (e->count > 0){
+				fprintf(fp, ",\"args\":{\"byte\":%d,\"bit\":%d,\"bits\":%d", e->first_bit / 8, e->first_bit % 8, e->count);
+				if (e->status >= 0){
+					const char *status = STATUS_NAME ? STATUS_NAME(e->status) : NULL;
+					if (status){
+						fprintf(fp, ",\"status\":\"%s\"", status);
+					} else {
+						fprintf(fp, ",\"status\":%d", e->status);
+					}
+				}
+				fprintf(fp, "}");
+			}
+			fprintf(fp, "}");
+		}
+		events += head - oldest;
+		dropped += oldest;
+	}
+	fprintf(fp, "\n],\"otherData\":{\"sample_every\":%d,\"dropped_events\":%ld}}\n", SAMPLE_EVERY, dropped);
+	fclose(fp);
+	printf("Trace: %s, %ld events (%ld dropped)\n", TRACE_PATH, events, dropped);
+}
+
+/*
+ * Function: traceInit
+ * -------------------------------------------------------------------------------
+ * Turns tracing on for this process and every process forked from it.
+ *
+ * path: Chrome trace JSON written at exit
+ * sample_every: trials per recorded trial, on each track
+ * status_name: names the outcome of trial spans, may be NULL
+ * -------------------------------------------------------------------------------
+ */
+void traceInit(const char *path, int sample_every, const char *(*status_name)(int)){
+	// Rings are only backed by memory once written
+	RINGS = mmap(NULL, sizeof(struct trace_ring) * TRACE_MAX_TRACKS, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (RINGS == MAP_FAILED){
+		perror("ERROR: ");
+		exit(-1);
+	}
+	TRACE_PATH = path;
+	SAMPLE_EVERY = sample_every > 1 ? sample_every : 1;
+	STATUS_NAME = status_name;
+	TRACE_START = traceNow();
+	TRACE_PID = getpid();
+	atexit(traceWrite);
+}
+
+/*
+ * Function: traceTrack
+ * -------------------------------------------------------------------------------
+ * Sets the track the calling thread records on. A track must only ever be
+ * written by one thread at a time; workers past the last track share it,
+ * as they share the last telemetry slot.
+ * -------------------------------------------------------------------------------
+ */
+void traceTrack(int track){
+	TRACK = track < TRACE_MAX_TRACKS ? track : TRACE_MAX_TRACKS - 1;
+}
+
+/*
+ * Function: traceSample
+ * -------------------------------------------------------------------------------
+ * Starts a trial on the calling thread, deciding whether its spans (and
+ * those of the trial child forked for it) are recorded.
+ * -------------------------------------------------------------------------------
+ */
+void traceSample(void){
+	SKIP = SAMPLE_EVERY > 1 && TRIALS++ % SAMPLE_EVERY != 0;
+}
+
+/*
+ * Function: traceBegin
+ * -------------------------------------------------------------------------------
+ * returns: the start of a span of this kind, 0 if it is not recorded
+ * -------------------------------------------------------------------------------
+ */
+int64_t traceBegin(int kind){
+	if (RINGS == NULL || (kind >= TRACE_TRIAL && SKIP)){
+		return 0;
+	}
+	return traceNow();
+}
+
+/*
+ * Function: traceEnd
+ * -------------------------------------------------------------------------------
+ * Records a span from traceBegin until now on the calling thread's track.
+ *
+ * first_bit, count: stream bits of a trial span, count 0 for none
+ * status: outcome of a trial span, -1 for none
+ * -------------------------------------------------------------------------------
+ */
+void traceEnd(int kind, int64_t start, int first_bit, int count, int status){
+	if (start == 0){
+		return;
+	}
+	traceRecord(TRACK, kind, start, traceNow(), first_bit, count, status);
+}
+
+/*
+ * Function: traceSpan
+ * -------------------------------------------------------------------------------
+ * Records a span measured elsewhere on a given track, for spans that belong
+ * to a process which has already exited.
+ * -------------------------------------------------------------------------------
+ */
+void traceSpan(int kind, int track, int64_t start, int64_t end){
+	if (RINGS == NULL || track < 0 || track >= TRACE_MAX_TRACKS || end <= start){
+		return;
+	}
+	traceRecord(track, kind, start, end, 0, 0, -1);
+}
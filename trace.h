@@ -0,0 +1,55 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+/*
+ * Campaign timeline tracing.
+ * -------------------------------------------------------------------------------
+ * Optional spans for where a campaign's time goes, written as Chrome trace
+ * JSON (chrome://tracing, or ui.perfetto.dev which opens the same file):
+ *
+ *   load, compress, baseline    once per field and setting
+ *   trial                       fork to classification of one decompression
+ *   flip, decompress, metrics   inside the trial child
+ *   write                       the trial's row and record
+ *   crash                       reaping and classifying a trial that failed
+ *   idle                        a worker that ran out of bytes, waiting for
+ *                               the others to finish
+ *
+ * Each track (the main thread, the batch reader and writer threads, each
+ * campaign worker) has its own ring of events in shared memory, so forked
+ * workers and their trial children record without locks or system calls;
+ * only the one thread of a track ever writes it, and a trial child writes
+ * while its worker waits. A full ring overwrites its oldest events, the
+ * number lost is reported. Trials are sampled, 1 in sample_every per track
+ * records its spans, to keep the cost out of the numbers being measured.
+ * The file is written when the process exits.
+ * -------------------------------------------------------------------------------
+ */
+
+// Events kept per track
+#define TRACE_RING_EVENTS 16384
+// Tracks: main, batch reader, batch writer, then one per campaign worker
+#define TRACE_TRACK_MAIN 0
+#define TRACE_TRACK_READER 1
+#define TRACE_TRACK_WRITER 2
+#define TRACE_TRACK_WORKERS 3
+#define TRACE_MAX_TRACKS (TRACE_TRACK_WORKERS + 256)
+
+// Span kinds; the ones from TRACE_TRIAL on belong to a trial and are sampled
+enum trace_kind {
+	TRACE_LOAD, TRACE_COMPRESS, TRACE_BASELINE, TRACE_IDLE,
+	TRACE_TRIAL, TRACE_FLIP, TRACE_DECOMPRESS, TRACE_METRICS, TRACE_WRITE, TRACE_CRASH,
+	TRACE_KINDS
+};
+
+void traceInit(const char *path, int sample_every, const char *(*status_name)(int));
+void traceTrack(int track);
+void traceSample(void);
+int64_t traceBegin(int kind);
+void traceEnd(int kind, int64_t start, int first_bit, int count, int status);
+void traceSpan(int kind, int track, int64_t start, int64_t end);
+int64_t traceNow(void);
+
+#endif